@@ -0,0 +1,794 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+// This program builds the workloads in ./workload natively, for Wasm and by go2cpp, runs them, and reports the
+// results.
+//
+// The metrics are:
+//
+//   - the nanoseconds per operation of each workload (throughput),
+//   - the allocations per operation of each workload, on the Go heap and, for go2cpp, by C++'s operator new,
+//   - the startup time, which is the shortest time to run the program without a workload,
+//   - the peak RSS of each run,
+//   - the size of the generated C++ files, and the time to generate them,
+//   - the time to compile the C++ files, in wall-clock time and in CPU time,
+//   - the latency of the generated TaskQueue from Enqueue to the run of the task, alone and under contention by
+//     threads like the audio thread and the timer thread, by the C++ program in ./taskqueue.
+//
+// The results are appended to a TSV file with the commit. A previous TSV file can be given by -baseline to compare
+// the results across commits.
+//
+// -gen-flags passes flags to gowasm2cpp, e.g. -gen-flags="-structured -cacheglobals". The go2cpp mode is then
+// labeled with the flags like go2cpp[-structured -cacheglobals] in the results, so that the results by different
+// generator flags are never compared as the same mode.
+//
+// -gen-flags can be given more than once to build and run go2cpp with each set of the flags. Then the results of
+// each set are also compared with the first set. For example, this compares the goto lowering with the structured
+// lowering of the control flow:
+//
+//	./run.sh -modes=go2cpp -gen-flags= -gen-flags=-structured
+//
+// The workloads like utf8-valid and bytealg-count each measure a Go function that go2cpp replaces with a host
+// implementation (an intrinsic). -intrinsics-off adds a go2cpp variant where the intrinsics are disabled by empty bodies
+// in -intrinsics, so that each intrinsic is compared with the translated function:
+//
+//	./run.sh -modes=go2cpp -intrinsics-off
+package main
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/json"
+	"flag"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"runtime"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"syscall"
+	"text/tabwriter"
+	"time"
+)
+
+var (
+	flagModes     = flag.String("modes", "native,wasm,go2cpp", "comma-separated modes to run")
+	flagWorkloads = flag.String("workloads", "", "comma-separated workloads to run, or empty to run all")
+	flagDuration  = flag.Duration("duration", time.Second, "the duration to run each workload")
+	flagCount     = flag.Int("count", 3, "the number of runs of each workload, of which the best is reported")
+	flagCXX       = flag.String("cxx", "", "the C++ compiler, or empty to use $CXX or clang++")
+	flagCXXFlags  = flag.String("cxxflags", "-O3 -std=c++14 -pthread", "the C++ compiler flags")
+	flagWork      = flag.String("work", "_work", "the directory for the built files")
+	flagOut       = flag.String("o", "results.tsv", "the TSV file to append the results to, or empty not to write")
+	flagBaseline  = flag.String("baseline", "", "a TSV file of the results of another commit to compare with")
+	flagIntrinOff = flag.Bool("intrinsics-off", false, "also run go2cpp with the intrinsics measured by the workloads disabled")
+	flagGenFlags  genFlagsList
+)
+
+// intrinsicWorkloads maps the workloads to the Go functions, as in the Wasm name section, whose intrinsics they
+// measure.
+var intrinsicWorkloads = []struct {
+	workload string
+	funcs    []string
+}{
+	{"utf8-valid", []string{"unicode_utf8.Valid", "unicode_utf8.ValidString"}},
+	{"utf8-runecount", []string{"unicode_utf8.RuneCount", "unicode_utf8.RuneCountInString"}},
+	{"bytealg-count", []string{"internal_bytealg.Count", "internal_bytealg.CountString"}},
+	{"bytealg-index", []string{"memchr"}},
+	{"bytealg-equal", []string{"memeqbody"}},
+	// cmpbody calls memcmp, which go2cpp cannot translate and always replaces.
+	{"bytealg-compare", []string{"cmpbody"}},
+	{"sha256", []string{"crypto_sha256.block", "crypto_sha256.blockGeneric"}},
+	{"crc32", []string{"hash_crc32.simpleUpdate", "hash_crc32.slicingUpdate"}},
+	{"big", []string{"math_big.addVV", "math_big.addVV_g", "math_big.subVV", "math_big.subVV_g", "math_big.addVW", "math_big.addVW_g", "math_big.subVW", "math_big.subVW_g", "math_big.mulAddVWW", "math_big.mulAddVWW_g", "math_big.addMulVVW", "math_big.addMulVVW_g"}},
+}
+
+// writeIntrinsicsOff writes a JSON file for -intrinsics of gowasm2cpp to disable the intrinsics in intrinsicWorkloads.
+func writeIntrinsicsOff(path string) error {
+	m := map[string]string{}
+	for _, w := range intrinsicWorkloads {
+		for _, f := range w.funcs {
+			m[f] = ""
+		}
+	}
+	b, err := json.MarshalIndent(m, "", "  ")
+	if err != nil {
+		return err
+	}
+	return ioutil.WriteFile(path, b, 0644)
+}
+
+func init() {
+	flag.Var(&flagGenFlags, "gen-flags", "the space-separated flags for gowasm2cpp, e.g. -structured or -pgo=cpu.pprof (repeatable)")
+}
+
+// genFlagsList is the values of -gen-flags.
+type genFlagsList []string
+
+func (l *genFlagsList) String() string {
+	return strings.Join(*l, ", ")
+}
+
+func (l *genFlagsList) Set(value string) error {
+	*l = append(*l, value)
+	return nil
+}
+
+// mainCppContent is the main function of the program by go2cpp. This is written to the work directory, as Go doesn't
+// allow C++ files in a directory of a Go package without cgo.
+//
+// The program counts the allocations by operator new, and prints the count at exit.
+const mainCppContent = `#include "autogen/go.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<long long> allocCount{0};
+
+void* operator new(std::size_t size) {
+  allocCount.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+int main(int argc, char *argv[]) {
+  int code = 0;
+  {
+    go2cpp_autogen::Go go;
+    code = go.Run(argc, argv);
+  }
+  std::printf("cpp-allocs %lld\n", allocCount.load());
+  return code;
+}
+`
+
+// result is a measured value.
+type result struct {
+	mode   string
+	metric string
+	value  float64
+	unit   string
+}
+
+// variant is a build by go2cpp with a set of generator flags.
+type variant struct {
+	// name is the mode name in the results.
+	name     string
+	dir      string
+	genFlags []string
+}
+
+type runner struct {
+	work     string
+	variants []variant
+	results  []result
+}
+
+func (r *runner) add(mode, metric string, value float64, unit string) {
+	r.results = append(r.results, result{mode: mode, metric: metric, value: value, unit: unit})
+}
+
+func (r *runner) path(name string) string {
+	return filepath.Join(r.work, name)
+}
+
+// newVariants returns the go2cpp builds for the values of -gen-flags.
+func (r *runner) newVariants(values []string) []variant {
+	if len(values) == 0 {
+		values = []string{""}
+	}
+	var vs []variant
+	for i, value := range values {
+		v := variant{
+			name:     "go2cpp",
+			dir:      r.path("go2cpp"),
+			genFlags: strings.Fields(value),
+		}
+		if len(v.genFlags) > 0 {
+			v.name += "[" + strings.Join(v.genFlags, " ") + "]"
+		}
+		if i > 0 {
+			v.dir = r.path(fmt.Sprintf("go2cpp%d", i))
+		}
+		vs = append(vs, v)
+	}
+	return vs
+}
+
+func command(env []string, name string, args ...string) *exec.Cmd {
+	cmd := exec.Command(name, args...)
+	cmd.Env = append(os.Environ(), env...)
+	cmd.Stderr = os.Stderr
+	return cmd
+}
+
+// timed runs cmd, and returns the wall-clock time and the CPU time of the process and its children.
+func timed(cmd *exec.Cmd) (time.Duration, time.Duration, error) {
+	start := time.Now()
+	if err := cmd.Run(); err != nil {
+		return 0, 0, fmt.Errorf("%s: %v", strings.Join(cmd.Args, " "), err)
+	}
+	return time.Since(start), cmd.ProcessState.UserTime() + cmd.ProcessState.SystemTime(), nil
+}
+
+// maxRSS returns the peak RSS of the finished process in bytes.
+func maxRSS(state *os.ProcessState) int64 {
+	ru, ok := state.SysUsage().(*syscall.Rusage)
+	if !ok {
+		return 0
+	}
+	// ru_maxrss is in bytes on macOS, and in kilobytes on the other platforms.
+	if runtime.GOOS == "darwin" {
+		return int64(ru.Maxrss)
+	}
+	return int64(ru.Maxrss) * 1024
+}
+
+func dirSize(dir string) (int64, int, error) {
+	var size int64
+	var n int
+	if err := filepath.Walk(dir, func(path string, info os.FileInfo, err error) error {
+		if err != nil {
+			return err
+		}
+		if !info.IsDir() {
+			size += info.Size()
+			n++
+		}
+		return nil
+	}); err != nil {
+		return 0, 0, err
+	}
+	return size, n, nil
+}
+
+func (r *runner) buildNative() error {
+	_, _, err := timed(command(nil, "go", "build", "-tags", "example", "-o", r.path("native"), "./workload"))
+	return err
+}
+
+func (r *runner) buildWasm() error {
+	_, _, err := timed(command([]string{"GOOS=js", "GOARCH=wasm"}, "go", "build", "-tags", "example", "-o", r.path("bench.wasm"), "./workload"))
+	return err
+}
+
+func cxx() string {
+	if *flagCXX != "" {
+		return *flagCXX
+	}
+	if cxx := os.Getenv("CXX"); cxx != "" {
+		return cxx
+	}
+	return "clang++"
+}
+
+func (r *runner) buildGo2Cpp(v variant) error {
+	autogen := filepath.Join(v.dir, "autogen")
+	if err := os.RemoveAll(autogen); err != nil {
+		return err
+	}
+	mode := v.name
+	args := []string{"run", "../cmd/gowasm2cpp", "-out", autogen, "-include", "autogen", "-wasm", r.path("bench.wasm"), "-namespace", "go2cpp_autogen"}
+	args = append(args, v.genFlags...)
+	wall, _, err := timed(command(nil, "go", args...))
+	if err != nil {
+		return err
+	}
+	r.add(mode, "generate-time", wall.Seconds(), "s")
+
+	size, n, err := dirSize(autogen)
+	if err != nil {
+		return err
+	}
+	r.add(mode, "cpp-size", float64(size), "B")
+	r.add(mode, "cpp-files", float64(n), "")
+
+	cxxflags := strings.Fields(*flagCXXFlags)
+
+	srcs, err := filepath.Glob(filepath.Join(autogen, "*.cpp"))
+	if err != nil {
+		return err
+	}
+	mainCpp := filepath.Join(v.dir, "main.cpp")
+	if err := ioutil.WriteFile(mainCpp, []byte(mainCppContent), 0644); err != nil {
+		return err
+	}
+	srcs = append(srcs, mainCpp)
+
+	// Compile the files in parallel as a build system would.
+	start := time.Now()
+	var cpu time.Duration
+	var objs []string
+	var m sync.Mutex
+	var firstErr error
+	sem := make(chan struct{}, runtime.NumCPU())
+	var wg sync.WaitGroup
+	for i, src := range srcs {
+		obj := filepath.Join(v.dir, fmt.Sprintf("obj%d.o", i))
+		objs = append(objs, obj)
+		args := append(append([]string{}, cxxflags...), "-I"+v.dir, "-c", "-o", obj, src)
+		wg.Add(1)
+		sem <- struct{}{}
+		go func() {
+			defer wg.Done()
+			defer func() { <-sem }()
+			_, c, err := timed(command(nil, cxx(), args...))
+			m.Lock()
+			defer m.Unlock()
+			cpu += c
+			if err != nil && firstErr == nil {
+				firstErr = err
+			}
+		}()
+	}
+	wg.Wait()
+	if firstErr != nil {
+		return firstErr
+	}
+	args = append(append([]string{}, cxxflags...), "-o", filepath.Join(v.dir, "go2cpp"))
+	args = append(args, objs...)
+	_, c, err := timed(command(nil, cxx(), args...))
+	if err != nil {
+		return err
+	}
+	cpu += c
+	r.add(mode, "compile-time", time.Since(start).Seconds(), "s")
+	r.add(mode, "compile-cpu-time", cpu.Seconds(), "s")
+	return nil
+}
+
+// wasmExecNode returns the path of wasm_exec_node.js in GOROOT.
+func wasmExecNode() (string, error) {
+	out, err := exec.Command("go", "env", "GOROOT").Output()
+	if err != nil {
+		return "", err
+	}
+	goroot := strings.TrimSpace(string(out))
+	for _, dir := range []string{"lib/wasm", "misc/wasm"} {
+		path := filepath.Join(goroot, dir, "wasm_exec_node.js")
+		if _, err := os.Stat(path); err == nil {
+			return path, nil
+		}
+	}
+	return "", fmt.Errorf("wasm_exec_node.js is not found in %s", goroot)
+}
+
+// program returns the command line to run the program of the mode except for go2cpp, whose programs are per variant.
+func (r *runner) program(mode string) ([]string, error) {
+	switch mode {
+	case "native":
+		return []string{r.path("native")}, nil
+	case "wasm":
+		js, err := wasmExecNode()
+		if err != nil {
+			return nil, err
+		}
+		return []string{"node", js, r.path("bench.wasm")}, nil
+	}
+	return nil, fmt.Errorf("unknown mode: %s", mode)
+}
+
+// runWorkload runs the program and returns the output, the wall-clock time and the peak RSS.
+func runWorkload(program []string, args ...string) ([]byte, time.Duration, int64, error) {
+	var out bytes.Buffer
+	cmd := command(nil, program[0], append(program[1:], args...)...)
+	cmd.Stdout = &out
+	wall, _, err := timed(cmd)
+	if err != nil {
+		return nil, 0, 0, err
+	}
+	return out.Bytes(), wall, maxRSS(cmd.ProcessState), nil
+}
+
+// runTaskQueue builds ./taskqueue with the TaskQueue generated for v, runs it, and adds the best latencies.
+func (r *runner) runTaskQueue(v variant) error {
+	bin := filepath.Join(v.dir, "taskqueue")
+	args := append(strings.Fields(*flagCXXFlags), "-I"+v.dir, "-o", bin, filepath.Join("taskqueue", "main.cpp"), filepath.Join(v.dir, "autogen", "taskqueue.cpp"))
+	if _, _, err := timed(command(nil, cxx(), args...)); err != nil {
+		return err
+	}
+
+	var names []string
+	best := map[string]float64{}
+	for i := 0; i < *flagCount; i++ {
+		out, _, _, err := runWorkload([]string{bin}, strconv.FormatFloat(flagDuration.Seconds(), 'g', -1, 64))
+		if err != nil {
+			return err
+		}
+		for _, line := range strings.Split(strings.TrimSpace(string(out)), "\n") {
+			fs := strings.Fields(line)
+			if len(fs) != 3 || fs[0] != "latency" {
+				return fmt.Errorf("taskqueue: unexpected output: %q", line)
+			}
+			ns, err := strconv.ParseFloat(fs[2], 64)
+			if err != nil {
+				return err
+			}
+			old, ok := best[fs[1]]
+			if !ok {
+				names = append(names, fs[1])
+			}
+			if !ok || ns < old {
+				best[fs[1]] = ns
+			}
+		}
+	}
+	for _, name := range names {
+		r.add(v.name, "taskqueue/"+name, best[name], "ns")
+	}
+	return nil
+}
+
+// outputLine returns the fields of the first line of out that starts with one of the prefixes, or nil.
+func outputLine(out []byte, prefixes ...string) []string {
+	for _, line := range strings.Split(string(out), "\n") {
+		fs := strings.Fields(line)
+		if len(fs) == 0 {
+			continue
+		}
+		for _, p := range prefixes {
+			if fs[0] == p {
+				return fs
+			}
+		}
+	}
+	return nil
+}
+
+// cppAllocs returns the number of the C++ allocations that the program by go2cpp reports at exit.
+func cppAllocs(out []byte) (float64, bool) {
+	fs := outputLine(out, "cpp-allocs")
+	if len(fs) < 2 {
+		return 0, false
+	}
+	n, err := strconv.ParseFloat(fs[1], 64)
+	if err != nil {
+		return 0, false
+	}
+	return n, true
+}
+
+// run runs the workloads by program, and adds the results as the mode name.
+func (r *runner) run(name string, program []string, workloads []string) error {
+	var startup time.Duration
+	var startupRSS int64
+	var startupAllocs float64
+	for i := 0; i < *flagCount; i++ {
+		out, wall, rss, err := runWorkload(program)
+		if err != nil {
+			return err
+		}
+		if i == 0 || wall < startup {
+			startup = wall
+			startupRSS = rss
+		}
+		if n, ok := cppAllocs(out); ok && (i == 0 || n < startupAllocs) {
+			startupAllocs = n
+		}
+	}
+	r.add(name, "startup-time", startup.Seconds()*1000, "ms")
+	r.add(name, "startup-rss", float64(startupRSS), "B")
+
+	for _, w := range workloads {
+		var best float64
+		var bestRSS int64
+		bestAllocs := -1.0
+		bestCppAllocs := -1.0
+		skipped := false
+		for i := 0; i < *flagCount; i++ {
+			out, _, rss, err := runWorkload(program, "-workload", w, "-duration", flagDuration.String())
+			if err != nil {
+				return err
+			}
+			fs := outputLine(out, "result", "skip")
+			if len(fs) >= 2 && fs[0] == "skip" {
+				skipped = true
+				break
+			}
+			if len(fs) < 5 || fs[0] != "result" {
+				return fmt.Errorf("%s %s: unexpected output: %q", name, w, out)
+			}
+			ops, err := strconv.ParseFloat(fs[2], 64)
+			if err != nil {
+				return err
+			}
+			ns, err := strconv.ParseFloat(fs[3], 64)
+			if err != nil {
+				return err
+			}
+			allocs, err := strconv.ParseFloat(fs[4], 64)
+			if err != nil {
+				return err
+			}
+			if i == 0 || ns < best {
+				best = ns
+			}
+			if rss > bestRSS {
+				bestRSS = rss
+			}
+			if bestAllocs < 0 || allocs < bestAllocs {
+				bestAllocs = allocs
+			}
+			// The C++ allocations are counted for the whole process. The allocations at startup are subtracted, and
+			// the rest are mostly by the operations.
+			if n, ok := cppAllocs(out); ok {
+				perOp := (n - startupAllocs) / ops
+				if bestCppAllocs < 0 || perOp < bestCppAllocs {
+					bestCppAllocs = perOp
+				}
+			}
+		}
+		if skipped {
+			continue
+		}
+		r.add(name, w+"/time", best, "ns/op")
+		r.add(name, w+"/rss", float64(bestRSS), "B")
+		r.add(name, w+"/allocs", bestAllocs, "allocs/op")
+		if bestCppAllocs >= 0 {
+			r.add(name, w+"/cpp-allocs", bestCppAllocs, "allocs/op")
+		}
+	}
+	return nil
+}
+
+func commit() string {
+	out, err := exec.Command("git", "rev-parse", "--short", "HEAD").Output()
+	if err != nil {
+		return "unknown"
+	}
+	c := strings.TrimSpace(string(out))
+	if out, err := exec.Command("git", "status", "--porcelain", "--untracked-files=no").Output(); err == nil && len(bytes.TrimSpace(out)) > 0 {
+		c += "-dirty"
+	}
+	return c
+}
+
+type key struct {
+	mode   string
+	metric string
+}
+
+// readBaseline reads the results of the last commit in a TSV file.
+func readBaseline(path string) (string, map[key]float64, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return "", nil, err
+	}
+	defer f.Close()
+
+	var last string
+	values := map[key]float64{}
+	s := bufio.NewScanner(f)
+	for s.Scan() {
+		fs := strings.Split(s.Text(), "\t")
+		if len(fs) < 5 || fs[0] == "commit" {
+			continue
+		}
+		if fs[0] != last {
+			last = fs[0]
+			values = map[key]float64{}
+		}
+		v, err := strconv.ParseFloat(fs[4], 64)
+		if err != nil {
+			return "", nil, err
+		}
+		values[key{mode: fs[2], metric: fs[3]}] = v
+	}
+	if err := s.Err(); err != nil {
+		return "", nil, err
+	}
+	return last, values, nil
+}
+
+func (r *runner) print(w io.Writer, baselineCommit string, baseline map[key]float64) {
+	sort.SliceStable(r.results, func(a, b int) bool {
+		return r.results[a].mode < r.results[b].mode
+	})
+	tw := tabwriter.NewWriter(w, 0, 8, 2, ' ', tabwriter.AlignRight)
+	if baseline != nil {
+		fmt.Fprintf(tw, "mode\tmetric\tvalue\tunit\t%s\tdelta\t\n", baselineCommit)
+	} else {
+		fmt.Fprintf(tw, "mode\tmetric\tvalue\tunit\t\n")
+	}
+	for _, res := range r.results {
+		if baseline == nil {
+			fmt.Fprintf(tw, "%s\t%s\t%.6g\t%s\t\n", res.mode, res.metric, res.value, res.unit)
+			continue
+		}
+		old, ok := baseline[key{mode: res.mode, metric: res.metric}]
+		if !ok || old == 0 {
+			fmt.Fprintf(tw, "%s\t%s\t%.6g\t%s\t-\t-\t\n", res.mode, res.metric, res.value, res.unit)
+			continue
+		}
+		fmt.Fprintf(tw, "%s\t%s\t%.6g\t%s\t%.6g\t%+.1f%%\t\n", res.mode, res.metric, res.value, res.unit, old, (res.value-old)/old*100)
+	}
+	tw.Flush()
+}
+
+// printVariants prints the results of the go2cpp variants compared with the first variant.
+func (r *runner) printVariants(w io.Writer) {
+	ref := r.variants[0].name
+	values := map[string]float64{}
+	for _, res := range r.results {
+		if res.mode == ref {
+			values[res.metric] = res.value
+		}
+	}
+	tw := tabwriter.NewWriter(w, 0, 8, 2, ' ', tabwriter.AlignRight)
+	fmt.Fprintf(tw, "mode\tmetric\tvalue\tunit\t%s\tdelta\t\n", ref)
+	for _, v := range r.variants[1:] {
+		for _, res := range r.results {
+			if res.mode != v.name {
+				continue
+			}
+			old, ok := values[res.metric]
+			if !ok || old == 0 {
+				fmt.Fprintf(tw, "%s\t%s\t%.6g\t%s\t-\t-\t\n", res.mode, res.metric, res.value, res.unit)
+				continue
+			}
+			fmt.Fprintf(tw, "%s\t%s\t%.6g\t%s\t%.6g\t%+.1f%%\t\n", res.mode, res.metric, res.value, res.unit, old, (res.value-old)/old*100)
+		}
+	}
+	tw.Flush()
+}
+
+func (r *runner) write(path string, commit string) error {
+	_, err := os.Stat(path)
+	exists := err == nil
+	f, err := os.OpenFile(path, os.O_WRONLY|os.O_APPEND|os.O_CREATE, 0644)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+
+	if !exists {
+		if _, err := fmt.Fprintf(f, "commit\tdate\tmode\tmetric\tvalue\tunit\n"); err != nil {
+			return err
+		}
+	}
+	date := time.Now().UTC().Format(time.RFC3339)
+	for _, res := range r.results {
+		if _, err := fmt.Fprintf(f, "%s\t%s\t%s\t%s\t%g\t%s\n", commit, date, res.mode, res.metric, res.value, res.unit); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func listWorkloads(r *runner) ([]string, error) {
+	if *flagWorkloads != "" {
+		return strings.Split(*flagWorkloads, ","), nil
+	}
+	out, _, _, err := runWorkload([]string{r.path("native")}, "-list")
+	if err != nil {
+		return nil, err
+	}
+	return strings.Fields(string(out)), nil
+}
+
+func run() error {
+	r := &runner{work: *flagWork}
+	if err := os.MkdirAll(r.work, 0755); err != nil {
+		return err
+	}
+	genFlags := append([]string{}, flagGenFlags...)
+	if len(genFlags) == 0 {
+		genFlags = []string{""}
+	}
+	if *flagIntrinOff {
+		path := r.path("intrinsics-off.json")
+		if err := writeIntrinsicsOff(path); err != nil {
+			return err
+		}
+		genFlags = append(genFlags, genFlags[0]+" -intrinsics="+path)
+	}
+	r.variants = r.newVariants(genFlags)
+
+	modes := strings.Split(*flagModes, ",")
+	has := map[string]bool{}
+	for _, m := range modes {
+		has[m] = true
+	}
+
+	// The native program lists the workloads.
+	if err := r.buildNative(); err != nil {
+		return err
+	}
+	if has["wasm"] || has["go2cpp"] {
+		if err := r.buildWasm(); err != nil {
+			return err
+		}
+		wasm, err := ioutil.ReadFile(r.path("bench.wasm"))
+		if err != nil {
+			return err
+		}
+		r.add("wasm", "wasm-size", float64(len(wasm)), "B")
+	}
+	if has["go2cpp"] {
+		for _, v := range r.variants {
+			if err := os.MkdirAll(v.dir, 0755); err != nil {
+				return err
+			}
+			if err := r.buildGo2Cpp(v); err != nil {
+				return err
+			}
+		}
+	}
+
+	workloads, err := listWorkloads(r)
+	if err != nil {
+		return err
+	}
+	for _, m := range modes {
+		if m == "go2cpp" {
+			for _, v := range r.variants {
+				fmt.Fprintf(os.Stderr, "# Run %s\n", v.name)
+				if err := r.run(v.name, []string{filepath.Join(v.dir, "go2cpp")}, workloads); err != nil {
+					return err
+				}
+			}
+			// The generator flags don't change TaskQueue.
+			if err := r.runTaskQueue(r.variants[0]); err != nil {
+				return err
+			}
+			continue
+		}
+		fmt.Fprintf(os.Stderr, "# Run %s\n", m)
+		program, err := r.program(m)
+		if err != nil {
+			return err
+		}
+		if err := r.run(m, program, workloads); err != nil {
+			return err
+		}
+	}
+
+	c := commit()
+	var baselineCommit string
+	var baseline map[key]float64
+	if *flagBaseline != "" {
+		baselineCommit, baseline, err = readBaseline(*flagBaseline)
+		if err != nil {
+			return err
+		}
+	}
+	fmt.Printf("# %s\n", c)
+	r.print(os.Stdout, baselineCommit, baseline)
+	if has["go2cpp"] && len(r.variants) > 1 {
+		fmt.Printf("\n# go2cpp variants\n")
+		r.printVariants(os.Stdout)
+	}
+
+	if *flagOut != "" {
+		if err := r.write(*flagOut, c); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func main() {
+	flag.Parse()
+	if err := run(); err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		os.Exit(1)
+	}
+}
@@ -0,0 +1,2 @@
+set -e
+go run -tags example . "$@"
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// This program measures the latency of TaskQueue from Enqueue to the start of the task on the thread running Go. A
+// probe thread enqueues tasks that record the latencies, first alone and then with other threads enqueuing tasks like
+// the audio thread and the timer thread do.
+//
+// The argument is the duration of each scenario in seconds. The program prints lines:
+//
+//   latency <scenario>-<statistic> <nanoseconds>
+
+#include "autogen/taskqueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using go2cpp_autogen::TaskQueue;
+using Clock = std::chrono::steady_clock;
+
+// An audio callback is called every 128 frames at 44100 Hz, and posts tasks for the players.
+constexpr int kAudioThreadNum = 2;
+constexpr auto kAudioPeriod = std::chrono::microseconds(2902);
+constexpr int kAudioTasksPerPeriod = 16;
+
+// A timer thread posts a task for every timer that fires, e.g. for time.Sleep and time.Ticker in goroutines.
+constexpr int kTimerThreadNum = 2;
+constexpr auto kTimerPeriod = std::chrono::microseconds(50);
+
+constexpr auto kProbePeriod = std::chrono::microseconds(100);
+
+void RunScenario(const char* name, double duration, bool contended) {
+  TaskQueue queue;
+  std::atomic<bool> done{false};
+  bool stopped = false;
+  // latencies and work are touched only by the tasks, which run on this thread.
+  std::vector<int64_t> latencies;
+  int64_t work = 0;
+
+  std::vector<std::thread> threads;
+  if (contended) {
+    for (int i = 0; i < kAudioThreadNum; i++) {
+      threads.emplace_back([&queue, &done, &work]() {
+        auto next = Clock::now();
+        while (!done.load(std::memory_order_relaxed)) {
+          for (int j = 0; j < kAudioTasksPerPeriod; j++) {
+            queue.Enqueue([&work, j]() { work += j; });
+          }
+          next += kAudioPeriod;
+          std::this_thread::sleep_until(next);
+        }
+      });
+    }
+    for (int i = 0; i < kTimerThreadNum; i++) {
+      threads.emplace_back([&queue, &done, &work]() {
+        while (!done.load(std::memory_order_relaxed)) {
+          queue.Enqueue([&work]() { work++; });
+          std::this_thread::sleep_for(kTimerPeriod);
+        }
+      });
+    }
+  }
+  std::thread probe([&queue, &done, &latencies]() {
+    while (!done.load(std::memory_order_relaxed)) {
+      Clock::time_point enqueued = Clock::now();
+      queue.Enqueue([&latencies, enqueued]() {
+        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - enqueued).count());
+      });
+      std::this_thread::sleep_for(kProbePeriod);
+    }
+  });
+
+  std::thread stopper([&queue, &done, &stopped, duration]() {
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    done = true;
+    queue.Enqueue([&stopped]() { stopped = true; });
+  });
+
+  // Run the tasks as Go::Run does.
+  std::vector<TaskQueue::Task> tasks;
+  while (!stopped) {
+    queue.DequeueAll(tasks);
+    for (TaskQueue::Task& task : tasks) {
+      task();
+    }
+    tasks.clear();
+  }
+
+  stopper.join();
+  probe.join();
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  // The tasks enqueued after the stop are never run, and are destructed with the queue.
+
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+  };
+  std::printf("latency %s-p50 %lld\n", name, static_cast<long long>(percentile(0.5)));
+  std::printf("latency %s-p99 %lld\n", name, static_cast<long long>(percentile(0.99)));
+  std::printf("latency %s-max %lld\n", name, static_cast<long long>(latencies.back()));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  double duration = 1;
+  if (argc > 1) {
+    duration = std::atof(argv[1]);
+  }
+  RunScenario("idle", duration, false);
+  RunScenario("contended", duration, true);
+  return 0;
+}
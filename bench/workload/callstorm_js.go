@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example,js
+
+package main
+
+import (
+	"syscall/js"
+)
+
+// setupCallStorm returns an operation calling syscall/js many times like a game calling WebGL every frame.
+func setupCallStorm() func() {
+	const n = 100
+	obj := js.Global().Get("Object").New()
+	arr := js.Global().Get("Uint8Array").New(256)
+	crypto := js.Global().Get("crypto")
+	buf := make([]byte, 256)
+	return func() {
+		s := 0
+		for i := 0; i < n; i++ {
+			obj.Set("x", i)
+			s += obj.Get("x").Int()
+			buf[0] = byte(i)
+			js.CopyBytesToJS(arr, buf)
+			if i%10 == 0 {
+				crypto.Call("getRandomValues", arr)
+			}
+			js.CopyBytesToGo(buf, arr)
+		}
+		sink = s
+	}
+}
+
+// setupValueCall returns an operation calling a host function once by syscall/js.valueCall. The host function does
+// almost nothing, so the allocations per operation are the costs of a call from Go to the host.
+func setupValueCall() func() {
+	crypto := js.Global().Get("crypto")
+	arr := js.Global().Get("Uint8Array").New(1)
+	return func() {
+		crypto.Call("getRandomValues", arr)
+	}
+}
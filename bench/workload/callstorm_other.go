@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example,!js
+
+package main
+
+// setupCallStorm returns nil as syscall/js is not available.
+func setupCallStorm() func() {
+	return nil
+}
+
+// setupValueCall returns nil as syscall/js is not available.
+func setupValueCall() func() {
+	return nil
+}
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+package main
+
+import (
+	"bytes"
+	"hash/crc32"
+	"math/big"
+	"strings"
+	"unicode/utf8"
+)
+
+// The workloads in this file each call a Go function that go2cpp replaces with a host implementation (an intrinsic),
+// so that the intrinsic can be compared with the translated function.
+
+// intrinsicText returns 64KiB of text, mostly ASCII with some multi-byte runes, in lines.
+func intrinsicText() []byte {
+	var b bytes.Buffer
+	for i := 0; b.Len() < 64*1024; i++ {
+		if i%8 == 0 {
+			b.WriteString("こんにちは、世界。Grüße aus go2cpp! ")
+		} else {
+			b.WriteString("The quick brown fox jumps over the lazy dog. ")
+		}
+		if i%4 == 3 {
+			b.WriteByte('\n')
+		}
+	}
+	return b.Bytes()[:64*1024]
+}
+
+func setupUTF8Valid() func() {
+	b := intrinsicText()
+	// Cut the text at a rune boundary so that it is valid.
+	for !utf8.Valid(b) {
+		b = b[:len(b)-1]
+	}
+	s := string(b)
+	return func() {
+		sink = utf8.Valid(b) && utf8.ValidString(s)
+	}
+}
+
+func setupUTF8RuneCount() func() {
+	b := intrinsicText()
+	s := string(b)
+	return func() {
+		sink = utf8.RuneCount(b) + utf8.RuneCountInString(s)
+	}
+}
+
+func setupBytealgCount() func() {
+	b := intrinsicText()
+	s := string(b)
+	return func() {
+		sink = bytes.Count(b, []byte{'\n'}) + strings.Count(s, "o")
+	}
+}
+
+func setupBytealgIndex() func() {
+	b := intrinsicText()
+	return func() {
+		n := 0
+		for rest := b; ; {
+			i := bytes.IndexByte(rest, '\n')
+			if i < 0 {
+				break
+			}
+			n++
+			rest = rest[i+1:]
+		}
+		sink = n
+	}
+}
+
+func setupBytealgEqual() func() {
+	a := intrinsicText()
+	b := append([]byte{}, a...)
+	return func() {
+		sink = bytes.Equal(a, b)
+	}
+}
+
+func setupBytealgCompare() func() {
+	a := intrinsicText()
+	b := append([]byte{}, a...)
+	b[len(b)-1]++
+	// runtime.cmpstring calls cmpbody.
+	sa, sb := string(a), string(b)
+	return func() {
+		sink = sa < sb
+	}
+}
+
+func setupCRC32() func() {
+	b := intrinsicText()
+	return func() {
+		sink = crc32.ChecksumIEEE(b)
+	}
+}
+
+func setupBig() func() {
+	x := new(big.Int).Exp(big.NewInt(3), big.NewInt(4000), nil)
+	y := new(big.Int).Exp(big.NewInt(7), big.NewInt(3000), nil)
+	z := new(big.Int)
+	return func() {
+		z.Mul(x, y)
+		z.Add(z, x)
+		sink = z.Bit(0)
+	}
+}
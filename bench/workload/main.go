@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+// This program is the workloads of the benchmarks. The same program runs natively, on Wasm and on go2cpp.
+//
+// Each workload repeats its operation for the duration, and prints a line:
+//
+//	result <workload> <operations> <nanoseconds per operation> <Go heap allocations per operation>
+package main
+
+import (
+	"bytes"
+	"crypto/sha256"
+	"encoding/json"
+	"flag"
+	"fmt"
+	"math/rand"
+	"os"
+	"regexp"
+	"runtime"
+	"sort"
+	"strconv"
+	"strings"
+	"time"
+)
+
+type workload struct {
+	name string
+	// setup prepares the data and returns the operation.
+	setup func() func()
+}
+
+var workloads = []workload{
+	{"json", setupJSON},
+	{"sort", setupSort},
+	{"map", setupMap},
+	{"sha256", setupSHA256},
+	{"regexp", setupRegexp},
+	{"goroutine", setupGoroutine},
+	{"gc", setupGC},
+	{"utf8-valid", setupUTF8Valid},
+	{"utf8-runecount", setupUTF8RuneCount},
+	{"bytealg-count", setupBytealgCount},
+	{"bytealg-index", setupBytealgIndex},
+	{"bytealg-equal", setupBytealgEqual},
+	{"bytealg-compare", setupBytealgCompare},
+	{"crc32", setupCRC32},
+	{"big", setupBig},
+	{"callstorm", setupCallStorm},
+	{"valuecall", setupValueCall},
+}
+
+// sink keeps the results of the operations alive.
+var sink interface{}
+
+type record struct {
+	ID     int               `json:"id"`
+	Name   string            `json:"name"`
+	Score  float64           `json:"score"`
+	Tags   []string          `json:"tags"`
+	Labels map[string]string `json:"labels"`
+}
+
+func setupJSON() func() {
+	var records []record
+	for i := 0; i < 100; i++ {
+		records = append(records, record{
+			ID:     i,
+			Name:   "record" + strconv.Itoa(i),
+			Score:  float64(i) * 1.5,
+			Tags:   []string{"a", "b", "c"},
+			Labels: map[string]string{"key": "value", "index": strconv.Itoa(i)},
+		})
+	}
+	return func() {
+		b, err := json.Marshal(records)
+		if err != nil {
+			panic(err)
+		}
+		var decoded []record
+		if err := json.Unmarshal(b, &decoded); err != nil {
+			panic(err)
+		}
+		sink = decoded
+	}
+}
+
+func setupSort() func() {
+	r := rand.New(rand.NewSource(1))
+	src := make([]int, 10000)
+	for i := range src {
+		src[i] = r.Int()
+	}
+	dst := make([]int, len(src))
+	return func() {
+		copy(dst, src)
+		sort.Ints(dst)
+	}
+}
+
+func setupMap() func() {
+	keys := make([]string, 1000)
+	for i := range keys {
+		keys[i] = "key" + strconv.Itoa(i)
+	}
+	return func() {
+		m := map[string]int{}
+		for i, k := range keys {
+			m[k] = i
+		}
+		s := 0
+		for _, k := range keys {
+			s += m[k]
+		}
+		for _, k := range keys[:len(keys)/2] {
+			delete(m, k)
+		}
+		sink = s + len(m)
+	}
+}
+
+func setupSHA256() func() {
+	b := bytes.Repeat([]byte("go2cpp"), 64*1024/6)
+	return func() {
+		sink = sha256.Sum256(b)
+	}
+}
+
+func setupRegexp() func() {
+	re := regexp.MustCompile(`(\w+)@(\w+)\.(com|org|net)`)
+	var lines []string
+	for i := 0; i < 100; i++ {
+		if i%3 == 0 {
+			lines = append(lines, fmt.Sprintf("user%d@example%d.org wrote a message", i, i))
+		} else {
+			lines = append(lines, fmt.Sprintf("line %d without any address in it", i))
+		}
+	}
+	text := strings.Join(lines, "\n")
+	return func() {
+		sink = re.FindAllStringSubmatch(text, -1)
+	}
+}
+
+func setupGoroutine() func() {
+	const n = 100
+	ping := make(chan int)
+	pong := make(chan int)
+	go func() {
+		for v := range ping {
+			pong <- v + 1
+		}
+	}()
+	return func() {
+		v := 0
+		for i := 0; i < n; i++ {
+			ping <- v
+			v = <-pong
+		}
+		sink = v
+	}
+}
+
+type node struct {
+	left, right *node
+	value       int
+}
+
+func newTree(depth int) *node {
+	if depth == 0 {
+		return &node{value: 1}
+	}
+	return &node{left: newTree(depth - 1), right: newTree(depth - 1), value: depth}
+}
+
+func (n *node) sum() int {
+	if n == nil {
+		return 0
+	}
+	return n.value + n.left.sum() + n.right.sum()
+}
+
+// setupGC returns an operation allocating and dropping a tree of small objects. Most of the time is in the runtime
+// functions like mallocgc and scanobject, so this shows how the lowering of their control flow performs.
+func setupGC() func() {
+	// A long-lived tree makes the garbage collector mark something.
+	live := newTree(14)
+	return func() {
+		sink = newTree(12).sum() + live.value
+	}
+}
+
+func run(w workload, duration time.Duration) {
+	op := w.setup()
+	if op == nil {
+		fmt.Printf("skip %s\n", w.name)
+		return
+	}
+	// Warm up.
+	op()
+
+	var ms runtime.MemStats
+	runtime.ReadMemStats(&ms)
+	mallocs := ms.Mallocs
+
+	start := time.Now()
+	var n int
+	var d time.Duration
+	for {
+		op()
+		n++
+		d = time.Since(start)
+		if d >= duration {
+			break
+		}
+	}
+
+	runtime.ReadMemStats(&ms)
+	fmt.Printf("result %s %d %d %.2f\n", w.name, n, d.Nanoseconds()/int64(n), float64(ms.Mallocs-mallocs)/float64(n))
+}
+
+func main() {
+	name := flag.String("workload", "", "the workload to run, or empty to exit immediately to measure the startup time")
+	duration := flag.Duration("duration", time.Second, "the duration to run the workload")
+	list := flag.Bool("list", false, "list the workloads")
+	flag.Parse()
+
+	if *list {
+		for _, w := range workloads {
+			fmt.Println(w.name)
+		}
+		return
+	}
+	if *name == "" {
+		return
+	}
+	for _, w := range workloads {
+		if w.name == *name {
+			run(w, *duration)
+			return
+		}
+	}
+	fmt.Fprintf(os.Stderr, "unknown workload: %s\n", *name)
+	os.Exit(2)
+}
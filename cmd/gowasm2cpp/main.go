@@ -3,7 +3,9 @@
 package main
 
 import (
+	"encoding/json"
 	"flag"
+	"io/ioutil"
 	"log"
 	"os"
 
@@ -18,6 +20,18 @@ var (
 	flagWasm      = flag.String("wasm", "", "WebAssembly file generated by Go")
 	flagNamespace = flag.String("namespace", "", "Namespace")
 	flagProfile   = flag.Bool("profile", false, "Take profiles")
+	flagData      = flag.String("data", "inline", "How to embed the data segments: inline, file or incbin")
+	flagMem       = flag.String("mem", "fast", "How to access the memory: fast or checked")
+	flagDataPath  = flag.String("datapath", "mem.data", "Path by which the program (file mode) or the assembler (incbin mode) finds the data file, which is written to the output directory with the same base name")
+	flagDevirt    = flag.Bool("devirtualize", false, "Call the function directly when only one function in the table has the call_indirect's type")
+	flagShards    = flag.Int("shards", 32, "Number of C++ files for the functions (1 for a jumbo build)")
+	flagPCH       = flag.Bool("pch", false, "Make the C++ files for the functions include only inst.pch.h to be precompiled")
+	flagCacheGlob = flag.Bool("cacheglobals", false, "Keep the globals like the stack pointer in local variables and write them back only around calls and returns")
+	flagStruct    = flag.Bool("structured", false, "Lower the control flow to compound statements with break and continue instead of gotos")
+	flagProfilr   = flag.Bool("profiler", false, "Record the calls of the functions so that the generated Profiler can write pprof profiles")
+	flagIntrin    = flag.String("intrinsics", "", "JSON file mapping Go function names to C++ bodies to replace them (an empty body disables a built-in one)")
+	flagDeadFuncs = flag.Bool("deadfuncs", false, "Remove the functions unreachable from the exports and report them to deadfuncs.txt")
+	flagPGO       = flag.String("pgo", "", "pprof profile of the program, e.g. by the generated Profiler or runtime/pprof, to put the hot functions together and mark the hot and cold functions")
 )
 
 func main() {
@@ -29,7 +43,33 @@ func main() {
 	if err := os.MkdirAll(*flagOut, 0755); err != nil {
 		log.Fatal(err)
 	}
-	if err := gowasm2cpp.Generate(*flagOut, *flagInclude, *flagWasm, *flagNamespace); err != nil {
+
+	var intrinsics map[string]string
+	if *flagIntrin != "" {
+		content, err := ioutil.ReadFile(*flagIntrin)
+		if err != nil {
+			log.Fatal(err)
+		}
+		if err := json.Unmarshal(content, &intrinsics); err != nil {
+			log.Fatal(err)
+		}
+	}
+
+	if err := gowasm2cpp.GenerateWithOptions(*flagOut, *flagInclude, *flagWasm, *flagNamespace, &gowasm2cpp.Options{
+		DataMode:     gowasm2cpp.DataMode(*flagData),
+		MemMode:      gowasm2cpp.MemMode(*flagMem),
+		DataPath:     *flagDataPath,
+		Devirtualize: *flagDevirt,
+		Shards:       *flagShards,
+		PCH:          *flagPCH,
+
+		StructuredControlFlow: *flagStruct,
+		CacheGlobals:          *flagCacheGlob,
+		Intrinsics:            intrinsics,
+		Profiler:              *flagProfilr,
+		EliminateDeadFuncs:    *flagDeadFuncs,
+		ProfilePath:           *flagPGO,
+	}); err != nil {
 		log.Fatal(err)
 	}
 }
@@ -4,9 +4,11 @@
 
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <chrono>
 #include <dlfcn.h>
 #include <thread>
+#include <vector>
 
 namespace {
 
@@ -15,6 +17,9 @@ constexpr int kHeight = 480;
 
 } // namespace
 
+GLFWDriver::GLFWDriver(std::chrono::milliseconds audio_latency)
+    : audio_latency_{audio_latency} {}
+
 bool GLFWDriver::Initialize() {
   if (!glfwInit()) {
     return false;
@@ -61,54 +66,40 @@ void *GLFWDriver::GetOpenGLFunction(const char *name) {
   return dlsym(RTLD_DEFAULT, name);
 }
 
-std::vector<go2cpp_autogen::Game::Touch> GLFWDriver::GetTouches() {
-  if (glfwGetMouseButton(window_, GLFW_MOUSE_BUTTON_LEFT) != GLFW_PRESS) {
-    return {};
-  }
+void GLFWDriver::UpdateInput(go2cpp_autogen::Game::Input &input) {
+  using Input = go2cpp_autogen::Game::Input;
 
-  double xpos, ypos;
-  glfwGetCursorPos(window_, &xpos, &ypos);
-  go2cpp_autogen::Game::Touch touch;
-  touch.id = 0;
-  touch.x = static_cast<int>(xpos);
-  touch.y = static_cast<int>(ypos);
-  return {touch};
-}
+  // The setters change the state only when the values change.
+  if (glfwGetMouseButton(window_, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+    double xpos, ypos;
+    glfwGetCursorPos(window_, &xpos, &ypos);
+    input.SetTouch(0, static_cast<int>(xpos), static_cast<int>(ypos));
+  } else {
+    input.RemoveTouch(0);
+  }
 
-std::vector<go2cpp_autogen::Game::Gamepad> GLFWDriver::GetGamepads() {
-  std::vector<go2cpp_autogen::Game::Gamepad> gamepads;
   for (int id = GLFW_JOYSTICK_1; id <= GLFW_JOYSTICK_LAST; id++) {
     if (!glfwJoystickPresent(id)) {
+      input.RemoveGamepad(id);
       continue;
     }
 
-    go2cpp_autogen::Game::Gamepad gamepad;
-    gamepad.id = id;
-
+    int button_count;
     const unsigned char *button_states =
-        glfwGetJoystickButtons(id, &gamepad.button_count);
-    constexpr int kButtonMaxCount =
-        sizeof(gamepad.buttons) / sizeof(gamepad.buttons[0]);
-    if (kButtonMaxCount < gamepad.button_count) {
-      gamepad.button_count = kButtonMaxCount;
-    }
-    for (int i = 0; i < gamepad.button_count; i++) {
-      gamepad.buttons[i] = button_states[i] == GLFW_PRESS;
-    }
-
-    const float *axis_states = glfwGetJoystickAxes(id, &gamepad.axis_count);
-    constexpr int kAxisMaxCount =
-        sizeof(gamepad.axes) / sizeof(gamepad.axes[0]);
-    if (kAxisMaxCount < gamepad.axis_count) {
-      gamepad.axis_count = kAxisMaxCount;
+        glfwGetJoystickButtons(id, &button_count);
+    button_count = std::min(button_count, Input::kMaxGamepadButtonCount);
+    int axis_count;
+    const float *axis_states = glfwGetJoystickAxes(id, &axis_count);
+    axis_count = std::min(axis_count, Input::kMaxGamepadAxisCount);
+
+    input.SetGamepad(id, button_count, axis_count);
+    for (int i = 0; i < button_count; i++) {
+      input.SetGamepadButton(id, i, button_states[i] == GLFW_PRESS);
     }
-    for (int i = 0; i < gamepad.axis_count; i++) {
-      gamepad.axes[i] = axis_states[i];
+    for (int i = 0; i < axis_count; i++) {
+      input.SetGamepadAxis(id, i, axis_states[i]);
     }
-
-    gamepads.push_back(gamepad);
   }
-  return gamepads;
 }
 
 std::string GLFWDriver::GetLocalStorageItem(const std::string &key) {
@@ -125,7 +116,6 @@ void GLFWDriver::OpenAudio(int sample_rate, int channel_num,
   sample_rate_ = sample_rate;
   channel_num_ = channel_num;
   bit_depth_in_bytes_ = bit_depth_in_bytes;
-  buffer_size_ = sample_rate * channel_num * bit_depth_in_bytes / 2;
 }
 
 void GLFWDriver::CloseAudio() {
@@ -134,94 +124,43 @@ void GLFWDriver::CloseAudio() {
 std::unique_ptr<go2cpp_autogen::Game::AudioPlayer>
 GLFWDriver::CreateAudioPlayer(std::function<void()> on_written) {
   return std::make_unique<AudioPlayer>(sample_rate_, channel_num_,
-                                       bit_depth_in_bytes_, buffer_size_,
+                                       bit_depth_in_bytes_, audio_latency_,
                                        on_written);
 }
 
 GLFWDriver::AudioPlayer::AudioPlayer(int sample_rate, int channel_num,
-                                     int bit_depth_in_bytes, int buffer_size,
+                                     int bit_depth_in_bytes,
+                                     std::chrono::milliseconds latency,
                                      std::function<void()> on_written)
-    : sample_rate_{sample_rate}, channel_num_{channel_num},
-      bit_depth_in_bytes_{bit_depth_in_bytes}, buffer_size_{buffer_size},
-      on_written_{on_written}, thread_{[this] { Loop(); }} {}
+    : StreamAudioPlayer{sample_rate, channel_num, bit_depth_in_bytes, latency,
+                        on_written},
+      bytes_per_sec_{sample_rate * channel_num * bit_depth_in_bytes},
+      period_{std::max(latency / 4, std::chrono::milliseconds{1})},
+      thread_{[this] { Loop(); }} {}
 
 GLFWDriver::AudioPlayer::~AudioPlayer() {
+  stopped_ = true;
   if (thread_.joinable()) {
     thread_.join();
   }
 }
 
 void GLFWDriver::AudioPlayer::Close(bool immediately) {
-  {
-    std::lock_guard<std::mutex> lock{mutex_};
-    paused_ = false;
-    closed_ = true;
-  }
-  cond_.notify_all();
-}
-
-double GLFWDriver::AudioPlayer::GetVolume() { return volume_; }
-
-void GLFWDriver::AudioPlayer::SetVolume(double volume) { volume_ = volume; }
-
-void GLFWDriver::AudioPlayer::Pause() {
-  {
-    std::lock_guard<std::mutex> lock{mutex_};
-    if (closed_) {
-      return;
-    }
-    paused_ = true;
-  }
-  cond_.notify_all();
-}
-
-void GLFWDriver::AudioPlayer::Play() {
-  {
-    std::lock_guard<std::mutex> lock{mutex_};
-    if (closed_) {
-      return;
-    }
-    paused_ = false;
-  }
-  cond_.notify_all();
-}
-
-void GLFWDriver::AudioPlayer::Write(const uint8_t *data, int length) {
-  {
-    std::unique_lock<std::mutex> lock{mutex_};
-    cond_.wait(lock, [this] {
-      return (ready_to_play_ < buffer_size_ || closed_) && !paused_;
-    });
-    if (closed_) {
-      return;
-    }
-    ready_to_play_ += length;
-  }
-  cond_.notify_one();
-}
-
-size_t GLFWDriver::AudioPlayer::GetUnplayedBufferSize() {
-  std::lock_guard<std::mutex> lock{mutex_};
-  return ready_to_play_;
+  StreamAudioPlayer::Close(immediately);
+  closing_ = true;
 }
 
 void GLFWDriver::AudioPlayer::Loop() {
-  for (;;) {
-    {
-      std::unique_lock<std::mutex> lock{mutex_};
-      cond_.wait(lock, [this] {
-        return (ready_to_play_ >= buffer_size_ || closed_) && !paused_;
-      });
-      if (closed_) {
-        return;
-      }
-      ready_to_play_ -= buffer_size_;
-      on_written_();
+  std::vector<uint8_t> buf(bytes_per_sec_ * period_.count() / 1000);
+  // Pace by the deadlines instead of sleeping for each period so that the
+  // errors of the sleeps don't accumulate.
+  auto deadline = std::chrono::steady_clock::now();
+  while (!stopped_) {
+    Read(buf.data(), buf.size());
+    if (closing_ && GetUnplayedBufferSize() == 0) {
+      return;
     }
-    cond_.notify_one();
-    int bytes_per_sec = sample_rate_ * channel_num_ * bit_depth_in_bytes_;
-    std::chrono::duration<double> duration(static_cast<double>(buffer_size_) /
-                                           static_cast<double>(bytes_per_sec));
-    std::this_thread::sleep_for(duration);
+    deadline += period_;
+    std::this_thread::sleep_until(deadline);
   }
 }
@@ -5,10 +5,10 @@
 
 #include "autogen/game.h"
 
-#include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <map>
-#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -17,6 +17,10 @@ struct GLFWwindow;
 
 class GLFWDriver : public go2cpp_autogen::Game::Driver {
 public:
+  // audio_latency is the target latency of the audio players.
+  explicit GLFWDriver(
+      std::chrono::milliseconds audio_latency = std::chrono::milliseconds{50});
+
   bool Initialize() override;
   bool Finalize() override;
   void Update(std::function<void()> f) override;
@@ -24,8 +28,7 @@ public:
   int GetScreenHeight() override;
   double GetDevicePixelRatio() override;
   void *GetOpenGLFunction(const char *name) override;
-  std::vector<go2cpp_autogen::Game::Touch> GetTouches() override;
-  std::vector<go2cpp_autogen::Game::Gamepad> GetGamepads() override;
+  void UpdateInput(go2cpp_autogen::Game::Input &input) override;
   void OpenAudio(int sample_rate, int channel_num,
                  int bit_depth_in_bytes) override;
   void CloseAudio() override;
@@ -36,34 +39,25 @@ public:
   CreateAudioPlayer(std::function<void()> on_written) override;
 
 private:
-  class AudioPlayer : public go2cpp_autogen::Game::AudioPlayer {
+  // AudioPlayer emulates an audio device pulling the bytes from the ring buffer
+  // periodically. A real backend would call Read from its audio callback
+  // instead.
+  class AudioPlayer : public go2cpp_autogen::Game::StreamAudioPlayer {
   public:
     AudioPlayer(int sample_rate, int channel_num, int bit_depth_in_bytes,
-                int buffer_size, std::function<void()> on_written);
+                std::chrono::milliseconds latency,
+                std::function<void()> on_written);
     ~AudioPlayer() override;
 
     void Close(bool immediately) override;
-    double GetVolume() override;
-    void SetVolume(double volume) override;
-    void Pause() override;
-    void Play() override;
-    void Write(const uint8_t *data, int length) override;
-    size_t GetUnplayedBufferSize() override;
 
   private:
     void Loop();
 
-    const int sample_rate_;
-    const int channel_num_;
-    const int bit_depth_in_bytes_;
-    const int buffer_size_;
-    std::function<void()> on_written_;
-    double volume_ = 1.0;
-    int ready_to_play_ = 0;
-    bool paused_ = false;
-    bool closed_ = false;
-    std::mutex mutex_;
-    std::condition_variable cond_;
+    const int bytes_per_sec_;
+    const std::chrono::milliseconds period_;
+    std::atomic<bool> closing_{false};
+    std::atomic<bool> stopped_{false};
     std::thread thread_;
   };
 
@@ -73,7 +67,7 @@ private:
   int sample_rate_ = 0;
   int channel_num_ = 0;
   int bit_depth_in_bytes_ = 0;
-  int buffer_size_ = 0;
+  const std::chrono::milliseconds audio_latency_;
 };
 
 #endif
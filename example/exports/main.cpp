@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include "autogen/go.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+
+using Exports = go2cpp_autogen::Go::Exports;
+using go2cpp_autogen::Value;
+
+namespace {
+
+// Benchmark prints the time per call of f.
+void Benchmark(const char* name, int n, const std::function<int64_t()>& f) {
+  auto start = std::chrono::steady_clock::now();
+  int64_t result = f();
+  std::chrono::nanoseconds d = std::chrono::steady_clock::now() - start;
+  std::printf("%-24s %10.1f ns/call (result: %lld)\n", name, static_cast<double>(d.count()) / n, static_cast<long long>(result));
+}
+
+void RunBenchmarks(Exports& exports) {
+  const int n = 100000;
+  const int batch = 100;
+
+  int32_t add = exports.Lookup("add");
+  int32_t sum = exports.Lookup("sum");
+  Exports::Args args;
+  std::vector<uint8_t> bytes(1024, 1);
+
+  Benchmark("add (syscall/js)", n, [&]() -> int64_t {
+    Value f = Value::ReflectGet(Value::Global(), "goAdd");
+    int64_t s = 0;
+    for (int i = 0; i < n; i++) {
+      s += static_cast<int64_t>(Value::ReflectApply(f, Value{}, {Value{static_cast<double>(i)}, Value{1.0}}).ToNumber());
+    }
+    return s;
+  });
+  Benchmark("add (Exports::Call)", n, [&]() -> int64_t {
+    int64_t s = 0;
+    for (int i = 0; i < n; i++) {
+      args.Clear();
+      args.Int64(i).Int64(1);
+      s += exports.Call(add, args).Int64();
+    }
+    return s;
+  });
+  Benchmark("add (Exports, batched)", n, [&]() -> int64_t {
+    int64_t s = 0;
+    for (int i = 0; i < n; i += batch) {
+      for (int j = 0; j < batch; j++) {
+        args.Clear();
+        args.Int64(i + j).Int64(1);
+        exports.Enqueue(add, args);
+      }
+      exports.Flush();
+      for (int j = 0; j < batch; j++) {
+        s += exports.GetResult(j).Int64();
+      }
+    }
+    return s;
+  });
+
+  Benchmark("sum 1KiB (syscall/js)", n, [&]() -> int64_t {
+    Value f = Value::ReflectGet(Value::Global(), "goSum");
+    auto buffer = std::make_shared<go2cpp_autogen::ArrayBuffer>(bytes);
+    Value array{std::make_shared<go2cpp_autogen::Uint8Array>(buffer, 0, bytes.size())};
+    int64_t s = 0;
+    for (int i = 0; i < n; i++) {
+      s += static_cast<int64_t>(Value::ReflectApply(f, Value{}, {array}).ToNumber());
+    }
+    return s;
+  });
+  Benchmark("sum 1KiB (Exports::Call)", n, [&]() -> int64_t {
+    int64_t s = 0;
+    for (int i = 0; i < n; i++) {
+      args.Clear();
+      args.Bytes(bytes.data(), bytes.size());
+      s += exports.Call(sum, args).Int64();
+    }
+    return s;
+  });
+
+  exports.Call(exports.Lookup("quit"), Exports::Args{});
+}
+
+}
+
+int main() {
+  go2cpp_autogen::Go go;
+  // The task runs after Go registers the functions and waits.
+  go.EnqueueTask([&go] {
+    RunBenchmarks(go.GetExports());
+  });
+  return go.Run();
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+// This program registers the same Go functions by the export package and by syscall/js, so that main.cpp can compare
+// the costs of calling them from C++.
+package main
+
+import (
+	"syscall/js"
+
+	"github.com/hajimehoshi/go2cpp/export"
+)
+
+func add(a, b int64) int64 {
+	return a + b
+}
+
+func sum(bs []byte) int64 {
+	var s int64
+	for _, b := range bs {
+		s += int64(b)
+	}
+	return s
+}
+
+func main() {
+	done := make(chan struct{})
+
+	export.Register("add", func(args *export.Args, results *export.Results) {
+		results.PutInt64(add(args.Int64(), args.Int64()))
+	})
+	export.Register("sum", func(args *export.Args, results *export.Results) {
+		results.PutInt64(sum(args.Bytes()))
+	})
+	export.Register("quit", func(args *export.Args, results *export.Results) {
+		close(done)
+	})
+
+	var buf []byte
+	js.Global().Set("goAdd", js.FuncOf(func(this js.Value, args []js.Value) interface{} {
+		return add(int64(args[0].Int()), int64(args[1].Int()))
+	}))
+	js.Global().Set("goSum", js.FuncOf(func(this js.Value, args []js.Value) interface{} {
+		// A typed array has no length property in go2cpp, but its byteLength is the same for a Uint8Array.
+		n := args[0].Get("byteLength").Int()
+		if cap(buf) < n {
+			buf = make([]byte, n)
+		}
+		buf = buf[:n]
+		js.CopyBytesToGo(buf, args[0])
+		return sum(buf)
+	}))
+
+	<-done
+}
@@ -0,0 +1,294 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+package main
+
+import (
+	"context"
+	"errors"
+	"io"
+	"net"
+	"strconv"
+	"sync"
+	"syscall/js"
+	"time"
+	"unsafe"
+)
+
+// This file implements net.Listener and net.Conn on go2cppNet, the host network object of go2cpp.
+
+var (
+	hostNet    = js.Global().Get("go2cppNet")
+	memoryView = js.Global().Get("go2cppMemoryView")
+)
+
+var errClosed = errors.New("use of closed network connection")
+
+type timeoutError struct{}
+
+func (timeoutError) Error() string   { return "i/o timeout" }
+func (timeoutError) Timeout() bool   { return true }
+func (timeoutError) Temporary() bool { return true }
+
+type hostError struct {
+	code    string
+	message string
+}
+
+func (e *hostError) Error() string {
+	return e.message
+}
+
+func toError(v js.Value) error {
+	if v.IsNull() {
+		return nil
+	}
+	switch code := v.Get("code").String(); code {
+	case "ECANCELED":
+		return errClosed
+	case "ETIMEDOUT":
+		return timeoutError{}
+	default:
+		return &hostError{code: code, message: v.Get("message").String()}
+	}
+}
+
+// hostCall calls the method of go2cppNet with the arguments and a callback, and waits for the callback.
+func hostCall(method string, args ...interface{}) (js.Value, error) {
+	type result struct {
+		v   js.Value
+		err error
+	}
+	ch := make(chan result, 1)
+	f := js.FuncOf(func(this js.Value, args []js.Value) interface{} {
+		ch <- result{v: args[1], err: toError(args[0])}
+		return nil
+	})
+	defer f.Release()
+	hostNet.Call(method, append(args, f)...)
+	r := <-ch
+	return r.v, r.err
+}
+
+// view returns a Uint8Array viewing b without copying.
+func view(b []byte) js.Value {
+	return memoryView.Invoke(uintptr(unsafe.Pointer(&b[0])), len(b))
+}
+
+func splitHostPort(address string) (string, int, error) {
+	host, port, err := net.SplitHostPort(address)
+	if err != nil {
+		return "", 0, err
+	}
+	p, err := strconv.Atoi(port)
+	if err != nil {
+		return "", 0, err
+	}
+	return host, p, nil
+}
+
+type hostAddr string
+
+func (hostAddr) Network() string  { return "tcp" }
+func (a hostAddr) String() string { return string(a) }
+
+func addr(v js.Value) net.Addr {
+	if v.IsNull() {
+		return nil
+	}
+	return hostAddr(v.String())
+}
+
+type hostListener struct {
+	fd   int
+	addr net.Addr
+}
+
+func listenHost(address string) (net.Listener, error) {
+	host, port, err := splitHostPort(address)
+	if err != nil {
+		return nil, err
+	}
+	fd, err := hostCall("listen", host, port, 128)
+	if err != nil {
+		return nil, err
+	}
+	return &hostListener{
+		fd:   fd.Int(),
+		addr: addr(hostNet.Call("localAddr", fd)),
+	}, nil
+}
+
+func (l *hostListener) Accept() (net.Conn, error) {
+	fd, err := hostCall("accept", l.fd)
+	if err != nil {
+		return nil, err
+	}
+	return newHostConn(fd.Int()), nil
+}
+
+func (l *hostListener) Close() error {
+	hostNet.Call("close", l.fd)
+	return nil
+}
+
+func (l *hostListener) Addr() net.Addr {
+	return l.addr
+}
+
+func dialHost(ctx context.Context, network, address string) (net.Conn, error) {
+	host, port, err := splitHostPort(address)
+	if err != nil {
+		return nil, err
+	}
+	fd, err := hostCall("connect", host, port)
+	if err != nil {
+		return nil, err
+	}
+	return newHostConn(fd.Int()), nil
+}
+
+// deadline implements a deadline of a hostConn. When the deadline is exceeded, the pending operations are canceled.
+type deadline struct {
+	m      sync.Mutex
+	t      time.Time
+	timer  *time.Timer
+	cancel func()
+}
+
+func (d *deadline) set(t time.Time) {
+	d.m.Lock()
+	d.t = t
+	if d.timer != nil {
+		d.timer.Stop()
+		d.timer = nil
+	}
+	exceeded := false
+	if !t.IsZero() {
+		if dur := time.Until(t); dur > 0 {
+			d.timer = time.AfterFunc(dur, d.cancel)
+		} else {
+			exceeded = true
+		}
+	}
+	d.m.Unlock()
+
+	if exceeded {
+		d.cancel()
+	}
+}
+
+func (d *deadline) exceeded() bool {
+	d.m.Lock()
+	defer d.m.Unlock()
+	return !d.t.IsZero() && !time.Now().Before(d.t)
+}
+
+type hostConn struct {
+	fd     int
+	local  net.Addr
+	remote net.Addr
+
+	rd deadline
+	wd deadline
+
+	m      sync.Mutex
+	closed bool
+}
+
+func newHostConn(fd int) *hostConn {
+	c := &hostConn{
+		fd:     fd,
+		local:  addr(hostNet.Call("localAddr", fd)),
+		remote: addr(hostNet.Call("remoteAddr", fd)),
+	}
+	c.rd.cancel = func() { c.cancel("cancelRead") }
+	c.wd.cancel = func() { c.cancel("cancelWrite") }
+	return c
+}
+
+func (c *hostConn) cancel(method string) {
+	c.m.Lock()
+	defer c.m.Unlock()
+	if c.closed {
+		return
+	}
+	hostNet.Call(method, c.fd)
+}
+
+func (c *hostConn) Read(b []byte) (int, error) {
+	if c.rd.exceeded() {
+		return 0, timeoutError{}
+	}
+	if len(b) == 0 {
+		return 0, nil
+	}
+	// The bytes are read directly into b.
+	n, err := hostCall("read", c.fd, view(b), 0, len(b))
+	if err != nil {
+		return 0, err
+	}
+	if n.Int() == 0 {
+		return 0, io.EOF
+	}
+	return n.Int(), nil
+}
+
+func (c *hostConn) Write(b []byte) (int, error) {
+	if c.wd.exceeded() {
+		return 0, timeoutError{}
+	}
+	if len(b) == 0 {
+		return 0, nil
+	}
+	// The bytes are written directly from b.
+	n, err := hostCall("write", c.fd, view(b), 0, len(b))
+	if err != nil {
+		if n.Type() == js.TypeNumber {
+			return n.Int(), err
+		}
+		return 0, err
+	}
+	return n.Int(), nil
+}
+
+func (c *hostConn) Close() error {
+	c.m.Lock()
+	if c.closed {
+		c.m.Unlock()
+		return errClosed
+	}
+	c.closed = true
+	// The pending operations are canceled by the host.
+	hostNet.Call("close", c.fd)
+	c.m.Unlock()
+
+	c.rd.set(time.Time{})
+	c.wd.set(time.Time{})
+	return nil
+}
+
+func (c *hostConn) LocalAddr() net.Addr {
+	return c.local
+}
+
+func (c *hostConn) RemoteAddr() net.Addr {
+	return c.remote
+}
+
+func (c *hostConn) SetDeadline(t time.Time) error {
+	c.rd.set(t)
+	c.wd.set(t)
+	return nil
+}
+
+func (c *hostConn) SetReadDeadline(t time.Time) error {
+	c.rd.set(t)
+	return nil
+}
+
+func (c *hostConn) SetWriteDeadline(t time.Time) error {
+	c.wd.set(t)
+	return nil
+}
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+// This program serves HTTP on the host network object go2cppNet, and requests it by an HTTP client on the same
+// object. While the goroutines wait for the sockets, the other goroutines keep running.
+package main
+
+import (
+	"fmt"
+	"io/ioutil"
+	"net/http"
+	"os"
+	"time"
+)
+
+func main() {
+	l, err := listenHost("127.0.0.1:0")
+	if err != nil {
+		panic(err)
+	}
+	fmt.Println("listening on", l.Addr())
+
+	mux := http.NewServeMux()
+	mux.HandleFunc("/", func(w http.ResponseWriter, r *http.Request) {
+		fmt.Fprintf(w, "Hello, %s!", r.URL.Path[1:])
+	})
+	s := &http.Server{Handler: mux}
+	go s.Serve(l)
+
+	ticks := 0
+	done := make(chan struct{})
+	go func() {
+		for {
+			select {
+			case <-done:
+				return
+			case <-time.After(time.Millisecond):
+				ticks++
+			}
+		}
+	}()
+
+	c := &http.Client{
+		Transport: &http.Transport{
+			DialContext: dialHost,
+		},
+	}
+	for _, name := range []string{"Gopher", "C++", "go2cpp"} {
+		res, err := c.Get("http://" + l.Addr().String() + "/" + name)
+		if err != nil {
+			panic(err)
+		}
+		body, err := ioutil.ReadAll(res.Body)
+		res.Body.Close()
+		if err != nil {
+			panic(err)
+		}
+		fmt.Println(res.Status, string(body))
+	}
+	close(done)
+
+	if err := s.Close(); err != nil {
+		panic(err)
+	}
+	if ticks == 0 {
+		fmt.Println("the other goroutines didn't run while waiting for the sockets")
+		os.Exit(1)
+	}
+}
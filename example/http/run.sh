@@ -0,0 +1,6 @@
+set -e
+env GOOS=js GOARCH=wasm go build -tags example -o http.wasm -trimpath .
+rm -rf autogen
+go run ../../cmd/gowasm2cpp -out autogen -include autogen -wasm http.wasm -namespace go2cpp_autogen
+clang++ -O3 -Wall -std=c++14 -pthread -I. -o http -g *.cpp autogen/*.cpp
+./http
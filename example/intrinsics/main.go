@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+// This program checks the functions replaced with the intrinsics against the Go results, and measures their
+// throughputs. Run this with and without the intrinsics to compare them.
+package main
+
+import (
+	"bytes"
+	"crypto/sha256"
+	"encoding/hex"
+	"fmt"
+	"hash/crc32"
+	"math/big"
+	"math/bits"
+	"math/rand"
+	"os"
+	"strings"
+	"time"
+	"unicode/utf8"
+)
+
+var (
+	failed bool
+	sink   interface{}
+)
+
+func check(name string, ok bool) {
+	if !ok {
+		fmt.Printf("FAIL: %s\n", name)
+		failed = true
+	}
+}
+
+// crc32Bitwise is a reference implementation of CRC-32 without tables.
+func crc32Bitwise(poly uint32, p []byte) uint32 {
+	crc := ^uint32(0)
+	for _, b := range p {
+		crc ^= uint32(b)
+		for i := 0; i < 8; i++ {
+			if crc&1 != 0 {
+				crc = (crc >> 1) ^ poly
+			} else {
+				crc >>= 1
+			}
+		}
+	}
+	return ^crc
+}
+
+// mul64 is a reference implementation of bits.Mul64 with 32-bit halves.
+func mul64(x, y uint64) (hi, lo uint64) {
+	x0, x1 := x&0xffffffff, x>>32
+	y0, y1 := y&0xffffffff, y>>32
+	p00, p01, p10, p11 := x0*y0, x0*y1, x1*y0, x1*y1
+	mid := (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff)
+	hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32)
+	lo = (mid << 32) | (p00 & 0xffffffff)
+	return
+}
+
+func checkSHA256() {
+	vectors := []struct {
+		in  string
+		out string
+	}{
+		{"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+		{"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+		{"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+		{strings.Repeat("a", 1000000), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+	}
+	for _, v := range vectors {
+		sum := sha256.Sum256([]byte(v.in))
+		check(fmt.Sprintf("sha256 (len %d)", len(v.in)), hex.EncodeToString(sum[:]) == v.out)
+	}
+}
+
+func checkCRC32(r *rand.Rand) {
+	castagnoli := crc32.MakeTable(crc32.Castagnoli)
+	for n := 0; n < 300; n++ {
+		p := make([]byte, n)
+		r.Read(p)
+		check(fmt.Sprintf("crc32 IEEE (len %d)", n), crc32.ChecksumIEEE(p) == crc32Bitwise(crc32.IEEE, p))
+		check(fmt.Sprintf("crc32 Castagnoli (len %d)", n), crc32.Checksum(p, castagnoli) == crc32Bitwise(crc32.Castagnoli, p))
+	}
+}
+
+func checkBits(r *rand.Rand) {
+	for i := 0; i < 10000; i++ {
+		x, y := r.Uint64(), r.Uint64()
+		hi, lo := bits.Mul64(x, y)
+		rhi, rlo := mul64(x, y)
+		check(fmt.Sprintf("bits.Mul64(%d, %d)", x, y), hi == rhi && lo == rlo)
+	}
+}
+
+func checkBig(r *rand.Rand) {
+	f := big.NewInt(1)
+	for i := int64(2); i <= 50; i++ {
+		f.Mul(f, big.NewInt(i))
+	}
+	check("50!", f.String() == "30414093201713378043612608166064768844377641568960512000000000000")
+
+	m := new(big.Int).Lsh(big.NewInt(1), 128)
+	m.Sub(m, big.NewInt(1))
+	check("(2^128-1)^2", new(big.Int).Mul(m, m).String() == "115792089237316195423570985008687907852589419931798687112530834793049593217025")
+
+	for i := 0; i < 1000; i++ {
+		a := new(big.Int).Rand(r, new(big.Int).Lsh(big.NewInt(1), uint(r.Intn(2000)+1)))
+		b := new(big.Int).Rand(r, new(big.Int).Lsh(big.NewInt(1), uint(r.Intn(2000)+1)))
+		b.Add(b, big.NewInt(1))
+		sum := new(big.Int).Add(a, b)
+		prod := new(big.Int).Mul(a, b)
+		check("big (a+b)-b", new(big.Int).Sub(sum, b).Cmp(a) == 0)
+		check("big (a*b)/b", new(big.Int).Quo(prod, b).Cmp(a) == 0)
+		s, _ := new(big.Int).SetString(a.String(), 10)
+		check("big SetString", s.Cmp(a) == 0)
+	}
+}
+
+func checkBytes(r *rand.Rand) {
+	for i := 0; i < 1000; i++ {
+		p := make([]byte, r.Intn(100))
+		for j := range p {
+			p[j] = "ab\x80\xc3\xa9\xe3\x81\x82\xf0\x9f\x98\x80\xff"[r.Intn(13)]
+		}
+		q := append([]byte{}, p...)
+		if len(q) > 0 {
+			q[r.Intn(len(q))]++
+		}
+		n := 0
+		for _, b := range p {
+			if b == 'a' {
+				n++
+			}
+		}
+		check("bytes.Count", bytes.Count(p, []byte{'a'}) == n)
+
+		runes, valid := 0, true
+		for rest := p; len(rest) > 0; runes++ {
+			c, size := utf8.DecodeRune(rest)
+			if c == utf8.RuneError && size == 1 {
+				valid = false
+			}
+			rest = rest[size:]
+		}
+		check("utf8.RuneCount", utf8.RuneCount(p) == runes && utf8.RuneCountInString(string(p)) == runes)
+		check("utf8.Valid", utf8.Valid(p) == valid && utf8.ValidString(string(p)) == valid)
+
+		cmp := 0
+		for j := 0; ; j++ {
+			if j == len(p) || j == len(q) {
+				if len(p) < len(q) {
+					cmp = -1
+				} else if len(p) > len(q) {
+					cmp = 1
+				}
+				break
+			}
+			if p[j] != q[j] {
+				cmp = 1
+				if p[j] < q[j] {
+					cmp = -1
+				}
+				break
+			}
+		}
+		check("bytes.Compare", bytes.Compare(p, q) == cmp)
+	}
+}
+
+func throughput(name string, bytes int, f func()) {
+	start := time.Now()
+	n := 0
+	for time.Since(start) < 500*time.Millisecond {
+		f()
+		n++
+	}
+	fmt.Printf("%s: %.1f MB/s\n", name, float64(bytes*n)/time.Since(start).Seconds()/1e6)
+}
+
+func bench() {
+	buf := make([]byte, 1<<20)
+	rand.New(rand.NewSource(1)).Read(buf)
+	throughput("sha256", len(buf), func() { sink = sha256.Sum256(buf) })
+	throughput("crc32", len(buf), func() { sink = crc32.ChecksumIEEE(buf) })
+	text := []byte(strings.Repeat("Hello, 世界! ", len(buf)/16))
+	throughput("utf8.Valid", len(text), func() { sink = utf8.Valid(text) })
+	throughput("bytes.Count", len(buf), func() { sink = bytes.Count(buf, []byte{'a'}) })
+
+	x := new(big.Int).Rand(rand.New(rand.NewSource(1)), new(big.Int).Lsh(big.NewInt(1), 1<<14))
+	throughput("big.Int Mul (16Kbit)", len(x.Bytes())*2, func() { sink = new(big.Int).Mul(x, x) })
+}
+
+func main() {
+	r := rand.New(rand.NewSource(1))
+	checkSHA256()
+	checkCRC32(r)
+	checkBits(r)
+	checkBig(r)
+	checkBytes(r)
+	if failed {
+		os.Exit(1)
+	}
+	fmt.Println("ok")
+	bench()
+}
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include "autogen/pool.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+
+int main() {
+  constexpr int kInstances = 4;
+  constexpr int kRequests = 16;
+
+  go2cpp_autogen::GoPool pool{kInstances};
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  int received = 0;
+  pool.SetHostHandler([&](int from, go2cpp_autogen::GoPool::Message message) {
+    go2cpp_autogen::BytesSpan bytes = message.Bytes();
+    uint64_t result = 0;
+    for (int i = 0; i < 8; i++) {
+      result |= static_cast<uint64_t>(bytes[2 + i]) << (8 * i);
+    }
+    std::lock_guard<std::mutex> lock{mutex};
+    std::printf("instance %d: fib(%d) = %llu\n", from, bytes[1], static_cast<unsigned long long>(result));
+    received++;
+    cond.notify_one();
+  });
+  pool.Start({});
+
+  for (int i = 0; i < kRequests; i++) {
+    pool.Post(go2cpp_autogen::GoPool::kAnyInstance, go2cpp_autogen::GoPool::Message{std::vector<uint8_t>{static_cast<uint8_t>(20 + i)}});
+  }
+  {
+    std::unique_lock<std::mutex> lock{mutex};
+    cond.wait(lock, [&] { return received == kRequests; });
+  }
+  for (int i = 0; i < kInstances; i++) {
+    pool.Post(i, go2cpp_autogen::GoPool::Message{std::vector<uint8_t>{0}});
+  }
+  pool.Wait();
+  return 0;
+}
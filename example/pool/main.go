@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+package main
+
+import (
+	"encoding/binary"
+	"syscall/js"
+)
+
+func fib(n int) int {
+	if n < 2 {
+		return n
+	}
+	return fib(n-1) + fib(n-2)
+}
+
+func main() {
+	pool := js.Global().Get("go2cppPool")
+	id := pool.Get("id").Int()
+
+	done := make(chan struct{})
+	pool.Set("onmessage", js.FuncOf(func(this js.Value, args []js.Value) interface{} {
+		from := args[0].Int()
+		req := make([]byte, args[1].Get("byteLength").Int())
+		js.CopyBytesToGo(req, args[1])
+
+		n := int(req[0])
+		if n == 0 {
+			close(done)
+			return nil
+		}
+
+		res := make([]byte, 10)
+		res[0] = byte(id)
+		res[1] = byte(n)
+		binary.LittleEndian.PutUint64(res[2:], uint64(fib(n)))
+		arr := js.Global().Get("Uint8Array").New(len(res))
+		js.CopyBytesToJS(arr, res)
+		pool.Call("postMessage", from, arr)
+		return nil
+	}))
+
+	<-done
+}
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include "autogen/go.h"
+#include "autogen/profiler.h"
+
+#include <iostream>
+
+int main() {
+  if (!go2cpp_autogen::Profiler::Start()) {
+    std::cerr << "the profiler is not enabled" << std::endl;
+    return 1;
+  }
+  go2cpp_autogen::Go go;
+  int code = go.Run();
+  go2cpp_autogen::Profiler::Stop();
+  if (!go2cpp_autogen::Profiler::WriteProfile("profiler.pprof")) {
+    std::cerr << "writing the profile failed" << std::endl;
+    return 1;
+  }
+  return code;
+}
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+// This program spends most of its time in spin, partly at the bottom of a recursion deeper than the profiler's
+// shadow stack. run.sh checks the profile written by main.cpp.
+package main
+
+import (
+	"fmt"
+	"time"
+)
+
+var sink int
+
+//go:noinline
+func spin(d time.Duration) {
+	start := time.Now()
+	for time.Since(start) < d {
+		for i := 0; i < 1000; i++ {
+			sink += i
+		}
+	}
+}
+
+//go:noinline
+func recurse(depth int, d time.Duration) {
+	if depth == 0 {
+		spin(d)
+		return
+	}
+	recurse(depth-1, d)
+}
+
+func main() {
+	spin(time.Second)
+	// The first recursion grows the goroutine stack. A call that grows the stack unwinds the C++ stack, so only the
+	// second recursion is as deep in C++ as in Go.
+	recurse(2000, 0)
+	recurse(2000, 500*time.Millisecond)
+	fmt.Println("done")
+}
@@ -0,0 +1,20 @@
+set -e
+env GOOS=js GOARCH=wasm go build -tags example -o profiler.wasm -trimpath .
+rm -rf autogen profiler.pprof
+go run ../../cmd/gowasm2cpp -out autogen -include autogen -wasm profiler.wasm -namespace go2cpp_autogen -profiler
+clang++ -O3 -Wall -std=c++14 -pthread -I. -o profiler -g *.cpp autogen/*.cpp
+./profiler
+# Check the flat and cumulative sample counts by the Go names. spin runs for 1s and the deep recursion for 0.5s, and
+# a sample is taken every 10ms.
+go tool pprof -top -sample_index=samples profiler.pprof > profiler.txt
+awk '
+  $6 == "main.spin" { spin = $1 }
+  $6 == "[truncated]" { truncated = $1 }
+  $6 == "main.recurse" { recurse = $4 }
+  END {
+    print "main.spin:", spin, "[truncated]:", truncated, "main.recurse:", recurse
+    if (spin < 50 || truncated < 25 || recurse < truncated) {
+      print "FAIL"
+      exit 1
+    }
+  }' profiler.txt
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include "autogen/go.h"
+
+#include <chrono>
+#include <iostream>
+
+int main(int argc, char** argv) {
+  std::vector<std::string> args(argv, argv + argc);
+  auto start = std::chrono::steady_clock::now();
+
+  go2cpp_autogen::Go go;
+  // The first run writes the snapshot, and the later runs start from it.
+  go.SetSnapshotPath("snapshot.bin");
+  int code = go.RunFromSnapshot("snapshot.bin", args);
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  std::cerr << "elapsed: " << elapsed.count() << "ms" << std::endl;
+  return code;
+}
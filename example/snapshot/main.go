@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+// This program builds a table at the initialization, and then takes a snapshot by go2cppSnapshot. The next run starts
+// from the snapshot, and skips the Go runtime startup and building the table.
+package main
+
+import (
+	"fmt"
+	"os"
+	"runtime"
+	"syscall/js"
+)
+
+var primes = sieve(10000000)
+
+func sieve(n int) []int {
+	composite := make([]bool, n)
+	var ps []int
+	for i := 2; i < n; i++ {
+		if composite[i] {
+			continue
+		}
+		ps = append(ps, i)
+		for j := i * i; j < n; j += i {
+			composite[j] = true
+		}
+	}
+	return ps
+}
+
+// snapshot takes a snapshot and returns the arguments of the current run. os.Args is the arguments at the snapshot.
+func snapshot() []string {
+	// The garbage is collected so that the snapshot is smaller and has fewer references to the host.
+	runtime.GC()
+
+	ch := make(chan []string)
+	f := js.FuncOf(func(this js.Value, args []js.Value) interface{} {
+		a := args[0]
+		s := make([]string, a.Length())
+		for i := range s {
+			s[i] = a.Index(i).String()
+		}
+		ch <- s
+		return nil
+	})
+	defer f.Release()
+	js.Global().Call("go2cppSnapshot", f)
+	return <-ch
+}
+
+func main() {
+	args := snapshot()
+	fmt.Printf("%d primes below 10000000, the last is %d\n", len(primes), primes[len(primes)-1])
+	fmt.Println("os.Args:", os.Args[1:], "args:", args[1:])
+}
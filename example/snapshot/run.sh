@@ -0,0 +1,7 @@
+set -e
+env GOOS=js GOARCH=wasm go build -tags example -o snapshot.wasm -trimpath .
+rm -rf autogen snapshot.bin
+go run ../../cmd/gowasm2cpp -out autogen -include autogen -wasm snapshot.wasm -namespace go2cpp_autogen
+clang++ -O3 -Wall -std=c++14 -pthread -I. -o snapshot -g *.cpp autogen/*.cpp
+./snapshot first
+./snapshot second
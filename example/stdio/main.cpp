@@ -0,0 +1,8 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include "autogen/go.h"
+
+int main() {
+  go2cpp_autogen::Go go;
+  return go.Run();
+}
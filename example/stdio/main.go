@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build example
+
+// This program interleaves println, which goes to the debug writer, with writes to the standard output and the
+// standard error, which go to the fs object. run.sh checks that the lines are in the order they are written.
+package main
+
+import (
+	"fmt"
+	"os"
+)
+
+func main() {
+	for i := 0; i < 3; i++ {
+		println("println", i)
+		fmt.Fprintln(os.Stderr, "stderr", i)
+		println("println", i)
+		fmt.Fprintln(os.Stdout, "stdout", i)
+	}
+}
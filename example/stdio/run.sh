@@ -0,0 +1,7 @@
+set -e
+env GOOS=js GOARCH=wasm go build -tags example -o stdio.wasm -trimpath .
+rm -rf autogen
+go run ../../cmd/gowasm2cpp -out autogen -include autogen -wasm stdio.wasm -namespace go2cpp_autogen
+clang++ -O3 -Wall -std=c++14 -pthread -I. -o stdio -g *.cpp autogen/*.cpp
+./stdio > stdio.txt 2>&1
+diff -u want.txt stdio.txt
@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: Apache-2.0
+
+// +build js,wasm
+
+// Package export registers Go functions that the host C++ calls by Go::Exports of go2cpp.
+//
+// The arguments and the results are bytes in the linear memory. The host writes a batch of calls to a request
+// buffer, and the functions run in one event without syscall/js values for each call.
+package export
+
+import (
+	"encoding/binary"
+	"math"
+	"sync"
+	"syscall/js"
+	"unsafe"
+)
+
+// Func is a Go function called from the host. A Func reads the arguments from args and writes the results to
+// results in the same order as the host. A Func must not block.
+type Func func(args *Args, results *Results)
+
+// mailbox is shared with the host. The layout must match Go::Exports.
+type mailbox struct {
+	reqAddr  uint32
+	reqCap   uint32
+	reqLen   uint32
+	reqCount uint32
+	resAddr  uint32
+	resLen   uint32
+	// need is the capacity of the request buffer that the host needs. The host sets need and dispatches an empty
+	// batch when a call doesn't fit.
+	need uint32
+	_    uint32
+}
+
+const initialRequestBufferSize = 4096
+
+var (
+	once     sync.Once
+	m        mailbox
+	funcs    []Func
+	req      []byte
+	res      []byte
+	dispatch js.Func
+)
+
+func align8(n int) int {
+	return (n + 7) &^ 7
+}
+
+func addr(b []byte) uint32 {
+	return uint32(uintptr(unsafe.Pointer(&b[0])))
+}
+
+func initialize() {
+	req = make([]byte, initialRequestBufferSize)
+	m.reqAddr = addr(req)
+	m.reqCap = uint32(len(req))
+	res = make([]byte, 0, initialRequestBufferSize)
+	dispatch = js.FuncOf(func(this js.Value, args []js.Value) interface{} {
+		handle()
+		return nil
+	})
+	js.Global().Call("go2cppExportsInit", uintptr(unsafe.Pointer(&m)), dispatch)
+}
+
+// Register registers the function with the name. The host finds the function by Go::Exports::Lookup.
+//
+// If the host takes a snapshot by go2cppSnapshot, register the functions after the snapshot.
+func Register(name string, f Func) {
+	once.Do(initialize)
+	funcs = append(funcs, f)
+	js.Global().Call("go2cppExportsRegister", name, len(funcs)-1)
+}
+
+func handle() {
+	if m.need > 0 {
+		// Grow the request buffer with the requests so far.
+		n := len(req)
+		for n < int(m.need) {
+			n *= 2
+		}
+		newReq := make([]byte, n)
+		copy(newReq, req[:m.reqLen])
+		req = newReq
+		m.reqAddr = addr(req)
+		m.reqCap = uint32(len(req))
+		m.need = 0
+		return
+	}
+
+	res = res[:0]
+	b := req[:m.reqLen]
+	for i := uint32(0); i < m.reqCount; i++ {
+		id := binary.LittleEndian.Uint32(b)
+		n := int(binary.LittleEndian.Uint32(b[4:]))
+		args := Args{b: b[8 : 8+n]}
+		b = b[align8(8+n):]
+
+		// A result is the length, the padding and the bytes.
+		head := len(res)
+		res = append(res, 0, 0, 0, 0, 0, 0, 0, 0)
+		results := Results{b: res}
+		funcs[id](&args, &results)
+		res = results.b
+		binary.LittleEndian.PutUint32(res[head:], uint32(len(res)-head-8))
+		for len(res)%8 != 0 {
+			res = append(res, 0)
+		}
+	}
+	m.resLen = uint32(len(res))
+	if len(res) > 0 {
+		m.resAddr = addr(res)
+	}
+}
+
+// Args reads the arguments of a call.
+type Args struct {
+	b []byte
+}
+
+// Int32 reads an int32.
+func (a *Args) Int32() int32 {
+	v := int32(binary.LittleEndian.Uint32(a.b))
+	a.b = a.b[4:]
+	return v
+}
+
+// Int64 reads an int64.
+func (a *Args) Int64() int64 {
+	v := int64(binary.LittleEndian.Uint64(a.b))
+	a.b = a.b[8:]
+	return v
+}
+
+// Float64 reads a float64.
+func (a *Args) Float64() float64 {
+	return math.Float64frombits(uint64(a.Int64()))
+}
+
+// Bytes reads bytes. The bytes are valid only during the call.
+func (a *Args) Bytes() []byte {
+	n := int(a.Int32())
+	v := a.b[:n:n]
+	a.b = a.b[n:]
+	return v
+}
+
+// String reads a string.
+func (a *Args) String() string {
+	return string(a.Bytes())
+}
+
+// Results writes the results of a call.
+type Results struct {
+	b []byte
+}
+
+// PutInt32 writes an int32.
+func (r *Results) PutInt32(v int32) {
+	r.b = append(r.b, byte(v), byte(v>>8), byte(v>>16), byte(v>>24))
+}
+
+// PutInt64 writes an int64.
+func (r *Results) PutInt64(v int64) {
+	r.PutInt32(int32(v))
+	r.PutInt32(int32(v >> 32))
+}
+
+// PutFloat64 writes a float64.
+func (r *Results) PutFloat64(v float64) {
+	r.PutInt64(int64(math.Float64bits(v)))
+}
+
+// PutBytes writes bytes.
+func (r *Results) PutBytes(v []byte) {
+	r.PutInt32(int32(len(v)))
+	r.b = append(r.b, v...)
+}
+
+// PutString writes a string.
+func (r *Results) PutString(v string) {
+	r.PutInt32(int32(len(v)))
+	r.b = append(r.b, v...)
+}
@@ -3,18 +3,12 @@
 package gowasm2cpp
 
 import (
-	"os"
-	"path/filepath"
 	"text/template"
 )
 
-func writeBits(dir string, incpath string, namespace string) error {
+func writeBits(dir *outputDir, incpath string, namespace string) error {
 	{
-		f, err := os.Create(filepath.Join(dir, "bits.h"))
-		if err != nil {
-			return err
-		}
-		defer f.Close()
+		f := dir.Create("bits.h")
 
 		if err := bitsHTmpl.Execute(f, struct {
 			IncludeGuard string
@@ -27,13 +21,12 @@ func writeBits(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
-	}
-	{
-		f, err := os.Create(filepath.Join(dir, "bits.cpp"))
-		if err != nil {
+		if err := f.Close(); err != nil {
 			return err
 		}
-		defer f.Close()
+	}
+	{
+		f := dir.Create("bits.cpp")
 
 		if err := bitsCppTmpl.Execute(f, struct {
 			IncludePath string
@@ -44,6 +37,9 @@ func writeBits(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
+		if err := f.Close(); err != nil {
+			return err
+		}
 	}
 	return nil
 }
@@ -3,18 +3,12 @@
 package gowasm2cpp
 
 import (
-	"os"
-	"path/filepath"
 	"text/template"
 )
 
-func writeBytes(dir string, incpath string, namespace string) error {
+func writeBytes(dir *outputDir, incpath string, namespace string) error {
 	{
-		f, err := os.Create(filepath.Join(dir, "bytes.h"))
-		if err != nil {
-			return err
-		}
-		defer f.Close()
+		f := dir.Create("bytes.h")
 
 		if err := bytesHTmpl.Execute(f, struct {
 			IncludeGuard string
@@ -27,13 +21,12 @@ func writeBytes(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
-	}
-	{
-		f, err := os.Create(filepath.Join(dir, "bytes.cpp"))
-		if err != nil {
+		if err := f.Close(); err != nil {
 			return err
 		}
-		defer f.Close()
+	}
+	{
+		f := dir.Create("bytes.cpp")
 
 		if err := bytesCppTmpl.Execute(f, struct {
 			IncludePath string
@@ -44,6 +37,9 @@ func writeBytes(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
+		if err := f.Close(); err != nil {
+			return err
+		}
 	}
 	return nil
 }
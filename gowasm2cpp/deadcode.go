@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: Apache-2.0
+
+package gowasm2cpp
+
+import (
+	"bytes"
+	"fmt"
+	"runtime"
+	"sort"
+	"strings"
+
+	"github.com/go-interpreter/wagon/disasm"
+	"github.com/go-interpreter/wagon/wasm/operators"
+	"golang.org/x/sync/errgroup"
+)
+
+const deadFuncsReportFileName = "deadfuncs.txt"
+
+// callees returns the functions that f calls directly and the types that f calls indirectly.
+func (f *wasmFunc) callees(idents map[string]*wasmFunc) ([]*wasmFunc, []*wasmType, error) {
+	// An intrinsic is C++, and calls the generated functions in the same way as the translated bodies.
+	if f.BodyStr != "" {
+		var fs []*wasmFunc
+		for _, m := range callRe.FindAllStringSubmatch(f.BodyStr, -1) {
+			if g, ok := idents[m[1]]; ok {
+				fs = append(fs, g)
+			}
+		}
+		return fs, nil, nil
+	}
+
+	dis, err := disasm.NewDisassembly(f.Wasm, f.Mod)
+	if err != nil {
+		return nil, nil, err
+	}
+	var fs []*wasmFunc
+	var ts []*wasmType
+	for _, instr := range dis.Code {
+		switch instr.Op.Code {
+		case operators.Call:
+			fs = append(fs, f.Funcs[instr.Immediates[0].(uint32)])
+		case operators.CallIndirect:
+			ts = append(ts, f.Types[instr.Immediates[0].(uint32)])
+		}
+	}
+	return fs, ts, nil
+}
+
+// reachableFuncs returns the functions reachable from the exports, and the others.
+//
+// A function is reachable when a reachable function calls it directly, or when it is in the table and a reachable
+// function has a call_indirect whose type matches it. Go puts all the functions in the table and calls them
+// indirectly to resume goroutines, so the functions with Go's common signature are always reachable; the functions
+// removed are mostly helpers whose callers were replaced by intrinsics, and the functions with other signatures.
+func reachableFuncs(funcs []*wasmFunc, exports []*wasmExport) ([]*wasmFunc, []*wasmFunc, error) {
+	idents := map[string]*wasmFunc{}
+	for _, f := range funcs {
+		idents[f.Identifier()] = f
+	}
+
+	type edges struct {
+		funcs []*wasmFunc
+		types []*wasmType
+	}
+	calls := make([]edges, len(funcs))
+	var g errgroup.Group
+	workers := runtime.NumCPU()
+	for w := 0; w < workers; w++ {
+		w := w
+		g.Go(func() error {
+			for i := w; i < len(funcs); i += workers {
+				fs, ts, err := funcs[i].callees(idents)
+				if err != nil {
+					return err
+				}
+				calls[i] = edges{funcs: fs, types: ts}
+			}
+			return nil
+		})
+	}
+	if err := g.Wait(); err != nil {
+		return nil, nil, err
+	}
+	idx := map[*wasmFunc]int{}
+	for i, f := range funcs {
+		idx[f] = i
+	}
+
+	reached := map[*wasmFunc]struct{}{}
+	calledTypes := map[*wasmType]struct{}{}
+	var queue []*wasmFunc
+	visit := func(f *wasmFunc) {
+		if f == nil || f.Import {
+			return
+		}
+		if _, ok := reached[f]; ok {
+			return
+		}
+		reached[f] = struct{}{}
+		queue = append(queue, f)
+	}
+	for _, e := range exports {
+		visit(e.Funcs[e.Index])
+	}
+	for len(queue) > 0 {
+		f := queue[len(queue)-1]
+		queue = queue[:len(queue)-1]
+		i, ok := idx[f]
+		if !ok {
+			return nil, nil, fmt.Errorf("function %s is not found", f.Wasm.Name)
+		}
+		for _, g := range calls[i].funcs {
+			visit(g)
+		}
+		for _, t := range calls[i].types {
+			if _, ok := calledTypes[t]; ok {
+				continue
+			}
+			calledTypes[t] = struct{}{}
+			for _, g := range t.IndirectTargets {
+				visit(g)
+			}
+		}
+	}
+
+	var live, dead []*wasmFunc
+	for _, f := range funcs {
+		if _, ok := reached[f]; ok {
+			live = append(live, f)
+		} else {
+			dead = append(dead, f)
+		}
+	}
+	return live, dead, nil
+}
+
+// goPackage returns the package part of the Wasm function name, which is the Go name mangled by the linker, e.g.
+// "net_http" for "net_http.__Client_.Do". The first element of a path like github.com keeps its dot, e.g.
+// "github.com_hajimehoshi_go2cpp_export" for "github.com_hajimehoshi_go2cpp_export.Register".
+func goPackage(name string) string {
+	start := 0
+	// A host name ends with a top-level domain, and is followed by the mangled "/" and the rest of the path before the
+	// function name. Go function names rarely have '_', so this is not confused with them.
+	if d, u := strings.Index(name, "."), strings.Index(name, "_"); 0 <= d && d+1 < u && isLowerLetters(name[d+1:u]) && strings.Contains(name[u:], ".") {
+		start = u
+	}
+	if i := strings.Index(name[start:], "."); i >= 0 {
+		return name[:start+i]
+	}
+	return name
+}
+
+func isLowerLetters(str string) bool {
+	for _, r := range str {
+		if r < 'a' || 'z' < r {
+			return false
+		}
+	}
+	return true
+}
+
+// deadFuncsReport returns a report of the removed functions and their Wasm code sizes per package.
+func deadFuncsReport(dead []*wasmFunc, total int) []byte {
+	type pkgStat struct {
+		name  string
+		funcs []string
+		size  int
+	}
+	pkgs := map[string]*pkgStat{}
+	size := 0
+	for _, f := range dead {
+		name := goPackage(f.Wasm.Name)
+		p, ok := pkgs[name]
+		if !ok {
+			p = &pkgStat{name: name}
+			pkgs[name] = p
+		}
+		p.funcs = append(p.funcs, f.Wasm.Name)
+		if f.Wasm.Body != nil {
+			p.size += len(f.Wasm.Body.Code)
+			size += len(f.Wasm.Body.Code)
+		}
+	}
+	var stats []*pkgStat
+	for _, p := range pkgs {
+		sort.Strings(p.funcs)
+		stats = append(stats, p)
+	}
+	sort.Slice(stats, func(a, b int) bool {
+		if stats[a].size != stats[b].size {
+			return stats[a].size > stats[b].size
+		}
+		return stats[a].name < stats[b].name
+	})
+
+	var buf bytes.Buffer
+	fmt.Fprintf(&buf, "# %d of %d functions are unreachable and removed (%d bytes of Wasm code).\n", len(dead), total, size)
+	for _, p := range stats {
+		fmt.Fprintf(&buf, "\n%s: %d functions, %d bytes\n", p.name, len(p.funcs), p.size)
+		for _, f := range p.funcs {
+			fmt.Fprintf(&buf, "\t%s\n", f)
+		}
+	}
+	return buf.Bytes()
+}
@@ -0,0 +1,325 @@
+// SPDX-License-Identifier: Apache-2.0
+
+package gowasm2cpp
+
+import (
+	"text/template"
+)
+
+func writeFileIO(dir *outputDir, incpath string, namespace string) error {
+	{
+		f := dir.Create("fileio.h")
+
+		if err := fileioHTmpl.Execute(f, struct {
+			IncludeGuard string
+			IncludePath  string
+			Namespace    string
+		}{
+			IncludeGuard: includeGuard(namespace) + "_FILEIO_H",
+			IncludePath:  incpath,
+			Namespace:    namespace,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+	}
+	{
+		f := dir.Create("fileio.cpp")
+
+		if err := fileioCppTmpl.Execute(f, struct {
+			IncludePath string
+			Namespace   string
+		}{
+			IncludePath: incpath,
+			Namespace:   namespace,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+var fileioHTmpl = template.Must(template.New("fileio.h").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#ifndef {{.IncludeGuard}}
+#define {{.IncludeGuard}}
+
+#include "{{.IncludePath}}taskqueue.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {{.Namespace}} {
+
+// FileIO runs blocking file operations for the fs object and name resolutions for go2cppNet on a bounded pool of worker
+// threads, so that a slow disk or DNS server does not stop the goroutines. A completion is posted back to the thread
+// running Go, where the callback is called.
+//
+// Submitted operations are batched and handed to the workers at once by Flush. Go flushes every time the control
+// returns to its event loop.
+class FileIO {
+public:
+  enum class Op {
+    Open,
+    Close,
+    Read,
+    Write,
+    Fstat,
+    Ftruncate,
+    Stat,
+    Mkdir,
+    Readdir,
+    Rename,
+    Rmdir,
+    Unlink,
+    Resolve,
+    Num,
+  };
+
+  struct OpStats {
+    // The number of the completed operations.
+    uint64_t count = 0;
+
+    // The times from the submissions to the ends of the operations on the workers, in milliseconds.
+    double total_latency = 0;
+    double max_latency = 0;
+  };
+
+  struct Stats {
+    std::array<OpStats, static_cast<size_t>(Op::Num)> ops;
+
+    // The number of the flushes that handed operations to the workers, and the largest number of the operations in
+    // one flush.
+    uint64_t batch_count = 0;
+    size_t max_batch_size = 0;
+  };
+
+  // Work is run on a worker thread, and returns a task to complete the operation on the thread running Go.
+  //
+  // Work should only touch plain data like file descriptors and bytes. Values should be moved into the returned task
+  // so that they are used and destructed on the thread running Go.
+  using Work = std::function<TaskQueue::Task()>;
+
+  // Poster posts a completion to the thread running Go. Poster must be concurrent-safe.
+  using Poster = std::function<void(TaskQueue::Task)>;
+
+  static const char* OpName(Op op);
+
+  // Submit submits work to the FileIO for the current thread. If there is no FileIO for the current thread, work and
+  // its completion are run synchronously.
+  static void Submit(Op op, Work work);
+
+  // SetCurrent sets the FileIO for the current thread. file_io can be nullptr.
+  static void SetCurrent(FileIO* file_io);
+
+  explicit FileIO(Poster poster);
+
+  // The destructor stops the workers. Queued operations are discarded, and the completions of running operations are
+  // never posted.
+  ~FileIO();
+
+  // Flush hands the submitted operations to the workers. Flush must be called on the thread running Go.
+  void Flush();
+
+  // GetStats is concurrent-safe.
+  Stats GetStats();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t kMaxBatchSize = 64;
+
+  struct Request {
+    Op op;
+    Clock::time_point submitted;
+    Work work;
+  };
+
+  // State is shared with the workers. A worker might be blocked in a system call like reading stdin forever, so the
+  // workers are detached and can outlive the FileIO.
+  struct State {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Request> requests;
+    bool stopped = false;
+    Poster poster;
+    Stats stats;
+  };
+
+  FileIO(const FileIO&) = delete;
+  FileIO& operator=(const FileIO&) = delete;
+
+  static void Loop(std::shared_ptr<State> state);
+
+  std::shared_ptr<State> state_;
+  // pending_ is the batch of the operations not flushed yet. pending_ is accessed only on the thread running Go.
+  std::vector<Request> pending_;
+  size_t worker_num_ = 0;
+};
+
+}
+
+#endif  // {{.IncludeGuard}}
+`))
+
+var fileioCppTmpl = template.Must(template.New("fileio.cpp").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#include "{{.IncludePath}}fileio.h"
+
+#include <algorithm>
+
+namespace {{.Namespace}} {
+
+namespace {
+
+// kMaxWorkerNum is the maximum number of the workers. File operations are rarely CPU-bound, and a larger number
+// hardly helps a disk.
+constexpr size_t kMaxWorkerNum = 4;
+
+FileIO*& CurrentFileIO() {
+  static thread_local FileIO* file_io = nullptr;
+  return file_io;
+}
+
+}
+
+constexpr size_t FileIO::kMaxBatchSize;
+
+const char* FileIO::OpName(Op op) {
+  switch (op) {
+  case Op::Open: return "open";
+  case Op::Close: return "close";
+  case Op::Read: return "read";
+  case Op::Write: return "write";
+  case Op::Fstat: return "fstat";
+  case Op::Ftruncate: return "ftruncate";
+  case Op::Stat: return "stat";
+  case Op::Mkdir: return "mkdir";
+  case Op::Readdir: return "readdir";
+  case Op::Rename: return "rename";
+  case Op::Rmdir: return "rmdir";
+  case Op::Unlink: return "unlink";
+  case Op::Resolve: return "resolve";
+  case Op::Num: break;
+  }
+  return "";
+}
+
+void FileIO::Submit(Op op, Work work) {
+  FileIO* file_io = CurrentFileIO();
+  if (!file_io) {
+    work()();
+    return;
+  }
+  file_io->pending_.push_back(Request{op, Clock::now(), std::move(work)});
+  if (file_io->pending_.size() >= kMaxBatchSize) {
+    file_io->Flush();
+  }
+}
+
+void FileIO::SetCurrent(FileIO* file_io) {
+  CurrentFileIO() = file_io;
+}
+
+FileIO::FileIO(Poster poster)
+    : state_{std::make_shared<State>()} {
+  state_->poster = std::move(poster);
+}
+
+FileIO::~FileIO() {
+  {
+    std::lock_guard<std::mutex> lock{state_->mutex};
+    state_->stopped = true;
+    state_->requests.clear();
+  }
+  state_->cond.notify_all();
+  if (CurrentFileIO() == this) {
+    CurrentFileIO() = nullptr;
+  }
+}
+
+void FileIO::Flush() {
+  if (pending_.empty()) {
+    return;
+  }
+
+  size_t n = pending_.size();
+  size_t queued = 0;
+  {
+    std::lock_guard<std::mutex> lock{state_->mutex};
+    for (Request& r : pending_) {
+      state_->requests.push_back(std::move(r));
+    }
+    queued = state_->requests.size();
+    state_->stats.batch_count++;
+    state_->stats.max_batch_size = std::max(state_->stats.max_batch_size, n);
+  }
+  pending_.clear();
+
+  // Start workers lazily, as many programs never touch files other than the standard outputs.
+  size_t max_worker_num = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), kMaxWorkerNum));
+  while (worker_num_ < std::min(queued, max_worker_num)) {
+    std::thread{Loop, state_}.detach();
+    worker_num_++;
+  }
+
+  if (n == 1) {
+    state_->cond.notify_one();
+  } else {
+    state_->cond.notify_all();
+  }
+}
+
+FileIO::Stats FileIO::GetStats() {
+  std::lock_guard<std::mutex> lock{state_->mutex};
+  return state_->stats;
+}
+
+void FileIO::Loop(std::shared_ptr<State> state) {
+  for (;;) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock{state->mutex};
+      state->cond.wait(lock, [&state] {
+        return state->stopped || !state->requests.empty();
+      });
+      if (state->stopped) {
+        return;
+      }
+      request = std::move(state->requests.front());
+      state->requests.pop_front();
+    }
+
+    TaskQueue::Task done = request.work();
+    Clock::time_point now = Clock::now();
+    double latency = std::chrono::duration<double, std::milli>(now - request.submitted).count();
+
+    std::lock_guard<std::mutex> lock{state->mutex};
+    if (state->stopped) {
+      return;
+    }
+    OpStats& stats = state->stats.ops[static_cast<size_t>(request.op)];
+    stats.count++;
+    stats.total_latency += latency;
+    stats.max_latency = std::max(stats.max_latency, latency);
+    // Post the completion while holding the lock, so that the poster is never called after the FileIO is destructed.
+    state->poster(std::move(done));
+  }
+}
+
+}
+`))
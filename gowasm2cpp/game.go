@@ -3,18 +3,12 @@
 package gowasm2cpp
 
 import (
-	"os"
-	"path/filepath"
 	"text/template"
 )
 
-func writeGame(dir string, incpath string, namespace string) error {
+func writeGame(dir *outputDir, incpath string, namespace string) error {
 	{
-		f, err := os.Create(filepath.Join(dir, "game.h"))
-		if err != nil {
-			return err
-		}
-		defer f.Close()
+		f := dir.Create("game.h")
 
 		if err := gameHTmpl.Execute(f, struct {
 			IncludeGuard string
@@ -27,13 +21,12 @@ func writeGame(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
-	}
-	{
-		f, err := os.Create(filepath.Join(dir, "game.cpp"))
-		if err != nil {
+		if err := f.Close(); err != nil {
 			return err
 		}
-		defer f.Close()
+	}
+	{
+		f := dir.Create("game.cpp")
 
 		if err := gameCppTmpl.Execute(f, struct {
 			IncludePath string
@@ -44,6 +37,9 @@ func writeGame(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
+		if err := f.Close(); err != nil {
+			return err
+		}
 	}
 	return nil
 }
@@ -55,6 +51,8 @@ var gameHTmpl = template.Must(template.New("game.h").Parse(`// Code generated by
 
 #include "{{.IncludePath}}go.h"
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -62,6 +60,8 @@ var gameHTmpl = template.Must(template.New("game.h").Parse(`// Code generated by
 
 namespace {{.Namespace}} {
 
+class GL;
+
 class Game {
 public:
   struct Touch {
@@ -78,6 +78,76 @@ public:
     float axes[16];
   };
 
+  // Input is the state of the touches and the gamepads in a flat layout. A Driver updates Input by the changes, and
+  // the Go side reads the state without a copy per frame.
+  //
+  // The state is also exposed to the Go side as go2cpp.inputState, a Uint8Array of the bytes of State, and
+  // go2cpp.inputVersion, which is incremented only when the state changes. The Go side can copy the bytes by
+  // js.CopyBytesToGo only when inputVersion changes. All the values are in the host byte order, which is little
+  // endian on the supported platforms.
+  class Input {
+  public:
+    static constexpr int kMaxTouchCount = 16;
+    static constexpr int kMaxGamepadCount = 16;
+    static constexpr int kMaxGamepadButtonCount = 256;
+    static constexpr int kMaxGamepadAxisCount = 16;
+
+    struct TouchState {
+      int32_t id;
+      int32_t x;
+      int32_t y;
+      int32_t padding;
+    };
+
+    struct GamepadState {
+      int32_t id;
+      int32_t button_count;
+      int32_t axis_count;
+      int32_t padding;
+      uint8_t buttons[kMaxGamepadButtonCount];
+      float axes[kMaxGamepadAxisCount];
+    };
+
+    struct State {
+      uint32_t version;
+      uint32_t touch_count;
+      uint32_t gamepad_count;
+      uint32_t padding;
+      TouchState touches[kMaxTouchCount];
+      GamepadState gamepads[kMaxGamepadCount];
+    };
+
+    Input();
+
+    // SetTouch adds a touch or moves the touch with the same ID. A touch over kMaxTouchCount is ignored.
+    void SetTouch(int id, int x, int y);
+    void RemoveTouch(int id);
+
+    // SetGamepad adds a gamepad or changes the numbers of the buttons and the axes of the gamepad with the same ID.
+    // A gamepad over kMaxGamepadCount is ignored, and the numbers are clamped to the maximums.
+    void SetGamepad(int id, int button_count, int axis_count);
+    void RemoveGamepad(int id);
+    void SetGamepadButton(int id, int button, bool pressed);
+    void SetGamepadAxis(int id, int axis, float value);
+
+    // SetTouches and SetGamepads replace the touches and the gamepads, and change only the differences.
+    void SetTouches(const std::vector<Touch>& touches);
+    void SetGamepads(const std::vector<Gamepad>& gamepads);
+
+    const State& GetState() const;
+    BytesSpan GetBytes();
+
+  private:
+    Input(const Input&) = delete;
+    Input& operator=(const Input&) = delete;
+
+    TouchState* FindTouch(int id);
+    GamepadState* FindGamepad(int id);
+    void Changed();
+
+    State state_;
+  };
+
   class AudioPlayer {
   public:
     virtual ~AudioPlayer();
@@ -88,12 +158,99 @@ public:
     virtual void Play() = 0;
     virtual void Write(const uint8_t* data, int length) = 0;
     virtual size_t GetUnplayedBufferSize() = 0;
+
+    // GetUnderrunCount returns the number of the times the player ran out of the bytes to play.
+    virtual int64_t GetUnderrunCount();
+  };
+
+  // AudioRingBuffer is a lock-free ring buffer of bytes for one producer thread and one consumer thread.
+  class AudioRingBuffer {
+  public:
+    // The capacity is rounded up to a power of two.
+    explicit AudioRingBuffer(size_t capacity);
+
+    // Write copies the bytes as many as possible and returns the number of the copied bytes. Write must be called
+    // from the producer thread.
+    size_t Write(const uint8_t* data, size_t length);
+
+    // Read moves the bytes as many as possible to dst and returns the number of the moved bytes. Read must be
+    // called from the consumer thread.
+    size_t Read(uint8_t* dst, size_t length);
+
+    // Clear discards the bytes. Clear must be called from the consumer thread.
+    void Clear();
+
+    size_t size() const;
+    size_t capacity() const;
+
+  private:
+    AudioRingBuffer(const AudioRingBuffer&) = delete;
+    AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+    std::unique_ptr<uint8_t[]> buf_;
+    size_t mask_;
+    // read_pos_ and write_pos_ increase monotonically, and are masked to access buf_.
+    std::atomic<size_t> read_pos_{0};
+    std::atomic<size_t> write_pos_{0};
+  };
+
+  // StreamAudioPlayer is an AudioPlayer for pull-style audio backends like miniaudio or OpenAL. The Go side writes
+  // the bytes into a ring buffer, and the backend's audio thread takes them by Read. Read never blocks nor locks.
+  //
+  // The Go side is notified to write more when the buffered bytes get less than the target latency. Write never
+  // blocks: the bytes that don't fit in the ring buffer are dropped in whole frames and counted.
+  class StreamAudioPlayer : public AudioPlayer {
+  public:
+    StreamAudioPlayer(int sample_rate, int channel_num, int bit_depth_in_bytes,
+                      std::chrono::milliseconds target_latency, std::function<void()> on_written);
+
+    void Close(bool immediately) override;
+    double GetVolume() override;
+    void SetVolume(double volume) override;
+    void Pause() override;
+    void Play() override;
+    void Write(const uint8_t* data, int length) override;
+    size_t GetUnplayedBufferSize() override;
+    int64_t GetUnderrunCount() override;
+
+    // Read fills dst with the bytes to play, and returns the number of the bytes taken from the buffer. The rest
+    // of dst is filled with silence. Running out of the bytes while playing is counted as an underrun. The volume
+    // is applied to 16-bit samples. Read is called from the audio backend's thread.
+    size_t Read(uint8_t* dst, size_t length);
+
+    // GetTargetBufferSize returns the number of the bytes for the target latency.
+    size_t GetTargetBufferSize() const;
+
+    // GetDroppedByteCount returns the number of the bytes Write dropped as the ring buffer was full.
+    int64_t GetDroppedByteCount() const;
+
+  private:
+    void FillSilence(uint8_t* dst, size_t length) const;
+    void ApplyVolume(uint8_t* dst, size_t length) const;
+
+    const int bit_depth_in_bytes_;
+    const size_t bytes_per_frame_;
+    const size_t target_buffer_size_;
+    std::function<void()> on_written_;
+    AudioRingBuffer ring_;
+
+    std::atomic<double> volume_{1.0};
+    std::atomic<bool> paused_{false};
+    std::atomic<bool> closed_{false};
+    // draining_ is true after Close(false) until the rest of the bytes are played.
+    std::atomic<bool> draining_{false};
+    // started_ is true after the first Write. An underrun is not counted before that.
+    std::atomic<bool> started_{false};
+    // notified_ is true after on_written_ is called until the next Write, not to notify the Go side repeatedly.
+    std::atomic<bool> notified_{false};
+    std::atomic<int64_t> underrun_count_{0};
+    std::atomic<int64_t> dropped_byte_count_{0};
   };
 
   class Driver {
   public:
     virtual ~Driver();
-    virtual void DebugWrite(const std::vector<uint8_t>& bytes);
+    virtual void DebugWrite(BytesSpan bytes);
     virtual bool Initialize() = 0;
     virtual bool Finalize() = 0;
     virtual void Update(std::function<void()> f) = 0;
@@ -101,8 +258,19 @@ public:
     virtual int GetScreenHeight() = 0;
     virtual double GetDevicePixelRatio() = 0;
     virtual void* GetOpenGLFunction(const char* name) = 0;
-    virtual std::vector<Touch> GetTouches() = 0;
-    virtual std::vector<Gamepad> GetGamepads() = 0;
+
+    // UpdateInput updates input by the changes of the touches and the gamepads since the last call. UpdateInput is
+    // called before every frame on the thread where Update calls its function.
+    //
+    // The default implementation applies the differences of GetTouches and GetGamepads. A driver can override this
+    // to push the changes from its events without building the vectors.
+    virtual void UpdateInput(Input& input);
+
+    // GetTouches and GetGamepads return the current state. These are used only by the default UpdateInput, and
+    // return no touches and no gamepads by default.
+    virtual std::vector<Touch> GetTouches();
+    virtual std::vector<Gamepad> GetGamepads();
+
     virtual std::string GetLocalStorageItem(const std::string& key) = 0;
     virtual void SetLocalStorageItem(const std::string& key, const std::string& value) = 0;
     virtual std::string GetDefaultLanguage();
@@ -129,12 +297,19 @@ public:
   int Run(int argc, char *argv[]);
   int Run(const std::vector<std::string>& args);
 
+  // SetGLBatching makes the GL calls recorded and executed once per Driver::Update. This must be called before Run.
+  void SetGLBatching(bool batching);
+
 private:
   void Update(Value f);
 
   std::unique_ptr<Driver> driver_;
-  std::vector<Touch> touches_;
-  std::vector<Gamepad> gamepads_;
+  std::shared_ptr<GL> gl_;
+  bool gl_batching_ = false;
+  Input input_;
+  uint32_t input_version_ = 0;
+  uint32_t touch_count_ = 0;
+  uint32_t gamepad_count_ = 0;
   std::unique_ptr<Binding> binding_;
   bool is_audio_opened_ = false;
 };
@@ -150,6 +325,7 @@ var gameCppTmpl = template.Must(template.New("game.cpp").Parse(`// Code generate
 
 #include "{{.IncludePath}}gl.h"
 
+#include <algorithm>
 #include <cstring>
 #include <thread>
 
@@ -169,7 +345,7 @@ public:
       : driver_{driver} {
   }
 
-  void Write(const std::vector<uint8_t>& bytes) override {
+  void Write(BytesSpan bytes) override {
     driver_->DebugWrite(bytes);
   }
 
@@ -185,9 +361,10 @@ public:
 
   Value Get(const std::string& key) override {
     auto bytes = binding_->Get(key);
-    auto u8 = std::make_shared<Uint8Array>(bytes.size());
-    std::memcpy(u8->ToBytes().begin(), &(*bytes.begin()), bytes.size());
-    return Value{u8};
+    size_t size = bytes.size();
+    // Adopt the bytes instead of copying them.
+    auto buffer = std::make_shared<ArrayBuffer>(std::move(bytes));
+    return Value{std::make_shared<Uint8Array>(buffer, 0, size)};
   }
 
   void Set(const std::string& key, Value value) override {
@@ -389,17 +566,349 @@ private:
 
 } // namespace
 
+constexpr int Game::Input::kMaxTouchCount;
+constexpr int Game::Input::kMaxGamepadCount;
+constexpr int Game::Input::kMaxGamepadButtonCount;
+constexpr int Game::Input::kMaxGamepadAxisCount;
+
+Game::Input::Input() {
+  std::memset(&state_, 0, sizeof(state_));
+}
+
+void Game::Input::SetTouch(int id, int x, int y) {
+  TouchState* t = FindTouch(id);
+  if (!t) {
+    if (static_cast<int>(state_.touch_count) >= kMaxTouchCount) {
+      return;
+    }
+    t = &state_.touches[state_.touch_count];
+    state_.touch_count++;
+    t->id = id;
+  } else if (t->x == x && t->y == y) {
+    return;
+  }
+  t->x = x;
+  t->y = y;
+  Changed();
+}
+
+void Game::Input::RemoveTouch(int id) {
+  TouchState* t = FindTouch(id);
+  if (!t) {
+    return;
+  }
+  // Move the last touch to keep the touches contiguous.
+  state_.touch_count--;
+  *t = state_.touches[state_.touch_count];
+  state_.touches[state_.touch_count] = TouchState{};
+  Changed();
+}
+
+void Game::Input::SetGamepad(int id, int button_count, int axis_count) {
+  button_count = std::max(0, std::min(button_count, kMaxGamepadButtonCount));
+  axis_count = std::max(0, std::min(axis_count, kMaxGamepadAxisCount));
+  GamepadState* g = FindGamepad(id);
+  if (!g) {
+    if (static_cast<int>(state_.gamepad_count) >= kMaxGamepadCount) {
+      return;
+    }
+    g = &state_.gamepads[state_.gamepad_count];
+    state_.gamepad_count++;
+    std::memset(g, 0, sizeof(*g));
+    g->id = id;
+  } else if (g->button_count == button_count && g->axis_count == axis_count) {
+    return;
+  }
+  g->button_count = button_count;
+  g->axis_count = axis_count;
+  Changed();
+}
+
+void Game::Input::RemoveGamepad(int id) {
+  GamepadState* g = FindGamepad(id);
+  if (!g) {
+    return;
+  }
+  state_.gamepad_count--;
+  GamepadState& last = state_.gamepads[state_.gamepad_count];
+  if (g != &last) {
+    std::memcpy(g, &last, sizeof(*g));
+  }
+  std::memset(&last, 0, sizeof(last));
+  Changed();
+}
+
+void Game::Input::SetGamepadButton(int id, int button, bool pressed) {
+  GamepadState* g = FindGamepad(id);
+  if (!g || button < 0 || g->button_count <= button) {
+    return;
+  }
+  uint8_t v = pressed ? 1 : 0;
+  if (g->buttons[button] == v) {
+    return;
+  }
+  g->buttons[button] = v;
+  Changed();
+}
+
+void Game::Input::SetGamepadAxis(int id, int axis, float value) {
+  GamepadState* g = FindGamepad(id);
+  if (!g || axis < 0 || g->axis_count <= axis) {
+    return;
+  }
+  if (g->axes[axis] == value) {
+    return;
+  }
+  g->axes[axis] = value;
+  Changed();
+}
+
+void Game::Input::SetTouches(const std::vector<Touch>& touches) {
+  for (int i = static_cast<int>(state_.touch_count) - 1; i >= 0; i--) {
+    int id = state_.touches[i].id;
+    if (std::none_of(touches.begin(), touches.end(), [id](const Touch& t) { return t.id == id; })) {
+      RemoveTouch(id);
+    }
+  }
+  for (const Touch& t : touches) {
+    SetTouch(t.id, t.x, t.y);
+  }
+}
+
+void Game::Input::SetGamepads(const std::vector<Gamepad>& gamepads) {
+  for (int i = static_cast<int>(state_.gamepad_count) - 1; i >= 0; i--) {
+    int id = state_.gamepads[i].id;
+    if (std::none_of(gamepads.begin(), gamepads.end(), [id](const Gamepad& g) { return g.id == id; })) {
+      RemoveGamepad(id);
+    }
+  }
+  for (const Gamepad& g : gamepads) {
+    SetGamepad(g.id, g.button_count, g.axis_count);
+    for (int i = 0; i < g.button_count && i < kMaxGamepadButtonCount; i++) {
+      SetGamepadButton(g.id, i, g.buttons[i]);
+    }
+    for (int i = 0; i < g.axis_count && i < kMaxGamepadAxisCount; i++) {
+      SetGamepadAxis(g.id, i, g.axes[i]);
+    }
+  }
+}
+
+const Game::Input::State& Game::Input::GetState() const {
+  return state_;
+}
+
+BytesSpan Game::Input::GetBytes() {
+  return BytesSpan{reinterpret_cast<uint8_t*>(&state_), sizeof(state_)};
+}
+
+Game::Input::TouchState* Game::Input::FindTouch(int id) {
+  for (uint32_t i = 0; i < state_.touch_count; i++) {
+    if (state_.touches[i].id == id) {
+      return &state_.touches[i];
+    }
+  }
+  return nullptr;
+}
+
+Game::Input::GamepadState* Game::Input::FindGamepad(int id) {
+  for (uint32_t i = 0; i < state_.gamepad_count; i++) {
+    if (state_.gamepads[i].id == id) {
+      return &state_.gamepads[i];
+    }
+  }
+  return nullptr;
+}
+
+void Game::Input::Changed() {
+  state_.version++;
+}
+
 Game::AudioPlayer::~AudioPlayer() = default;
 
+int64_t Game::AudioPlayer::GetUnderrunCount() {
+  return 0;
+}
+
+Game::AudioRingBuffer::AudioRingBuffer(size_t capacity) {
+  size_t n = 1;
+  while (n < capacity) {
+    n *= 2;
+  }
+  buf_ = std::make_unique<uint8_t[]>(n);
+  mask_ = n - 1;
+}
+
+size_t Game::AudioRingBuffer::Write(const uint8_t* data, size_t length) {
+  size_t write_pos = write_pos_.load(std::memory_order_relaxed);
+  size_t read_pos = read_pos_.load(std::memory_order_acquire);
+  size_t n = std::min(length, capacity() - (write_pos - read_pos));
+  size_t offset = write_pos & mask_;
+  size_t first = std::min(n, capacity() - offset);
+  std::memcpy(&buf_[offset], data, first);
+  std::memcpy(&buf_[0], data + first, n - first);
+  write_pos_.store(write_pos + n, std::memory_order_release);
+  return n;
+}
+
+size_t Game::AudioRingBuffer::Read(uint8_t* dst, size_t length) {
+  size_t read_pos = read_pos_.load(std::memory_order_relaxed);
+  size_t write_pos = write_pos_.load(std::memory_order_acquire);
+  size_t n = std::min(length, write_pos - read_pos);
+  size_t offset = read_pos & mask_;
+  size_t first = std::min(n, capacity() - offset);
+  std::memcpy(dst, &buf_[offset], first);
+  std::memcpy(dst + first, &buf_[0], n - first);
+  read_pos_.store(read_pos + n, std::memory_order_release);
+  return n;
+}
+
+void Game::AudioRingBuffer::Clear() {
+  read_pos_.store(write_pos_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t Game::AudioRingBuffer::size() const {
+  return write_pos_.load(std::memory_order_acquire) - read_pos_.load(std::memory_order_acquire);
+}
+
+size_t Game::AudioRingBuffer::capacity() const {
+  return mask_ + 1;
+}
+
+Game::StreamAudioPlayer::StreamAudioPlayer(int sample_rate, int channel_num, int bit_depth_in_bytes,
+                                           std::chrono::milliseconds target_latency,
+                                           std::function<void()> on_written)
+    : bit_depth_in_bytes_{bit_depth_in_bytes},
+      bytes_per_frame_{static_cast<size_t>(std::max(channel_num * bit_depth_in_bytes, 1))},
+      target_buffer_size_{static_cast<size_t>(sample_rate) * channel_num * bit_depth_in_bytes *
+                          target_latency.count() / 1000},
+      on_written_{std::move(on_written)},
+      // Have room for the Go side writing a little more than the target.
+      ring_{std::max(target_buffer_size_ * 2, static_cast<size_t>(sample_rate) * channel_num * bit_depth_in_bytes / 2)} {
+}
+
+void Game::StreamAudioPlayer::Close(bool immediately) {
+  if (!immediately) {
+    draining_.store(true, std::memory_order_release);
+  }
+  closed_.store(true, std::memory_order_release);
+}
+
+double Game::StreamAudioPlayer::GetVolume() {
+  return volume_.load(std::memory_order_relaxed);
+}
+
+void Game::StreamAudioPlayer::SetVolume(double volume) {
+  volume_.store(volume, std::memory_order_relaxed);
+}
+
+void Game::StreamAudioPlayer::Pause() {
+  paused_.store(true, std::memory_order_release);
+}
+
+void Game::StreamAudioPlayer::Play() {
+  paused_.store(false, std::memory_order_release);
+}
+
+void Game::StreamAudioPlayer::Write(const uint8_t* data, int length) {
+  started_.store(true, std::memory_order_release);
+  notified_.store(false, std::memory_order_release);
+  if (closed_.load(std::memory_order_acquire) || length <= 0) {
+    return;
+  }
+
+  // Never wait for the audio thread here. Read doesn't consume the bytes while the player is paused, and Play can
+  // come only from this thread, so waiting could never end. The Go side writes more after on_written anyway.
+  // The free space only grows by Read, so the space seen here is available. Keep the frames aligned.
+  size_t space = ring_.capacity() - ring_.size();
+  size_t n = std::min(static_cast<size_t>(length), space - space % bytes_per_frame_);
+  n -= n % bytes_per_frame_;
+  ring_.Write(data, n);
+  if (n < static_cast<size_t>(length)) {
+    dropped_byte_count_.fetch_add(static_cast<int64_t>(length - n), std::memory_order_relaxed);
+  }
+}
+
+size_t Game::StreamAudioPlayer::GetUnplayedBufferSize() {
+  return ring_.size();
+}
+
+int64_t Game::StreamAudioPlayer::GetUnderrunCount() {
+  return underrun_count_.load(std::memory_order_relaxed);
+}
+
+size_t Game::StreamAudioPlayer::Read(uint8_t* dst, size_t length) {
+  bool closed = closed_.load(std::memory_order_acquire);
+  if (closed && !draining_.load(std::memory_order_acquire)) {
+    ring_.Clear();
+    FillSilence(dst, length);
+    return 0;
+  }
+  if (paused_.load(std::memory_order_acquire) && !closed) {
+    FillSilence(dst, length);
+    return 0;
+  }
+
+  size_t n = ring_.Read(dst, length);
+  ApplyVolume(dst, n);
+  FillSilence(dst + n, length - n);
+  if (n < length && !closed && started_.load(std::memory_order_acquire)) {
+    underrun_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (!closed && ring_.size() < target_buffer_size_ && !notified_.exchange(true, std::memory_order_acq_rel)) {
+    on_written_();
+  }
+  return n;
+}
+
+size_t Game::StreamAudioPlayer::GetTargetBufferSize() const {
+  return target_buffer_size_;
+}
+
+int64_t Game::StreamAudioPlayer::GetDroppedByteCount() const {
+  return dropped_byte_count_.load(std::memory_order_relaxed);
+}
+
+void Game::StreamAudioPlayer::FillSilence(uint8_t* dst, size_t length) const {
+  // 8-bit PCM is unsigned.
+  std::memset(dst, bit_depth_in_bytes_ == 1 ? 0x80 : 0, length);
+}
+
+void Game::StreamAudioPlayer::ApplyVolume(uint8_t* dst, size_t length) const {
+  double volume = volume_.load(std::memory_order_relaxed);
+  if (volume == 1.0 || bit_depth_in_bytes_ != 2) {
+    return;
+  }
+  for (size_t i = 0; i + 1 < length; i += 2) {
+    int16_t v;
+    std::memcpy(&v, dst + i, 2);
+    v = static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, v * volume)));
+    std::memcpy(dst + i, &v, 2);
+  }
+}
+
 Game::Driver::~Driver() = default;
 
-void Game::Driver::DebugWrite(const std::vector<uint8_t>& bytes) {
+void Game::Driver::DebugWrite(BytesSpan bytes) {
   if (!default_debug_writer_) {
-    default_debug_writer_ = std::make_unique<StreamWriter>(std::cerr);
+    default_debug_writer_ = std::make_unique<BufferedStreamWriter>(std::cerr);
   }
   default_debug_writer_->Write(bytes);
 }
 
+void Game::Driver::UpdateInput(Input& input) {
+  input.SetTouches(GetTouches());
+  input.SetGamepads(GetGamepads());
+}
+
+std::vector<Game::Touch> Game::Driver::GetTouches() {
+  return {};
+}
+
+std::vector<Game::Gamepad> Game::Driver::GetGamepads() {
+  return {};
+}
+
 std::string Game::Driver::GetDefaultLanguage() {
   return "en";
 }
@@ -427,17 +936,21 @@ int Game::Run(const std::vector<std::string>& args) {
     return EXIT_FAILURE;
   }
 
-  auto& global = Value::Global().ToObject();
+  Go go{std::make_unique<DriverDebugWriter>(driver_.get())};
+
+  Value global_value = go.Global();
+  auto& global = global_value.ToObject();
   global.Set("localStorage", Value{std::make_shared<LocalStorage>(driver_.get())});
   global.Set("navigator", Value{std::make_shared<Navigator>(driver_.get())});
 
   auto go2cpp = std::make_shared<DictionaryValues>();
   global.Set("go2cpp", Value{go2cpp});
 
-  auto gl = std::make_shared<GL>([this](const char* name) -> void* {
+  gl_ = std::make_shared<GL>([this](const char* name) -> void* {
     return driver_->GetOpenGLFunction(name);
   });
-  go2cpp->Set("gl", Value{gl});
+  gl_->SetBatching(gl_batching_);
+  go2cpp->Set("gl", Value{gl_});
 
   go2cpp->Set("screenWidth",
       Value{static_cast<double>(driver_->GetScreenWidth())});
@@ -445,54 +958,58 @@ int Game::Run(const std::vector<std::string>& args) {
       Value{static_cast<double>(driver_->GetScreenHeight())});
   go2cpp->Set("devicePixelRatio", Value{driver_->GetDevicePixelRatio()});
 
+  go2cpp->Set("inputVersion", Value{0.0});
+  {
+    auto buffer = std::make_shared<ArrayBuffer>(input_.GetBytes());
+    go2cpp->Set("inputState", Value{std::make_shared<Uint8Array>(buffer, 0, buffer->ByteLength())});
+  }
+
   go2cpp->Set("touchCount", Value{0.0});
   go2cpp->Set("getTouchId", Value{std::make_shared<Function>(
     [this](Value self, std::vector<Value> args) -> Value {
       int idx = static_cast<int>(args[0].ToNumber());
-      return Value{static_cast<double>(touches_[idx].id)};
+      return Value{static_cast<double>(input_.GetState().touches[idx].id)};
     })});
   go2cpp->Set("getTouchX", Value{std::make_shared<Function>(
     [this](Value self, std::vector<Value> args) -> Value {
       int idx = static_cast<int>(args[0].ToNumber());
-      return Value{static_cast<double>(touches_[idx].x)};
+      return Value{static_cast<double>(input_.GetState().touches[idx].x)};
     })});
   go2cpp->Set("getTouchY", Value{std::make_shared<Function>(
     [this](Value self, std::vector<Value> args) -> Value {
       int idx = static_cast<int>(args[0].ToNumber());
-      return Value{static_cast<double>(touches_[idx].y)};
+      return Value{static_cast<double>(input_.GetState().touches[idx].y)};
     })});
 
   go2cpp->Set("gamepadCount", Value{0.0});
   go2cpp->Set("getGamepadId", Value{std::make_shared<Function>(
     [this](Value self, std::vector<Value> args) -> Value {
       int idx = static_cast<int>(args[0].ToNumber());
-      return Value{static_cast<double>(gamepads_[idx].id)};
+      return Value{static_cast<double>(input_.GetState().gamepads[idx].id)};
     })});
   go2cpp->Set("getGamepadButtonCount", Value{std::make_shared<Function>(
     [this](Value self, std::vector<Value> args) -> Value {
       int idx = static_cast<int>(args[0].ToNumber());
-      return Value{static_cast<double>(gamepads_[idx].button_count)};
+      return Value{static_cast<double>(input_.GetState().gamepads[idx].button_count)};
     })});
   go2cpp->Set("isGamepadButtonPressed", Value{std::make_shared<Function>(
     [this](Value self, std::vector<Value> args) -> Value {
       int idx = static_cast<int>(args[0].ToNumber());
       int button_idx = static_cast<int>(args[1].ToNumber());
-      return Value{gamepads_[idx].buttons[button_idx]};
+      return Value{input_.GetState().gamepads[idx].buttons[button_idx] != 0};
     })});
   go2cpp->Set("getGamepadAxisCount", Value{std::make_shared<Function>(
     [this](Value self, std::vector<Value> args) -> Value {
       int idx = static_cast<int>(args[0].ToNumber());
-      return Value{static_cast<double>(gamepads_[idx].axis_count)};
+      return Value{static_cast<double>(input_.GetState().gamepads[idx].axis_count)};
     })});
   go2cpp->Set("getGamepadAxis", Value{std::make_shared<Function>(
     [this](Value self, std::vector<Value> args) -> Value {
       int idx = static_cast<int>(args[0].ToNumber());
       int axis_idx = static_cast<int>(args[1].ToNumber());
-      return Value{static_cast<double>(gamepads_[idx].axes[axis_idx])};
+      return Value{static_cast<double>(input_.GetState().gamepads[idx].axes[axis_idx])};
     })});
 
-  Go go{std::make_unique<DriverDebugWriter>(driver_.get())};
-
   go2cpp->Set("createAudio", Value{std::make_shared<Function>(
     [this, &go](Value self, std::vector<Value> args) -> Value {
       int sample_rate = static_cast<int>(args[0].ToNumber());
@@ -537,13 +1054,28 @@ void Game::Update(Value f) {
   auto& global = Value::Global().ToObject();
   auto& go2cpp = global.Get("go2cpp").ToObject();
 
-  touches_ = driver_->GetTouches();
-  go2cpp.Set("touchCount", Value{static_cast<double>(touches_.size())});
-
-  gamepads_ = driver_->GetGamepads();
-  go2cpp.Set("gamepadCount", Value{static_cast<double>(gamepads_.size())});
+  // The properties are set only when they change.
+  driver_->UpdateInput(input_);
+  const Input::State& state = input_.GetState();
+  if (input_version_ != state.version) {
+    input_version_ = state.version;
+    go2cpp.Set("inputVersion", Value{static_cast<double>(input_version_)});
+  }
+  if (touch_count_ != state.touch_count) {
+    touch_count_ = state.touch_count;
+    go2cpp.Set("touchCount", Value{static_cast<double>(touch_count_)});
+  }
+  if (gamepad_count_ != state.gamepad_count) {
+    gamepad_count_ = state.gamepad_count;
+    go2cpp.Set("gamepadCount", Value{static_cast<double>(gamepad_count_)});
+  }
 
   f.ToObject().Invoke(Value{}, {});
+  gl_->Flush();
+}
+
+void Game::SetGLBatching(bool batching) {
+  gl_batching_ = batching;
 }
 
 Game::Binding::~Binding() = default;
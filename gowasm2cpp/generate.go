@@ -4,11 +4,16 @@ package gowasm2cpp
 
 import (
 	"bytes"
+	"crypto/sha256"
+	"encoding/binary"
 	"fmt"
-	"os"
+	"io/ioutil"
 	"path/filepath"
 	"regexp"
+	"sort"
+	"strconv"
 	"strings"
+	"sync/atomic"
 	"text/template"
 
 	"github.com/go-interpreter/wagon/wasm"
@@ -55,6 +60,21 @@ type wasmFunc struct {
 	Index   int
 	Import  bool
 	BodyStr string
+
+	// Structured reports whether the control flow is lowered to structured statements instead of gotos.
+	Structured bool
+
+	// CacheGlobals reports whether the body works on local copies of the globals.
+	CacheGlobals bool
+
+	// CheckedMem reports whether the body passes its name to the memory accessors for the error messages.
+	CheckedMem bool
+
+	// Profile reports whether the body records its calls on the profiler's shadow call stack.
+	Profile bool
+
+	// Temperature is how often the function runs according to the profile given by Options.ProfilePath.
+	Temperature temperature
 }
 
 func (f *wasmFunc) Identifier() string {
@@ -62,12 +82,10 @@ func (f *wasmFunc) Identifier() string {
 }
 
 var funcDeclTmpl = template.Must(template.New("funcDecl").Parse(`// OriginalName: {{.OriginalName}}
-// Index:        {{.Index}}
-{{if .Abstract}}virtual {{end}}{{.ReturnType}} {{.Name}}({{.Args}}){{if .Abstract}} = 0{{end}}{{if .Override}} override{{end}};`))
+{{if .Abstract}}virtual {{end}}{{.Attr}}{{.ReturnType}} {{.Name}}({{.Args}}){{if .Abstract}} = 0{{end}}{{if .Override}} override{{end}};`))
 
 var funcImplTmpl = template.Must(template.New("func").Parse(`// OriginalName: {{.OriginalName}}
-// Index:        {{.Index}}
-{{.ReturnType}} {{.Class}}::{{.Name}}({{.Args}}) {
+{{.Attr}}{{.ReturnType}} {{if .Class}}{{.Class}}::{{end}}{{.Name}}({{.Args}}) {
 {{range .Locals}}  {{.}}
 {{end}}{{if .Locals}}
 {{end}}{{range .Body}}{{.}}
@@ -100,6 +118,9 @@ func (f *wasmFunc) CppDecl(indent string, abstract bool, override bool) (string,
 	}
 
 	var args []string
+	if !f.Import {
+		args = append(args, "Inst* inst")
+	}
 	for i, t := range f.Wasm.Sig.ParamTypes {
 		args = append(args, fmt.Sprintf("%s local%d_", wasmTypeToReturnType(t).Cpp(), i))
 	}
@@ -109,6 +130,7 @@ func (f *wasmFunc) CppDecl(indent string, abstract bool, override bool) (string,
 		OriginalName string
 		Name         string
 		Index        int
+		Attr         string
 		ReturnType   string
 		Args         string
 		Abstract     bool
@@ -117,6 +139,7 @@ func (f *wasmFunc) CppDecl(indent string, abstract bool, override bool) (string,
 		OriginalName: f.Wasm.Name,
 		Name:         identifierFromString(f.Wasm.Name),
 		Index:        f.Index,
+		Attr:         f.Temperature.Attr(),
 		ReturnType:   retType.Cpp(),
 		Args:         strings.Join(args, ", "),
 		Abstract:     abstract,
@@ -133,6 +156,8 @@ func (f *wasmFunc) CppDecl(indent string, abstract bool, override bool) (string,
 	return strings.Join(lines, "\n"), nil
 }
 
+// CppImpl returns the C++ definition of the function. If className is empty, the function is a free function taking
+// the Inst as the first argument.
 func (f *wasmFunc) CppImpl(className string, indent string) (string, error) {
 	var retType returnType
 	switch ts := f.Wasm.Sig.ReturnTypes; len(ts) {
@@ -145,12 +170,16 @@ func (f *wasmFunc) CppImpl(className string, indent string) (string, error) {
 	}
 
 	var args []string
+	if className == "" {
+		args = append(args, "Inst* inst")
+	}
 	for i, t := range f.Wasm.Sig.ParamTypes {
 		args = append(args, fmt.Sprintf("%s local%d_", wasmTypeToReturnType(t).Cpp(), i))
 	}
 
 	var locals []string
 	var body []string
+	var cached bool
 	if f.BodyStr != "" {
 		body = strings.Split(f.BodyStr, "\n")
 	} else if f.Wasm.Body != nil {
@@ -167,6 +196,10 @@ func (f *wasmFunc) CppImpl(className string, indent string) (string, error) {
 			return "", err
 		}
 		locals = removeUnusedLocalVariables(locals, body)
+		cached = f.CacheGlobals
+		if f.CheckedMem && nameMemAccesses(body) {
+			locals = append([]string{fmt.Sprintf("constexpr const char* func_ = %s;", strconv.Quote(f.Wasm.Name))}, locals...)
+		}
 	} else {
 		// TODO: Use error function.
 		ident := identifierFromString(f.Wasm.Name)
@@ -174,6 +207,12 @@ func (f *wasmFunc) CppImpl(className string, indent string) (string, error) {
 			fmt.Sprintf(`  std::cerr << "%s not implemented" << std::endl;`, ident),
 			"  std::exit(1);"}
 	}
+	if className == "" {
+		locals = append(instMemberAliases(body, cached), locals...)
+		if f.Profile {
+			locals = append([]string{fmt.Sprintf("Profiler::Scope profiler_scope_{%d};", f.Index)}, locals...)
+		}
+	}
 
 	var buf bytes.Buffer
 	if err := funcImplTmpl.Execute(&buf, struct {
@@ -181,6 +220,7 @@ func (f *wasmFunc) CppImpl(className string, indent string) (string, error) {
 		Name         string
 		Class        string
 		Index        int
+		Attr         string
 		ReturnType   string
 		Args         string
 		Locals       []string
@@ -190,6 +230,7 @@ func (f *wasmFunc) CppImpl(className string, indent string) (string, error) {
 		Name:         identifierFromString(f.Wasm.Name),
 		Class:        className,
 		Index:        f.Index,
+		Attr:         f.Temperature.Attr(),
 		ReturnType:   retType.Cpp(),
 		Args:         strings.Join(args, ", "),
 		Locals:       locals,
@@ -207,9 +248,69 @@ func (f *wasmFunc) CppImpl(className string, indent string) (string, error) {
 }
 
 var (
-	localVariableRe = regexp.MustCompile(`local[0-9]+_`)
+	localVariableRe  = regexp.MustCompile(`local[0-9]+_`)
+	globalVariableRe = regexp.MustCompile(`global([0-9]+)_`)
+	memMemberRe      = regexp.MustCompile(`\bmem_(->|[,)])`)
+	importMemberRe   = regexp.MustCompile(`\bimport_->`)
 )
 
+// instMemberAliases returns the declarations of the local aliases for the Inst members used in the body.
+// If cached is true, the globals are declared as copies instead of references (see cacheGlobals).
+func instMemberAliases(body []string, cached bool) []string {
+	var mem, imp bool
+	globals := map[int]struct{}{}
+	for _, l := range body {
+		if !mem && memMemberRe.MatchString(l) {
+			mem = true
+		}
+		if !imp && importMemberRe.MatchString(l) {
+			imp = true
+		}
+		for _, m := range globalVariableRe.FindAllStringSubmatch(l, -1) {
+			idx, _ := strconv.Atoi(m[1])
+			globals[idx] = struct{}{}
+		}
+	}
+
+	var decls []string
+	if mem {
+		decls = append(decls, "Mem* const mem_ = inst->mem_;")
+	}
+	if imp {
+		decls = append(decls, "Import* const import_ = inst->import_;")
+	}
+	var gs []int
+	for idx := range globals {
+		gs = append(gs, idx)
+	}
+	sort.Ints(gs)
+	for _, idx := range gs {
+		if cached {
+			decls = append(decls, fmt.Sprintf("auto global%d_ = inst->global%d_;", idx, idx))
+			continue
+		}
+		decls = append(decls, fmt.Sprintf("auto& global%d_ = inst->global%d_;", idx, idx))
+	}
+	return decls
+}
+
+var memAccessRe = regexp.MustCompile(`\bmem_->((Load|Store)(Int|Uint|Float)[0-9]+)\(`)
+
+// nameMemAccesses makes the memory loads and stores in the body pass the function name func_ as the first
+// argument, so that an invalid access can be reported with the function name in MemModeChecked. nameMemAccesses
+// reports whether the body has any memory accesses.
+func nameMemAccesses(body []string) bool {
+	var found bool
+	for i, l := range body {
+		if !memAccessRe.MatchString(l) {
+			continue
+		}
+		body[i] = memAccessRe.ReplaceAllString(l, "mem_->${1}(func_, ")
+		found = true
+	}
+	return found
+}
+
 func removeUnusedLocalVariables(decls []string, body []string) []string {
 	decl2name := map[string]string{}
 	for _, d := range decls {
@@ -299,7 +400,7 @@ func (e *wasmExport) CppImpl(indent string) (string, error) {
 	str := fmt.Sprintf(`%s Inst::%s(%s) {
   %s%s(%s);
 }
-`, retType.Cpp(), e.Name, strings.Join(args, ", "), ret, identifierFromString(f.Wasm.Name), strings.Join(argsToPass, ", "))
+`, retType.Cpp(), e.Name, strings.Join(args, ", "), ret, identifierFromString(f.Wasm.Name), strings.Join(append([]string{"this"}, argsToPass...), ", "))
 
 	lines := strings.Split(str, "\n")
 	for i := range lines {
@@ -321,6 +422,45 @@ func (g *wasmGlobal) Cpp() string {
 type wasmType struct {
 	Sig   *wasm.FunctionSig
 	Index int
+
+	// IndirectTargets is the table for call_indirect with this type. An element is nil when the function at the
+	// index does not have this type. IndirectTargets is nil when no function in the table has this type.
+	IndirectTargets []*wasmFunc
+
+	// Devirtualized is the only function in the table that has this type, if devirtualization is enabled.
+	Devirtualized *wasmFunc
+
+	// indirectCalled is set atomically when a function body calls IndirectTargets.
+	indirectCalled int32
+}
+
+// IndirectTable returns the table to be emitted for call_indirect with this type. IndirectTable returns nil if no
+// function body uses the table.
+func (t *wasmType) IndirectTable() []*wasmFunc {
+	if atomic.LoadInt32(&t.indirectCalled) == 0 {
+		return nil
+	}
+	lo, hi := t.indirectTableRange()
+	return t.IndirectTargets[lo:hi]
+}
+
+// IndirectTableOffset returns the table index of the first element of IndirectTable.
+func (t *wasmType) IndirectTableOffset() int {
+	lo, _ := t.indirectTableRange()
+	return lo
+}
+
+// indirectTableRange returns the range of the table indices from the first function to the last function with this
+// type. The elements out of the range are not emitted.
+func (t *wasmType) indirectTableRange() (int, int) {
+	lo, hi := 0, len(t.IndirectTargets)
+	for lo < hi && t.IndirectTargets[lo] == nil {
+		lo++
+	}
+	for hi > lo && t.IndirectTargets[hi-1] == nil {
+		hi--
+	}
+	return lo, hi
 }
 
 func (t *wasmType) Cpp() (string, error) {
@@ -333,26 +473,213 @@ func (t *wasmType) Cpp() (string, error) {
 	default:
 		return "", fmt.Errorf("the number of return values must be 0 or 1 but %d", len(ts))
 	}
-	var args []string
+	args := []string{"Inst* inst"}
 	for i, t := range t.Sig.ParamTypes {
 		args = append(args, fmt.Sprintf("%s arg%d", wasmTypeToReturnType(t).Cpp(), i))
 	}
 
-	return fmt.Sprintf("%s (Inst::*)(%s)", retType.Cpp(), strings.Join(args, ", ")), nil
+	return fmt.Sprintf("%s (*)(%s)", retType.Cpp(), strings.Join(args, ", ")), nil
+}
+
+func sameSig(a, b *wasm.FunctionSig) bool {
+	if len(a.ParamTypes) != len(b.ParamTypes) || len(a.ReturnTypes) != len(b.ReturnTypes) {
+		return false
+	}
+	for i := range a.ParamTypes {
+		if a.ParamTypes[i] != b.ParamTypes[i] {
+			return false
+		}
+	}
+	for i := range a.ReturnTypes {
+		if a.ReturnTypes[i] != b.ReturnTypes[i] {
+			return false
+		}
+	}
+	return true
+}
+
+// CppTrap returns the C++ definition of a function with this type that traps.
+func (t *wasmType) CppTrap() (string, error) {
+	var retType returnType
+	switch ts := t.Sig.ReturnTypes; len(ts) {
+	case 0:
+		retType = returnTypeVoid
+	case 1:
+		retType = wasmTypeToReturnType(ts[0])
+	default:
+		return "", fmt.Errorf("the number of return values must be 0 or 1 but %d", len(ts))
+	}
+	args := []string{"Inst* inst"}
+	for i, t := range t.Sig.ParamTypes {
+		args = append(args, fmt.Sprintf("%s arg%d", wasmTypeToReturnType(t).Cpp(), i))
+	}
+	return fmt.Sprintf(`%s TrapType%d(%s) {
+  TrapIndirectCall();
+}`, retType.Cpp(), t.Index, strings.Join(args, ", ")), nil
+}
+
+// DataMode represents how the Wasm data segments are embedded into the generated program.
+type DataMode string
+
+const (
+	// DataModeInline embeds the data segments into mem.cpp as a byte literal.
+	DataModeInline DataMode = "inline"
+
+	// DataModeFile writes the data segments as a sidecar file, which is mapped copy-on-write into the linear memory
+	// at startup.
+	DataModeFile DataMode = "file"
+
+	// DataModeIncbin writes the data segments as a sidecar file, which is linked into the program by the
+	// assembler's .incbin directive.
+	DataModeIncbin DataMode = "incbin"
+)
+
+// MemMode represents how the generated program accesses the linear memory.
+type MemMode string
+
+const (
+	// MemModeFast accesses the memory by memcpy without any checks. The compiler folds a memcpy into a single move.
+	MemModeFast MemMode = "fast"
+
+	// MemModeChecked validates every access against the memory size, and reports the Go function making an invalid
+	// access. This is for debugging and staging.
+	MemModeChecked MemMode = "checked"
+)
+
+// defaultShards is the default number of inst.funcs.*.cpp files.
+const defaultShards = 32
+
+// Options represents options for GenerateWithOptions.
+type Options struct {
+	// DataMode specifies how the data segments are embedded. The default value is DataModeInline.
+	DataMode DataMode
+
+	// MemMode specifies how the memory is accessed. The default value is MemModeFast.
+	MemMode MemMode
+
+	// Devirtualize makes a call_indirect a direct call when only one function in the table has the type.
+	// The call does not trap even if the index is invalid.
+	Devirtualize bool
+
+	// DataPath is the path of the sidecar data file that the generated program opens at runtime (DataModeFile) or
+	// that the assembler includes (DataModeIncbin). The path is embedded as is: a relative path is resolved against
+	// the working directory of the program, or against the working directory and the include paths of the
+	// assembler. The generator writes the file to the output directory with the base name of DataPath, and the file
+	// should be installed where DataPath points, e.g. DataPath is "autogen/mem.data" for the output directory
+	// "autogen" and the program run in its parent directory. The default value is "mem.data".
+	DataPath string
+
+	// Shards is the number of inst.funcs.*.cpp files. The functions are distributed so that the files have similar
+	// sizes. 1 means a jumbo build of all the functions. The default value is 32.
+	Shards int
+
+	// PCH makes each inst.funcs.*.cpp include only inst.pch.h so that the header can be precompiled.
+	PCH bool
+
+	// StructuredControlFlow lowers the Wasm blocks and loops to C++ compound statements, and the branches to
+	// break and continue where possible. The stack variables are declared in their blocks instead of the
+	// beginning of the function, which helps the C++ compiler's register allocation. A branch that cannot be
+	// break or continue, e.g. a branch to an outer block or a br_table, is still lowered to goto.
+	StructuredControlFlow bool
+
+	// Intrinsics maps Go function names, as in the Wasm name section, to C++ function bodies replacing the
+	// translated bodies. The entries are added to the built-in intrinsics, and override them. An empty body disables
+	// the built-in intrinsic for the function.
+	//
+	// A body is the statements of a generated function: the Wasm parameters are local0_, local1_, ..., and the body
+	// can use inst, mem_, import_ and the globals like global0_. Note that a Go function takes its arguments and
+	// results on the Go stack, which global0_ points to.
+	Intrinsics map[string]string
+
+	// CacheGlobals makes each function keep the globals, such as Go's stack pointer, in local variables. The
+	// globals are written back to Inst only before calls and returns, and are reloaded after calls.
+	CacheGlobals bool
+
+	// Profiler makes each function record its calls on a per-thread shadow call stack, which Profiler in
+	// profiler.h samples and writes as a pprof profile keyed by the Go function names. This costs a few stores per
+	// call.
+	Profiler bool
+
+	// EliminateDeadFuncs removes the functions that are unreachable from the exports through the calls and the
+	// call_indirects, and writes the removed functions per package to deadfuncs.txt.
+	EliminateDeadFuncs bool
+
+	// ProfilePath is the path of a pprof profile keyed by the Go function names, e.g. a profile written by Profiler or
+	// by runtime/pprof. The names are matched after being mangled as Go's linker does for Wasm.
+	// With a profile, the hot functions are marked hot and put together in inst.funcs.hot.cpp so that the C++
+	// compiler can inline them into each other. The panic and fatal error functions that the profile never has are
+	// marked cold and non-inlined, and are put in inst.funcs.cold.cpp.
+	ProfilePath string
+}
+
+func (o *Options) dataMode() DataMode {
+	if o.DataMode == "" {
+		return DataModeInline
+	}
+	return o.DataMode
+}
+
+func (o *Options) memMode() MemMode {
+	if o.MemMode == "" {
+		return MemModeFast
+	}
+	return o.MemMode
+}
+
+func (o *Options) intrinsics() map[string]string {
+	m := map[string]string{}
+	for name, body := range builtinIntrinsics {
+		m[name] = body
+	}
+	for name, body := range o.Intrinsics {
+		m[name] = body
+	}
+	return m
+}
+
+func (o *Options) shards() int {
+	if o.Shards <= 0 {
+		return defaultShards
+	}
+	return o.Shards
+}
+
+func (o *Options) dataPath() string {
+	if o.DataPath == "" {
+		return dataFileName
+	}
+	return o.DataPath
 }
 
 func Generate(outDir string, include string, wasmFile string, namespace string) error {
-	f, err := os.Open(wasmFile)
+	return GenerateWithOptions(outDir, include, wasmFile, namespace, &Options{})
+}
+
+func GenerateWithOptions(outDir string, include string, wasmFile string, namespace string, options *Options) error {
+	switch options.dataMode() {
+	case DataModeInline, DataModeFile, DataModeIncbin:
+	default:
+		return fmt.Errorf("invalid data mode: %q", options.DataMode)
+	}
+	switch options.memMode() {
+	case MemModeFast, MemModeChecked:
+	default:
+		return fmt.Errorf("invalid memory mode: %q", options.MemMode)
+	}
+
+	wasmBytes, err := ioutil.ReadFile(wasmFile)
 	if err != nil {
 		return err
 	}
-	defer f.Close()
 
-	mod, err := wasm.DecodeModule(f)
+	mod, err := wasm.DecodeModule(bytes.NewReader(wasmBytes))
 	if err != nil {
 		return err
 	}
 
+	// programHash identifies the Wasm file, so that a snapshot for another program is not used.
+	programHash := sha256.Sum256(wasmBytes)
+
 	var types []*wasmType
 	for i, e := range mod.Types.Entries {
 		e := e
@@ -404,12 +731,13 @@ func Generate(outDir string, include string, wasmFile string, namespace string)
 			names = sub.(*wasm.FunctionNames).Names
 		}
 	}
+	intrinsics := options.intrinsics()
 	var fs []*wasmFunc
 	for i, t := range mod.Function.Types {
 		name := names[uint32(i+len(mod.Import.Entries))]
-		bodyStr, ok := specialFunctionBodies[name]
+		bodyStr, ok := intrinsics[name]
 		var body *wasm.FunctionBody
-		if !ok {
+		if !ok || bodyStr == "" {
 			body = &mod.Code.Bodies[i]
 		}
 		fs = append(fs, &wasmFunc{
@@ -422,6 +750,11 @@ func Generate(outDir string, include string, wasmFile string, namespace string)
 			Globals: globals,
 			Index:   i + len(mod.Import.Entries),
 			BodyStr: bodyStr,
+
+			Structured:   options.StructuredControlFlow,
+			CacheGlobals: options.CacheGlobals,
+			CheckedMem:   options.memMode() == MemModeChecked,
+			Profile:      options.Profiler,
 		})
 	}
 
@@ -472,6 +805,62 @@ func Generate(outDir string, include string, wasmFile string, namespace string)
 		copy(tables[e.Index][offset:], e.Elems)
 	}
 
+	if len(tables) > 0 {
+		for i, idx := range tables[0] {
+			f := allfs[idx]
+			// An import function cannot be called indirectly.
+			if f.Import {
+				continue
+			}
+			// Signatures are compared structurally, as call_indirect does.
+			for _, t := range types {
+				if !sameSig(t.Sig, f.Type.Sig) {
+					continue
+				}
+				if t.IndirectTargets == nil {
+					t.IndirectTargets = make([]*wasmFunc, len(tables[0]))
+				}
+				t.IndirectTargets[i] = f
+			}
+		}
+	}
+	if options.Devirtualize {
+		for _, t := range types {
+			var target *wasmFunc
+			for _, f := range t.IndirectTargets {
+				if f == nil || f == target {
+					continue
+				}
+				if target != nil {
+					target = nil
+					break
+				}
+				target = f
+			}
+			t.Devirtualized = target
+		}
+	}
+
+	var deadFuncsReportContent []byte
+	if options.EliminateDeadFuncs {
+		live, dead, err := reachableFuncs(fs, exports)
+		if err != nil {
+			return err
+		}
+		deadFuncsReportContent = deadFuncsReport(dead, len(fs))
+		fs = live
+	}
+
+	if options.ProfilePath != "" {
+		p, err := readFuncProfile(options.ProfilePath)
+		if err != nil {
+			return err
+		}
+		for f, t := range p.temperatures(fs) {
+			f.Temperature = t
+		}
+	}
+
 	var data []wasmData
 	for _, e := range mod.Data.Entries {
 		offset, err := mod.ExecInitExpr(e.Offset)
@@ -492,14 +881,18 @@ func Generate(outDir string, include string, wasmFile string, namespace string)
 		}
 	}
 
+	dir := newOutputDir(outDir)
+	prevManifest := readManifest(outDir)
+	var prevBoundaries []string
+	if prevManifest != nil {
+		prevBoundaries = prevManifest.ShardBoundaries
+	}
+	var shardBoundaries []string
+
 	var g errgroup.Group
 	g.Go(func() error {
 		{
-			out, err := os.Create(filepath.Join(outDir, "go.h"))
-			if err != nil {
-				return err
-			}
-			defer out.Close()
+			out := dir.Create("go.h")
 
 			if err := goHTmpl.Execute(out, struct {
 				IncludeGuard string
@@ -514,58 +907,87 @@ func Generate(outDir string, include string, wasmFile string, namespace string)
 			}); err != nil {
 				return err
 			}
-		}
-		{
-			out, err := os.Create(filepath.Join(outDir, "go.cpp"))
-			if err != nil {
+			if err := out.Close(); err != nil {
 				return err
 			}
-			defer out.Close()
+		}
+		{
+			out := dir.Create("go.cpp")
 
 			if err := goCppTmpl.Execute(out, struct {
 				IncludePath string
 				Namespace   string
 				ImportFuncs []*wasmFunc
+				ProgramHash uint64
 			}{
 				IncludePath: incpath,
 				Namespace:   namespace,
 				ImportFuncs: ifs,
+				ProgramHash: binary.LittleEndian.Uint64(programHash[:8]),
 			}); err != nil {
 				return err
 			}
+			if err := out.Close(); err != nil {
+				return err
+			}
 		}
 		return nil
 	})
 	g.Go(func() error {
-		return writeBits(outDir, incpath, namespace)
+		return writeBits(dir, incpath, namespace)
+	})
+	g.Go(func() error {
+		return writeIntrinsics(dir, incpath, namespace)
 	})
 	g.Go(func() error {
-		return writeGame(outDir, incpath, namespace)
+		return writeGame(dir, incpath, namespace)
 	})
 	g.Go(func() error {
-		return writeGL(outDir, incpath, namespace)
+		return writeGL(dir, incpath, namespace)
 	})
 	g.Go(func() error {
-		return writeJS(outDir, incpath, namespace)
+		return writeJS(dir, incpath, namespace)
 	})
 	g.Go(func() error {
-		return writeTaskQueue(outDir, incpath, namespace)
+		return writeTaskQueue(dir, incpath, namespace)
 	})
 	g.Go(func() error {
-		return writeBytes(outDir, incpath, namespace)
+		return writeFileIO(dir, incpath, namespace)
 	})
 	g.Go(func() error {
-		return writeInst(outDir, incpath, namespace, ifs, fs, exports, globals, types, tables)
+		return writeNet(dir, incpath, namespace)
 	})
 	g.Go(func() error {
-		return writeMem(outDir, incpath, namespace, int(mod.Memory.Entries[0].Limits.Initial), data)
+		return writePool(dir, incpath, namespace)
+	})
+	g.Go(func() error {
+		return writeBytes(dir, incpath, namespace)
+	})
+	g.Go(func() error {
+		return writeProfiler(dir, incpath, namespace, allfs, options)
+	})
+	g.Go(func() error {
+		b, err := writeInst(dir, incpath, namespace, ifs, fs, exports, globals, types, prevBoundaries, options)
+		if err != nil {
+			return err
+		}
+		shardBoundaries = b
+		return nil
+	})
+	if deadFuncsReportContent != nil {
+		g.Go(func() error {
+			return dir.WriteFile(deadFuncsReportFileName, deadFuncsReportContent)
+		})
+	}
+	g.Go(func() error {
+		return writeMem(dir, incpath, namespace, int(mod.Memory.Entries[0].Limits.Initial), data, options)
 	})
 
 	if err := g.Wait(); err != nil {
 		return err
 	}
 
-	return nil
+	return dir.writeManifest(prevManifest, shardBoundaries)
 }
 
 var goHTmpl = template.Must(template.New("go.h").Parse(`// Code generated by go2cpp. DO NOT EDIT.
@@ -574,9 +996,11 @@ var goHTmpl = template.Must(template.New("go.h").Parse(`// Code generated by go2
 #define {{.IncludeGuard}}
 
 #include "{{.IncludePath}}bytes.h"
+#include "{{.IncludePath}}fileio.h"
 #include "{{.IncludePath}}js.h"
 #include "{{.IncludePath}}inst.h"
 #include "{{.IncludePath}}mem.h"
+#include "{{.IncludePath}}net.h"
 #include "{{.IncludePath}}taskqueue.h"
 
 #include <algorithm>
@@ -585,7 +1009,6 @@ var goHTmpl = template.Must(template.New("go.h").Parse(`// Code generated by go2
 #include <functional>
 #include <map>
 #include <memory>
-#include <stack>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -596,16 +1019,202 @@ class Mem;
 
 class Go {
 public:
+  // Exports calls the Go functions registered by the package github.com/hajimehoshi/go2cpp/export.
+  //
+  // The arguments and the results are bytes in the linear memory, and a batch of calls runs in one event of Go
+  // without js Values for each call. Use Exports on the thread running Go while Go waits for events, e.g. in a task
+  // by EnqueueTask.
+  class Exports {
+  public:
+    // Args is the arguments of a call. An Args can be reused after Clear without allocations.
+    class Args {
+    public:
+      Args& Int32(int32_t v);
+      Args& Int64(int64_t v);
+      Args& Float64(double v);
+      Args& Bytes(const uint8_t* data, size_t size);
+      Args& String(const std::string& str);
+      void Clear();
+
+    private:
+      friend class Exports;
+
+      template<typename T>
+      void Put(T v);
+
+      std::vector<uint8_t> bytes_;
+    };
+
+    // Result reads the results of a call in the order Go wrote them. A Result views the linear memory, and is valid
+    // until the next Enqueue, Flush or Call.
+    class Result {
+    public:
+      Result() = default;
+      Result(const uint8_t* data, size_t size);
+
+      int32_t Int32();
+      int64_t Int64();
+      double Float64();
+      // Bytes returns the bytes without copying.
+      BytesSpan Bytes();
+      std::string String();
+
+      // Ok reports whether all the reads were in range.
+      bool Ok() const;
+
+    private:
+      template<typename T>
+      T Get();
+
+      const uint8_t* data_ = nullptr;
+      size_t size_ = 0;
+      size_t pos_ = 0;
+      bool ok_ = true;
+    };
+
+    explicit Exports(Go* go);
+
+    // Lookup returns the ID of the Go function registered with the name, or -1 if the name is not registered.
+    int32_t Lookup(const std::string& name) const;
+
+    // Enqueue adds a call of the Go function id to the batch, and returns the index of the result. The arguments are
+    // copied to the request buffer in the linear memory.
+    int32_t Enqueue(int32_t id, const Args& args);
+
+    // Flush runs the calls in the batch in one event of Go.
+    void Flush();
+
+    // GetResult returns the result of the call at the index in the last batch.
+    Result GetResult(int32_t index) const;
+
+    // Call runs the batch with a call of the Go function id, and returns the result of the call.
+    Result Call(int32_t id, const Args& args);
+
+  private:
+    friend class Go;
+
+    // The offsets in the mailbox of the export package.
+    static constexpr int32_t kRequestAddr = 0;
+    static constexpr int32_t kRequestCap = 4;
+    static constexpr int32_t kRequestLen = 8;
+    static constexpr int32_t kRequestCount = 12;
+    static constexpr int32_t kResultAddr = 16;
+    static constexpr int32_t kResultLen = 20;
+    static constexpr int32_t kNeed = 24;
+
+    void Reset();
+    void Dispatch();
+
+    Go* go_;
+    int32_t mailbox_ = 0;
+    Value dispatch_;
+    std::unordered_map<std::string, int32_t> ids_;
+    // len_ and count_ are the bytes and the number of the calls in the batch.
+    int32_t len_ = 0;
+    int32_t count_ = 0;
+    std::vector<std::pair<const uint8_t*, size_t>> results_;
+  };
+
   Go();
   Go(std::unique_ptr<Writer> debug_writer);
   int Run();
   int Run(int argc, char** argv);
   int Run(const std::vector<std::string>& args);
 
+  // SetSnapshotPath sets the path to write a snapshot to.
+  //
+  // When the Go program calls go2cppSnapshot(callback), e.g. at the beginning of main.main, the snapshot is written
+  // once the control returns to the host, and then the callback is called with the arguments of the run as an array
+  // of strings. Without a snapshot path, only the callback is called.
+  //
+  // A snapshot has the linear memory, the globals, the references held by Go and the pending timeouts. Values that
+  // Go set on host objects, file or socket operations in flight, and references not obtained as properties of other
+  // references are not in a snapshot. Such references are restored as undefined with a warning at writing. A
+  // snapshot is valid only for the same Wasm file and the same architecture.
+  void SetSnapshotPath(const std::string& path);
+
+  // RunFromSnapshot runs the program from the snapshot at path, skipping the runtime initialization and everything
+  // else before go2cppSnapshot. The callback is called with args, as os.Args has the arguments at the snapshot.
+  //
+  // If the snapshot cannot be used, e.g. the file doesn't exist or was written for another program, RunFromSnapshot
+  // runs the program from the start like Run.
+  int RunFromSnapshot(const std::string& path, const std::vector<std::string>& args);
+
   // EnqueuTask is concurrent-safe.
-  void EnqueueTask(std::function<void()> task);
+  void EnqueueTask(TaskQueue::Task task);
+
+  // GetTimerStats returns the statistics of the timers for setTimeout.
+  TimerService::Stats GetTimerStats();
+
+  // GetFileIOStats returns the statistics of the file operations for the fs object.
+  FileIO::Stats GetFileIOStats();
+
+  // GetLiveRefCount returns the number of the references held by Go, excluding the permanent ones like null or the
+  // global object. A number that keeps growing indicates a leak of js.Value or js.Func.
+  int32_t GetLiveRefCount() const;
+
+  Exports& GetExports();
+
+  // Global returns the global object of this instance. Each instance has its own global object with its own fs,
+  // process and net objects. Set the host objects for the Go program here before Run.
+  Value Global();
 
 private:
+  // kMaxInlineArgs is the number of the arguments of a call from Go that are passed without a heap allocation.
+  static constexpr int32_t kMaxInlineArgs = 16;
+
+  // kNumPredefinedRefs is the number of the references whose IDs are fixed in syscall/js.
+  static constexpr int32_t kNumPredefinedRefs = 7;
+
+  // RefOrigin describes how a reference was made, so that a snapshot can make it again.
+  struct RefOrigin {
+    enum class Kind : uint8_t {
+      Unknown,
+      // Property is the property key of the reference parent.
+      Property,
+      // FuncWrapper is the function made by MakeFuncWrapper(id).
+      FuncWrapper,
+      // Event and Args are the cached event and arguments for the function wrapper id.
+      Event,
+      Args,
+      EmptyArgs,
+    };
+
+    Kind kind = Kind::Unknown;
+    int32_t parent = 0;
+    // key points to an interned string in property_names_.
+    const std::string* key = nullptr;
+    int32_t id = 0;
+  };
+
+  // RefSlot is an entry of the reference table. The index of the slot is the reference ID for Go.
+  struct RefSlot {
+    Value value;
+    // go_ref_count is the number of the references from Go. The permanent references have an infinite count.
+    double go_ref_count = 0;
+    RefOrigin origin;
+  };
+
+  // StringPtrHash and StringPtrEqual compare the strings by their contents. string_ids_ is keyed by the strings held
+  // by the values in refs_, so that a lookup doesn't copy the string.
+  struct StringPtrHash {
+    size_t operator()(const std::string* str) const {
+      return std::hash<std::string>()(*str);
+    }
+  };
+
+  struct StringPtrEqual {
+    bool operator()(const std::string* lhs, const std::string* rhs) const {
+      return *lhs == *rhs;
+    }
+  };
+
+  struct ScheduledTimeout {
+    uint64_t timer_id;
+    // deadline is in the same time base as PreciseNowInNanoseconds.
+    int64_t deadline;
+  };
+
   class ImportImpl : public Import {
   public:
     explicit ImportImpl(Go* go);
@@ -628,39 +1237,83 @@ private:
     Go* go_;
   };
 
+  // Reset resets the references and the other states for a new run.
+  void Reset(const std::vector<std::string>& args);
+  // RunLoop runs the tasks until the program exits, and returns the exit code.
+  int RunLoop();
+
   Value LoadValue(int32_t addr);
-  void StoreValue(int32_t addr, Value v);
+  // LoadRefId returns the reference ID of the value at addr, or -1 if the value is not a reference.
+  int32_t LoadRefId(int32_t addr);
+  // StoreValue returns the reference ID of v, or -1 if v is not stored as a reference.
+  int32_t StoreValue(int32_t addr, Value v);
+  // SetRefOrigin records that the object of the reference id is the property key of the reference parent.
+  void SetRefOrigin(int32_t id, int32_t parent, const std::string& key);
   std::vector<Value> LoadSliceOfValues(int32_t addr);
+  // ApplySliceOfValues calls target with the Go slice of values at addr as the arguments. Up to kMaxInlineArgs
+  // arguments are loaded onto the C++ stack without allocating a vector.
+  Value ApplySliceOfValues(Value target, Value self, int32_t addr);
+  // LoadPropertyName returns an interned string of the Go string at addr.
+  const std::string& LoadPropertyName(int32_t addr);
   void Exit(int32_t code);
   void Resume();
   Value MakeFuncWrapper(int32_t id);
+  Value NewFuncWrapper(int32_t id);
+  static Value EmptyArgs();
   void DebugWrite(BytesSpan bytes);
   int64_t PreciseNowInNanoseconds();
   double UnixNowInMilliseconds();
   int32_t SetTimeout(double interval);
+  void ScheduleTimeout(int32_t id, double interval);
   void ClearTimeout(int32_t id);
   void GetRandomBytes(BytesSpan bytes);
-  int32_t GetIdFromValue(Value value);
+  int32_t GetIdFromValue(const Value& value);
+  // SetPermanent makes the reference never finalized.
+  void SetPermanent(int32_t id);
+  void FinalizeRef(int32_t id);
+
+  // TakeSnapshot is called by go2cppSnapshot.
+  void TakeSnapshot(Value callback);
+  void CallSnapshotCallback(const Value& callback);
+  bool WriteSnapshot(const std::string& path, const Value& callback, std::string* err);
+  // RestoreSnapshot restores the states from the snapshot at path, and returns the callback for go2cppSnapshot.
+  // RestoreSnapshot returns false when the snapshot cannot be used.
+  bool RestoreSnapshot(const std::string& path, Value* callback, std::string* err);
 
   ImportImpl import_;
   std::unique_ptr<Writer> debug_writer_;
   // A TaskQueue must be destructed after the timers are destructed.
   TaskQueue task_queue_;
+  TimerService timer_service_;
+  FileIO file_io_;
+  Reactor reactor_;
 
+  // global_ is the global object of this instance, which syscall/js's Global returns.
+  Value global_;
   Value pending_event_;
   std::unordered_map<int32_t, Value> cached_args_;
   std::unordered_map<int32_t, Value> cached_events_;
-  std::unordered_map<int32_t, std::unique_ptr<Timer>> scheduled_timeouts_;
+  // scheduled_timeouts_ maps a timeout ID for Go to a timer of timer_service_.
+  std::unordered_map<int32_t, ScheduledTimeout> scheduled_timeouts_;
   int32_t next_callback_timeout_id_ = 1;
+  PropertyNames property_names_;
 
   std::unique_ptr<Inst> inst_;
   std::unique_ptr<Mem> mem_;
-  std::vector<Value> values_;
-  std::vector<double> go_ref_counts_;
-  std::unordered_map<Value, int32_t, Value::Hash> ids_;
-  std::stack<int32_t, std::vector<int32_t>> id_pool_;
+  std::vector<RefSlot> refs_;
+  // object_ids_ maps the identities of objects and arrays to their IDs.
+  std::unordered_map<const void*, int32_t> object_ids_;
+  // string_ids_ maps strings to their IDs. Strings are compared by their contents, as js.Value.Equal compares IDs.
+  // A key is the string of the value in refs_, which is immutable and lives until the entry is erased.
+  std::unordered_map<const std::string*, int32_t, StringPtrHash, StringPtrEqual> string_ids_;
+  std::vector<int32_t> free_ids_;
+  int32_t permanent_ref_count_ = 0;
   bool exited_ = false;
   int32_t exit_code_ = 0;
+  std::string snapshot_path_;
+  // args_ is the arguments of the run, which are passed to the callback of go2cppSnapshot.
+  std::vector<std::string> args_;
+  Exports exports_{this};
 
   std::chrono::high_resolution_clock::time_point start_time_point_ = std::chrono::high_resolution_clock::now();
 };
@@ -677,7 +1330,9 @@ var goCppTmpl = template.Must(template.New("go.cpp").Parse(`// Code generated by
 
 #include <cassert>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <random>
@@ -692,15 +1347,93 @@ void error(const std::string& msg) {
   std::exit(1);
 }
 
+// kProgramHash identifies the Wasm file this code was generated from.
+constexpr uint64_t kProgramHash = {{.ProgramHash}}ull;
+
+constexpr char kSnapshotMagic[8] = {'g', 'o', '2', 'c', 'p', 'p', 'S', 'S'};
+constexpr uint32_t kSnapshotVersion = 1;
+
+// kSnapshotString is the tag of a string reference in a snapshot. The other tags are the kinds of RefOrigin.
+constexpr uint8_t kSnapshotString = 0xff;
+
+// SnapshotHeader is at the beginning of a snapshot file. The metadata follows the header, and the linear memory
+// starts at mem_offset, which is aligned to the page size so that the memory can be mapped directly.
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  // pointer_size detects a snapshot from another architecture, whose metadata layout might differ.
+  uint32_t pointer_size;
+  uint64_t program_hash;
+  uint64_t meta_size;
+  uint64_t mem_offset;
+  uint64_t page_num;
+};
+
+class SnapshotEncoder {
+public:
+  template<typename T>
+  void Put(T v) {
+    size_t n = bytes_.size();
+    bytes_.resize(n + sizeof(T));
+    std::memcpy(&bytes_[n], &v, sizeof(T));
+  }
+
+  void PutString(const std::string& str) {
+    Put<uint64_t>(str.size());
+    bytes_.insert(bytes_.end(), str.begin(), str.end());
+  }
+
+  const std::vector<uint8_t>& bytes() const {
+    return bytes_;
+  }
+
+private:
+  std::vector<uint8_t> bytes_;
+};
+
+class SnapshotDecoder {
+public:
+  explicit SnapshotDecoder(const std::vector<uint8_t>& bytes)
+      : bytes_{bytes} {
+  }
+
+  template<typename T>
+  bool Get(T* v) {
+    if (bytes_.size() - pos_ < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(v, &bytes_[pos_], sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  bool GetString(std::string* str) {
+    uint64_t size = 0;
+    if (!Get(&size) || bytes_.size() - pos_ < size) {
+      return false;
+    }
+    str->assign(reinterpret_cast<const char*>(&bytes_[pos_]), size);
+    pos_ += size;
+    return true;
+  }
+
+private:
+  const std::vector<uint8_t>& bytes_;
+  size_t pos_ = 0;
+};
+
 }
 
 Go::Go()
-    : Go(std::make_unique<StreamWriter>(std::cerr)) {
+    : Go(std::make_unique<BufferedStreamWriter>(std::cerr)) {
 }
 
 Go::Go(std::unique_ptr<Writer> debug_writer)
     : import_{this},
       debug_writer_{std::move(debug_writer)},
+      file_io_{[this](TaskQueue::Task task) { task_queue_.Enqueue(std::move(task)); }},
+      reactor_{[this](TaskQueue::Task task) { task_queue_.Enqueue(std::move(task)); }},
+      global_{Value::NewGlobal()},
       pending_event_{Value::Null()} {
 }
 
@@ -716,30 +1449,7 @@ int Go::Run(int argc, char** argv) {
 int Go::Run(const std::vector<std::string>& args) {
   mem_ = std::make_unique<Mem>();
   inst_ = std::make_unique<Inst>(mem_.get(), &import_);
-
-  values_ = {
-    Value{std::nan("")},
-    Value{0.0},
-    Value::Null(),
-    Value{true},
-    Value{false},
-    Value::Global(),
-    Value{std::make_unique<GoObject>(this)},
-  };
-  static constexpr double inf = std::numeric_limits<double>::infinity();
-  go_ref_counts_ = {inf, inf, inf, inf, inf, inf};
-  ids_ = {
-    {values_[1], 1},
-    {values_[2], 2},
-    {values_[3], 3},
-    {values_[4], 4},
-    {values_[5], 5},
-    {values_[6], 6},
-  };
-
-  id_pool_ = {};
-  exited_ = false;
-  exit_code_ = 0;
+  Reset(args);
 
   int32_t offset = 4096;
   auto str_ptr = [this, &offset](const std::string& str) -> int32_t {
@@ -777,13 +1487,134 @@ int Go::Run(const std::vector<std::string>& args) {
     offset += 8;
   }
 
+  // The fs object submits file operations to file_io_ while Go runs on this thread. The operations submitted while
+  // Go runs are flushed when the control returns here.
+  FileIO::SetCurrent(&file_io_);
+  // go2cppNet waits for the sockets by reactor_.
+  Reactor::SetCurrent(&reactor_);
+  // Value::Global returns global_ while Go runs on this thread.
+  Value::SetCurrentGlobal(&global_);
+
   inst_->run(argc, argv);
+  return RunLoop();
+}
+
+void Go::SetSnapshotPath(const std::string& path) {
+  snapshot_path_ = path;
+}
+
+int Go::RunFromSnapshot(const std::string& path, const std::vector<std::string>& args) {
+  Value callback;
+  std::string err;
+  if (!RestoreSnapshot(path, &callback, &err)) {
+    // A missing snapshot is usual at the first run.
+    if (!err.empty()) {
+      std::cerr << "Go::RunFromSnapshot: " << path << ": " << err << "; running from the start" << std::endl;
+    }
+    return Run(args);
+  }
+  args_ = args;
 
+  FileIO::SetCurrent(&file_io_);
+  Reactor::SetCurrent(&reactor_);
+  Value::SetCurrentGlobal(&global_);
+
+  // Go is paused at go2cppSnapshot, so the program is resumed by the callback.
+  task_queue_.Enqueue([this, callback] {
+    CallSnapshotCallback(callback);
+  });
+  return RunLoop();
+}
+
+void Go::Reset(const std::vector<std::string>& args) {
+  // The IDs of these predefined values are fixed in syscall/js.
+  static constexpr double inf = std::numeric_limits<double>::infinity();
+  refs_ = {
+    {Value{std::nan("")}, inf},
+    {Value{0.0}, inf},
+    {Value::Null(), inf},
+    {Value{true}, inf},
+    {Value{false}, inf},
+    {global_, inf},
+    {Value{std::make_unique<GoObject>(this)}, inf},
+  };
+  object_ids_ = {
+    {refs_[5].value.Identity(), 5},
+    {refs_[6].value.Identity(), 6},
+  };
+  string_ids_ = {};
+  free_ids_ = {};
+  cached_args_ = {};
+  cached_events_ = {};
+  for (auto& t : scheduled_timeouts_) {
+    timer_service_.Cancel(t.second.timer_id);
+  }
+  scheduled_timeouts_ = {};
+  permanent_ref_count_ = static_cast<int32_t>(refs_.size());
+  pending_event_ = Value::Null();
+  exited_ = false;
+  exit_code_ = 0;
+  args_ = args;
+
+  // go2cppMemoryView(offset, length) returns a Uint8Array viewing the linear memory without copying. This is useful
+  // to pass large Go bytes like audio samples or vertices to the host without copying (e.g. by
+  // unsafe.Pointer(&buf[0])). The Go side must keep the bytes alive while the view is used. The view stays valid
+  // after the memory grows, but is invalidated when this Go instance runs again or is destroyed.
+  global_.ToObject().Set("go2cppMemoryView", Value{std::make_shared<Function>(
+    [this](Value self, std::vector<Value> args) -> Value {
+      int64_t offset = static_cast<int64_t>(args[0].ToNumber());
+      int64_t length = static_cast<int64_t>(args[1].ToNumber());
+      BytesSpan view = mem_->View(offset, length);
+      if (view.size() != static_cast<size_t>(length)) {
+        error("go2cppMemoryView: out of range: offset: " + std::to_string(offset) + ", length: " + std::to_string(length));
+      }
+      auto buffer = std::make_shared<ArrayBuffer>(view);
+      return Value{std::make_shared<Uint8Array>(buffer, 0, view.size())};
+    })});
+
+  // go2cppSnapshot(callback) takes a snapshot. See SetSnapshotPath.
+  global_.ToObject().Set("go2cppSnapshot", Value{std::make_shared<Function>(
+    [this](Value self, std::vector<Value> args) -> Value {
+      TakeSnapshot(args[0]);
+      return Value{};
+    })});
+
+  // go2cppExportsInit(mailbox, dispatch) and go2cppExportsRegister(name, id) are called by the export package.
+  exports_.Reset();
+  global_.ToObject().Set("go2cppExportsInit", Value{std::make_shared<Function>(
+    [this](Value self, std::vector<Value> args) -> Value {
+      exports_.mailbox_ = static_cast<int32_t>(args[0].ToNumber());
+      exports_.dispatch_ = args[1];
+      return Value{};
+    })});
+  global_.ToObject().Set("go2cppExportsRegister", Value{std::make_shared<Function>(
+    [this](Value self, std::vector<Value> args) -> Value {
+      exports_.ids_[args[0].ToString()] = static_cast<int32_t>(args[1].ToNumber());
+      return Value{};
+    })});
+}
+
+int Go::RunLoop() {
+  file_io_.Flush();
+
+  std::vector<TaskQueue::Task> tasks;
   while (!exited_) {
-    TaskQueue::Task task = task_queue_.Dequeue();
-    task();
+    task_queue_.DequeueAll(tasks);
+    for (TaskQueue::Task& task : tasks) {
+      task();
+      file_io_.Flush();
+      if (exited_) {
+        break;
+      }
+    }
+    tasks.clear();
   }
 
+  FileIO::SetCurrent(nullptr);
+  Reactor::SetCurrent(nullptr);
+  Value::SetCurrentGlobal(nullptr);
+  debug_writer_->Flush();
+
   return static_cast<int>(exit_code_);
 }
 
@@ -830,13 +1661,21 @@ Value Go::LoadValue(int32_t addr) {
     return Value{f};
   }
   int32_t id = static_cast<int32_t>(mem_->LoadUint32(addr));
-  if (values_.size() <= id) {
+  if (refs_.size() <= id) {
     return Value{};
   }
-  return values_[id];
+  return refs_[id].value;
 }
 
-void Go::StoreValue(int32_t addr, Value v) {
+int32_t Go::LoadRefId(int32_t addr) {
+  double f = mem_->LoadFloat64(addr);
+  if (f == 0 || !std::isnan(f)) {
+    return -1;
+  }
+  return static_cast<int32_t>(mem_->LoadUint32(addr));
+}
+
+int32_t Go::StoreValue(int32_t addr, Value v) {
   static const int32_t kNaNHead = 0x7FF80000;
 
   if (v.IsNumber() && v.ToNumber() != 0.0) {
@@ -844,19 +1683,19 @@ void Go::StoreValue(int32_t addr, Value v) {
     if (std::isnan(n)) {
       mem_->StoreInt32(addr + 4, kNaNHead);
       mem_->StoreInt32(addr, 0);
-      return;
+      return 0;
     }
     mem_->StoreFloat64(addr, n);
-    return;
+    return -1;
   }
 
   if (v.IsUndefined()) {
     mem_->StoreFloat64(addr, 0);
-    return;
+    return -1;
   }
 
   int32_t id = GetIdFromValue(v);
-  go_ref_counts_[id]++;
+  refs_[id].go_ref_count++;
 
   int32_t type_flag = 0;
   if (v.IsString()) {
@@ -869,6 +1708,21 @@ void Go::StoreValue(int32_t addr, Value v) {
   }
   mem_->StoreInt32(addr + 4, kNaNHead | type_flag);
   mem_->StoreInt32(addr, id);
+  return id;
+}
+
+void Go::SetRefOrigin(int32_t id, int32_t parent, const std::string& key) {
+  if (id < kNumPredefinedRefs || parent < 0) {
+    return;
+  }
+  RefSlot& slot = refs_[id];
+  // A string can be made again from itself, and the first origin is kept for an object.
+  if (slot.origin.kind != RefOrigin::Kind::Unknown || slot.value.IsString()) {
+    return;
+  }
+  slot.origin.kind = RefOrigin::Kind::Property;
+  slot.origin.parent = parent;
+  slot.origin.key = &key;
 }
 
 std::vector<Value> Go::LoadSliceOfValues(int32_t addr) {
@@ -881,6 +1735,24 @@ std::vector<Value> Go::LoadSliceOfValues(int32_t addr) {
   return a;
 }
 
+Value Go::ApplySliceOfValues(Value target, Value self, int32_t addr) {
+  int32_t array = static_cast<int32_t>(mem_->LoadInt64(addr));
+  int32_t len = static_cast<int32_t>(mem_->LoadInt64(addr + 8));
+  if (len > kMaxInlineArgs) {
+    return Value::ReflectApply(std::move(target), std::move(self), LoadSliceOfValues(addr));
+  }
+  Value args[kMaxInlineArgs];
+  for (int32_t i = 0; i < len; i++) {
+    args[i] = LoadValue(array + i * 8);
+  }
+  return Value::ReflectApplySpan(std::move(target), std::move(self), ValueSpan{args, static_cast<size_t>(len)});
+}
+
+const std::string& Go::LoadPropertyName(int32_t addr) {
+  BytesSpan bytes = mem_->LoadSlice(addr);
+  return property_names_.Get(bytes.begin(), bytes.size());
+}
+
 void Go::Exit(int32_t code) {
   exit_code_ = code;
 }
@@ -894,15 +1766,27 @@ void Go::Resume() {
   // In this C++, the loop automatically ends when |exited_| is true.
 }
 
-Value Go::MakeFuncWrapper(int32_t id) {
+Value Go::EmptyArgs() {
   // empty_args is a Value of an empty array for arguments.
   // This assumes that the argment array is never modified in the callbacks.
   // By using the same Value, this can avoid being finalized at syscall/js.finalizeRef.
-  static Value empty_args = Value{std::vector<Value>()};
+  static thread_local Value empty_args = Value{std::vector<Value>()};
+  return empty_args;
+}
 
-  static constexpr double inf = std::numeric_limits<double>::infinity();
-  go_ref_counts_[GetIdFromValue(empty_args)] = inf;
+Value Go::MakeFuncWrapper(int32_t id) {
+  int32_t empty_args_id = GetIdFromValue(EmptyArgs());
+  SetPermanent(empty_args_id);
+  refs_[empty_args_id].origin.kind = RefOrigin::Kind::EmptyArgs;
+
+  Value f = NewFuncWrapper(id);
+  RefSlot& slot = refs_[GetIdFromValue(f)];
+  slot.origin.kind = RefOrigin::Kind::FuncWrapper;
+  slot.origin.id = id;
+  return f;
+}
 
+Value Go::NewFuncWrapper(int32_t id) {
   return Value{std::make_shared<Function>(
     [this, id](Value self, std::vector<Value> args) -> Value {
       Value argsv;
@@ -924,10 +1808,13 @@ Value Go::MakeFuncWrapper(int32_t id) {
         } else {
           argsv = Value{args};
           cached_args_[id] = argsv;
-          go_ref_counts_[GetIdFromValue(argsv)] = inf;
+          int32_t ref_id = GetIdFromValue(argsv);
+          SetPermanent(ref_id);
+          refs_[ref_id].origin.kind = RefOrigin::Kind::Args;
+          refs_[ref_id].origin.id = id;
         }
       } else {
-        argsv = empty_args;
+        argsv = EmptyArgs();
       }
 
       auto it = cached_events_.find(id);
@@ -945,8 +1832,11 @@ Value Go::MakeFuncWrapper(int32_t id) {
 
         // Note that the cached event is never released.
         // This means that every js.FuncOf calls increases the number of Value objects.
-        cached_events_[static_cast<double>(id)] = evt;
-        go_ref_counts_[GetIdFromValue(evt)] = inf;
+        cached_events_[id] = evt;
+        int32_t ref_id = GetIdFromValue(evt);
+        SetPermanent(ref_id);
+        refs_[ref_id].origin.kind = RefOrigin::Kind::Event;
+        refs_[ref_id].origin.id = id;
       }
       pending_event_ = evt;
       Resume();
@@ -956,7 +1846,7 @@ Value Go::MakeFuncWrapper(int32_t id) {
 }
 
 void Go::DebugWrite(BytesSpan bytes) {
-  debug_writer_->Write(std::vector<uint8_t>(bytes.begin(), bytes.end()));
+  debug_writer_->Write(bytes);
 }
 
 int64_t Go::PreciseNowInNanoseconds() {
@@ -973,73 +1863,673 @@ double Go::UnixNowInMilliseconds() {
 int32_t Go::SetTimeout(double interval) {
   int32_t id = next_callback_timeout_id_;
   next_callback_timeout_id_++;
-  std::unique_ptr<Timer> timer = std::make_unique<Timer>(
-    [this, id] {
-      task_queue_.Enqueue([this, id]{
-        Resume();
-        while (scheduled_timeouts_.find(id) != scheduled_timeouts_.end()) {
-          // for some reason Go failed to register the timeout event, log and try again
-          // (temporary workaround for https://github.com/golang/go/issues/28975)
-          Resume();
-        }
-      });
-    }, interval);
-  scheduled_timeouts_[id] = std::move(timer);
+  ScheduleTimeout(id, interval);
   return id;
 }
 
+void Go::ScheduleTimeout(int32_t id, double interval) {
+  uint64_t timer_id = timer_service_.Schedule(interval, [this, id] {
+    task_queue_.Enqueue([this, id]{
+      // The timeout might be cleared after the timer was fired.
+      if (scheduled_timeouts_.find(id) == scheduled_timeouts_.end()) {
+        return;
+      }
+      Resume();
+      while (scheduled_timeouts_.find(id) != scheduled_timeouts_.end()) {
+        // for some reason Go failed to register the timeout event, log and try again
+        // (temporary workaround for https://github.com/golang/go/issues/28975)
+        Resume();
+      }
+    });
+  });
+  scheduled_timeouts_[id] = {timer_id, PreciseNowInNanoseconds() + static_cast<int64_t>(interval * 1e6)};
+}
+
 void Go::ClearTimeout(int32_t id) {
-  if (scheduled_timeouts_.find(id) != scheduled_timeouts_.end()) {
-    scheduled_timeouts_[id]->Stop();
+  auto it = scheduled_timeouts_.find(id);
+  if (it == scheduled_timeouts_.end()) {
+    return;
   }
-  scheduled_timeouts_.erase(id);
+  timer_service_.Cancel(it->second.timer_id);
+  scheduled_timeouts_.erase(it);
 }
 
 void Go::GetRandomBytes(BytesSpan bytes) {
   // TODO: Use cryptographically strong random values instead of std::random_device.
-  static std::random_device rd;
+  static thread_local std::random_device rd;
   std::uniform_int_distribution<uint8_t> dist(0, 255);
   for (int i = 0; i < bytes.size(); i++) {
     bytes[i] = dist(rd);
   }
 }
 
-void Go::EnqueueTask(std::function<void()> task) {
-  task_queue_.Enqueue(task);
+void Go::EnqueueTask(TaskQueue::Task task) {
+  task_queue_.Enqueue(std::move(task));
+}
+
+TimerService::Stats Go::GetTimerStats() {
+  return timer_service_.GetStats();
+}
+
+FileIO::Stats Go::GetFileIOStats() {
+  return file_io_.GetStats();
+}
+
+int32_t Go::GetLiveRefCount() const {
+  return static_cast<int32_t>(refs_.size() - free_ids_.size()) - permanent_ref_count_;
+}
+
+Go::Exports& Go::GetExports() {
+  return exports_;
+}
+
+Value Go::Global() {
+  return global_;
+}
+
+template<typename T>
+void Go::Exports::Args::Put(T v) {
+  size_t n = bytes_.size();
+  bytes_.resize(n + sizeof(T));
+  std::memcpy(&bytes_[n], &v, sizeof(T));
+}
+
+Go::Exports::Args& Go::Exports::Args::Int32(int32_t v) {
+  Put(v);
+  return *this;
+}
+
+Go::Exports::Args& Go::Exports::Args::Int64(int64_t v) {
+  Put(v);
+  return *this;
+}
+
+Go::Exports::Args& Go::Exports::Args::Float64(double v) {
+  Put(v);
+  return *this;
+}
+
+Go::Exports::Args& Go::Exports::Args::Bytes(const uint8_t* data, size_t size) {
+  Put(static_cast<int32_t>(size));
+  bytes_.insert(bytes_.end(), data, data + size);
+  return *this;
+}
+
+Go::Exports::Args& Go::Exports::Args::String(const std::string& str) {
+  return Bytes(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+}
+
+void Go::Exports::Args::Clear() {
+  bytes_.clear();
+}
+
+Go::Exports::Result::Result(const uint8_t* data, size_t size)
+    : data_{data},
+      size_{size} {
+}
+
+template<typename T>
+T Go::Exports::Result::Get() {
+  T v = 0;
+  if (size_ - pos_ < sizeof(T)) {
+    ok_ = false;
+    return v;
+  }
+  std::memcpy(&v, data_ + pos_, sizeof(T));
+  pos_ += sizeof(T);
+  return v;
+}
+
+int32_t Go::Exports::Result::Int32() {
+  return Get<int32_t>();
+}
+
+int64_t Go::Exports::Result::Int64() {
+  return Get<int64_t>();
+}
+
+double Go::Exports::Result::Float64() {
+  return Get<double>();
+}
+
+BytesSpan Go::Exports::Result::Bytes() {
+  size_t n = static_cast<size_t>(Get<int32_t>());
+  if (!ok_ || size_ - pos_ < n) {
+    ok_ = false;
+    return BytesSpan{};
+  }
+  // The data is in the linear memory, which is writable.
+  BytesSpan bytes{const_cast<uint8_t*>(data_ + pos_), n};
+  pos_ += n;
+  return bytes;
+}
+
+std::string Go::Exports::Result::String() {
+  BytesSpan bytes = Bytes();
+  return std::string(bytes.begin(), bytes.end());
+}
+
+bool Go::Exports::Result::Ok() const {
+  return ok_;
+}
+
+constexpr int32_t Go::Exports::kRequestAddr;
+constexpr int32_t Go::Exports::kRequestCap;
+constexpr int32_t Go::Exports::kRequestLen;
+constexpr int32_t Go::Exports::kRequestCount;
+constexpr int32_t Go::Exports::kResultAddr;
+constexpr int32_t Go::Exports::kResultLen;
+constexpr int32_t Go::Exports::kNeed;
+
+Go::Exports::Exports(Go* go)
+    : go_{go} {
+}
+
+void Go::Exports::Reset() {
+  mailbox_ = 0;
+  dispatch_ = Value{};
+  ids_.clear();
+  len_ = 0;
+  count_ = 0;
+  results_.clear();
+}
+
+int32_t Go::Exports::Lookup(const std::string& name) const {
+  auto it = ids_.find(name);
+  if (it == ids_.end()) {
+    return -1;
+  }
+  return it->second;
+}
+
+int32_t Go::Exports::Enqueue(int32_t id, const Args& args) {
+  if (!mailbox_) {
+    error("Go::Exports::Enqueue: the export package is not initialized");
+  }
+  Mem* mem = go_->mem_.get();
+
+  // A call is the ID, the size, the arguments and the padding to 8 bytes.
+  int32_t size = static_cast<int32_t>((8 + args.bytes_.size() + 7) / 8 * 8);
+  if (len_ + size > static_cast<int32_t>(mem->LoadUint32(mailbox_ + kRequestCap))) {
+    // Go grows the request buffer, keeping the calls so far.
+    mem->StoreInt32(mailbox_ + kRequestLen, len_);
+    mem->StoreInt32(mailbox_ + kRequestCount, 0);
+    mem->StoreInt32(mailbox_ + kNeed, len_ + size);
+    Dispatch();
+  }
+
+  int32_t addr = static_cast<int32_t>(mem->LoadUint32(mailbox_ + kRequestAddr)) + len_;
+  BytesSpan dst = mem->View(addr, size);
+  if (dst.size() != static_cast<size_t>(size)) {
+    error("Go::Exports::Enqueue: the request buffer is out of range");
+  }
+  int32_t header[2] = {id, static_cast<int32_t>(args.bytes_.size())};
+  std::memcpy(dst.begin(), header, sizeof(header));
+  if (args.bytes_.size()) {
+    std::memcpy(dst.begin() + sizeof(header), args.bytes_.data(), args.bytes_.size());
+  }
+  len_ += size;
+  return count_++;
+}
+
+void Go::Exports::Flush() {
+  if (!mailbox_) {
+    error("Go::Exports::Flush: the export package is not initialized");
+  }
+  Mem* mem = go_->mem_.get();
+  mem->StoreInt32(mailbox_ + kRequestLen, len_);
+  mem->StoreInt32(mailbox_ + kRequestCount, count_);
+  mem->StoreInt32(mailbox_ + kNeed, 0);
+  int32_t count = count_;
+  len_ = 0;
+  count_ = 0;
+  Dispatch();
+
+  // A result is the size, the padding, the results and the padding to 8 bytes.
+  results_.clear();
+  int32_t len = static_cast<int32_t>(mem->LoadUint32(mailbox_ + kResultLen));
+  if (!len) {
+    return;
+  }
+  BytesSpan bytes = mem->View(mem->LoadUint32(mailbox_ + kResultAddr), len);
+  size_t pos = 0;
+  for (int32_t i = 0; i < count && pos + 8 <= bytes.size(); i++) {
+    uint32_t size = 0;
+    std::memcpy(&size, bytes.begin() + pos, sizeof(size));
+    results_.push_back({bytes.begin() + pos + 8, size});
+    pos += (8 + size + 7) / 8 * 8;
+  }
 }
 
-int32_t Go::GetIdFromValue(Value value) {
-  auto it = ids_.find(value);
-  if (it != ids_.end()) {
-    return it->second;
+Go::Exports::Result Go::Exports::GetResult(int32_t index) const {
+  if (index < 0 || static_cast<size_t>(index) >= results_.size()) {
+    return Result{};
+  }
+  return Result{results_[index].first, results_[index].second};
+}
+
+Go::Exports::Result Go::Exports::Call(int32_t id, const Args& args) {
+  int32_t index = Enqueue(id, args);
+  Flush();
+  return GetResult(index);
+}
+
+void Go::Exports::Dispatch() {
+  // The dispatch function is a js.Func, which resumes Go with an event. The empty arguments don't make a Value.
+  Value::ReflectApply(dispatch_, Value{}, std::vector<Value>{});
+}
+
+int32_t Go::GetIdFromValue(const Value& value) {
+  // The predefined values don't need lookups.
+  if (value.IsNull()) {
+    return 2;
+  }
+  if (value.IsBool()) {
+    return value.ToBool() ? 3 : 4;
+  }
+  if (value.IsNumber()) {
+    double n = value.ToNumber();
+    if (std::isnan(n)) {
+      return 0;
+    }
+    if (n == 0) {
+      return 1;
+    }
+  }
+
+  int32_t* found = nullptr;
+  if (value.IsString()) {
+    // The identity of a string value is the address of its string. A new key points to the string shared with the
+    // copy stored in refs_ below.
+    found = &string_ids_[static_cast<const std::string*>(value.Identity())];
+  } else if (value.Identity()) {
+    found = &object_ids_[value.Identity()];
+  }
+  // 0 is the ID for NaN, then 0 means a newly inserted entry here.
+  if (found && *found) {
+    return *found;
   }
 
   int32_t id = 0;
-  if (id_pool_.size()) {
-    id = id_pool_.top();
-    id_pool_.pop();
+  if (free_ids_.size()) {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+    refs_[id] = {value, 0};
   } else {
-    id = values_.size();
-  }
-  if (values_.size() <= id) {
-    values_.resize(id+1);
+    id = static_cast<int32_t>(refs_.size());
+    refs_.push_back({value, 0});
   }
-  values_[id] = value;
-  if (go_ref_counts_.size() <= id) {
-    go_ref_counts_.resize(id+1);
+  if (found) {
+    *found = id;
   }
-  go_ref_counts_[id] = 0;
-  ids_[value] = id;
   return id;
 }
 
+void Go::SetPermanent(int32_t id) {
+  if (std::isinf(refs_[id].go_ref_count)) {
+    return;
+  }
+  refs_[id].go_ref_count = std::numeric_limits<double>::infinity();
+  permanent_ref_count_++;
+}
+
+void Go::FinalizeRef(int32_t id) {
+  RefSlot& slot = refs_[id];
+  slot.go_ref_count--;
+  if (slot.go_ref_count != 0) {
+    return;
+  }
+  if (slot.value.IsString()) {
+    string_ids_.erase(static_cast<const std::string*>(slot.value.Identity()));
+  } else if (slot.value.Identity()) {
+    object_ids_.erase(slot.value.Identity());
+  }
+  slot.value = Value{};
+  free_ids_.push_back(id);
 }
-`))
 
-var specialFunctionBodies = map[string]string{
-	"memcmp":           `  return static_cast<int32_t>(mem_->Memcmp(local0_, local1_, local2_));`,
-	"memeqbody":        `  return static_cast<int64_t>(mem_->Memcmp(local0_, local1_, local2_) == 0);`,
-	"memchr":           `  return static_cast<int32_t>(mem_->Memchr(local0_, local1_, local2_));`,
-	"runtime.wasmMove": `  mem_->Memmove(local0_, local1_, local2_ * 8);`,
-	"runtime.wasmZero": `  mem_->Memset(local0_, 0, local1_ * 8);`,
+void Go::TakeSnapshot(Value callback) {
+  // The snapshot is taken after the control returns to the host, where no function of Inst is running and Go waits
+  // for the callback.
+  task_queue_.Enqueue([this, callback] {
+    if (!snapshot_path_.empty()) {
+      std::string err;
+      if (!WriteSnapshot(snapshot_path_, callback, &err)) {
+        std::cerr << "go2cppSnapshot: " << snapshot_path_ << ": " << err << std::endl;
+      }
+    }
+    CallSnapshotCallback(callback);
+  });
 }
+
+void Go::CallSnapshotCallback(const Value& callback) {
+  std::vector<Value> args;
+  for (const std::string& arg : args_) {
+    args.push_back(Value{arg});
+  }
+  Value::ReflectApply(callback, Value{}, {Value{std::move(args)}});
+}
+
+bool Go::WriteSnapshot(const std::string& path, const Value& callback, std::string* err) {
+  auto callback_it = object_ids_.find(callback.Identity());
+  if (!callback.Identity() || callback_it == object_ids_.end() ||
+      refs_[callback_it->second].origin.kind != RefOrigin::Kind::FuncWrapper) {
+    *err = "the callback must be a js.Func";
+    return false;
+  }
+
+  SnapshotEncoder meta;
+  meta.Put<int32_t>(callback_it->second);
+
+  std::vector<uint64_t> globals(Inst::kNumGlobals);
+  inst_->GetGlobals(globals.data());
+  meta.Put<int32_t>(Inst::kNumGlobals);
+  for (uint64_t g : globals) {
+    meta.Put<uint64_t>(g);
+  }
+
+  // The timeouts keep their remaining durations.
+  int64_t now = PreciseNowInNanoseconds();
+  meta.Put<int32_t>(next_callback_timeout_id_);
+  meta.Put<int32_t>(static_cast<int32_t>(scheduled_timeouts_.size()));
+  for (auto& t : scheduled_timeouts_) {
+    meta.Put<int32_t>(t.first);
+    meta.Put<int64_t>(std::max<int64_t>(t.second.deadline - now, 0));
+  }
+
+  // The predefined references are made by Reset.
+  int32_t lost_count = 0;
+  std::string lost;
+  meta.Put<int32_t>(static_cast<int32_t>(refs_.size()));
+  for (int32_t id = kNumPredefinedRefs; id < static_cast<int32_t>(refs_.size()); id++) {
+    const RefSlot& slot = refs_[id];
+    meta.Put<double>(slot.go_ref_count);
+    if (slot.value.IsString()) {
+      meta.Put<uint8_t>(kSnapshotString);
+      meta.PutString(slot.value.ToString());
+      continue;
+    }
+    meta.Put<uint8_t>(static_cast<uint8_t>(slot.origin.kind));
+    switch (slot.origin.kind) {
+    case RefOrigin::Kind::Unknown:
+      if (!slot.value.IsUndefined()) {
+        if (lost_count < 4) {
+          lost += "\n  " + std::to_string(id) + ": " + slot.value.Inspect();
+        }
+        lost_count++;
+      }
+      break;
+    case RefOrigin::Kind::Property:
+      meta.Put<int32_t>(slot.origin.parent);
+      meta.PutString(*slot.origin.key);
+      break;
+    case RefOrigin::Kind::FuncWrapper:
+    case RefOrigin::Kind::Event:
+    case RefOrigin::Kind::Args:
+      meta.Put<int32_t>(slot.origin.id);
+      break;
+    case RefOrigin::Kind::EmptyArgs:
+      break;
+    }
+  }
+  meta.Put<int32_t>(static_cast<int32_t>(free_ids_.size()));
+  for (int32_t id : free_ids_) {
+    meta.Put<int32_t>(id);
+  }
+
+  if (lost_count) {
+    std::cerr << "go2cppSnapshot: " << lost_count
+              << " reference(s) cannot be made again and will be undefined after restoring:" << lost << std::endl;
+  }
+
+  SnapshotHeader header = {};
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+  header.version = kSnapshotVersion;
+  header.pointer_size = sizeof(void*);
+  header.program_hash = kProgramHash;
+  header.meta_size = meta.bytes().size();
+  header.mem_offset = (sizeof(header) + meta.bytes().size() + Mem::kPageSize - 1) / Mem::kPageSize * Mem::kPageSize;
+  header.page_num = mem_->GetSize();
+
+  int64_t mem_size = static_cast<int64_t>(header.page_num) * Mem::kPageSize;
+  BytesSpan mem = mem_->View(0, mem_size);
+  std::vector<char> padding(header.mem_offset - sizeof(header) - meta.bytes().size());
+
+  // The snapshot is written to a temporary file first, so that a partial snapshot is never used.
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(meta.bytes().data()), meta.bytes().size());
+    out.write(padding.data(), padding.size());
+    out.write(reinterpret_cast<const char*>(mem.begin()), mem.size());
+    if (!out) {
+      *err = "writing failed";
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+  }
+  std::remove(path.c_str());
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    *err = "renaming " + tmp_path + " failed";
+    return false;
+  }
+  return true;
+}
+
+bool Go::RestoreSnapshot(const std::string& path, Value* callback, std::string* err) {
+  std::vector<uint8_t> meta_bytes;
+  SnapshotHeader header;
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      return false;
+    }
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) {
+      *err = "not a snapshot";
+      return false;
+    }
+    if (header.version != kSnapshotVersion || header.pointer_size != sizeof(void*)) {
+      *err = "the snapshot format doesn't match";
+      return false;
+    }
+    if (header.program_hash != kProgramHash) {
+      *err = "the snapshot is for another program";
+      return false;
+    }
+    if (header.meta_size > header.mem_offset) {
+      *err = "the snapshot is broken";
+      return false;
+    }
+    meta_bytes.resize(header.meta_size);
+    if (!in.read(reinterpret_cast<char*>(meta_bytes.data()), meta_bytes.size())) {
+      *err = "the snapshot is broken";
+      return false;
+    }
+  }
+
+  struct RefEntry {
+    double go_ref_count;
+    uint8_t kind;
+    std::string str;
+    int32_t parent;
+    int32_t id;
+  };
+
+  SnapshotDecoder meta{meta_bytes};
+  int32_t callback_id = 0;
+  int32_t num_globals = 0;
+  std::vector<uint64_t> globals;
+  int32_t next_timeout_id = 0;
+  int32_t num_timeouts = 0;
+  std::vector<std::pair<int32_t, int64_t>> timeouts;
+  int32_t num_refs = 0;
+  std::vector<RefEntry> entries;
+  int32_t num_free_ids = 0;
+  std::vector<int32_t> free_ids;
+
+  bool ok = meta.Get(&callback_id) && meta.Get(&num_globals) && num_globals == Inst::kNumGlobals;
+  globals.resize(Inst::kNumGlobals);
+  for (int32_t i = 0; ok && i < num_globals; i++) {
+    ok = meta.Get(&globals[i]);
+  }
+  ok = ok && meta.Get(&next_timeout_id) && meta.Get(&num_timeouts) && num_timeouts >= 0;
+  for (int32_t i = 0; ok && i < num_timeouts; i++) {
+    std::pair<int32_t, int64_t> t;
+    ok = meta.Get(&t.first) && meta.Get(&t.second);
+    timeouts.push_back(t);
+  }
+  ok = ok && meta.Get(&num_refs) && num_refs >= kNumPredefinedRefs;
+  for (int32_t id = kNumPredefinedRefs; ok && id < num_refs; id++) {
+    RefEntry e = {};
+    ok = meta.Get(&e.go_ref_count) && meta.Get(&e.kind);
+    if (!ok) {
+      break;
+    }
+    switch (e.kind) {
+    case kSnapshotString:
+      ok = meta.GetString(&e.str);
+      break;
+    case static_cast<uint8_t>(RefOrigin::Kind::Unknown):
+    case static_cast<uint8_t>(RefOrigin::Kind::EmptyArgs):
+      break;
+    case static_cast<uint8_t>(RefOrigin::Kind::Property):
+      ok = meta.Get(&e.parent) && 0 <= e.parent && e.parent < num_refs && meta.GetString(&e.str);
+      break;
+    case static_cast<uint8_t>(RefOrigin::Kind::FuncWrapper):
+    case static_cast<uint8_t>(RefOrigin::Kind::Event):
+    case static_cast<uint8_t>(RefOrigin::Kind::Args):
+      ok = meta.Get(&e.id);
+      break;
+    default:
+      ok = false;
+      break;
+    }
+    entries.push_back(std::move(e));
+  }
+  ok = ok && kNumPredefinedRefs <= callback_id && callback_id < num_refs;
+  ok = ok && meta.Get(&num_free_ids) && num_free_ids >= 0;
+  for (int32_t i = 0; ok && i < num_free_ids; i++) {
+    int32_t id = 0;
+    ok = meta.Get(&id) && kNumPredefinedRefs <= id && id < num_refs;
+    free_ids.push_back(id);
+  }
+  if (!ok) {
+    *err = "the snapshot is broken";
+    return false;
+  }
+
+  std::unique_ptr<Mem> mem = Mem::Restore(path, header.mem_offset, static_cast<int32_t>(header.page_num));
+  if (!mem) {
+    *err = "restoring the memory failed";
+    return false;
+  }
+
+  mem_ = std::move(mem);
+  inst_ = std::make_unique<Inst>(mem_.get(), &import_);
+  inst_->SetGlobals(globals.data());
+  Reset({});
+
+  refs_.resize(num_refs);
+  for (int32_t id = kNumPredefinedRefs; id < num_refs; id++) {
+    const RefEntry& e = entries[id - kNumPredefinedRefs];
+    RefSlot& slot = refs_[id];
+    slot.go_ref_count = e.go_ref_count;
+    if (e.kind == kSnapshotString) {
+      slot.value = Value{e.str};
+      continue;
+    }
+    slot.origin.kind = static_cast<RefOrigin::Kind>(e.kind);
+    slot.origin.parent = e.parent;
+    slot.origin.id = e.id;
+    if (slot.origin.kind == RefOrigin::Kind::Property) {
+      slot.origin.key = &property_names_.Get(reinterpret_cast<const uint8_t*>(e.str.data()), e.str.size());
+    }
+  }
+
+  // The objects are made again in the order of the dependencies. A property is got after its parent is made.
+  // A property whose parent cannot be made again, e.g. a property of a reference with an unknown origin, is left
+  // undefined.
+  int32_t lost_count = 0;
+  std::string lost;
+  std::vector<uint8_t> made(num_refs);
+  std::fill(made.begin(), made.begin() + kNumPredefinedRefs, 1);
+  std::function<void(int32_t)> make = [&](int32_t id) {
+    if (made[id]) {
+      return;
+    }
+    // Marking first avoids an infinite recursion for a broken snapshot with a cycle.
+    made[id] = 1;
+    RefSlot& slot = refs_[id];
+    switch (slot.origin.kind) {
+    case RefOrigin::Kind::Unknown:
+      break;
+    case RefOrigin::Kind::Property: {
+      make(slot.origin.parent);
+      const Value& parent = refs_[slot.origin.parent].value;
+      if (!parent.IsObject() && !parent.IsArray()) {
+        if (lost_count < 4) {
+          lost += "\n  " + std::to_string(id) + ": " + *slot.origin.key + " of " + std::to_string(slot.origin.parent) +
+                  " (" + parent.Inspect() + ")";
+        }
+        lost_count++;
+        break;
+      }
+      slot.value = Value::ReflectGet(parent, *slot.origin.key);
+      break;
+    }
+    case RefOrigin::Kind::FuncWrapper:
+      slot.value = NewFuncWrapper(slot.origin.id);
+      break;
+    case RefOrigin::Kind::Event:
+      slot.value = Value{std::make_shared<DictionaryValues>(std::map<std::string, Value>{
+        {"id", Value{static_cast<double>(slot.origin.id)}},
+      })};
+      cached_events_[slot.origin.id] = slot.value;
+      break;
+    case RefOrigin::Kind::Args:
+      slot.value = Value{std::vector<Value>{}};
+      cached_args_[slot.origin.id] = slot.value;
+      break;
+    case RefOrigin::Kind::EmptyArgs:
+      slot.value = EmptyArgs();
+      break;
+    }
+  };
+  for (int32_t id = kNumPredefinedRefs; id < num_refs; id++) {
+    if (refs_[id].value.IsString()) {
+      made[id] = 1;
+      continue;
+    }
+    make(id);
+  }
+  if (lost_count) {
+    std::cerr << "RunFromSnapshot: " << lost_count
+              << " reference(s) are undefined as their parents cannot be made again:" << lost << std::endl;
+  }
+
+  for (int32_t id = kNumPredefinedRefs; id < num_refs; id++) {
+    const RefSlot& slot = refs_[id];
+    if (slot.value.IsString()) {
+      string_ids_[static_cast<const std::string*>(slot.value.Identity())] = id;
+    } else if (slot.value.Identity()) {
+      object_ids_.emplace(slot.value.Identity(), id);
+    }
+    if (std::isinf(slot.go_ref_count)) {
+      permanent_ref_count_++;
+    }
+  }
+  free_ids_ = std::move(free_ids);
+
+  next_callback_timeout_id_ = next_timeout_id;
+  for (auto& t : timeouts) {
+    ScheduleTimeout(t.first, t.second / 1e6);
+  }
+
+  *callback = refs_[callback_id].value;
+  return true;
+}
+
+}
+`))
@@ -3,18 +3,12 @@
 package gowasm2cpp
 
 import (
-	"os"
-	"path/filepath"
 	"text/template"
 )
 
-func writeGL(dir string, incpath string, namespace string) error {
+func writeGL(dir *outputDir, incpath string, namespace string) error {
 	{
-		f, err := os.Create(filepath.Join(dir, "gl.h"))
-		if err != nil {
-			return err
-		}
-		defer f.Close()
+		f := dir.Create("gl.h")
 
 		if err := glHTmpl.Execute(f, struct {
 			IncludeGuard string
@@ -27,13 +21,12 @@ func writeGL(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
-	}
-	{
-		f, err := os.Create(filepath.Join(dir, "gl.cpp"))
-		if err != nil {
+		if err := f.Close(); err != nil {
 			return err
 		}
-		defer f.Close()
+	}
+	{
+		f := dir.Create("gl.cpp")
 
 		if err := glCppTmpl.Execute(f, struct {
 			IncludePath string
@@ -44,6 +37,9 @@ func writeGL(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
+		if err := f.Close(); err != nil {
+			return err
+		}
 	}
 	return nil
 }
@@ -56,18 +52,85 @@ var glHTmpl = template.Must(template.New("gl.h").Parse(`// Code generated by go2
 #include "{{.IncludePath}}js.h"
 
 #include <cstdint>
+#include <cstring>
 #include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace {{.Namespace}} {
 
 // GL emulates WebGLRenderingContext by OpenGL (not ES).
+//
+// The functions are created once and looked up by their names, and take the arguments as a ValueSpan. In the
+// batching mode, the calls without results nor pointers are recorded and executed at Flush. The other calls flush
+// the recorded calls first so that the order is kept.
 class GL : public Object {
 public:
   explicit GL(std::function<void*(const char*)> func);
   Value Get(const std::string &key) override;
   std::string ToString() const override;
 
+  // SetBatching switches the batching mode. Turning off the batching mode flushes the recorded calls.
+  void SetBatching(bool batching);
+
+  // Flush executes the recorded calls.
+  void Flush();
+
 private:
+  static constexpr int kMaxCommandArgs = 6;
+
+  // Command is a recorded call. Each argument is stored in a slot of args.
+  struct Command {
+    void (*invoke)(const Command& command);
+    void* func;
+    uint64_t args[kMaxCommandArgs];
+  };
+
+  template<typename T>
+  static uint64_t ToSlot(T v) {
+    static_assert(sizeof(T) <= sizeof(uint64_t) && std::is_trivially_copyable<T>::value, "invalid argument type");
+    uint64_t slot = 0;
+    std::memcpy(&slot, &v, sizeof(T));
+    return slot;
+  }
+
+  template<typename T>
+  static T FromSlot(uint64_t slot) {
+    T v;
+    std::memcpy(&v, &slot, sizeof(T));
+    return v;
+  }
+
+  template<typename... Ts>
+  struct Invoker {
+    static void Invoke(const Command& command) {
+      Apply(command, std::index_sequence_for<Ts...>{});
+    }
+
+    template<size_t... Is>
+    static void Apply(const Command& command, std::index_sequence<Is...>) {
+      reinterpret_cast<void(*)(Ts...)>(command.func)(FromSlot<Ts>(command.args[Is])...);
+    }
+  };
+
+  // Call calls the GL function func, or records the call in the batching mode.
+  template<typename... Ts>
+  void Call(void* func, Ts... args) {
+    if (!batching_) {
+      reinterpret_cast<void(*)(Ts...)>(func)(args...);
+      return;
+    }
+    static_assert(sizeof...(Ts) <= kMaxCommandArgs, "too many arguments to record");
+    commands_.push_back(Command{&Invoker<Ts...>::Invoke, func, {ToSlot(args)...}});
+  }
+
+  void InitFunctions();
+
+  FlatStringMap<Value> functions_;
+  bool batching_ = false;
+  std::vector<Command> commands_;
+
   // TODO: Now this covers GL 1.x functions.
   // Get the proc addresses for all the GL functions?
   void *glActiveTexture_;
@@ -215,817 +278,715 @@ GL::GL(std::function<void*(const char*)> get_proc_address) {
   glUseProgram_ = get_proc_address("glUseProgram");
   glVertexAttribPointer_ = get_proc_address("glVertexAttribPointer");
   glViewport_ = get_proc_address("glViewport");
+
+  InitFunctions();
 }
 
-Value GL::Get(const std::string &key) {
-  if (key == "activeTexture") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum texture = static_cast<GLenum>(args[0].ToNumber());
-          using f = void(*)(GLenum texture);
-          reinterpret_cast<f>(glActiveTexture_)(texture);
-          return Value{};
-        })};
-  }
-  if (key == "attachShader") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint program = static_cast<GLuint>(args[0].ToNumber());
-          GLuint shader = static_cast<GLuint>(args[1].ToNumber());
-          using f = void(*)(GLuint, GLuint);
-          reinterpret_cast<f>(glAttachShader_)(program, shader);
-          return Value{};
-        })};
-  }
-  if (key == "bindAttribLocation") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint program = static_cast<GLuint>(args[0].ToNumber());
-          GLuint index = static_cast<GLuint>(args[1].ToNumber());
-          std::string name = args[2].ToString();
-          using f = void(*)(GLuint, GLuint, const GLchar*);
-          reinterpret_cast<f>(glBindAttribLocation_)(
-              program, index, const_cast<GLchar *>(name.c_str()));
-          return Value{};
-        })};
-  }
-  if (key == "bindBuffer") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          GLuint buffer = 0;
-          if (args[1].IsNumber()) {
-            buffer = static_cast<GLuint>(args[1].ToNumber());
-          }
-          using f = void(*)(GLenum, GLuint);
-          reinterpret_cast<f>(glBindBuffer_)(target, buffer);
-          return Value{};
-        })};
-  }
-  if (key == "bindFramebuffer") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          GLuint framebuffer = static_cast<GLuint>(args[1].ToNumber());
-          using f = void(*)(GLenum, GLuint);
-          reinterpret_cast<f>(glBindFramebuffer_)(target, framebuffer);
-          return Value{};
-        })};
-  }
-  if (key == "bindTexture") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          GLuint texture = static_cast<GLuint>(args[1].ToNumber());
-          using f = void(*)(GLenum, GLuint);
-          reinterpret_cast<f>(glBindTexture_)(target, texture);
-          return Value{};
-        })};
-  }
-  if (key == "blendFunc") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum sfactor = static_cast<GLenum>(args[0].ToNumber());
-          GLenum dfactor = static_cast<GLenum>(args[1].ToNumber());
-          using f = void(*)(GLenum, GLenum);
-          reinterpret_cast<f>(glBlendFunc_)(sfactor, dfactor);
-          return Value{};
-        })};
-  }
-  if (key == "bufferData") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          GLsizeiptr size = static_cast<GLsizeiptr>(args[1].ToNumber());
-          void* data = nullptr;
-          GLenum usage = static_cast<GLenum>(args[2].ToNumber());
-          using f = void(*)(GLenum, GLsizeiptr, const void*, GLenum);
-          reinterpret_cast<f>(glBufferData_)(target, size, data, usage);
-          return Value{};
-        })};
-  }
-  if (key == "bufferSubData") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          GLintptr offset = static_cast<GLintptr>(args[1].ToNumber());
-          BytesSpan data = args[2].ToBytes();
-          ptrdiff_t src_offset = 0;
-          if (args.size() > 3 && args[3].IsNumber()) {
-            src_offset = static_cast<size_t>(args[3].ToNumber());
-          }
-          GLsizeiptr size = data.size();
-          if (args.size() > 4 && args[4].IsNumber()) {
-            size = static_cast<GLsizeiptr>(args[4].ToNumber());
-          }
-          using f = void(*)(GLenum, GLintptr, GLsizeiptr, const void*);
-          reinterpret_cast<f>(glBufferSubData_)(target, offset, size, data.begin() + src_offset);
-          return Value{};
-        })};
-  }
-  if (key == "checkFramebufferStatus") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          using f = GLenum(*)(GLenum);
-          GLenum status = reinterpret_cast<f>(glCheckFramebufferStatus_)(target);
-          return Value{static_cast<double>(status)};
-        })};
-  }
-  if (key == "compileShader") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint shader = static_cast<GLuint>(args[0].ToNumber());
-          using f = void(*)(GLuint);
-          reinterpret_cast<f>(glCompileShader_)(shader);
-          return Value{};
-        })};
-  }
-  if (key == "createBuffer") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint buffer;
-          using f = void(*)(GLsizei, GLuint*);
-          reinterpret_cast<f>(glGenBuffers_)(1, &buffer);
-          return Value{static_cast<double>(buffer)};
-        })};
-  }
-  if (key == "createFramebuffer") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint framebuffer;
-          using f = void(*)(GLsizei, GLuint*);
-          reinterpret_cast<f>(glGenFramebuffers_)(1, &framebuffer);
-          return Value{static_cast<double>(framebuffer)};
-        })};
-  }
-  if (key == "createProgram") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          using f = GLuint(*)();
-          GLuint program = reinterpret_cast<f>(glCreateProgram_)();
-          return Value{static_cast<double>(program)};
-        })};
-  }
-  if (key == "createShader") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum shaderType = static_cast<GLenum>(args[0].ToNumber());
-          using f = GLuint(*)(GLenum);
-          GLuint shader = reinterpret_cast<f>(glCreateShader_)(shaderType);
-          return Value{static_cast<double>(shader)};
-        })};
-  }
-  if (key == "createTexture") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint texture;
-          using f = void(*)(GLsizei, GLuint*);
-          reinterpret_cast<f>(glGenTextures_)(1, &texture);
-          return Value{static_cast<double>(texture)};
-        })};
-  }
-  if (key == "deleteBuffer") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint buffer = static_cast<GLuint>(args[0].ToNumber());
-          using f = void(*)(GLsizei, GLuint*);
-          reinterpret_cast<f>(glDeleteBuffers_)(1, &buffer);
-          return Value{};
-        })};
-  }
-  if (key == "deleteFramebuffer") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint framebuffer = static_cast<GLuint>(args[0].ToNumber());
-          using f = void(*)(GLsizei, GLuint*);
-          reinterpret_cast<f>(glDeleteFramebuffers_)(1, &framebuffer);
-          return Value{};
-        })};
-  }
-  if (key == "deleteProgram") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint program = static_cast<GLuint>(args[0].ToNumber());
-          using f = void(*)(GLuint);
-          reinterpret_cast<f>(glDeleteProgram_)(program);
-          return Value{};
-        })};
-  }
-  if (key == "deleteShader") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint shader = static_cast<GLuint>(args[0].ToNumber());
-          using f = void(*)(GLuint);
-          reinterpret_cast<f>(glDeleteShader_)(shader);
-          return Value{};
-        })};
-  }
-  if (key == "deleteTexture") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint texture = static_cast<GLuint>(args[0].ToNumber());
-          using f = void(*)(GLsizei, GLuint*);
-          reinterpret_cast<f>(glDeleteTextures_)(1, &texture);
-          return Value{};
-        })};
-  }
-  if (key == "disableVertexAttribArray") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint index = static_cast<GLuint>(args[0].ToNumber());
-          using f = void(*)(GLuint);
-          reinterpret_cast<f>(glDisableVertexAttribArray_)(index);
-          return Value{};
-        })};
-  }
-  if (key == "drawElements") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum mode = static_cast<GLenum>(args[0].ToNumber());
-          GLsizei count = static_cast<GLsizei>(args[1].ToNumber());
-          GLenum type = static_cast<GLenum>(args[2].ToNumber());
-          void *indices = nullptr;
-          if (args[3].IsNumber()) {
-            indices = reinterpret_cast<void *>(
-                static_cast<uintptr_t>(args[3].ToNumber()));
-          }
-          if (args[3].IsBytes()) {
-            indices = args[3].ToBytes().begin();
-          }
+void GL::InitFunctions() {
+  functions_.Set("activeTexture", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum texture = static_cast<GLenum>(args[0].ToNumber());
+        Call<GLenum>(glActiveTexture_, texture);
+        return Value{};
+      })});
+  functions_.Set("attachShader", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint program = static_cast<GLuint>(args[0].ToNumber());
+        GLuint shader = static_cast<GLuint>(args[1].ToNumber());
+        Call<GLuint, GLuint>(glAttachShader_, program, shader);
+        return Value{};
+      })});
+  functions_.Set("bindAttribLocation", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint program = static_cast<GLuint>(args[0].ToNumber());
+        GLuint index = static_cast<GLuint>(args[1].ToNumber());
+        std::string name = args[2].ToString();
+        Flush();
+        using f = void(*)(GLuint, GLuint, const GLchar*);
+        reinterpret_cast<f>(glBindAttribLocation_)(
+            program, index, const_cast<GLchar *>(name.c_str()));
+        return Value{};
+      })});
+  functions_.Set("bindBuffer", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        GLuint buffer = 0;
+        if (args[1].IsNumber()) {
+          buffer = static_cast<GLuint>(args[1].ToNumber());
+        }
+        Call<GLenum, GLuint>(glBindBuffer_, target, buffer);
+        return Value{};
+      })});
+  functions_.Set("bindFramebuffer", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        GLuint framebuffer = static_cast<GLuint>(args[1].ToNumber());
+        Call<GLenum, GLuint>(glBindFramebuffer_, target, framebuffer);
+        return Value{};
+      })});
+  functions_.Set("bindTexture", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        GLuint texture = static_cast<GLuint>(args[1].ToNumber());
+        Call<GLenum, GLuint>(glBindTexture_, target, texture);
+        return Value{};
+      })});
+  functions_.Set("blendFunc", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum sfactor = static_cast<GLenum>(args[0].ToNumber());
+        GLenum dfactor = static_cast<GLenum>(args[1].ToNumber());
+        Call<GLenum, GLenum>(glBlendFunc_, sfactor, dfactor);
+        return Value{};
+      })});
+  functions_.Set("bufferData", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        GLsizeiptr size = static_cast<GLsizeiptr>(args[1].ToNumber());
+        void* data = nullptr;
+        GLenum usage = static_cast<GLenum>(args[2].ToNumber());
+        Flush();
+        using f = void(*)(GLenum, GLsizeiptr, const void*, GLenum);
+        reinterpret_cast<f>(glBufferData_)(target, size, data, usage);
+        return Value{};
+      })});
+  functions_.Set("bufferSubData", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        GLintptr offset = static_cast<GLintptr>(args[1].ToNumber());
+        BytesSpan data = args[2].ToBytes();
+        ptrdiff_t src_offset = 0;
+        if (args.size() > 3 && args[3].IsNumber()) {
+          src_offset = static_cast<size_t>(args[3].ToNumber());
+        }
+        GLsizeiptr size = data.size();
+        if (args.size() > 4 && args[4].IsNumber()) {
+          size = static_cast<GLsizeiptr>(args[4].ToNumber());
+        }
+        Flush();
+        using f = void(*)(GLenum, GLintptr, GLsizeiptr, const void*);
+        reinterpret_cast<f>(glBufferSubData_)(target, offset, size, data.begin() + src_offset);
+        return Value{};
+      })});
+  functions_.Set("checkFramebufferStatus", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        Flush();
+        using f = GLenum(*)(GLenum);
+        GLenum status = reinterpret_cast<f>(glCheckFramebufferStatus_)(target);
+        return Value{static_cast<double>(status)};
+      })});
+  functions_.Set("compileShader", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint shader = static_cast<GLuint>(args[0].ToNumber());
+        Call<GLuint>(glCompileShader_, shader);
+        return Value{};
+      })});
+  functions_.Set("createBuffer", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint buffer;
+        Flush();
+        using f = void(*)(GLsizei, GLuint*);
+        reinterpret_cast<f>(glGenBuffers_)(1, &buffer);
+        return Value{static_cast<double>(buffer)};
+      })});
+  functions_.Set("createFramebuffer", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint framebuffer;
+        Flush();
+        using f = void(*)(GLsizei, GLuint*);
+        reinterpret_cast<f>(glGenFramebuffers_)(1, &framebuffer);
+        return Value{static_cast<double>(framebuffer)};
+      })});
+  functions_.Set("createProgram", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        Flush();
+        using f = GLuint(*)();
+        GLuint program = reinterpret_cast<f>(glCreateProgram_)();
+        return Value{static_cast<double>(program)};
+      })});
+  functions_.Set("createShader", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum shaderType = static_cast<GLenum>(args[0].ToNumber());
+        Flush();
+        using f = GLuint(*)(GLenum);
+        GLuint shader = reinterpret_cast<f>(glCreateShader_)(shaderType);
+        return Value{static_cast<double>(shader)};
+      })});
+  functions_.Set("createTexture", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint texture;
+        Flush();
+        using f = void(*)(GLsizei, GLuint*);
+        reinterpret_cast<f>(glGenTextures_)(1, &texture);
+        return Value{static_cast<double>(texture)};
+      })});
+  functions_.Set("deleteBuffer", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint buffer = static_cast<GLuint>(args[0].ToNumber());
+        Flush();
+        using f = void(*)(GLsizei, GLuint*);
+        reinterpret_cast<f>(glDeleteBuffers_)(1, &buffer);
+        return Value{};
+      })});
+  functions_.Set("deleteFramebuffer", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint framebuffer = static_cast<GLuint>(args[0].ToNumber());
+        Flush();
+        using f = void(*)(GLsizei, GLuint*);
+        reinterpret_cast<f>(glDeleteFramebuffers_)(1, &framebuffer);
+        return Value{};
+      })});
+  functions_.Set("deleteProgram", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint program = static_cast<GLuint>(args[0].ToNumber());
+        Call<GLuint>(glDeleteProgram_, program);
+        return Value{};
+      })});
+  functions_.Set("deleteShader", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint shader = static_cast<GLuint>(args[0].ToNumber());
+        Call<GLuint>(glDeleteShader_, shader);
+        return Value{};
+      })});
+  functions_.Set("deleteTexture", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint texture = static_cast<GLuint>(args[0].ToNumber());
+        Flush();
+        using f = void(*)(GLsizei, GLuint*);
+        reinterpret_cast<f>(glDeleteTextures_)(1, &texture);
+        return Value{};
+      })});
+  functions_.Set("disableVertexAttribArray", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint index = static_cast<GLuint>(args[0].ToNumber());
+        Call<GLuint>(glDisableVertexAttribArray_, index);
+        return Value{};
+      })});
+  functions_.Set("drawElements", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum mode = static_cast<GLenum>(args[0].ToNumber());
+        GLsizei count = static_cast<GLsizei>(args[1].ToNumber());
+        GLenum type = static_cast<GLenum>(args[2].ToNumber());
+        if (args[3].IsBytes()) {
+          // The bytes might not live until the batch is flushed.
+          Flush();
           using f = void(*)(GLenum, GLsizei, GLenum, const void*);
-          reinterpret_cast<f>(glDrawElements_)(mode, count, type, indices);
-          return Value{};
-        })};
-  }
-  if (key == "enable") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum cap = static_cast<GLenum>(args[0].ToNumber());
-          using f = void(*)(GLenum);
-          reinterpret_cast<f>(glEnable_)(cap);
-          return Value{};
-        })};
-  }
-  if (key == "enableVertexAttribArray") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint index = static_cast<GLuint>(args[0].ToNumber());
-          using f = void(*)(GLuint);
-          reinterpret_cast<f>(glEnableVertexAttribArray_)(index);
-          return Value{};
-        })};
-  }
-  if (key == "flush") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          using f = void(*)();
-          reinterpret_cast<f>(glFlush_)();
-          return Value{};
-        })};
-  }
-  if (key == "framebufferTexture2D") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          GLenum attachment = static_cast<GLenum>(args[1].ToNumber());
-          GLenum textarget = static_cast<GLenum>(args[2].ToNumber());
-          GLuint texture = static_cast<GLuint>(args[3].ToNumber());
-          GLint level = static_cast<GLint>(args[4].ToNumber());
-          using f = void(*)(GLenum, GLenum, GLenum, GLuint, GLint);
-          reinterpret_cast<f>(glFramebufferTexture2D_)(
-              target, attachment, textarget, texture, level);
-          return Value{};
-        })};
-  }
-  if (key == "getBufferSubData") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          GLintptr offset = static_cast<GLintptr>(args[1].ToNumber());
-          BytesSpan data = args[2].ToBytes();
-          ptrdiff_t dst_offset = static_cast<ptrdiff_t>(args[3].ToNumber());
-          GLsizeiptr size = static_cast<GLsizeiptr>(args[4].ToNumber());
-          using f = void(*)(GLenum, GLintptr, GLsizeiptr, void*);
-          reinterpret_cast<f>(glGetBufferSubData_)(
-              target, offset, size, data.begin() + dst_offset);
-          return Value{};
-        })};
-  }
-  if (key == "getError") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          using f = GLenum(*)();
-          GLenum error = reinterpret_cast<f>(glGetError_)();
-          return Value{static_cast<double>(error)};
-        })};
-  }
-  if (key == "getExtension") {
-    return Value{std::make_shared<Function>(
-        [](Value self, std::vector<Value> args) -> Value {
-          // Do nothing.
-          return Value{};
-        })};
-  }
-  if (key == "getParameter") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum pname = static_cast<GLenum>(args[0].ToNumber());
-          GLint data;
-          using f = void(*)(GLenum, GLint*);
-          reinterpret_cast<f>(glGetIntegerv_)(pname, &data);
-          return Value{static_cast<double>(data)};
-        })};
-  }
-  if (key == "getProgramInfoLog") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint program = static_cast<GLuint>(args[0].ToNumber());
-          GLint buflen;
-          using f1 = void(*)(GLuint, GLenum, GLint*);
-          reinterpret_cast<f1>(glGetProgramiv_)(program, GL_INFO_LOG_LENGTH, &buflen);
+          reinterpret_cast<f>(glDrawElements_)(mode, count, type, args[3].ToBytes().begin());
+          return Value{};
+        }
+        void *indices = nullptr;
+        if (args[3].IsNumber()) {
+          indices = reinterpret_cast<void *>(
+              static_cast<uintptr_t>(args[3].ToNumber()));
+        }
+        Call<GLenum, GLsizei, GLenum, const void*>(glDrawElements_, mode, count, type, indices);
+        return Value{};
+      })});
+  functions_.Set("enable", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum cap = static_cast<GLenum>(args[0].ToNumber());
+        Call<GLenum>(glEnable_, cap);
+        return Value{};
+      })});
+  functions_.Set("enableVertexAttribArray", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint index = static_cast<GLuint>(args[0].ToNumber());
+        Call<GLuint>(glEnableVertexAttribArray_, index);
+        return Value{};
+      })});
+  functions_.Set("flush", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        Flush();
+        using f = void(*)();
+        reinterpret_cast<f>(glFlush_)();
+        return Value{};
+      })});
+  functions_.Set("framebufferTexture2D", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        GLenum attachment = static_cast<GLenum>(args[1].ToNumber());
+        GLenum textarget = static_cast<GLenum>(args[2].ToNumber());
+        GLuint texture = static_cast<GLuint>(args[3].ToNumber());
+        GLint level = static_cast<GLint>(args[4].ToNumber());
+        Call<GLenum, GLenum, GLenum, GLuint, GLint>(glFramebufferTexture2D_,
+            target, attachment, textarget, texture, level);
+        return Value{};
+      })});
+  functions_.Set("getBufferSubData", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        GLintptr offset = static_cast<GLintptr>(args[1].ToNumber());
+        BytesSpan data = args[2].ToBytes();
+        ptrdiff_t dst_offset = static_cast<ptrdiff_t>(args[3].ToNumber());
+        GLsizeiptr size = static_cast<GLsizeiptr>(args[4].ToNumber());
+        Flush();
+        using f = void(*)(GLenum, GLintptr, GLsizeiptr, void*);
+        reinterpret_cast<f>(glGetBufferSubData_)(
+            target, offset, size, data.begin() + dst_offset);
+        return Value{};
+      })});
+  functions_.Set("getError", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        Flush();
+        using f = GLenum(*)();
+        GLenum error = reinterpret_cast<f>(glGetError_)();
+        return Value{static_cast<double>(error)};
+      })});
+  functions_.Set("getExtension", Value{std::make_shared<Function>(
+      [](Value self, ValueSpan args) -> Value {
+        // Do nothing.
+        return Value{};
+      })});
+  functions_.Set("getParameter", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum pname = static_cast<GLenum>(args[0].ToNumber());
+        GLint data;
+        Flush();
+        using f = void(*)(GLenum, GLint*);
+        reinterpret_cast<f>(glGetIntegerv_)(pname, &data);
+        return Value{static_cast<double>(data)};
+      })});
+  functions_.Set("getProgramInfoLog", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint program = static_cast<GLuint>(args[0].ToNumber());
+        GLint buflen;
+        Flush();
+        using f1 = void(*)(GLuint, GLenum, GLint*);
+        reinterpret_cast<f1>(glGetProgramiv_)(program, GL_INFO_LOG_LENGTH, &buflen);
 
-          GLint len;
-          std::vector<GLchar> buf = std::vector<GLchar>(buflen);
-          using f2 = void(*)(GLuint, GLsizei, GLsizei*, GLchar*);
-          reinterpret_cast<f2>(glGetProgramInfoLog_)(program, buflen, &len, buf.data());
-          std::string log = std::string(buf.begin(), buf.begin() + len);
-          return Value{log};
-        })};
-  }
-  if (key == "getProgramParameter") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint program = static_cast<GLuint>(args[0].ToNumber());
-          GLenum pname = static_cast<GLenum>(args[1].ToNumber());
-          GLint params;
-          using f = void(*)(GLuint, GLenum, GLint*);
-          reinterpret_cast<f>(glGetProgramiv_)(program, pname, &params);
-          switch (pname) {
-          case GL_DELETE_STATUS:
-          case GL_LINK_STATUS:
-          case GL_VALIDATE_STATUS:
-            return Value{static_cast<bool>(params)};
-          default:
-            return Value{static_cast<double>(params)};
-          }
-        })};
-  }
-  if (key == "getShaderInfoLog") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint shader = static_cast<GLuint>(args[0].ToNumber());
-          GLint buflen;
-          using f1 = void(*)(GLuint, GLenum, GLint*);
-          reinterpret_cast<f1>(glGetShaderiv_)(shader, GL_INFO_LOG_LENGTH, &buflen);
+        GLint len;
+        std::vector<GLchar> buf = std::vector<GLchar>(buflen);
+        using f2 = void(*)(GLuint, GLsizei, GLsizei*, GLchar*);
+        reinterpret_cast<f2>(glGetProgramInfoLog_)(program, buflen, &len, buf.data());
+        std::string log = std::string(buf.begin(), buf.begin() + len);
+        return Value{log};
+      })});
+  functions_.Set("getProgramParameter", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint program = static_cast<GLuint>(args[0].ToNumber());
+        GLenum pname = static_cast<GLenum>(args[1].ToNumber());
+        GLint params;
+        Flush();
+        using f = void(*)(GLuint, GLenum, GLint*);
+        reinterpret_cast<f>(glGetProgramiv_)(program, pname, &params);
+        switch (pname) {
+        case GL_DELETE_STATUS:
+        case GL_LINK_STATUS:
+        case GL_VALIDATE_STATUS:
+          return Value{static_cast<bool>(params)};
+        default:
+          return Value{static_cast<double>(params)};
+        }
+      })});
+  functions_.Set("getShaderInfoLog", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint shader = static_cast<GLuint>(args[0].ToNumber());
+        GLint buflen;
+        Flush();
+        using f1 = void(*)(GLuint, GLenum, GLint*);
+        reinterpret_cast<f1>(glGetShaderiv_)(shader, GL_INFO_LOG_LENGTH, &buflen);
 
-          GLint len;
-          std::vector<GLchar> buf = std::vector<GLchar>(buflen);
-          using f2 = void(*)(GLuint, GLsizei, GLsizei*, GLchar*);
-          reinterpret_cast<f2>(glGetShaderInfoLog_)(shader, buflen, &len, buf.data());
-          std::string log = std::string(buf.begin(), buf.begin() + len);
-          return Value{log};
-      })};
-  }
-  if (key == "getShaderParameter") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint shader = static_cast<GLuint>(args[0].ToNumber());
-          GLenum pname = static_cast<GLenum>(args[1].ToNumber());
-          GLint params;
-          using f = void(*)(GLuint, GLenum, GLint*);
-          reinterpret_cast<f>(glGetShaderiv_)(shader, pname, &params);
-          switch (pname) {
-          case GL_DELETE_STATUS:
-          case GL_COMPILE_STATUS:
-            return Value{static_cast<bool>(params)};
-          default:
-            return Value{static_cast<double>(params)};
-          }
-        })};
-  }
-  if (key == "getShaderPrecisionFormat") {
-    return Value{std::make_shared<Function>(
-        [](Value self, std::vector<Value> args) -> Value {
-          GLenum shaderType = static_cast<GLenum>(args[0].ToNumber());
-          GLenum precisionType = static_cast<GLenum>(args[1].ToNumber());
-          if (shaderType != GL_FRAGMENT_SHADER) {
-            return Value{};
-          }
-          if (precisionType != 0x8DF2 /* GL_HIGH_FLOAT */) {
-            return Value{};
-          }
+        GLint len;
+        std::vector<GLchar> buf = std::vector<GLchar>(buflen);
+        using f2 = void(*)(GLuint, GLsizei, GLsizei*, GLchar*);
+        reinterpret_cast<f2>(glGetShaderInfoLog_)(shader, buflen, &len, buf.data());
+        std::string log = std::string(buf.begin(), buf.begin() + len);
+        return Value{log};
+      })});
+  functions_.Set("getShaderParameter", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint shader = static_cast<GLuint>(args[0].ToNumber());
+        GLenum pname = static_cast<GLenum>(args[1].ToNumber());
+        GLint params;
+        Flush();
+        using f = void(*)(GLuint, GLenum, GLint*);
+        reinterpret_cast<f>(glGetShaderiv_)(shader, pname, &params);
+        switch (pname) {
+        case GL_DELETE_STATUS:
+        case GL_COMPILE_STATUS:
+          return Value{static_cast<bool>(params)};
+        default:
+          return Value{static_cast<double>(params)};
+        }
+      })});
+  functions_.Set("getShaderPrecisionFormat", Value{std::make_shared<Function>(
+      [](Value self, ValueSpan args) -> Value {
+        GLenum shaderType = static_cast<GLenum>(args[0].ToNumber());
+        GLenum precisionType = static_cast<GLenum>(args[1].ToNumber());
+        if (shaderType != GL_FRAGMENT_SHADER) {
+          return Value{};
+        }
+        if (precisionType != 0x8DF2 /* GL_HIGH_FLOAT */) {
+          return Value{};
+        }
 
-          // glGetShaderPrecisionFormat is only for OpenGL ES.
-          // Assume that the precision is always enough.
-          auto obj = std::make_shared<DictionaryValues>();
-          obj->Set("rangeMin", Value{static_cast<double>(127)});
-          obj->Set("rangeMax", Value{static_cast<double>(127)});
-          obj->Set("precision", Value{static_cast<double>(23)});
-          return Value{obj};
-        })};
-}
-  if (key == "getUniformLocation") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint program = static_cast<GLuint>(args[0].ToNumber());
-          std::string name = args[1].ToString();
-          using f = GLint(*)(GLuint, const GLchar*);
-          GLint location = reinterpret_cast<f>(glGetUniformLocation_)(program, name.c_str());
-          return Value{static_cast<double>(location)};
-        })};
-  }
-  if (key == "isContextLost") {
-    return Value{std::make_shared<Function>(
-        [](Value self, std::vector<Value> args) -> Value {
-          return Value{false};
-        })};
-  }
-  if (key == "isFramebuffer") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint framebuffer = static_cast<GLuint>(args[0].ToNumber());
-          using f = GLboolean(*)(GLuint);
-          bool result = reinterpret_cast<f>(glIsFramebuffer_)(framebuffer) == GL_TRUE;
-          return Value{result};
-        })};
-  }
-  if (key == "isProgram") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint program = static_cast<GLuint>(args[0].ToNumber());
-          using f = GLboolean(*)(GLuint);
-          bool result = reinterpret_cast<f>(glIsProgram_)(program) == GL_TRUE;
-          return Value{result};
-        })};
-  }
-  if (key == "isTexture") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint texture = static_cast<GLuint>(args[0].ToNumber());
-          using f = GLboolean(*)(GLuint);
-          bool result = reinterpret_cast<f>(glIsTexture_)(texture) == GL_TRUE;
-          return Value{result};
-        })};
-  }
-  if (key == "linkProgram") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint program = static_cast<GLuint>(args[0].ToNumber());
-          using f = void(*)(GLuint);
-          reinterpret_cast<f>(glLinkProgram_)(program);
-          return Value{};
-        })};
-  }
-  if (key == "pixelStorei") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum pname = static_cast<GLenum>(args[0].ToNumber());
-          GLint param = static_cast<GLint>(args[1].ToNumber());
-          using f = void(*)(GLenum, GLint);
-          reinterpret_cast<f>(glPixelStorei_)(pname, param);
-          return Value{};
-        })};
-  }
-  if (key == "readPixels") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint x = static_cast<GLint>(args[0].ToNumber());
-          GLint y = static_cast<GLint>(args[1].ToNumber());
-          GLsizei width = static_cast<GLsizei>(args[2].ToNumber());
-          GLsizei height = static_cast<GLsizei>(args[3].ToNumber());
-          GLenum format = static_cast<GLenum>(args[4].ToNumber());
-          GLenum type = static_cast<GLenum>(args[5].ToNumber());
-          void *data = nullptr;
-          if (args[6].IsNumber()) {
-            data = reinterpret_cast<void *>(
-                static_cast<uintptr_t>(args[6].ToNumber()));
-          }
-          if (args[6].IsBytes()) {
-            data = args[6].ToBytes().begin();
-          }
-          using f = void(*)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void*);
-          reinterpret_cast<f>(glReadPixels_)(x, y, width, height, format, type, data);
-          return Value{};
-        })};
-  }
-  if (key == "scissor") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint x = static_cast<GLint>(args[0].ToNumber());
-          GLint y = static_cast<GLint>(args[1].ToNumber());
-          GLsizei width = static_cast<GLsizei>(args[2].ToNumber());
-          GLsizei height = static_cast<GLsizei>(args[3].ToNumber());
-          using f = void(*)(GLint, GLint, GLsizei, GLsizei);
-          reinterpret_cast<f>(glScissor_)(x, y, width, height);
-          return Value{};
-        })};
-  }
-  if (key == "shaderSource") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint shader = static_cast<GLuint>(args[0].ToNumber());
-          std::string str = args[1].ToString();
-          const char *cstr = str.c_str();
-          using f = void(*)(GLuint, GLsizei, const GLchar**, const GLint*);
-          reinterpret_cast<f>(glShaderSource_)(shader, 1, &cstr, nullptr);
-          return Value{};
-        })};
-  }
-  if (key == "texImage2D") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          GLint level = static_cast<GLint>(args[1].ToNumber());
-          GLint internalFormat = static_cast<GLint>(args[2].ToNumber());
-          GLsizei width = static_cast<GLsizei>(args[3].ToNumber());
-          GLsizei height = static_cast<GLsizei>(args[4].ToNumber());
-          GLint border = static_cast<GLint>(args[5].ToNumber());
-          GLenum format = static_cast<GLenum>(args[6].ToNumber());
-          GLenum type = static_cast<GLenum>(args[7].ToNumber());
-          void *data = nullptr;
-          if (args[8].IsBytes()) {
-            data = args[8].ToBytes().begin();
-          }
-          using f = void(*)(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const void*);
-          reinterpret_cast<f>(glTexImage2D_)(
-              target, level, internalFormat, width, height, border, format, type, data);
-          return Value{};
-        })};
-  }
-  if (key == "texParameteri") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          GLenum pname = static_cast<GLenum>(args[1].ToNumber());
-          GLint param = static_cast<GLint>(args[2].ToNumber());
-          using f = void(*)(GLenum, GLenum, GLint);
-          reinterpret_cast<f>(glTexParameteri_)(target, pname, param);
-          return Value{};
-        })};
-  }
-  if (key == "texSubImage2D") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLenum target = static_cast<GLenum>(args[0].ToNumber());
-          GLint level = static_cast<GLint>(args[1].ToNumber());
-          GLint xoffset = static_cast<GLint>(args[2].ToNumber());
-          GLint yoffset = static_cast<GLint>(args[3].ToNumber());
-          GLsizei width = static_cast<GLsizei>(args[4].ToNumber());
-          GLsizei height = static_cast<GLsizei>(args[5].ToNumber());
-          GLenum format = static_cast<GLenum>(args[6].ToNumber());
-          GLenum type = static_cast<GLenum>(args[7].ToNumber());
-          void *data = nullptr;
-          if (args[8].IsNumber()) {
-            data = reinterpret_cast<void*>(static_cast<uintptr_t>(args[8].ToNumber()));
-          }
-          if (args[8].IsBytes()) {
-            data = args[8].ToBytes().begin();
-            if (args.size() > 9) {
-              int offset = static_cast<int>(args[9].ToNumber());
-              data = args[8].ToBytes().begin() + offset;
-            }
-          }
-          using f = void(*)(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void*);
-          reinterpret_cast<f>(glTexSubImage2D_)(
-              target, level, xoffset, yoffset, width, height, format, type, data);
-          return Value{};
-        })};
-  }
-  if (key == "uniform1f") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          GLfloat v0 = static_cast<GLfloat>(args[1].ToNumber());
-          using f = void(*)(GLint, GLfloat);
-          reinterpret_cast<f>(glUniform1f_)(location, v0);
-          return Value{};
-        })};
-  }
-  if (key == "uniform1fv") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          BytesSpan bytes = args[1].ToBytes();
-          int offset = 0;
-          if (args.size() > 2) {
-            offset = static_cast<int>(args[2].ToNumber());
-          }
-          GLsizei count = bytes.size() / sizeof(GLfloat) - offset;
-          if (args.size() > 3) {
-            count = static_cast<GLsizei>(args[3].ToNumber());
-          }
-          GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
-          using f = void(*)(GLint, GLsizei, GLfloat*);
-          reinterpret_cast<f>(glUniform1fv_)(location, count, value + offset);
-          return Value{};
-        })};
-  }
-  if (key == "uniform1i") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          GLint v0 = static_cast<GLint>(args[1].ToNumber());
-          using f = void(*)(GLint, GLint);
-          reinterpret_cast<f>(glUniform1i_)(location, v0);
-          return Value{};
-        })};
-  }
-  if (key == "uniform2f") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          GLfloat v0 = static_cast<GLfloat>(args[1].ToNumber());
-          GLfloat v1 = static_cast<GLfloat>(args[2].ToNumber());
-          using f = void(*)(GLint, GLfloat, GLfloat);
-          reinterpret_cast<f>(glUniform2f_)(location, v0, v1);
-          return Value{};
-        })};
-  }
-  if (key == "uniform2fv") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          BytesSpan bytes = args[1].ToBytes();
-          int offset = 0;
-          if (args.size() > 2) {
-            offset = static_cast<int>(args[2].ToNumber());
-          }
-          GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 2;
-          if (args.size() > 3) {
-            count = static_cast<GLsizei>(args[3].ToNumber()) / 2;
-          }
-          GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
-          using f = void(*)(GLint, GLsizei, GLfloat*);
-          reinterpret_cast<f>(glUniform2fv_)(location, count, value + offset);
-          return Value{};
-        })};
-  }
-  if (key == "uniform3f") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          GLfloat v0 = static_cast<GLfloat>(args[1].ToNumber());
-          GLfloat v1 = static_cast<GLfloat>(args[2].ToNumber());
-          GLfloat v2 = static_cast<GLfloat>(args[3].ToNumber());
-          using f = void(*)(GLint, GLfloat, GLfloat, GLfloat);
-          reinterpret_cast<f>(glUniform3f_)(location, v0, v1, v2);
-          return Value{};
-        })};
-  }
-  if (key == "uniform3fv") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          BytesSpan bytes = args[1].ToBytes();
-          int offset = 0;
-          if (args.size() > 2) {
-            offset = static_cast<int>(args[2].ToNumber());
-          }
-          GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 3;
-          if (args.size() > 3) {
-            count = static_cast<GLsizei>(args[3].ToNumber()) / 3;
-          }
-          GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
-          using f = void(*)(GLint, GLsizei, GLfloat*);
-          reinterpret_cast<f>(glUniform3fv_)(location, count, value + offset);
-          return Value{};
-        })};
-  }
-  if (key == "uniform4f") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          GLfloat v0 = static_cast<GLfloat>(args[1].ToNumber());
-          GLfloat v1 = static_cast<GLfloat>(args[2].ToNumber());
-          GLfloat v2 = static_cast<GLfloat>(args[3].ToNumber());
-          GLfloat v3 = static_cast<GLfloat>(args[4].ToNumber());
-          using f = void(*)(GLint, GLfloat, GLfloat, GLfloat, GLfloat);
-          reinterpret_cast<f>(glUniform4f_)(location, v0, v1, v2, v3);
-          return Value{};
-        })};
-  }
-  if (key == "uniform4fv") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          BytesSpan bytes = args[1].ToBytes();
-          int offset = 0;
-          if (args.size() > 2) {
-            offset = static_cast<int>(args[2].ToNumber());
-          }
-          GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 4;
-          if (args.size() > 3) {
-            count = static_cast<GLsizei>(args[3].ToNumber()) / 4;
-          }
-          GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
-          using f = void(*)(GLint, GLsizei, GLfloat*);
-          reinterpret_cast<f>(glUniform4fv_)(location, count, value + offset);
-          return Value{};
-        })};
-  }
-  if (key == "uniformMatrix2fv") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          GLboolean transpose = static_cast<GLboolean>(args[1].ToBool());
-          BytesSpan bytes = args[2].ToBytes();
-          int offset = 0;
-          if (args.size() > 3) {
-            offset = static_cast<int>(args[3].ToNumber());
-          }
-          GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 4;
-          if (args.size() > 4) {
-            count = static_cast<GLsizei>(args[4].ToNumber()) / 4;
-          }
-          GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
-          using f = void(*)(GLint, GLsizei, GLboolean, GLfloat*);
-          reinterpret_cast<f>(glUniformMatrix2fv_)(location, count, transpose, value + offset);
-          return Value{};
-        })};
-  }
-  if (key == "uniformMatrix3fv") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          GLboolean transpose = static_cast<GLboolean>(args[1].ToBool());
-          BytesSpan bytes = args[2].ToBytes();
-          int offset = 0;
-          if (args.size() > 3) {
-            offset = static_cast<int>(args[3].ToNumber());
-          }
-          GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 9;
-          if (args.size() > 4) {
-            count = static_cast<GLsizei>(args[4].ToNumber()) / 9;
-          }
-          GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
-          using f = void(*)(GLint, GLsizei, GLboolean, GLfloat*);
-          reinterpret_cast<f>(glUniformMatrix3fv_)(location, count, transpose, value + offset);
-          return Value{};
-        })};
-  }
-  if (key == "uniformMatrix4fv") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint location = static_cast<GLint>(args[0].ToNumber());
-          GLboolean transpose = static_cast<GLboolean>(args[1].ToBool());
-          BytesSpan bytes = args[2].ToBytes();
-          int offset = 0;
-          if (args.size() > 3) {
-            offset = static_cast<int>(args[3].ToNumber());
-          }
-          GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 16;
-          if (args.size() > 4) {
-            count = static_cast<GLsizei>(args[4].ToNumber()) / 16;
-          }
-          GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
-          using f = void(*)(GLint, GLsizei, GLboolean, GLfloat*);
-          reinterpret_cast<f>(glUniformMatrix4fv_)(location, count, transpose, value + offset);
-          return Value{};
-        })};
-  }
-  if (key == "useProgram") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint program = static_cast<GLuint>(args[0].ToNumber());
-          using f = void(*)(GLuint);
-          reinterpret_cast<f>(glUseProgram_)(program);
-          return Value{};
-        })};
-  }
-  if (key == "vertexAttribPointer") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLuint index = static_cast<GLuint>(args[0].ToNumber());
-          GLint size = static_cast<GLint>(args[1].ToNumber());
-          GLenum type = static_cast<GLenum>(args[2].ToNumber());
-          GLboolean normalized = static_cast<GLboolean>(args[3].ToBool());
-          GLsizei stride = static_cast<GLsizei>(args[4].ToNumber());
-          void *pointer = nullptr;
-          if (args[5].IsNumber()) {
-            pointer = reinterpret_cast<void *>(
-                static_cast<uintptr_t>(args[5].ToNumber()));
-          }
-          if (args[5].IsBytes()) {
-            pointer = args[5].ToBytes().begin();
+        // glGetShaderPrecisionFormat is only for OpenGL ES.
+        // Assume that the precision is always enough.
+        auto obj = std::make_shared<DictionaryValues>();
+        obj->Set("rangeMin", Value{static_cast<double>(127)});
+        obj->Set("rangeMax", Value{static_cast<double>(127)});
+        obj->Set("precision", Value{static_cast<double>(23)});
+        return Value{obj};
+      })});
+  functions_.Set("getUniformLocation", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint program = static_cast<GLuint>(args[0].ToNumber());
+        std::string name = args[1].ToString();
+        Flush();
+        using f = GLint(*)(GLuint, const GLchar*);
+        GLint location = reinterpret_cast<f>(glGetUniformLocation_)(program, name.c_str());
+        return Value{static_cast<double>(location)};
+      })});
+  functions_.Set("isContextLost", Value{std::make_shared<Function>(
+      [](Value self, ValueSpan args) -> Value {
+        return Value{false};
+      })});
+  functions_.Set("isFramebuffer", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint framebuffer = static_cast<GLuint>(args[0].ToNumber());
+        Flush();
+        using f = GLboolean(*)(GLuint);
+        bool result = reinterpret_cast<f>(glIsFramebuffer_)(framebuffer) == GL_TRUE;
+        return Value{result};
+      })});
+  functions_.Set("isProgram", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint program = static_cast<GLuint>(args[0].ToNumber());
+        Flush();
+        using f = GLboolean(*)(GLuint);
+        bool result = reinterpret_cast<f>(glIsProgram_)(program) == GL_TRUE;
+        return Value{result};
+      })});
+  functions_.Set("isTexture", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint texture = static_cast<GLuint>(args[0].ToNumber());
+        Flush();
+        using f = GLboolean(*)(GLuint);
+        bool result = reinterpret_cast<f>(glIsTexture_)(texture) == GL_TRUE;
+        return Value{result};
+      })});
+  functions_.Set("linkProgram", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint program = static_cast<GLuint>(args[0].ToNumber());
+        Call<GLuint>(glLinkProgram_, program);
+        return Value{};
+      })});
+  functions_.Set("pixelStorei", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum pname = static_cast<GLenum>(args[0].ToNumber());
+        GLint param = static_cast<GLint>(args[1].ToNumber());
+        Call<GLenum, GLint>(glPixelStorei_, pname, param);
+        return Value{};
+      })});
+  functions_.Set("readPixels", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint x = static_cast<GLint>(args[0].ToNumber());
+        GLint y = static_cast<GLint>(args[1].ToNumber());
+        GLsizei width = static_cast<GLsizei>(args[2].ToNumber());
+        GLsizei height = static_cast<GLsizei>(args[3].ToNumber());
+        GLenum format = static_cast<GLenum>(args[4].ToNumber());
+        GLenum type = static_cast<GLenum>(args[5].ToNumber());
+        void *data = nullptr;
+        if (args[6].IsNumber()) {
+          data = reinterpret_cast<void *>(
+              static_cast<uintptr_t>(args[6].ToNumber()));
+        }
+        if (args[6].IsBytes()) {
+          data = args[6].ToBytes().begin();
+        }
+        Flush();
+        using f = void(*)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void*);
+        reinterpret_cast<f>(glReadPixels_)(x, y, width, height, format, type, data);
+        return Value{};
+      })});
+  functions_.Set("scissor", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint x = static_cast<GLint>(args[0].ToNumber());
+        GLint y = static_cast<GLint>(args[1].ToNumber());
+        GLsizei width = static_cast<GLsizei>(args[2].ToNumber());
+        GLsizei height = static_cast<GLsizei>(args[3].ToNumber());
+        Call<GLint, GLint, GLsizei, GLsizei>(glScissor_, x, y, width, height);
+        return Value{};
+      })});
+  functions_.Set("shaderSource", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint shader = static_cast<GLuint>(args[0].ToNumber());
+        std::string str = args[1].ToString();
+        const char *cstr = str.c_str();
+        Flush();
+        using f = void(*)(GLuint, GLsizei, const GLchar**, const GLint*);
+        reinterpret_cast<f>(glShaderSource_)(shader, 1, &cstr, nullptr);
+        return Value{};
+      })});
+  functions_.Set("texImage2D", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        GLint level = static_cast<GLint>(args[1].ToNumber());
+        GLint internalFormat = static_cast<GLint>(args[2].ToNumber());
+        GLsizei width = static_cast<GLsizei>(args[3].ToNumber());
+        GLsizei height = static_cast<GLsizei>(args[4].ToNumber());
+        GLint border = static_cast<GLint>(args[5].ToNumber());
+        GLenum format = static_cast<GLenum>(args[6].ToNumber());
+        GLenum type = static_cast<GLenum>(args[7].ToNumber());
+        void *data = nullptr;
+        if (args[8].IsBytes()) {
+          data = args[8].ToBytes().begin();
+        }
+        Flush();
+        using f = void(*)(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const void*);
+        reinterpret_cast<f>(glTexImage2D_)(
+            target, level, internalFormat, width, height, border, format, type, data);
+        return Value{};
+      })});
+  functions_.Set("texParameteri", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        GLenum pname = static_cast<GLenum>(args[1].ToNumber());
+        GLint param = static_cast<GLint>(args[2].ToNumber());
+        Call<GLenum, GLenum, GLint>(glTexParameteri_, target, pname, param);
+        return Value{};
+      })});
+  functions_.Set("texSubImage2D", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLenum target = static_cast<GLenum>(args[0].ToNumber());
+        GLint level = static_cast<GLint>(args[1].ToNumber());
+        GLint xoffset = static_cast<GLint>(args[2].ToNumber());
+        GLint yoffset = static_cast<GLint>(args[3].ToNumber());
+        GLsizei width = static_cast<GLsizei>(args[4].ToNumber());
+        GLsizei height = static_cast<GLsizei>(args[5].ToNumber());
+        GLenum format = static_cast<GLenum>(args[6].ToNumber());
+        GLenum type = static_cast<GLenum>(args[7].ToNumber());
+        void *data = nullptr;
+        if (args[8].IsNumber()) {
+          data = reinterpret_cast<void*>(static_cast<uintptr_t>(args[8].ToNumber()));
+        }
+        if (args[8].IsBytes()) {
+          data = args[8].ToBytes().begin();
+          if (args.size() > 9) {
+            int offset = static_cast<int>(args[9].ToNumber());
+            data = args[8].ToBytes().begin() + offset;
           }
+        }
+        Flush();
+        using f = void(*)(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void*);
+        reinterpret_cast<f>(glTexSubImage2D_)(
+            target, level, xoffset, yoffset, width, height, format, type, data);
+        return Value{};
+      })});
+  functions_.Set("uniform1f", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        GLfloat v0 = static_cast<GLfloat>(args[1].ToNumber());
+        Call<GLint, GLfloat>(glUniform1f_, location, v0);
+        return Value{};
+      })});
+  functions_.Set("uniform1fv", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        BytesSpan bytes = args[1].ToBytes();
+        int offset = 0;
+        if (args.size() > 2) {
+          offset = static_cast<int>(args[2].ToNumber());
+        }
+        GLsizei count = bytes.size() / sizeof(GLfloat) - offset;
+        if (args.size() > 3) {
+          count = static_cast<GLsizei>(args[3].ToNumber());
+        }
+        GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
+        Flush();
+        using f = void(*)(GLint, GLsizei, GLfloat*);
+        reinterpret_cast<f>(glUniform1fv_)(location, count, value + offset);
+        return Value{};
+      })});
+  functions_.Set("uniform1i", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        GLint v0 = static_cast<GLint>(args[1].ToNumber());
+        Call<GLint, GLint>(glUniform1i_, location, v0);
+        return Value{};
+      })});
+  functions_.Set("uniform2f", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        GLfloat v0 = static_cast<GLfloat>(args[1].ToNumber());
+        GLfloat v1 = static_cast<GLfloat>(args[2].ToNumber());
+        Call<GLint, GLfloat, GLfloat>(glUniform2f_, location, v0, v1);
+        return Value{};
+      })});
+  functions_.Set("uniform2fv", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        BytesSpan bytes = args[1].ToBytes();
+        int offset = 0;
+        if (args.size() > 2) {
+          offset = static_cast<int>(args[2].ToNumber());
+        }
+        GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 2;
+        if (args.size() > 3) {
+          count = static_cast<GLsizei>(args[3].ToNumber()) / 2;
+        }
+        GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
+        Flush();
+        using f = void(*)(GLint, GLsizei, GLfloat*);
+        reinterpret_cast<f>(glUniform2fv_)(location, count, value + offset);
+        return Value{};
+      })});
+  functions_.Set("uniform3f", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        GLfloat v0 = static_cast<GLfloat>(args[1].ToNumber());
+        GLfloat v1 = static_cast<GLfloat>(args[2].ToNumber());
+        GLfloat v2 = static_cast<GLfloat>(args[3].ToNumber());
+        Call<GLint, GLfloat, GLfloat, GLfloat>(glUniform3f_, location, v0, v1, v2);
+        return Value{};
+      })});
+  functions_.Set("uniform3fv", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        BytesSpan bytes = args[1].ToBytes();
+        int offset = 0;
+        if (args.size() > 2) {
+          offset = static_cast<int>(args[2].ToNumber());
+        }
+        GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 3;
+        if (args.size() > 3) {
+          count = static_cast<GLsizei>(args[3].ToNumber()) / 3;
+        }
+        GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
+        Flush();
+        using f = void(*)(GLint, GLsizei, GLfloat*);
+        reinterpret_cast<f>(glUniform3fv_)(location, count, value + offset);
+        return Value{};
+      })});
+  functions_.Set("uniform4f", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        GLfloat v0 = static_cast<GLfloat>(args[1].ToNumber());
+        GLfloat v1 = static_cast<GLfloat>(args[2].ToNumber());
+        GLfloat v2 = static_cast<GLfloat>(args[3].ToNumber());
+        GLfloat v3 = static_cast<GLfloat>(args[4].ToNumber());
+        Call<GLint, GLfloat, GLfloat, GLfloat, GLfloat>(glUniform4f_, location, v0, v1, v2, v3);
+        return Value{};
+      })});
+  functions_.Set("uniform4fv", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        BytesSpan bytes = args[1].ToBytes();
+        int offset = 0;
+        if (args.size() > 2) {
+          offset = static_cast<int>(args[2].ToNumber());
+        }
+        GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 4;
+        if (args.size() > 3) {
+          count = static_cast<GLsizei>(args[3].ToNumber()) / 4;
+        }
+        GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
+        Flush();
+        using f = void(*)(GLint, GLsizei, GLfloat*);
+        reinterpret_cast<f>(glUniform4fv_)(location, count, value + offset);
+        return Value{};
+      })});
+  functions_.Set("uniformMatrix2fv", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        GLboolean transpose = static_cast<GLboolean>(args[1].ToBool());
+        BytesSpan bytes = args[2].ToBytes();
+        int offset = 0;
+        if (args.size() > 3) {
+          offset = static_cast<int>(args[3].ToNumber());
+        }
+        GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 4;
+        if (args.size() > 4) {
+          count = static_cast<GLsizei>(args[4].ToNumber()) / 4;
+        }
+        GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
+        Flush();
+        using f = void(*)(GLint, GLsizei, GLboolean, GLfloat*);
+        reinterpret_cast<f>(glUniformMatrix2fv_)(location, count, transpose, value + offset);
+        return Value{};
+      })});
+  functions_.Set("uniformMatrix3fv", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        GLboolean transpose = static_cast<GLboolean>(args[1].ToBool());
+        BytesSpan bytes = args[2].ToBytes();
+        int offset = 0;
+        if (args.size() > 3) {
+          offset = static_cast<int>(args[3].ToNumber());
+        }
+        GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 9;
+        if (args.size() > 4) {
+          count = static_cast<GLsizei>(args[4].ToNumber()) / 9;
+        }
+        GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
+        Flush();
+        using f = void(*)(GLint, GLsizei, GLboolean, GLfloat*);
+        reinterpret_cast<f>(glUniformMatrix3fv_)(location, count, transpose, value + offset);
+        return Value{};
+      })});
+  functions_.Set("uniformMatrix4fv", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint location = static_cast<GLint>(args[0].ToNumber());
+        GLboolean transpose = static_cast<GLboolean>(args[1].ToBool());
+        BytesSpan bytes = args[2].ToBytes();
+        int offset = 0;
+        if (args.size() > 3) {
+          offset = static_cast<int>(args[3].ToNumber());
+        }
+        GLsizei count = (bytes.size() / sizeof(GLfloat) - offset) / 16;
+        if (args.size() > 4) {
+          count = static_cast<GLsizei>(args[4].ToNumber()) / 16;
+        }
+        GLfloat *value = reinterpret_cast<GLfloat *>(bytes.begin());
+        Flush();
+        using f = void(*)(GLint, GLsizei, GLboolean, GLfloat*);
+        reinterpret_cast<f>(glUniformMatrix4fv_)(location, count, transpose, value + offset);
+        return Value{};
+      })});
+  functions_.Set("useProgram", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint program = static_cast<GLuint>(args[0].ToNumber());
+        Call<GLuint>(glUseProgram_, program);
+        return Value{};
+      })});
+  functions_.Set("vertexAttribPointer", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLuint index = static_cast<GLuint>(args[0].ToNumber());
+        GLint size = static_cast<GLint>(args[1].ToNumber());
+        GLenum type = static_cast<GLenum>(args[2].ToNumber());
+        GLboolean normalized = static_cast<GLboolean>(args[3].ToBool());
+        GLsizei stride = static_cast<GLsizei>(args[4].ToNumber());
+        if (args[5].IsBytes()) {
+          // The bytes might not live until the batch is flushed.
+          Flush();
           using f = void(*)(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*);
           reinterpret_cast<f>(glVertexAttribPointer_)(
-              index, size, type, normalized, stride, pointer);
-          return Value{};
-        })};
-  }
-  if (key == "viewport") {
-    return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
-          GLint x = static_cast<GLint>(args[0].ToNumber());
-          GLint y = static_cast<GLint>(args[1].ToNumber());
-          GLsizei width = static_cast<GLsizei>(args[2].ToNumber());
-          GLsizei height = static_cast<GLsizei>(args[3].ToNumber());
-          using f = void(*)(GLint, GLint, GLsizei, GLsizei);
-          reinterpret_cast<f>(glViewport_)(x, y, width, height);
-          return Value{};
-        })};
+              index, size, type, normalized, stride, args[5].ToBytes().begin());
+          return Value{};
+        }
+        void *pointer = nullptr;
+        if (args[5].IsNumber()) {
+          pointer = reinterpret_cast<void *>(
+              static_cast<uintptr_t>(args[5].ToNumber()));
+        }
+        Call<GLuint, GLint, GLenum, GLboolean, GLsizei, const void*>(glVertexAttribPointer_,
+            index, size, type, normalized, stride, pointer);
+        return Value{};
+      })});
+  functions_.Set("viewport", Value{std::make_shared<Function>(
+      [this](Value self, ValueSpan args) -> Value {
+        GLint x = static_cast<GLint>(args[0].ToNumber());
+        GLint y = static_cast<GLint>(args[1].ToNumber());
+        GLsizei width = static_cast<GLsizei>(args[2].ToNumber());
+        GLsizei height = static_cast<GLsizei>(args[3].ToNumber());
+        Call<GLint, GLint, GLsizei, GLsizei>(glViewport_, x, y, width, height);
+        return Value{};
+      })});
+}
+
+Value GL::Get(const std::string &key) {
+  if (Value* f = functions_.Find(key)) {
+    return *f;
   }
   fprintf(stderr, "%s is not implemented\n", key.c_str());
   return Value{};
@@ -1035,5 +996,19 @@ std::string GL::ToString() const {
   return "GL";
 }
 
+void GL::SetBatching(bool batching) {
+  if (!batching) {
+    Flush();
+  }
+  batching_ = batching;
+}
+
+void GL::Flush() {
+  for (const Command& command : commands_) {
+    command.invoke(command);
+  }
+  commands_.clear();
+}
+
 }
 `))
@@ -47,29 +47,24 @@ var importFuncBodies = map[string]string{
   go_->GetRandomBytes(slice);`,
 
 	// func finalizeRef(v ref)
-	"syscall/js.finalizeRef": `  int32_t id = static_cast<int32_t>(go_->mem_->LoadUint32(local0_ + 8));
-  go_->go_ref_counts_[id]--;
-  if (go_->go_ref_counts_[id] == 0) {
-    Value v = go_->values_[id];
-    std::string i = v.Inspect();
-    go_->values_[id] = Value{};
-    go_->ids_.erase(v);
-    go_->id_pool_.push(id);
-  }`,
+	"syscall/js.finalizeRef": `  go_->FinalizeRef(static_cast<int32_t>(go_->mem_->LoadUint32(local0_ + 8)));`,
 
 	// func stringVal(value string) ref
 	"syscall/js.stringVal": `  go_->StoreValue(local0_ + 24, Value{go_->mem_->LoadString(local0_ + 8)});`,
 
 	// func valueGet(v ref, p string) ref
-	"syscall/js.valueGet": `  Value result = Value::ReflectGet(go_->LoadValue(local0_ + 8), go_->mem_->LoadString(local0_ + 16));
+	"syscall/js.valueGet": `  int32_t parent = go_->LoadRefId(local0_ + 8);
+  const std::string& key = go_->LoadPropertyName(local0_ + 16);
+  Value result = Value::ReflectGet(go_->LoadValue(local0_ + 8), key);
   local0_ = go_->inst_->getsp();
-  go_->StoreValue(local0_ + 32, result);`,
+  // The origin is recorded so that a snapshot can get the property again.
+  go_->SetRefOrigin(go_->StoreValue(local0_ + 32, result), parent, key);`,
 
 	// func valueSet(v ref, p string, x ref)
-	"syscall/js.valueSet": `  Value::ReflectSet(go_->LoadValue(local0_ + 8), go_->mem_->LoadString(local0_ + 16), go_->LoadValue(local0_ + 32));`,
+	"syscall/js.valueSet": `  Value::ReflectSet(go_->LoadValue(local0_ + 8), go_->LoadPropertyName(local0_ + 16), go_->LoadValue(local0_ + 32));`,
 
 	// func valueDelete(v ref, p string)
-	"syscall/js.valueDelete": `  Value::ReflectDelete(go_->LoadValue(local0_ + 8), go_->mem_->LoadString(local0_ + 16));`,
+	"syscall/js.valueDelete": `  Value::ReflectDelete(go_->LoadValue(local0_ + 8), go_->LoadPropertyName(local0_ + 16));`,
 
 	// func valueIndex(v ref, i int) ref
 	"syscall/js.valueIndex": `  go_->StoreValue(local0_ + 24, Value::ReflectGet(go_->LoadValue(local0_ + 8), std::to_string(go_->mem_->LoadInt64(local0_ + 16))));`,
@@ -79,17 +74,15 @@ var importFuncBodies = map[string]string{
 
 	// func valueCall(v ref, m string, args []ref) (ref, bool)
 	"syscall/js.valueCall": `  Value v = go_->LoadValue(local0_ + 8);
-  Value m = Value::ReflectGet(v, go_->mem_->LoadString(local0_ + 16));
-  std::vector<Value> args = go_->LoadSliceOfValues(local0_ + 32);
-  Value result = Value::ReflectApply(m, v, args);
+  Value m = Value::ReflectGet(v, go_->LoadPropertyName(local0_ + 16));
+  Value result = go_->ApplySliceOfValues(m, v, local0_ + 32);
   local0_ = go_->inst_->getsp();
   go_->StoreValue(local0_ + 56, result);
   go_->mem_->StoreInt8(local0_ + 64, 1);`,
 
 	// func valueInvoke(v ref, args []ref) (ref, bool)
 	"syscall/js.valueInvoke": `  Value v = go_->LoadValue(local0_ + 8);
-  std::vector<Value> args = go_->LoadSliceOfValues(local0_ + 16);
-  Value result = Value::ReflectApply(v, Value{}, args);
+  Value result = go_->ApplySliceOfValues(v, Value{}, local0_ + 16);
   local0_ = go_->inst_->getsp();
   go_->StoreValue(local0_ + 40, result);
   go_->mem_->StoreInt8(local0_ + 48, 1);`,
@@ -97,7 +90,7 @@ var importFuncBodies = map[string]string{
 	// func valueNew(v ref, args []ref) (ref, bool)
 	"syscall/js.valueNew": `  Value v = go_->LoadValue(local0_ + 8);
   std::vector<Value> args = go_->LoadSliceOfValues(local0_ + 16);
-  Value result = Value::ReflectConstruct(v, args);
+  Value result = Value::ReflectConstruct(v, std::move(args));
   if (!result.IsUndefined()) {
     local0_ = go_->inst_->getsp();
     go_->StoreValue(local0_ + 40, result);
@@ -134,7 +127,10 @@ var importFuncBodies = map[string]string{
     return;
   }
   BytesSpan srcbs = src.ToBytes();
-  std::memcpy(dst.begin(), srcbs.begin(), std::min(srcbs.size(), dst.size()));
+  // src might be a view of the memory by go2cppMemoryView.
+  if (dst.begin() != srcbs.begin()) {
+    std::memmove(dst.begin(), srcbs.begin(), std::min(srcbs.size(), dst.size()));
+  }
   go_->mem_->StoreInt64(local0_ + 40, static_cast<int64_t>(dst.size()));
   go_->mem_->StoreInt8(local0_ + 48, 1);`,
 
@@ -146,7 +142,10 @@ var importFuncBodies = map[string]string{
     return;
   }
   BytesSpan dstbs = dst.ToBytes();
-  std::memcpy(dstbs.begin(), src.begin(), std::min(src.size(), dstbs.size()));
+  // dst might be a view of the memory by go2cppMemoryView.
+  if (dstbs.begin() != src.begin()) {
+    std::memmove(dstbs.begin(), src.begin(), std::min(src.size(), dstbs.size()));
+  }
   go_->mem_->StoreInt64(local0_ + 40, static_cast<int64_t>(dstbs.size()));
   go_->mem_->StoreInt8(local0_ + 48, 1);`,
 
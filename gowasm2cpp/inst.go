@@ -4,9 +4,10 @@ package gowasm2cpp
 
 import (
 	"fmt"
-	"os"
-	"path/filepath"
+	"regexp"
+	"runtime"
 	"sort"
+	"strings"
 	"text/template"
 
 	"golang.org/x/sync/errgroup"
@@ -19,9 +20,119 @@ func min(a, b int) int {
 	return b
 }
 
-func writeInst(dir string, incpath string, namespace string, importFuncs, funcs []*wasmFunc, exports []*wasmExport, globals []*wasmGlobal, types []*wasmType, tables [][]uint32) error {
-	const groupSize = 64
+// callRe matches a call of a generated function, which always takes the Inst as the first argument.
+var callRe = regexp.MustCompile(`\b([A-Za-z_][A-Za-z0-9_]*)\(inst\b`)
 
+// forwardDecl returns the declaration of the function without the comments.
+func forwardDecl(f *wasmFunc) (string, error) {
+	decl, err := f.CppDecl("", false, false)
+	if err != nil {
+		return "", err
+	}
+	var lines []string
+	for _, l := range strings.Split(decl, "\n") {
+		if strings.HasPrefix(l, "//") {
+			continue
+		}
+		lines = append(lines, l)
+	}
+	return strings.Join(lines, "\n"), nil
+}
+
+// forwardDecls returns the sorted declarations of the functions.
+func forwardDecls(funcs map[*wasmFunc]struct{}) ([]string, error) {
+	var decls []string
+	for f := range funcs {
+		d, err := forwardDecl(f)
+		if err != nil {
+			return nil, err
+		}
+		decls = append(decls, d)
+	}
+	sort.Strings(decls)
+	return decls, nil
+}
+
+type instShard struct {
+	// Name is the file name, which is inst.funcs.<index>.cpp if empty.
+	Name  string
+	Funcs []*wasmFunc
+	Impls []string
+	Size  int
+}
+
+// splitShards splits the functions sorted by names into at most n shards of similar sizes of the emitted code.
+// The functions in a shard are contiguous so that a change in a function's size moves only the boundaries near it.
+//
+// prevBoundaries is the names of the first functions of the shards in the previous generation. If the boundaries
+// still make the shards balanced enough, the boundaries are reused so that each function stays in the same shard.
+//
+// splitShards returns the shards and their boundaries.
+func splitShards(funcs []*wasmFunc, impls []string, n int, prevBoundaries []string) ([]*instShard, []string) {
+	total := 0
+	for _, impl := range impls {
+		total += len(impl)
+	}
+
+	if len(prevBoundaries) == n {
+		if shards, ok := splitShardsByBoundaries(funcs, impls, prevBoundaries, total); ok {
+			return shards, prevBoundaries
+		}
+	}
+
+	var shards []*instShard
+	var boundaries []string
+	cur := &instShard{}
+	acc := 0
+	for i, f := range funcs {
+		if len(cur.Funcs) == 0 {
+			boundaries = append(boundaries, f.Wasm.Name)
+		}
+		cur.Funcs = append(cur.Funcs, f)
+		cur.Impls = append(cur.Impls, impls[i])
+		cur.Size += len(impls[i])
+		acc += len(impls[i])
+		if len(shards) < n-1 && acc*n >= total*(len(shards)+1) {
+			shards = append(shards, cur)
+			cur = &instShard{}
+		}
+	}
+	if len(cur.Funcs) > 0 {
+		shards = append(shards, cur)
+	}
+	return shards, boundaries
+}
+
+// splitShardsByBoundaries splits the functions by the boundaries. splitShardsByBoundaries returns false if a shard
+// becomes more than twice as large as the average.
+func splitShardsByBoundaries(funcs []*wasmFunc, impls []string, boundaries []string, total int) ([]*instShard, bool) {
+	shards := make([]*instShard, len(boundaries))
+	for i := range shards {
+		shards[i] = &instShard{}
+	}
+	for i, f := range funcs {
+		// The first shard also has the functions before the first boundary.
+		idx := sort.Search(len(boundaries), func(j int) bool {
+			return boundaries[j] > f.Wasm.Name
+		}) - 1
+		if idx < 0 {
+			idx = 0
+		}
+		s := shards[idx]
+		s.Funcs = append(s.Funcs, f)
+		s.Impls = append(s.Impls, impls[i])
+		s.Size += len(impls[i])
+	}
+	for _, s := range shards {
+		if s.Size*len(shards) > total*2 {
+			return nil, false
+		}
+	}
+	return shards, true
+}
+
+// writeInst writes the files for the Inst, and returns the boundaries of the shards.
+func writeInst(dir *outputDir, incpath string, namespace string, importFuncs, funcs []*wasmFunc, exports []*wasmExport, globals []*wasmGlobal, types []*wasmType, prevBoundaries []string, options *Options) ([]string, error) {
 	sort.Slice(funcs, func(a, b int) bool {
 		return funcs[a].Wasm.Name < funcs[b].Wasm.Name
 	})
@@ -29,137 +140,284 @@ func writeInst(dir string, incpath string, namespace string, importFuncs, funcs
 		return exports[a].Name < exports[b].Name
 	})
 
-	var g errgroup.Group
-	g.Go(func() error {
-		f, err := os.Create(filepath.Join(dir, "inst.h"))
-		if err != nil {
-			return err
+	// Generate the function bodies first to know their sizes.
+	impls := make([]string, len(funcs))
+	{
+		var g errgroup.Group
+		workers := runtime.NumCPU()
+		for w := 0; w < workers; w++ {
+			w := w
+			g.Go(func() error {
+				for i := w; i < len(funcs); i += workers {
+					impl, err := funcs[i].CppImpl("", "")
+					if err != nil {
+						return err
+					}
+					impls[i] = impl
+				}
+				return nil
+			})
 		}
-		defer f.Close()
-
-		m := 0
-		for _, t := range tables {
-			if m < len(t) {
-				m = len(t)
-			}
-		}
-		if err := instHTmpl.Execute(f, struct {
-			IncludeGuard        string
-			IncludePath         string
-			Namespace           string
-			ImportFuncs         []*wasmFunc
-			Exports             []*wasmExport
-			Funcs               []*wasmFunc
-			Types               []*wasmType
-			Globals             []*wasmGlobal
-			NumFuncs            int
-			NumTable            int
-			NumMaxTableElements int
-		}{
-			IncludeGuard:        includeGuard(namespace) + "_INST_H",
-			IncludePath:         incpath,
-			Namespace:           namespace,
-			ImportFuncs:         importFuncs,
-			Exports:             exports,
-			Funcs:               funcs,
-			Types:               types,
-			Globals:             globals,
-			NumFuncs:            len(importFuncs) + len(funcs),
-			NumTable:            len(tables),
-			NumMaxTableElements: m,
-		}); err != nil {
-			return err
+		if err := g.Wait(); err != nil {
+			return nil, err
 		}
-		return nil
-	})
+	}
 
-	groups := map[byte][]*wasmFunc{}
+	idents := map[string]*wasmFunc{}
 	for _, f := range funcs {
-		n := f.Wasm.Name
-		g := n[0]
-		groups[g] = append(groups[g], f)
+		idents[f.Identifier()] = f
+	}
+
+	// The hot functions are in one shard so that the C++ compiler can inline them into each other, and the cold
+	// functions are in another shard so that they don't dilute the others.
+	var normalFuncs []*wasmFunc
+	var normalImpls []string
+	hotShard := &instShard{Name: "inst.funcs.hot.cpp"}
+	coldShard := &instShard{Name: "inst.funcs.cold.cpp"}
+	for i, f := range funcs {
+		var s *instShard
+		switch f.Temperature {
+		case temperatureHot:
+			s = hotShard
+		case temperatureCold:
+			s = coldShard
+		default:
+			normalFuncs = append(normalFuncs, f)
+			normalImpls = append(normalImpls, impls[i])
+			continue
+		}
+		s.Funcs = append(s.Funcs, f)
+		s.Impls = append(s.Impls, impls[i])
+		s.Size += len(impls[i])
+	}
+
+	shards, boundaries := splitShards(normalFuncs, normalImpls, options.shards(), prevBoundaries)
+	for _, s := range []*instShard{hotShard, coldShard} {
+		if len(s.Funcs) > 0 {
+			shards = append(shards, s)
+		}
 	}
 
-	for gp, fs := range groups {
-		gp := gp
-		fs := fs
+	var g errgroup.Group
+	for i, shard := range shards {
+		i := i
+		shard := shard
 		g.Go(func() error {
-			f, err := os.Create(filepath.Join(dir, fmt.Sprintf("inst.funcs.%c.cpp", gp)))
+			// Declare the functions in this shard and the functions called from this shard.
+			used := map[*wasmFunc]struct{}{}
+			useTables := false
+			for _, f := range shard.Funcs {
+				used[f] = struct{}{}
+			}
+			for _, impl := range shard.Impls {
+				for _, m := range callRe.FindAllStringSubmatch(impl, -1) {
+					if f, ok := idents[m[1]]; ok {
+						used[f] = struct{}{}
+					}
+				}
+				if !useTables && (strings.Contains(impl, "LookupTableType") || strings.Contains(impl, "TrapIndirectCall")) {
+					useTables = true
+				}
+			}
+			decls, err := forwardDecls(used)
 			if err != nil {
 				return err
 			}
-			defer f.Close()
+
+			name := shard.Name
+			if name == "" {
+				name = fmt.Sprintf("inst.funcs.%d.cpp", i)
+			}
+			f := dir.Create(name)
 
 			if err := instFuncCppTmpl.Execute(f, struct {
 				IncludePath string
 				Namespace   string
-				Funcs       []*wasmFunc
+				PCH         bool
+				UseTables   bool
+				Profiler    bool
+				Decls       []string
+				Impls       []string
 			}{
 				IncludePath: incpath,
 				Namespace:   namespace,
-				Funcs:       fs,
+				PCH:         options.PCH,
+				UseTables:   useTables,
+				Profiler:    options.Profiler,
+				Decls:       decls,
+				Impls:       shard.Impls,
 			}); err != nil {
 				return err
 			}
+			if err := f.Close(); err != nil {
+				return err
+			}
 			return nil
 		})
 	}
 
 	// exports
 	g.Go(func() error {
-		f, err := os.Create(filepath.Join(dir, "inst.exports.cpp"))
+		used := map[*wasmFunc]struct{}{}
+		for _, e := range exports {
+			used[e.Funcs[e.Index]] = struct{}{}
+		}
+		decls, err := forwardDecls(used)
 		if err != nil {
 			return err
 		}
-		defer f.Close()
+
+		f := dir.Create("inst.exports.cpp")
 
 		if err := instExportsCppTmpl.Execute(f, struct {
 			IncludePath string
 			Namespace   string
+			Decls       []string
 			Exports     []*wasmExport
 		}{
 			IncludePath: incpath,
 			Namespace:   namespace,
+			Decls:       decls,
 			Exports:     exports,
 		}); err != nil {
 			return err
 		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+		return nil
+	})
+
+	g.Go(func() error {
+		f := dir.Create("inst.h")
+
+		if err := instHTmpl.Execute(f, struct {
+			IncludeGuard string
+			IncludePath  string
+			Namespace    string
+			ImportFuncs  []*wasmFunc
+			Exports      []*wasmExport
+			Globals      []*wasmGlobal
+		}{
+			IncludeGuard: includeGuard(namespace) + "_INST_H",
+			IncludePath:  incpath,
+			Namespace:    namespace,
+			ImportFuncs:  importFuncs,
+			Exports:      exports,
+			Globals:      globals,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
 		return nil
 	})
 
+	g.Go(func() error {
+		f := dir.Create("inst.tables.h")
+
+		if err := instTablesHTmpl.Execute(f, struct {
+			IncludeGuard string
+			IncludePath  string
+			Namespace    string
+			Types        []*wasmType
+		}{
+			IncludeGuard: includeGuard(namespace) + "_INST_TABLES_H",
+			IncludePath:  incpath,
+			Namespace:    namespace,
+			Types:        types,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+		return nil
+	})
+
+	if options.PCH {
+		g.Go(func() error {
+			f := dir.Create("inst.pch.h")
+
+			if err := instPCHHTmpl.Execute(f, struct {
+				IncludeGuard string
+				IncludePath  string
+				Profiler     bool
+			}{
+				IncludeGuard: includeGuard(namespace) + "_INST_PCH_H",
+				IncludePath:  incpath,
+				Profiler:     options.Profiler,
+			}); err != nil {
+				return err
+			}
+			if err := f.Close(); err != nil {
+				return err
+			}
+			return nil
+		})
+	}
+
 	// init
 	g.Go(func() error {
-		f, err := os.Create(filepath.Join(dir, "inst.init.cpp"))
+		f := dir.Create("inst.init.cpp")
+
+		if err := instInitCppTmpl.Execute(f, struct {
+			IncludePath string
+			Namespace   string
+			Globals     []*wasmGlobal
+		}{
+			IncludePath: incpath,
+			Namespace:   namespace,
+			Globals:     globals,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+		return nil
+	})
+
+	// tables
+	g.Go(func() error {
+		used := map[*wasmFunc]struct{}{}
+		for _, t := range types {
+			for _, f := range t.IndirectTable() {
+				if f != nil {
+					used[f] = struct{}{}
+				}
+			}
+		}
+		decls, err := forwardDecls(used)
 		if err != nil {
 			return err
 		}
-		defer f.Close()
 
-		if err := instInitCppTmpl.Execute(f, struct {
+		f := dir.Create("inst.tables.cpp")
+
+		if err := instTablesCppTmpl.Execute(f, struct {
 			IncludePath string
 			Namespace   string
-			ImportFuncs []*wasmFunc
-			Funcs       []*wasmFunc
+			Decls       []string
 			Types       []*wasmType
-			Tables      [][]uint32
-			Globals     []*wasmGlobal
 		}{
 			IncludePath: incpath,
 			Namespace:   namespace,
-			ImportFuncs: importFuncs,
-			Funcs:       funcs,
+			Decls:       decls,
 			Types:       types,
-			Tables:      tables,
-			Globals:     globals,
 		}); err != nil {
 			return err
 		}
+		if err := f.Close(); err != nil {
+			return err
+		}
 		return nil
 	})
 	if err := g.Wait(); err != nil {
-		return err
+		return nil, err
 	}
-	return nil
+	return boundaries, nil
 }
 
 var instHTmpl = template.Must(template.New("inst.h").Parse(`// Code generated by go2cpp. DO NOT EDIT.
@@ -169,6 +427,20 @@ var instHTmpl = template.Must(template.New("inst.h").Parse(`// Code generated by
 
 #include <cstdint>
 
+// GO2CPP_HOT and GO2CPP_COLD are the attributes of the hot and cold functions in a profile.
+#if !defined(GO2CPP_HOT)
+#if defined(__GNUC__)
+#define GO2CPP_HOT __attribute__((hot))
+#define GO2CPP_COLD __attribute__((cold, noinline))
+#elif defined(_MSC_VER)
+#define GO2CPP_HOT
+#define GO2CPP_COLD __declspec(noinline)
+#else
+#define GO2CPP_HOT
+#define GO2CPP_COLD
+#endif
+#endif
+
 namespace {{.Namespace}} {
 
 class Mem;
@@ -183,23 +455,21 @@ public:
 
 class Inst {
 public:
+  // kNumGlobals is the number of the globals.
+  static constexpr int32_t kNumGlobals = {{len .Globals}};
+
   Inst(Mem* mem, Import* import);
 
 {{range $value := .Exports}}{{$value.CppDecl "  "}}
 {{end}}
-private:
-{{range $value := .Types}}  using Type{{.Index}} = {{.Cpp}};
-{{end}}
-  union Func {
-{{range $value := .Types}}    Type{{.Index}} type{{.Index}}_;
-{{end}}  };
-
-{{range $value := .Funcs}}{{$value.CppDecl "  " false false}}
+  // GetGlobals and SetGlobals copy the bits of the globals, e.g. for a snapshot. globals must have kNumGlobals
+  // elements.
+  void GetGlobals(uint64_t* globals) const;
+  void SetGlobals(const uint64_t* globals);
 
-{{end}}  Mem* mem_;
+  // The members below are accessed by the generated functions.
+  Mem* mem_;
   Import* import_;
-  Func funcs_[{{.NumFuncs}}];
-  uint32_t table_[{{.NumTable}}][{{.NumMaxTableElements}}];
 
 {{range $value := .Globals}}  {{$value.Cpp}}
 {{end}}};
@@ -209,19 +479,77 @@ private:
 #endif  // {{.IncludeGuard}}
 `))
 
-var instFuncCppTmpl = template.Must(template.New("inst.funcs.cpp").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+var instTablesHTmpl = template.Must(template.New("inst.tables.h").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#ifndef {{.IncludeGuard}}
+#define {{.IncludeGuard}}
+
+#include "{{.IncludePath}}inst.h"
+
+namespace {{.Namespace}} {
+
+{{range $value := .Types}}using Type{{.Index}} = {{.Cpp}};
+{{end}}
+// TrapIndirectCall is called when call_indirect's signature does not match.
+[[noreturn]] void TrapIndirectCall();
+
+// table_typeN_ is the functions for call_indirect with TypeN, from the first to the last function with TypeN in the
+// table. The tables are constant data in inst.tables.cpp shared by all the instances.
+{{range $value := .Types}}{{if .IndirectTable}}
+extern const Type{{.Index}} table_type{{.Index}}_[{{len .IndirectTable}}];
+
+inline Type{{.Index}} LookupTableType{{.Index}}(uint32_t index) {
+  uint32_t i = index - {{.IndirectTableOffset}}u;
+  if (i >= {{len .IndirectTable}}u) {
+    TrapIndirectCall();
+  }
+  return table_type{{.Index}}_[i];
+}
+{{end}}{{end}}
+}
+
+#endif  // {{.IncludeGuard}}
+`))
+
+// instPCHHTmpl is the header to be precompiled. Each inst.funcs.*.cpp includes only this header in the PCH mode.
+var instPCHHTmpl = template.Must(template.New("inst.pch.h").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#ifndef {{.IncludeGuard}}
+#define {{.IncludeGuard}}
 
 #include "{{.IncludePath}}inst.h"
+#include "{{.IncludePath}}inst.tables.h"
 
 #include "{{.IncludePath}}bits.h"
+#include "{{.IncludePath}}intrinsics.h"
 #include "{{.IncludePath}}mem.h"
-
+{{if .Profiler}}#include "{{.IncludePath}}profiler.h"
+{{end}}
 #include <cassert>
 #include <cmath>
 
+#endif  // {{.IncludeGuard}}
+`))
+
+var instFuncCppTmpl = template.Must(template.New("inst.funcs.cpp").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+{{if .PCH}}#include "{{.IncludePath}}inst.pch.h"
+{{else}}#include "{{.IncludePath}}inst.h"
+{{if .UseTables}}#include "{{.IncludePath}}inst.tables.h"
+{{end}}
+#include "{{.IncludePath}}bits.h"
+#include "{{.IncludePath}}intrinsics.h"
+#include "{{.IncludePath}}mem.h"
+{{if .Profiler}}#include "{{.IncludePath}}profiler.h"
+{{end}}
+#include <cassert>
+#include <cmath>
+{{end}}
 namespace {{.Namespace}} {
 
-{{range $value := .Funcs}}{{$value.CppImpl "Inst" ""}}
+{{range $value := .Decls}}{{$value}}
+{{end}}
+{{range $value := .Impls}}{{$value}}
 {{end}}}
 `))
 
@@ -231,6 +559,8 @@ var instExportsCppTmpl = template.Must(template.New("inst.exports.cpp").Parse(`/
 
 namespace {{.Namespace}} {
 
+{{range $value := .Decls}}{{$value}}
+{{end}}
 {{range $value := .Exports}}{{$value.CppImpl ""}}
 {{end}}}
 `))
@@ -238,6 +568,11 @@ namespace {{.Namespace}} {
 var instInitCppTmpl = template.Must(template.New("inst.init.cpp").Parse(`// Code generated by go2cpp. DO NOT EDIT.
 
 #include "{{.IncludePath}}inst.h"
+#include "{{.IncludePath}}inst.tables.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 
 namespace {{.Namespace}} {
 
@@ -245,13 +580,52 @@ Import::~Import() = default;
 
 Inst::Inst(Mem* mem, Import* import)
     : mem_{mem},
-      import_{import},
-      table_{
-{{range $value := .Tables}}        { {{- range $value2 := $value}}{{$value2}}, {{end}} },
-{{end}}      } {
-{{range $value := .ImportFuncs}}  funcs_[{{.Index}}].type0_ = nullptr;
-{{end}}{{range $value := .Funcs}}  funcs_[{{.Index}}].type{{.Type.Index}}_ = &Inst::{{.Identifier}};
-{{end}}}
+      import_{import} {
+}
+
+constexpr int32_t Inst::kNumGlobals;
+
+void Inst::GetGlobals(uint64_t* globals) const {
+{{- range $value := .Globals}}
+  globals[{{.Index}}] = 0;
+  std::memcpy(&globals[{{.Index}}], &global{{.Index}}_, sizeof(global{{.Index}}_));
+{{- end}}
+}
 
+void Inst::SetGlobals(const uint64_t* globals) {
+{{- range $value := .Globals}}
+  std::memcpy(&global{{.Index}}_, &globals[{{.Index}}], sizeof(global{{.Index}}_));
+{{- end}}
+}
+
+void TrapIndirectCall() {
+  std::cerr << "call_indirect: signature mismatch" << std::endl;
+  std::exit(1);
+}
+
+}
+`))
+
+var instTablesCppTmpl = template.Must(template.New("inst.tables.cpp").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#include "{{.IncludePath}}inst.h"
+#include "{{.IncludePath}}inst.tables.h"
+
+namespace {{.Namespace}} {
+
+{{range $value := .Decls}}{{$value}}
+{{end}}
+namespace {
+
+{{range $value := .Types}}{{if .IndirectTable}}{{.CppTrap}}
+
+{{end}}{{end}}}
+
+// The tables are constexpr so that they are initialized at compile time without any code at startup.
+{{range $type := .Types}}{{if .IndirectTable}}
+constexpr Type{{$type.Index}} table_type{{$type.Index}}_[] = {
+{{range $value := .IndirectTable}}  {{if $value}}{{$value.Identifier}}{{else}}TrapType{{$type.Index}}{{end}},
+{{end}}};
+{{end}}{{end}}
 }
 `))
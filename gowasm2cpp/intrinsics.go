@@ -0,0 +1,430 @@
+// SPDX-License-Identifier: Apache-2.0
+
+package gowasm2cpp
+
+import (
+	"text/template"
+)
+
+// builtinIntrinsics maps Go function names to the C++ bodies replacing the translated bodies. See also
+// Options.Intrinsics.
+var builtinIntrinsics = map[string]string{
+	"memcmp":           `  return static_cast<int32_t>(mem_->Memcmp(local0_, local1_, local2_));`,
+	"memeqbody":        `  return static_cast<int64_t>(mem_->Memcmp(local0_, local1_, local2_) == 0);`,
+	"memchr":           `  return static_cast<int32_t>(mem_->Memchr(local0_, local1_, local2_));`,
+	"cmpbody":          `  return mem_->Compare(static_cast<int32_t>(local0_), static_cast<int32_t>(local1_), static_cast<int32_t>(local2_), static_cast<int32_t>(local3_));`,
+	"runtime.wasmMove": `  mem_->Memmove(local0_, local1_, local2_ * 8);`,
+	"runtime.wasmZero": `  mem_->Memset(local0_, 0, local1_ * 8);`,
+
+	// The Go functions below take the arguments and the results on the Go stack: the arguments start at SP+8, and
+	// the function pops the return address by adding 8 to SP.
+	"internal_bytealg.Count":         goStackFunctionBody(`mem_->StoreInt64(sp + 40, mem_->Count(static_cast<int32_t>(mem_->LoadInt64(sp + 8)), static_cast<int32_t>(mem_->LoadInt64(sp + 16)), mem_->LoadUint8(sp + 32)));`),
+	"internal_bytealg.CountString":   goStackFunctionBody(`mem_->StoreInt64(sp + 32, mem_->Count(static_cast<int32_t>(mem_->LoadInt64(sp + 8)), static_cast<int32_t>(mem_->LoadInt64(sp + 16)), mem_->LoadUint8(sp + 24)));`),
+	"unicode_utf8.RuneCount":         goStackFunctionBody(`mem_->StoreInt64(sp + 32, mem_->RuneCount(static_cast<int32_t>(mem_->LoadInt64(sp + 8)), static_cast<int32_t>(mem_->LoadInt64(sp + 16))));`),
+	"unicode_utf8.RuneCountInString": goStackFunctionBody(`mem_->StoreInt64(sp + 24, mem_->RuneCount(static_cast<int32_t>(mem_->LoadInt64(sp + 8)), static_cast<int32_t>(mem_->LoadInt64(sp + 16))));`),
+	"unicode_utf8.Valid":             goStackFunctionBody(`mem_->StoreInt8(sp + 32, mem_->ValidUTF8(static_cast<int32_t>(mem_->LoadInt64(sp + 8)), static_cast<int32_t>(mem_->LoadInt64(sp + 16))));`),
+	"unicode_utf8.ValidString":       goStackFunctionBody(`mem_->StoreInt8(sp + 24, mem_->ValidUTF8(static_cast<int32_t>(mem_->LoadInt64(sp + 8)), static_cast<int32_t>(mem_->LoadInt64(sp + 16))));`),
+
+	"crypto_sha256.block":        goStackFunctionBody(`Intrinsics::SHA256Block(mem_, sp);`),
+	"crypto_sha256.blockGeneric": goStackFunctionBody(`Intrinsics::SHA256Block(mem_, sp);`),
+	"hash_crc32.simpleUpdate":    goStackFunctionBody(`Intrinsics::CRC32Update(mem_, sp, 1);`),
+	"hash_crc32.slicingUpdate":   goStackFunctionBody(`Intrinsics::CRC32Update(mem_, sp, 8);`),
+	"math_bits.Mul64":            goStackFunctionBody(`Intrinsics::Mul64(mem_, sp);`),
+
+	// On Wasm, math/big's assembly functions like addVV jump to the Go functions like addVV_g with the same frame.
+	"math_big.addVV":       goStackFunctionBody(`Intrinsics::AddVV(mem_, sp);`),
+	"math_big.addVV_g":     goStackFunctionBody(`Intrinsics::AddVV(mem_, sp);`),
+	"math_big.subVV":       goStackFunctionBody(`Intrinsics::SubVV(mem_, sp);`),
+	"math_big.subVV_g":     goStackFunctionBody(`Intrinsics::SubVV(mem_, sp);`),
+	"math_big.addVW":       goStackFunctionBody(`Intrinsics::AddVW(mem_, sp);`),
+	"math_big.addVW_g":     goStackFunctionBody(`Intrinsics::AddVW(mem_, sp);`),
+	"math_big.subVW":       goStackFunctionBody(`Intrinsics::SubVW(mem_, sp);`),
+	"math_big.subVW_g":     goStackFunctionBody(`Intrinsics::SubVW(mem_, sp);`),
+	"math_big.mulAddVWW":   goStackFunctionBody(`Intrinsics::MulAddVWW(mem_, sp);`),
+	"math_big.mulAddVWW_g": goStackFunctionBody(`Intrinsics::MulAddVWW(mem_, sp);`),
+	"math_big.addMulVVW":   goStackFunctionBody(`Intrinsics::AddMulVVW(mem_, sp);`),
+	"math_big.addMulVVW_g": goStackFunctionBody(`Intrinsics::AddMulVVW(mem_, sp);`),
+}
+
+// goStackFunctionBody returns a body of a Go function that never calls other functions. stmt can use the stack
+// pointer as sp.
+func goStackFunctionBody(stmt string) string {
+	return `  int32_t sp = global0_;
+  ` + stmt + `
+  global0_ = sp + 8;
+  return 0;`
+}
+
+func writeIntrinsics(dir *outputDir, incpath string, namespace string) error {
+	{
+		f := dir.Create("intrinsics.h")
+
+		if err := intrinsicsHTmpl.Execute(f, struct {
+			IncludeGuard string
+			IncludePath  string
+			Namespace    string
+		}{
+			IncludeGuard: includeGuard(namespace) + "_INTRINSICS_H",
+			IncludePath:  incpath,
+			Namespace:    namespace,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+	}
+	{
+		f := dir.Create("intrinsics.cpp")
+
+		if err := intrinsicsCppTmpl.Execute(f, struct {
+			IncludePath string
+			Namespace   string
+		}{
+			IncludePath: incpath,
+			Namespace:   namespace,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+var intrinsicsHTmpl = template.Must(template.New("intrinsics.h").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#ifndef {{.IncludeGuard}}
+#define {{.IncludeGuard}}
+
+#include <cstdint>
+
+namespace {{.Namespace}} {
+
+class Mem;
+
+// Intrinsics has the native implementations of Go functions. Each function reads the arguments from the Go stack
+// frame at sp, and writes the results to the frame.
+class Intrinsics {
+public:
+  // SHA256Block is crypto/sha256.block(dig *digest, p []byte).
+  static void SHA256Block(Mem* mem, int32_t sp);
+
+  // CRC32Update is hash/crc32.simpleUpdate(crc uint32, tab *Table, p []byte) uint32 if tables is 1, or
+  // slicingUpdate(crc uint32, tab *slicing8Table, p []byte) uint32 if tables is 8.
+  static void CRC32Update(Mem* mem, int32_t sp, int tables);
+
+  // Mul64 is math/bits.Mul64(x, y uint64) (hi, lo uint64).
+  static void Mul64(Mem* mem, int32_t sp);
+
+  // AddVV is math/big.addVV(z, x, y []Word) (c Word).
+  static void AddVV(Mem* mem, int32_t sp);
+
+  // SubVV is math/big.subVV(z, x, y []Word) (c Word).
+  static void SubVV(Mem* mem, int32_t sp);
+
+  // AddVW is math/big.addVW(z, x []Word, y Word) (c Word).
+  static void AddVW(Mem* mem, int32_t sp);
+
+  // SubVW is math/big.subVW(z, x []Word, y Word) (c Word).
+  static void SubVW(Mem* mem, int32_t sp);
+
+  // MulAddVWW is math/big.mulAddVWW(z, x []Word, y, r Word) (c Word).
+  static void MulAddVWW(Mem* mem, int32_t sp);
+
+  // AddMulVVW is math/big.addMulVVW(z, x []Word, y Word) (c Word).
+  static void AddMulVVW(Mem* mem, int32_t sp);
+};
+
+}
+
+#endif  // {{.IncludeGuard}}
+`))
+
+var intrinsicsCppTmpl = template.Must(template.New("intrinsics.cpp").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#include "{{.IncludePath}}intrinsics.h"
+
+#include "{{.IncludePath}}mem.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {{.Namespace}} {
+
+namespace {
+
+void error(const std::string& msg) {
+  std::cerr << msg << std::endl;
+  std::exit(1);
+}
+
+// Bytes returns the pointer to [addr, addr+len) of the linear memory.
+uint8_t* Bytes(Mem* mem, int64_t addr, int64_t len) {
+  BytesSpan span = mem->View(addr, len);
+  if (span.size() != static_cast<size_t>(len)) {
+    error("Intrinsics: out of bounds memory access: address " + std::to_string(addr) + ", length " +
+          std::to_string(len));
+  }
+  return span.begin();
+}
+
+// Slice represents a Go slice of uint64_t in the linear memory.
+struct Slice {
+  Slice(Mem* mem, int32_t addr)
+      : len{mem->LoadInt64(addr + 8)},
+        data{Bytes(mem, mem->LoadInt64(addr), len * 8)} {
+  }
+
+  uint64_t Get(int64_t i) const {
+    uint64_t v;
+    std::memcpy(&v, data + i * 8, 8);
+    return v;
+  }
+
+  void Set(int64_t i, uint64_t v) {
+    std::memcpy(data + i * 8, &v, 8);
+  }
+
+  int64_t len;
+  uint8_t* data;
+};
+
+inline uint64_t Add(uint64_t x, uint64_t y, uint64_t carry, uint64_t* carry_out) {
+  uint64_t sum = x + y + carry;
+  *carry_out = ((x & y) | ((x | y) & ~sum)) >> 63;
+  return sum;
+}
+
+inline uint64_t Sub(uint64_t x, uint64_t y, uint64_t borrow, uint64_t* borrow_out) {
+  uint64_t diff = x - y - borrow;
+  *borrow_out = ((~x & y) | (~(x ^ y) & diff)) >> 63;
+  return diff;
+}
+
+// MulAdd returns the high 64 bits of x*y+c, and sets the low 64 bits to lo.
+inline uint64_t MulAdd(uint64_t x, uint64_t y, uint64_t c, uint64_t* lo) {
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 z = static_cast<unsigned __int128>(x) * y + c;
+  *lo = static_cast<uint64_t>(z);
+  return static_cast<uint64_t>(z >> 64);
+#else
+  // The implementation is copied from the Go standard package math/bits, which is under BSD-style license.
+  const uint64_t mask32 = (1ull << 32) - 1;
+  uint64_t x0 = x & mask32;
+  uint64_t x1 = x >> 32;
+  uint64_t y0 = y & mask32;
+  uint64_t y1 = y >> 32;
+  uint64_t w0 = x0 * y0;
+  uint64_t t = x1 * y0 + (w0 >> 32);
+  uint64_t w1 = t & mask32;
+  uint64_t w2 = t >> 32;
+  w1 += x0 * y1;
+  uint64_t hi = x1 * y1 + w2 + (w1 >> 32);
+  uint64_t l = x * y;
+  uint64_t carry;
+  *lo = Add(l, c, 0, &carry);
+  return hi + carry;
+#endif
+}
+
+inline uint32_t RotateRight(uint32_t x, int k) {
+  return (x >> k) | (x << (32 - k));
+}
+
+const uint32_t kSHA256K[] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+}
+
+void Intrinsics::SHA256Block(Mem* mem, int32_t sp) {
+  constexpr int64_t kChunk = 64;
+
+  int32_t dig = static_cast<int32_t>(mem->LoadInt64(sp + 8));
+  int64_t len = mem->LoadInt64(sp + 24);
+  const uint8_t* p = Bytes(mem, mem->LoadInt64(sp + 16), len);
+
+  // digest.h is the first member of digest.
+  uint32_t h[8];
+  for (int i = 0; i < 8; i++) {
+    h[i] = mem->LoadUint32(dig + i * 4);
+  }
+
+  uint32_t w[64];
+  for (; len >= kChunk; p += kChunk, len -= kChunk) {
+    for (int i = 0; i < 16; i++) {
+      w[i] = (static_cast<uint32_t>(p[i * 4]) << 24) | (static_cast<uint32_t>(p[i * 4 + 1]) << 16) |
+             (static_cast<uint32_t>(p[i * 4 + 2]) << 8) | static_cast<uint32_t>(p[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; i++) {
+      uint32_t v1 = w[i - 2];
+      uint32_t t1 = RotateRight(v1, 17) ^ RotateRight(v1, 19) ^ (v1 >> 10);
+      uint32_t v2 = w[i - 15];
+      uint32_t t2 = RotateRight(v2, 7) ^ RotateRight(v2, 18) ^ (v2 >> 3);
+      w[i] = t1 + w[i - 7] + t2 + w[i - 16];
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int i = 0; i < 64; i++) {
+      uint32_t t1 = hh + (RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25)) + ((e & f) ^ (~e & g)) +
+                    kSHA256K[i] + w[i];
+      uint32_t t2 = (RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      hh = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+  }
+
+  for (int i = 0; i < 8; i++) {
+    mem->StoreInt32(dig + i * 4, static_cast<int32_t>(h[i]));
+  }
+}
+
+void Intrinsics::CRC32Update(Mem* mem, int32_t sp, int tables) {
+  constexpr int64_t kTableSize = 256 * 4;
+  constexpr int64_t kSlicing8Cutoff = 16;
+
+  uint32_t crc = mem->LoadUint32(sp + 8);
+  const uint8_t* tab = Bytes(mem, mem->LoadInt64(sp + 16), kTableSize * tables);
+  int64_t len = mem->LoadInt64(sp + 32);
+  const uint8_t* p = Bytes(mem, mem->LoadInt64(sp + 24), len);
+
+  auto entry = [tab](int table, uint32_t index) -> uint32_t {
+    uint32_t v;
+    std::memcpy(&v, tab + table * kTableSize + index * 4, 4);
+    return v;
+  };
+
+  if (tables == 8 && len >= kSlicing8Cutoff) {
+    crc = ~crc;
+    for (; len > 8; p += 8, len -= 8) {
+      crc ^= static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+             (static_cast<uint32_t>(p[3]) << 24);
+      crc = entry(0, p[7]) ^ entry(1, p[6]) ^ entry(2, p[5]) ^ entry(3, p[4]) ^ entry(4, crc >> 24) ^
+            entry(5, (crc >> 16) & 0xff) ^ entry(6, (crc >> 8) & 0xff) ^ entry(7, crc & 0xff);
+    }
+    crc = ~crc;
+  }
+  if (len > 0) {
+    crc = ~crc;
+    for (int64_t i = 0; i < len; i++) {
+      crc = entry(0, (crc & 0xff) ^ p[i]) ^ (crc >> 8);
+    }
+    crc = ~crc;
+  }
+
+  mem->StoreInt32(sp + 48, static_cast<int32_t>(crc));
+}
+
+void Intrinsics::Mul64(Mem* mem, int32_t sp) {
+  uint64_t lo;
+  uint64_t x = static_cast<uint64_t>(mem->LoadInt64(sp + 8));
+  uint64_t y = static_cast<uint64_t>(mem->LoadInt64(sp + 16));
+  uint64_t hi = MulAdd(x, y, 0, &lo);
+  mem->StoreInt64(sp + 24, static_cast<int64_t>(hi));
+  mem->StoreInt64(sp + 32, static_cast<int64_t>(lo));
+}
+
+void Intrinsics::AddVV(Mem* mem, int32_t sp) {
+  Slice z{mem, sp + 8};
+  Slice x{mem, sp + 32};
+  Slice y{mem, sp + 56};
+  int64_t n = std::min({z.len, x.len, y.len});
+  uint64_t c = 0;
+  for (int64_t i = 0; i < n; i++) {
+    z.Set(i, Add(x.Get(i), y.Get(i), c, &c));
+  }
+  mem->StoreInt64(sp + 80, static_cast<int64_t>(c));
+}
+
+void Intrinsics::SubVV(Mem* mem, int32_t sp) {
+  Slice z{mem, sp + 8};
+  Slice x{mem, sp + 32};
+  Slice y{mem, sp + 56};
+  int64_t n = std::min({z.len, x.len, y.len});
+  uint64_t c = 0;
+  for (int64_t i = 0; i < n; i++) {
+    z.Set(i, Sub(x.Get(i), y.Get(i), c, &c));
+  }
+  mem->StoreInt64(sp + 80, static_cast<int64_t>(c));
+}
+
+void Intrinsics::AddVW(Mem* mem, int32_t sp) {
+  Slice z{mem, sp + 8};
+  Slice x{mem, sp + 32};
+  uint64_t c = static_cast<uint64_t>(mem->LoadInt64(sp + 56));
+  int64_t n = std::min(z.len, x.len);
+  for (int64_t i = 0; i < n; i++) {
+    z.Set(i, Add(x.Get(i), c, 0, &c));
+  }
+  mem->StoreInt64(sp + 64, static_cast<int64_t>(c));
+}
+
+void Intrinsics::SubVW(Mem* mem, int32_t sp) {
+  Slice z{mem, sp + 8};
+  Slice x{mem, sp + 32};
+  uint64_t c = static_cast<uint64_t>(mem->LoadInt64(sp + 56));
+  int64_t n = std::min(z.len, x.len);
+  for (int64_t i = 0; i < n; i++) {
+    z.Set(i, Sub(x.Get(i), c, 0, &c));
+  }
+  mem->StoreInt64(sp + 64, static_cast<int64_t>(c));
+}
+
+void Intrinsics::MulAddVWW(Mem* mem, int32_t sp) {
+  Slice z{mem, sp + 8};
+  Slice x{mem, sp + 32};
+  uint64_t y = static_cast<uint64_t>(mem->LoadInt64(sp + 56));
+  uint64_t c = static_cast<uint64_t>(mem->LoadInt64(sp + 64));
+  int64_t n = std::min(z.len, x.len);
+  for (int64_t i = 0; i < n; i++) {
+    uint64_t lo;
+    c = MulAdd(x.Get(i), y, c, &lo);
+    z.Set(i, lo);
+  }
+  mem->StoreInt64(sp + 72, static_cast<int64_t>(c));
+}
+
+void Intrinsics::AddMulVVW(Mem* mem, int32_t sp) {
+  Slice z{mem, sp + 8};
+  Slice x{mem, sp + 32};
+  uint64_t y = static_cast<uint64_t>(mem->LoadInt64(sp + 56));
+  uint64_t c = 0;
+  int64_t n = std::min(z.len, x.len);
+  for (int64_t i = 0; i < n; i++) {
+    uint64_t z0;
+    uint64_t z1 = MulAdd(x.Get(i), y, z.Get(i), &z0);
+    uint64_t cc;
+    z.Set(i, Add(z0, c, 0, &cc));
+    c = cc + z1;
+  }
+  mem->StoreInt64(sp + 64, static_cast<int64_t>(c));
+}
+
+}
+`))
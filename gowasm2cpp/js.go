@@ -3,18 +3,12 @@
 package gowasm2cpp
 
 import (
-	"os"
-	"path/filepath"
 	"text/template"
 )
 
-func writeJS(dir string, incpath string, namespace string) error {
+func writeJS(dir *outputDir, incpath string, namespace string) error {
 	{
-		f, err := os.Create(filepath.Join(dir, "js.h"))
-		if err != nil {
-			return err
-		}
-		defer f.Close()
+		f := dir.Create("js.h")
 
 		if err := jsHTmpl.Execute(f, struct {
 			IncludeGuard string
@@ -27,13 +21,12 @@ func writeJS(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
-	}
-	{
-		f, err := os.Create(filepath.Join(dir, "js.cpp"))
-		if err != nil {
+		if err := f.Close(); err != nil {
 			return err
 		}
-		defer f.Close()
+	}
+	{
+		f := dir.Create("js.cpp")
 
 		if err := jsCppTmpl.Execute(f, struct {
 			IncludePath string
@@ -44,6 +37,9 @@ func writeJS(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
+		if err := f.Close(); err != nil {
+			return err
+		}
 	}
 	return nil
 }
@@ -55,37 +51,264 @@ var jsHTmpl = template.Must(template.New("js.h").Parse(`// Code generated by go2
 
 #include "{{.IncludePath}}bytes.h"
 
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <deque>
 #include <dirent.h>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace {{.Namespace}} {
 
 class Object;
 
+// FlatStringMap is an insertion-ordered hash map with string keys.
+// The entries are stored in one vector, and the lookup is done by open addressing on a vector of indices. A lookup
+// by a pointer and a size doesn't allocate.
+template<class T>
+class FlatStringMap {
+public:
+  T* Find(const char* data, size_t size) {
+    int32_t idx = FindIndex(data, size);
+    if (idx == kEmpty) {
+      return nullptr;
+    }
+    return &entries_[idx].value;
+  }
+
+  T* Find(const std::string& key) {
+    return Find(key.data(), key.size());
+  }
+
+  const T* Find(const std::string& key) const {
+    int32_t idx = FindIndex(key.data(), key.size());
+    if (idx == kEmpty) {
+      return nullptr;
+    }
+    return &entries_[idx].value;
+  }
+
+  T& Set(const std::string& key, T value) {
+    if (T* v = Find(key)) {
+      *v = std::move(value);
+      return *v;
+    }
+    if ((entries_.size() + 1) * 2 > indices_.size()) {
+      Rehash();
+    }
+    size_t hash = Hash(key.data(), key.size());
+    size_t mask = indices_.size() - 1;
+    size_t i = hash & mask;
+    while (indices_[i] != kEmpty) {
+      i = (i + 1) & mask;
+    }
+    indices_[i] = static_cast<int32_t>(entries_.size());
+    entries_.push_back(Entry{key, hash, std::move(value), true});
+    size_++;
+    return entries_.back().value;
+  }
+
+  // Erase keeps a dead entry in place so that the probe sequences are not broken. The dead entries are removed at
+  // the next rehash.
+  bool Erase(const std::string& key) {
+    int32_t idx = FindIndex(key.data(), key.size());
+    if (idx == kEmpty) {
+      return false;
+    }
+    entries_[idx].alive = false;
+    entries_[idx].value = T{};
+    size_--;
+    return true;
+  }
+
+  template<class F>
+  void ForEach(F f) const {
+    for (const Entry& e : entries_) {
+      if (e.alive) {
+        f(e.key, e.value);
+      }
+    }
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+private:
+  static constexpr int32_t kEmpty = -1;
+
+  struct Entry {
+    std::string key;
+    size_t hash;
+    T value;
+    bool alive;
+  };
+
+  static size_t Hash(const char* data, size_t size) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+      h ^= static_cast<uint8_t>(data[i]);
+      h *= 1099511628211ull;
+    }
+    return static_cast<size_t>(h);
+  }
+
+  int32_t FindIndex(const char* data, size_t size) const {
+    if (indices_.empty()) {
+      return kEmpty;
+    }
+    size_t hash = Hash(data, size);
+    size_t mask = indices_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      int32_t idx = indices_[i];
+      if (idx == kEmpty) {
+        return kEmpty;
+      }
+      const Entry& e = entries_[idx];
+      if (e.alive && e.hash == hash && e.key.size() == size && std::memcmp(e.key.data(), data, size) == 0) {
+        return idx;
+      }
+    }
+  }
+
+  void Rehash() {
+    std::vector<Entry> entries;
+    entries.reserve(size_ + 1);
+    for (Entry& e : entries_) {
+      if (e.alive) {
+        entries.push_back(std::move(e));
+      }
+    }
+    entries_ = std::move(entries);
+
+    size_t n = 8;
+    while (n < (entries_.size() + 1) * 2) {
+      n *= 2;
+    }
+    indices_.assign(n, kEmpty);
+    size_t mask = n - 1;
+    for (size_t idx = 0; idx < entries_.size(); idx++) {
+      size_t i = entries_[idx].hash & mask;
+      while (indices_[i] != kEmpty) {
+        i = (i + 1) & mask;
+      }
+      indices_[i] = static_cast<int32_t>(idx);
+    }
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<int32_t> indices_;
+  size_t size_ = 0;
+};
+
+template<class T>
+constexpr int32_t FlatStringMap<T>::kEmpty;
+
+// PropertyNames interns property names.
+// A name is cached by the address and the size of its bytes, so that looking up the same name at the same address
+// again doesn't allocate nor hash. PropertyNames is not concurrent-safe.
+class PropertyNames {
+public:
+  const std::string& Get(const uint8_t* data, size_t size);
+
+private:
+  struct CacheEntry {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    const std::string* name = nullptr;
+  };
+
+  static constexpr size_t kCacheSize = 256;
+
+  std::array<CacheEntry, kCacheSize> cache_;
+  FlatStringMap<std::unique_ptr<std::string>> names_;
+};
+
 class Writer {
 public:
   virtual ~Writer();
-  virtual void Write(const std::vector<uint8_t>& bytes) = 0;
+
+  // Write writes the bytes. The bytes are valid only during the call.
+  virtual void Write(BytesSpan bytes) = 0;
+
+  // Flush blocks until the written bytes are output. The default implementation does nothing.
+  virtual void Flush();
 };
 
+// StreamWriter writes the bytes to the stream line by line on the caller's thread.
 class StreamWriter : public Writer {
 public:
   explicit StreamWriter(std::ostream& out);
-  void Write(const std::vector<uint8_t>& bytes) override;
+  void Write(BytesSpan bytes) override;
 
 private:
   std::ostream& out_;
-  // TODO: std::queue should be enough?
-  std::deque<uint8_t> buf_;
+  // buf_ is the bytes after the last line break.
+  std::vector<uint8_t> buf_;
+};
+
+// BufferedStreamWriter copies the bytes to a ring buffer and writes them to the stream on a background thread, so that
+// Write blocks only when the buffer is full. The buffered bytes are output when they reach flush_size, when
+// flush_interval passes after a write, on Flush, at the destruction, and at std::exit. The fs object flushes all the
+// BufferedStreamWriters before it writes to the standard output or the standard error, so that the buffered debug
+// output is not reordered with them.
+class BufferedStreamWriter : public Writer {
+public:
+  static constexpr size_t kDefaultBufferSize = 64 * 1024;
+  static constexpr size_t kDefaultFlushSize = 4096;
+  static constexpr int kDefaultFlushIntervalInMilliseconds = 50;
+
+  explicit BufferedStreamWriter(std::ostream& out);
+  BufferedStreamWriter(std::ostream& out, size_t buffer_size, size_t flush_size, std::chrono::milliseconds flush_interval);
+  ~BufferedStreamWriter() override;
+
+  void Write(BytesSpan bytes) override;
+  void Flush() override;
+
+  // FlushAll flushes all the living BufferedStreamWriters.
+  static void FlushAll();
+
+private:
+  BufferedStreamWriter(const BufferedStreamWriter&) = delete;
+  BufferedStreamWriter& operator=(const BufferedStreamWriter&) = delete;
+
+  void Loop();
+
+  std::ostream& out_;
+  const size_t flush_size_;
+  const std::chrono::milliseconds flush_interval_;
+
+  std::mutex mutex_;
+  // cond_ wakes the background thread.
+  std::condition_variable cond_;
+  // output_cond_ wakes the writers waiting for space and the flushers.
+  std::condition_variable output_cond_;
+
+  // ring_[head_, head_ + size_) are the buffered bytes. Only the background thread outputs the bytes, and it reads
+  // them without the lock, as the writers only touch the rest of ring_.
+  std::vector<uint8_t> ring_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+  // written_ and output_ are the total numbers of the written bytes and the output bytes.
+  uint64_t written_ = 0;
+  uint64_t output_ = 0;
+  int flusher_num_ = 0;
+  bool closed_ = false;
+
+  std::thread thread_;
 };
 
 class ArrayBuffer;
+class ValueSpan;
 
 class Value {
 public:
@@ -98,18 +321,26 @@ public:
     Object,
   };
 
-  class Hash {
-  public:
-    std::size_t operator()(const Value& value) const;
-  };
-
   static Value Null();
+
+  // Global returns the global object of the Go instance running on the current thread, i.e. in Go::Run or in a task
+  // of the instance. Global panics on a thread where no Go instance runs. Use Go::Global to set up the global object
+  // before Run.
   static Value Global();
+
+  // NewGlobal creates a global object with its own fs, process and net objects. Each Go instance has one.
+  static Value NewGlobal();
+
+  // SetCurrentGlobal sets the global object that Global returns on the current thread. global can be nullptr.
+  static void SetCurrentGlobal(const Value* global);
   static Value ReflectGet(Value target, const std::string& key);
   static void ReflectSet(Value target, const std::string& key, Value value);
   static void ReflectDelete(Value target, const std::string& key);
   static Value ReflectConstruct(Value target, std::vector<Value> args);
   static Value ReflectApply(Value target, Value self, std::vector<Value> args);
+  // ReflectApplySpan is ReflectApply with the arguments as a ValueSpan. This doesn't allocate a vector for the
+  // arguments when the target is a Function taking a ValueSpan.
+  static Value ReflectApplySpan(Value target, Value self, ValueSpan args);
 
   Value();
   explicit Value(bool b);
@@ -118,9 +349,12 @@ public:
   explicit Value(const std::string& str);
   explicit Value(std::shared_ptr<Object> object);
   explicit Value(const std::vector<Value>& array);
+  explicit Value(std::vector<Value>&& array);
 
   Value(const Value& rhs);
+  Value(Value&& rhs) noexcept;
   Value& operator=(const Value& rhs);
+  Value& operator=(Value&& rhs) noexcept;
   bool operator==(const Value& rhs) const;
 
   bool IsNull() const;
@@ -143,22 +377,55 @@ public:
 
   std::string Inspect() const;
 
-private:
-  static Value MakeGlobal();
+  // Identity returns the address of the string, the object or the array this value holds, or nullptr for the other
+  // types. Copies of a Value share the same identity.
+  const void* Identity() const;
 
+private:
   explicit Value(Type type);
   Value(Type type, double num);
 
+  const std::string& str_value() const;
+  Object* object_value() const;
+  std::vector<Value>* array_value() const;
+
   Type type_ = Type::Undefined;
+  // is_array_ is true when type_ is Type::Object and ptr_ holds an array.
+  bool is_array_ = false;
   double num_value_ = 0;
-  std::string str_value_;
-  std::shared_ptr<Object> object_value_;
-  std::shared_ptr<std::vector<Value>> array_value_;
+  // ptr_ holds a std::string for Type::String, and an Object or a std::vector<Value> for Type::Object.
+  // A string is immutable and shared among the copies.
+  std::shared_ptr<void> ptr_;
+};
+
+// ValueSpan is a view of Values, e.g. the arguments of a function call, which doesn't own them.
+class ValueSpan {
+public:
+  using size_type = size_t;
+  using iterator = Value*;
+
+  ValueSpan() = default;
+  ValueSpan(Value* data, size_t size)
+      : data_{data},
+        size_{size} {
+  }
+
+  Value& operator[](size_type n) { return data_[n]; }
+  const Value& operator[](size_type n) const { return data_[n]; }
+  size_type size() const { return size_; }
+  iterator begin() const { return data_; }
+  iterator end() const { return data_ + size_; }
+
+private:
+  Value* data_ = nullptr;
+  size_t size_ = 0;
 };
 
 class Object {
 public:
   using Func = std::function<Value (Value, std::vector<Value>)>;
+  // SpanFunc is a function taking the arguments as a ValueSpan. The arguments are valid only during the call.
+  using SpanFunc = std::function<Value (Value, ValueSpan)>;
 
   virtual ~Object();
   virtual Value Get(const std::string& key);
@@ -169,6 +436,9 @@ public:
   virtual bool IsConstructor() const { return false; }
   virtual bool IsBytes() const { return false; }
   virtual Value Invoke(Value self, std::vector<Value> args);
+  // InvokeSpan is Invoke with the arguments as a ValueSpan. By default, this copies the arguments to a vector and
+  // calls Invoke.
+  virtual Value InvokeSpan(Value self, ValueSpan args);
   virtual Value New(std::vector<Value> args);
 
   virtual BytesSpan ToBytes();
@@ -180,6 +450,11 @@ public:
 class ArrayBuffer : public Object {
 public:
   explicit ArrayBuffer(size_t size);
+  explicit ArrayBuffer(std::vector<uint8_t> data);
+
+  // ArrayBuffer with a BytesSpan is a view of the bytes without owning them. The bytes must outlive the
+  // ArrayBuffer.
+  explicit ArrayBuffer(BytesSpan view);
 
   size_t ByteLength() const;
   Value Get(const std::string& key) override;
@@ -189,6 +464,8 @@ public:
 
 private:
   std::vector<uint8_t> data_;
+  BytesSpan view_;
+  bool is_view_ = false;
 };
 
 class TypedArray : public Object {
@@ -236,22 +513,27 @@ public:
   std::string Inspect() const override;
 
 private:
-  std::map<std::string, Value> dict_;
+  FlatStringMap<Value> dict_;
 };
 
 class Function : public Object {
 public:
   explicit Function(Object::Func fn);
   Function(Object::Func fn, Value self);
+  explicit Function(Object::SpanFunc fn);
+  Function(Object::SpanFunc fn, Value self);
 
   Value Get(const std::string& key) override;
   bool IsFunction() const override { return true; }
   bool IsConstructor() const override { return false; }
   Value Invoke(Value self, std::vector<Value> args) override;
+  Value InvokeSpan(Value self, ValueSpan args) override;
   std::string ToString() const override { return "(function)"; }
 
 private:
+  // Either fn_ or span_fn_ is set.
   Object::Func fn_;
+  Object::SpanFunc span_fn_;
   Value self_;
 };
 
@@ -278,18 +560,27 @@ var jsCppTmpl = template.Must(template.New("js.cpp").Parse(`// Code generated by
 
 #include "{{.IncludePath}}js.h"
 
+#include "{{.IncludePath}}fileio.h"
+#include "{{.IncludePath}}net.h"
+
 #include <algorithm>
+#include <arpa/inet.h>
 #include <cassert>
 #include <cstring>
 #include <cstdlib>
 #include <ctime>
 #include <fcntl.h>
 #include <iomanip>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <random>
 #include <sstream>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <tuple>
 #include <unistd.h>
+#include <unordered_map>
 #include <utime.h>
 
 namespace {{.Namespace}} {
@@ -1010,6 +1301,51 @@ private:
   const int errno_;
 };
 
+// ResolveError is an error by getaddrinfo. The codes follow Node.js's dns module.
+class ResolveError : public Object {
+public:
+  explicit ResolveError(int err)
+      : err_(err) {
+  }
+
+  Value Get(const std::string& key) override {
+    if (key == "message") {
+      return Value{ToString()};
+    }
+    if (key == "code") {
+      return Value{CodeName()};
+    }
+    return Value{};
+  }
+
+  std::string ToString() const override {
+    return gai_strerror(err_);
+  }
+
+private:
+  const char* CodeName() const {
+    switch (err_) {
+    case EAI_NONAME: return "ENOTFOUND";
+#if defined(EAI_NODATA) && EAI_NODATA != EAI_NONAME
+    case EAI_NODATA: return "ENODATA";
+#endif
+#if defined(EAI_ADDRFAMILY)
+    case EAI_ADDRFAMILY: return "EADDRFAMILY";
+#endif
+    case EAI_AGAIN: return "EAI_AGAIN";
+    case EAI_FAIL: return "EAI_FAIL";
+    case EAI_FAMILY: return "EAI_FAMILY";
+    case EAI_MEMORY: return "ENOMEM";
+    case EAI_SERVICE: return "EAI_SERVICE";
+    case EAI_SOCKTYPE: return "EAI_SOCKTYPE";
+    case EAI_BADFLAGS: return "EAI_BADFLAGS";
+    }
+    return "EAI_FAIL";
+  }
+
+  const int err_;
+};
+
 // TODO: Use Error.
 class Enosys : public Object {
 public:
@@ -1056,22 +1392,34 @@ public:
       return Value{std::make_shared<Function>(
         [](Value self, std::vector<Value> args) -> Value {
           int fd = static_cast<int>(args[0].ToNumber());
-          BytesSpan buf = args[1].ToBytes();
+          Value buf = args[1];
           size_t offset = static_cast<size_t>(args[2].ToNumber());
           size_t length = static_cast<size_t>(args[3].ToNumber());
           Value position = args[4];
           Value callback = args[5];
-          size_t n;
-          if (position.IsNumber()) {
-            n = pwrite(fd, buf.begin() + offset, length, static_cast<off_t>(position.ToNumber()));
-          } else {
-            n = write(fd, buf.begin() + offset, length);
-          }
-          Value errval = Value::Null();
-          if (n == -1) {
-            errval = Value{std::make_shared<Errno>(errno)};
+          const uint8_t* data = buf.ToBytes().begin() + offset;
+          bool has_position = position.IsNumber();
+          off_t pos = has_position ? static_cast<off_t>(position.ToNumber()) : 0;
+          if (!has_position && IsStreamFD(fd)) {
+            // A write to a terminal, a pipe or a socket is done synchronously, as a round-trip to a FileIO worker
+            // would cost more than the write. The debug output is flushed first to keep the order with println.
+            BufferedStreamWriter::FlushAll();
+            ssize_t n = write(fd, data, length);
+            Value::ReflectApply(callback, Value{}, {ErrnoValue(n == -1 ? errno : 0), Value{static_cast<double>(n)}});
+            return Value{};
           }
-          Value::ReflectApply(callback, Value{}, {errval, Value{static_cast<double>(n)}});
+          FileIO::Submit(FileIO::Op::Write, [fd, data, length, has_position, pos, buf, callback]() mutable -> TaskQueue::Task {
+            ssize_t n;
+            if (has_position) {
+              n = pwrite(fd, data, length, pos);
+            } else {
+              n = write(fd, data, length);
+            }
+            int err = n == -1 ? errno : 0;
+            return [n, err, buf = std::move(buf), callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err), Value{static_cast<double>(n)}});
+            };
+          });
           return Value{};
         })};
     }
@@ -1080,25 +1428,27 @@ public:
         [](Value self, std::vector<Value> args) -> Value {
           int fd = static_cast<int>(args[0].ToNumber());
           Value callback = args[1];
-          Value errval = Value::Null();
-          if (close(fd)) {
-            errval = Value{std::make_shared<Errno>(errno)};
-          }
-          Value::ReflectApply(callback, Value{}, {errval});
+          FileIO::Submit(FileIO::Op::Close, [fd, callback]() mutable -> TaskQueue::Task {
+            int err = close(fd) ? errno : 0;
+            return [err, callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err)});
+            };
+          });
           return Value{};
         })};
     }
     if (key == "fstat") {
       return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
+        [](Value self, std::vector<Value> args) -> Value {
           int fd = static_cast<int>(args[0].ToNumber());
           Value callback = args[1];
-          struct stat statbuf;
-          Value errval = Value::Null();
-          if (fstat(fd, &statbuf)) {
-            errval = Value{std::make_shared<Errno>(errno)};
-          }
-          Value::ReflectApply(callback, Value{}, {errval, StatToValue(&statbuf)});
+          FileIO::Submit(FileIO::Op::Fstat, [fd, callback]() mutable -> TaskQueue::Task {
+            struct stat statbuf;
+            int err = fstat(fd, &statbuf) ? errno : 0;
+            return [statbuf, err, callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err), StatToValue(&statbuf)});
+            };
+          });
           return Value{};
         })};
     }
@@ -1108,11 +1458,12 @@ public:
           int fd = static_cast<int>(args[0].ToNumber());
           off_t len = static_cast<off_t>(args[1].ToNumber());
           Value callback = args[2];
-          Value errval = Value::Null();
-          if (ftruncate(fd, len)) {
-            errval = Value{std::make_shared<Errno>(errno)};
-          }
-          Value::ReflectApply(callback, Value{}, {errval});
+          FileIO::Submit(FileIO::Op::Ftruncate, [fd, len, callback]() mutable -> TaskQueue::Task {
+            int err = ftruncate(fd, len) ? errno : 0;
+            return [err, callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err)});
+            };
+          });
           return Value{};
         })};
     }
@@ -1120,7 +1471,7 @@ public:
       // Unfortunately, lstat might not be defined in some platforms.
 #if 0
       return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
+        [](Value self, std::vector<Value> args) -> Value {
           std::string path = args[0].ToString();
           Value callback = args[1];
           struct stat statbuf;
@@ -1139,11 +1490,12 @@ public:
           std::string path = args[0].ToString();
           int perm = static_cast<int>(args[1].ToNumber());
           Value callback = args[2];
-          Value errval = Value::Null();
-          if (mkdir(path.c_str(), perm)) {
-            errval = Value{std::make_shared<Errno>(errno)};
-          }
-          Value::ReflectApply(callback, Value{}, {errval});
+          FileIO::Submit(FileIO::Op::Mkdir, [path, perm, callback]() mutable -> TaskQueue::Task {
+            int err = mkdir(path.c_str(), perm) ? errno : 0;
+            return [err, callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err)});
+            };
+          });
           return Value{};
         })};
     }
@@ -1154,12 +1506,13 @@ public:
           int flags = static_cast<int>(args[1].ToNumber());
           mode_t mode = static_cast<mode_t>(args[2].ToNumber());
           Value callback = args[3];
-          int fd = open(path.c_str(), flags, mode);
-          Value errval = Value::Null();
-          if (fd == -1) {
-            errval = Value{std::make_shared<Errno>(errno)};
-          }
-          Value::ReflectApply(callback, Value{}, {errval, Value{static_cast<double>(fd)}});
+          FileIO::Submit(FileIO::Op::Open, [path, flags, mode, callback]() mutable -> TaskQueue::Task {
+            int fd = open(path.c_str(), flags, mode);
+            int err = fd == -1 ? errno : 0;
+            return [fd, err, callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err), Value{static_cast<double>(fd)}});
+            };
+          });
           return Value{};
         })};
     }
@@ -1167,22 +1520,26 @@ public:
       return Value{std::make_shared<Function>(
         [](Value self, std::vector<Value> args) -> Value {
           int fd = static_cast<int>(args[0].ToNumber());
-          BytesSpan buf = args[1].ToBytes();
+          Value buf = args[1];
           size_t offset = static_cast<size_t>(args[2].ToNumber());
           size_t length = static_cast<size_t>(args[3].ToNumber());
           Value position = args[4];
           Value callback = args[5];
-          size_t n;
-          if (position.IsNumber()) {
-            n = pread(fd, buf.begin() + offset, length, static_cast<off_t>(position.ToNumber()));
-          } else {
-            n = read(fd, buf.begin() + offset, length);
-          }
-          Value errval = Value::Null();
-          if (n == -1) {
-            errval = Value{std::make_shared<Errno>(errno)};
-          }
-          Value::ReflectApply(callback, Value{}, {errval, Value{static_cast<double>(n)}});
+          uint8_t* data = buf.ToBytes().begin() + offset;
+          bool has_position = position.IsNumber();
+          off_t pos = has_position ? static_cast<off_t>(position.ToNumber()) : 0;
+          FileIO::Submit(FileIO::Op::Read, [fd, data, length, has_position, pos, buf, callback]() mutable -> TaskQueue::Task {
+            ssize_t n;
+            if (has_position) {
+              n = pread(fd, data, length, pos);
+            } else {
+              n = read(fd, data, length);
+            }
+            int err = n == -1 ? errno : 0;
+            return [n, err, buf = std::move(buf), callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err), Value{static_cast<double>(n)}});
+            };
+          });
           return Value{};
         })};
     }
@@ -1191,37 +1548,40 @@ public:
         [](Value self, std::vector<Value> args) -> Value {
           std::string path = args[0].ToString();
           Value callback = args[1];
-
-          DIR* dir = opendir(path.c_str());
-          if (!dir) {
-            Value errval = Value{std::make_shared<Errno>(errno)};
-            Value::ReflectApply(callback, Value{}, {errval, Value{}});
-            return Value{};
-          }
-
-          struct dirent* dp;
-          std::vector<Value> filenames;
-          while ((dp = readdir(dir)) != nullptr) {
-            std::string filename = dp->d_name;
-            if (filename == "." || filename == "..") {
-              continue;
+          FileIO::Submit(FileIO::Op::Readdir, [path, callback]() mutable -> TaskQueue::Task {
+            std::vector<std::string> filenames;
+            int err = 0;
+            if (DIR* dir = opendir(path.c_str())) {
+              // readdir sets errno only on an error.
+              errno = 0;
+              struct dirent* dp;
+              while ((dp = readdir(dir)) != nullptr) {
+                std::string filename = dp->d_name;
+                if (filename == "." || filename == "..") {
+                  continue;
+                }
+                filenames.push_back(filename);
+              }
+              err = errno;
+              if (closedir(dir) && !err) {
+                err = errno;
+              }
+            } else {
+              err = errno;
             }
-            filenames.push_back(Value{filename});
-          }
-          // readdir can set an error value.
-          if (errno) {
-            Value errval = Value{std::make_shared<Errno>(errno)};
-            Value::ReflectApply(callback, Value{}, {errval, Value{}});
-            return Value{};
-          }
-
-          if (!closedir(dir)) {
-            Value errval = Value{std::make_shared<Errno>(errno)};
-            Value::ReflectApply(callback, Value{}, {errval, Value{}});
-            return Value{};
-          }
-
-          Value::ReflectApply(callback, Value{}, {Value::Null(), Value{filenames}});
+            return [filenames = std::move(filenames), err, callback = std::move(callback)]() {
+              if (err) {
+                Value::ReflectApply(callback, Value{}, {ErrnoValue(err), Value{}});
+                return;
+              }
+              std::vector<Value> values;
+              values.reserve(filenames.size());
+              for (const std::string& filename : filenames) {
+                values.push_back(Value{filename});
+              }
+              Value::ReflectApply(callback, Value{}, {Value::Null(), Value{values}});
+            };
+          });
           return Value{};
         })};
     }
@@ -1231,11 +1591,12 @@ public:
           std::string old_path = args[0].ToString();
           std::string new_path = args[1].ToString();
           Value callback = args[2];
-          Value errval = Value::Null();
-          if (rename(old_path.c_str(), new_path.c_str())) {
-            errval = Value{std::make_shared<Errno>(errno)};
-          }
-          Value::ReflectApply(callback, Value{}, {errval});
+          FileIO::Submit(FileIO::Op::Rename, [old_path, new_path, callback]() mutable -> TaskQueue::Task {
+            int err = rename(old_path.c_str(), new_path.c_str()) ? errno : 0;
+            return [err, callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err)});
+            };
+          });
           return Value{};
         })};
     }
@@ -1244,25 +1605,27 @@ public:
         [](Value self, std::vector<Value> args) -> Value {
           std::string path = args[0].ToString();
           Value callback = args[1];
-          Value errval = Value::Null();
-          if (rmdir(path.c_str())) {
-            errval = Value{std::make_shared<Errno>(errno)};
-          }
-          Value::ReflectApply(callback, Value{}, {errval});
+          FileIO::Submit(FileIO::Op::Rmdir, [path, callback]() mutable -> TaskQueue::Task {
+            int err = rmdir(path.c_str()) ? errno : 0;
+            return [err, callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err)});
+            };
+          });
           return Value{};
         })};
     }
     if (key == "stat") {
       return Value{std::make_shared<Function>(
-        [this](Value self, std::vector<Value> args) -> Value {
+        [](Value self, std::vector<Value> args) -> Value {
           std::string path = args[0].ToString();
           Value callback = args[1];
-          struct stat statbuf;
-          Value errval = Value::Null();
-          if (stat(path.c_str(), &statbuf)) {
-            errval = Value{std::make_shared<Errno>(errno)};
-          }
-          Value::ReflectApply(callback, Value{}, {errval, StatToValue(&statbuf)});
+          FileIO::Submit(FileIO::Op::Stat, [path, callback]() mutable -> TaskQueue::Task {
+            struct stat statbuf;
+            int err = stat(path.c_str(), &statbuf) ? errno : 0;
+            return [statbuf, err, callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err), StatToValue(&statbuf)});
+            };
+          });
           return Value{};
         })};
     }
@@ -1271,11 +1634,12 @@ public:
         [](Value self, std::vector<Value> args) -> Value {
           std::string path = args[0].ToString();
           Value callback = args[1];
-          Value errval = Value::Null();
-          if (unlink(path.c_str())) {
-            errval = Value{std::make_shared<Errno>(errno)};
-          }
-          Value::ReflectApply(callback, Value{}, {errval});
+          FileIO::Submit(FileIO::Op::Unlink, [path, callback]() mutable -> TaskQueue::Task {
+            int err = unlink(path.c_str()) ? errno : 0;
+            return [err, callback = std::move(callback)]() {
+              Value::ReflectApply(callback, Value{}, {ErrnoValue(err)});
+            };
+          });
           return Value{};
         })};
     }
@@ -1310,7 +1674,27 @@ public:
   }
 
 private:
-  Value StatToValue(struct stat* statbuf) {
+  static Value ErrnoValue(int err) {
+    if (!err) {
+      return Value::Null();
+    }
+    return Value{std::make_shared<Errno>(err)};
+  }
+
+  // IsStreamFD reports whether fd is the standard output, the standard error, or another file that is not a regular
+  // file, like a terminal or a pipe.
+  static bool IsStreamFD(int fd) {
+    if (fd == 1 || fd == 2) {
+      return true;
+    }
+    struct stat statbuf;
+    if (fstat(fd, &statbuf)) {
+      return false;
+    }
+    return !S_ISREG(statbuf.st_mode);
+  }
+
+  static Value StatToValue(const struct stat* statbuf) {
     auto dict = std::make_shared<DictionaryValues>();
     dict->Set("dev", Value{static_cast<double>(statbuf->st_dev)});
     dict->Set("ino", Value{static_cast<double>(statbuf->st_ino)});
@@ -1324,13 +1708,13 @@ private:
     dict->Set("blocks", Value{static_cast<double>(statbuf->st_blocks)});
 
 #if defined(__APPLE__)
-    dict->Set("atimMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_atimespec))});
-    dict->Set("mtimMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_mtimespec))});
-    dict->Set("ctimMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_ctimespec))});
+    dict->Set("atimeMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_atimespec))});
+    dict->Set("mtimeMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_mtimespec))});
+    dict->Set("ctimeMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_ctimespec))});
 #else
-    dict->Set("atimMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_atim))});
-    dict->Set("mtimMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_mtim))});
-    dict->Set("ctimMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_ctim))});
+    dict->Set("atimeMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_atim))});
+    dict->Set("mtimeMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_mtim))});
+    dict->Set("ctimeMs", Value{static_cast<double>(TimespecToMillisecond(&statbuf->st_ctim))});
 #endif
 
     bool dir = statbuf->st_mode & S_IFDIR;
@@ -1341,7 +1725,7 @@ private:
     return Value{dict};
   }
 
-  int64_t TimespecToMillisecond(struct timespec* t) {
+  static int64_t TimespecToMillisecond(const struct timespec* t) {
     return static_cast<int64_t>(t->tv_sec) * 1000ll +
         static_cast<int64_t>(t->tv_nsec) / 1000000ll;
   }
@@ -1378,6 +1762,449 @@ public:
   }
 };
 
+// Net is the host network object go2cppNet. Net provides nonblocking TCP sockets driven by the Reactor for the
+// thread running Go:
+//
+//   listen(host, port, backlog, callback(err, fd))
+//   accept(fd, callback(err, fd))
+//   connect(host, port, callback(err, fd)), which tries the resolved addresses in order
+//   read(fd, buf, offset, length, callback(err, n)), where n is 0 at the end of the stream
+//   write(fd, buf, offset, length, callback(err, n)), which completes when all the bytes are written
+//   close(fd)
+//   cancelRead(fd) and cancelWrite(fd), which make the pending operations fail with ETIMEDOUT
+//   localAddr(fd) and remoteAddr(fd)
+//
+// buf is a Uint8Array. The bytes are read and written directly, so a view by go2cppMemoryView makes the operations
+// zero-copy on Go slices. The Go side must keep buf alive until the callback is called.
+//
+// An operation is tried immediately, and the callback is called synchronously if it doesn't block. Otherwise, the
+// operation is retried when the Reactor reports the socket is ready, and the callback is called from the task queue.
+//
+// connect resolves the host name on a FileIO worker. A failure to resolve is an error with a code like ENOTFOUND or
+// EAI_AGAIN and the message by gai_strerror.
+class Net : public Object {
+public:
+  Value Get(const std::string& key) override {
+    if (key == "listen") {
+      return Value{std::make_shared<Function>(
+        [this](Value self, std::vector<Value> args) -> Value {
+          std::string host = args[0].ToString();
+          int port = static_cast<int>(args[1].ToNumber());
+          int backlog = static_cast<int>(args[2].ToNumber());
+          Value callback = args[3];
+
+          struct addrinfo* ai = nullptr;
+          int sys_err = 0;
+          if (int err = Resolve(host, port, true, &ai, &sys_err)) {
+            Value::ReflectApply(callback, Value{}, {ResolveErrorValue(err, sys_err), Value{}});
+            return Value{};
+          }
+          int fd = NewSocket(ai->ai_family);
+          int err = 0;
+          if (fd == -1) {
+            err = errno;
+          } else {
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) || listen(fd, backlog)) {
+              err = errno;
+              close(fd);
+            }
+          }
+          freeaddrinfo(ai);
+          if (err) {
+            Value::ReflectApply(callback, Value{}, {ErrnoValue(err), Value{}});
+            return Value{};
+          }
+          AddSocket(fd);
+          Value::ReflectApply(callback, Value{}, {Value::Null(), Value{static_cast<double>(fd)}});
+          return Value{};
+        })};
+    }
+    if (key == "accept") {
+      return Value{std::make_shared<Function>(
+        [this](Value self, std::vector<Value> args) -> Value {
+          std::shared_ptr<Socket> s = GetSocket(args[0]);
+          Enqueue(s, Reactor::Event::Read, Op{Op::Kind::Accept, Value{}, 0, 0, args[1]});
+          return Value{};
+        })};
+    }
+    if (key == "connect") {
+      return Value{std::make_shared<Function>(
+        [this](Value self, std::vector<Value> args) -> Value {
+          std::string host = args[0].ToString();
+          int port = static_cast<int>(args[1].ToNumber());
+          Value callback = args[2];
+
+          // getaddrinfo might block for a long time, so the host name is resolved on a FileIO worker.
+          FileIO::Submit(FileIO::Op::Resolve, [this, host, port, callback]() mutable -> TaskQueue::Task {
+            struct addrinfo* ai = nullptr;
+            int sys_err = 0;
+            int err = Resolve(host, port, false, &ai, &sys_err);
+            std::shared_ptr<struct addrinfo> addrs;
+            if (!err) {
+              addrs.reset(ai, freeaddrinfo);
+            }
+            return [this, err, sys_err, addrs, callback = std::move(callback)]() {
+              if (err) {
+                Value::ReflectApply(callback, Value{}, {ResolveErrorValue(err, sys_err), Value{}});
+                return;
+              }
+              Connect(addrs, addrs.get(), callback, 0);
+            };
+          });
+          return Value{};
+        })};
+    }
+    if (key == "read" || key == "write") {
+      bool read = key == "read";
+      return Value{std::make_shared<Function>(
+        [this, read](Value self, std::vector<Value> args) -> Value {
+          std::shared_ptr<Socket> s = GetSocket(args[0]);
+          size_t offset = static_cast<size_t>(args[2].ToNumber());
+          size_t length = static_cast<size_t>(args[3].ToNumber());
+          Op op{read ? Op::Kind::Read : Op::Kind::Write, args[1], offset, length, args[4]};
+          Enqueue(s, read ? Reactor::Event::Read : Reactor::Event::Write, std::move(op));
+          return Value{};
+        })};
+    }
+    if (key == "close") {
+      return Value{std::make_shared<Function>(
+        [this](Value self, std::vector<Value> args) -> Value {
+          int fd = static_cast<int>(args[0].ToNumber());
+          auto it = sockets_.find(fd);
+          if (it == sockets_.end()) {
+            return Value{};
+          }
+          std::shared_ptr<Socket> s = it->second;
+          CloseSocket(s);
+          Cancel(s->reads, ECANCELED);
+          Cancel(s->writes, ECANCELED);
+          return Value{};
+        })};
+    }
+    if (key == "cancelRead" || key == "cancelWrite") {
+      bool read = key == "cancelRead";
+      return Value{std::make_shared<Function>(
+        [this, read](Value self, std::vector<Value> args) -> Value {
+          std::shared_ptr<Socket> s = GetSocket(args[0]);
+          Cancel(read ? s->reads : s->writes, ETIMEDOUT);
+          return Value{};
+        })};
+    }
+    if (key == "localAddr" || key == "remoteAddr") {
+      bool local = key == "localAddr";
+      return Value{std::make_shared<Function>(
+        [this, local](Value self, std::vector<Value> args) -> Value {
+          std::shared_ptr<Socket> s = GetSocket(args[0]);
+          struct sockaddr_storage addr;
+          socklen_t len = sizeof(addr);
+          struct sockaddr* sa = reinterpret_cast<struct sockaddr*>(&addr);
+          if (local ? getsockname(s->fd, sa, &len) : getpeername(s->fd, sa, &len)) {
+            return Value::Null();
+          }
+          char host[NI_MAXHOST];
+          char port[NI_MAXSERV];
+          if (getnameinfo(sa, len, host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV)) {
+            return Value::Null();
+          }
+          if (addr.ss_family == AF_INET6) {
+            return Value{std::string("[") + host + "]:" + port};
+          }
+          return Value{std::string(host) + ":" + port};
+        })};
+    }
+    Panic(key + " on go2cppNet is not implemented");
+    return Value{};
+  }
+
+  std::string ToString() const override {
+    return "go2cppNet";
+  }
+
+private:
+  struct Op {
+    enum class Kind {
+      Accept,
+      Connect,
+      Read,
+      Write,
+    };
+
+    Kind kind;
+    Value buf;
+    size_t offset;
+    size_t length;
+    Value callback;
+    // done is the number of the bytes written so far.
+    size_t done = 0;
+    // addrs and next are the resolved addresses of a connect, and the address to try when this one fails.
+    std::shared_ptr<struct addrinfo> addrs;
+    const struct addrinfo* next = nullptr;
+  };
+
+  // Socket is the state of a socket. Socket is accessed only on the thread running Go.
+  struct Socket {
+    int fd;
+    bool closed = false;
+    // reads and writes are the pending operations. Only the first operation of each is in progress.
+    std::deque<Op> reads;
+    std::deque<Op> writes;
+    // reading and writing report whether the operations are being processed or waiting for the socket to be ready.
+    bool reading = false;
+    bool writing = false;
+  };
+
+  static Value ErrnoValue(int err) {
+    if (!err) {
+      return Value::Null();
+    }
+    return Value{std::make_shared<Errno>(err)};
+  }
+
+  static Reactor* CurrentReactor() {
+    Reactor* reactor = Reactor::Current();
+    if (!reactor) {
+      Panic("go2cppNet is available only while Go runs");
+    }
+    return reactor;
+  }
+
+  // Resolve returns 0 or a getaddrinfo error. For EAI_SYSTEM, sys_err is set to errno. Resolve might block, and is
+  // concurrent-safe.
+  static int Resolve(const std::string& host, int port, bool passive, struct addrinfo** ai, int* sys_err) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (passive) {
+      hints.ai_flags = AI_PASSIVE;
+    }
+    std::string service = std::to_string(port);
+    int err = getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, ai);
+    if (err == EAI_SYSTEM) {
+      *sys_err = errno;
+      if (!*sys_err) {
+        *sys_err = EIO;
+      }
+    }
+    return err;
+  }
+
+  static Value ResolveErrorValue(int err, int sys_err) {
+    if (err == EAI_SYSTEM) {
+      return ErrnoValue(sys_err);
+    }
+    return Value{std::make_shared<ResolveError>(err)};
+  }
+
+  // Connect connects to the addresses from ai in order, and calls callback with the first connected socket. If
+  // no address is left, callback is called with err, the error of the last address.
+  void Connect(std::shared_ptr<struct addrinfo> addrs, const struct addrinfo* ai, Value callback, int err) {
+    for (; ai; ai = ai->ai_next) {
+      int fd = NewSocket(ai->ai_family);
+      if (fd == -1) {
+        err = errno;
+        continue;
+      }
+      if (connect(fd, ai->ai_addr, ai->ai_addrlen) && errno != EINPROGRESS) {
+        err = errno;
+        close(fd);
+        continue;
+      }
+      std::shared_ptr<Socket> s = AddSocket(fd);
+      Op op{Op::Kind::Connect, Value{}, 0, 0, callback};
+      op.addrs = std::move(addrs);
+      op.next = ai->ai_next;
+      Enqueue(s, Reactor::Event::Write, std::move(op));
+      return;
+    }
+    if (!err) {
+      err = EADDRNOTAVAIL;
+    }
+    Value::ReflectApply(callback, Value{}, {ErrnoValue(err), Value{}});
+  }
+
+  static int NewSocket(int family) {
+    int fd = socket(family, SOCK_STREAM, 0);
+    if (fd == -1) {
+      return -1;
+    }
+    SetUpSocket(fd);
+    return fd;
+  }
+
+  static void SetUpSocket(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    int on = 1;
+    // Go disables Nagle's algorithm by default.
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+#if defined(SO_NOSIGPIPE)
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+  }
+
+  // Try tries op once. Try returns false if op would block. Otherwise, Try sets the result to err and result.
+  static bool Try(Socket& s, Op& op, int* err, Value* result) {
+    switch (op.kind) {
+    case Op::Kind::Accept: {
+      int fd = accept(s.fd, nullptr, nullptr);
+      if (fd == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) {
+          return false;
+        }
+        *err = errno;
+        return true;
+      }
+      SetUpSocket(fd);
+      *result = Value{static_cast<double>(fd)};
+      return true;
+    }
+    case Op::Kind::Connect: {
+      int soerr = 0;
+      socklen_t len = sizeof(soerr);
+      if (getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &soerr, &len)) {
+        soerr = errno;
+      }
+      if (soerr) {
+        *err = soerr;
+        return true;
+      }
+      // SO_ERROR is 0 also while connecting. The socket has a peer once it is connected.
+      struct sockaddr_storage addr;
+      len = sizeof(addr);
+      if (getpeername(s.fd, reinterpret_cast<struct sockaddr*>(&addr), &len)) {
+        if (errno == ENOTCONN) {
+          return false;
+        }
+        *err = errno;
+        return true;
+      }
+      *result = Value{static_cast<double>(s.fd)};
+      return true;
+    }
+    case Op::Kind::Read: {
+      uint8_t* data = op.buf.ToBytes().begin() + op.offset;
+      ssize_t n = recv(s.fd, data, op.length, 0);
+      if (n == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+          return false;
+        }
+        *err = errno;
+        n = 0;
+      }
+      *result = Value{static_cast<double>(n)};
+      return true;
+    }
+    case Op::Kind::Write: {
+      const uint8_t* data = op.buf.ToBytes().begin() + op.offset;
+      while (op.done < op.length) {
+        ssize_t n = send(s.fd, data + op.done, op.length - op.done, kSendFlags);
+        if (n == -1) {
+          if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return false;
+          }
+          *err = errno;
+          break;
+        }
+        op.done += n;
+      }
+      *result = Value{static_cast<double>(op.done)};
+      return true;
+    }
+    }
+    return true;
+  }
+
+  // Enqueue adds op to the operations of s for event, and runs it unless another operation is in progress.
+  void Enqueue(std::shared_ptr<Socket> s, Reactor::Event event, Op op) {
+    bool read = event == Reactor::Event::Read;
+    (read ? s->reads : s->writes).push_back(std::move(op));
+    if (!(read ? s->reading : s->writing)) {
+      RunOps(s, event);
+    }
+  }
+
+  // RunOps runs the pending operations of s for event in order, until one would block. Then RunOps waits for
+  // the socket to be ready, and continues from the task queue.
+  void RunOps(std::shared_ptr<Socket> s, Reactor::Event event) {
+    bool read = event == Reactor::Event::Read;
+    std::deque<Op>& ops = read ? s->reads : s->writes;
+    bool& busy = read ? s->reading : s->writing;
+    busy = true;
+    while (!s->closed && !ops.empty()) {
+      int err = 0;
+      Value result;
+      if (!Try(*s, ops.front(), &err, &result)) {
+        CurrentReactor()->Watch(s->fd, event, [this, s, event]() {
+          if (!s->closed) {
+            RunOps(s, event);
+          }
+        });
+        return;
+      }
+      Op op = std::move(ops.front());
+      ops.pop_front();
+      if (op.kind == Op::Kind::Accept && !err) {
+        AddSocket(static_cast<int>(result.ToNumber()));
+      }
+      if (op.kind == Op::Kind::Connect && err) {
+        CloseSocket(s);
+        if (op.next) {
+          Connect(std::move(op.addrs), op.next, std::move(op.callback), err);
+          continue;
+        }
+        result = Value{};
+      }
+      // The callback might add operations to s, which are run in this loop.
+      Value::ReflectApply(op.callback, Value{}, {ErrnoValue(err), result});
+    }
+    busy = false;
+  }
+
+  void CloseSocket(std::shared_ptr<Socket> s) {
+    sockets_.erase(s->fd);
+    s->closed = true;
+    CurrentReactor()->Unwatch(s->fd);
+    close(s->fd);
+  }
+
+  void Cancel(std::deque<Op>& ops, int err) {
+    std::deque<Op> canceled = std::move(ops);
+    ops.clear();
+    for (Op& op : canceled) {
+      Value callback = op.callback;
+      // The callbacks are called from the task queue, as Go might be waiting for the result of this call.
+      CurrentReactor()->Post([callback, err]() {
+        Value::ReflectApply(callback, Value{}, {ErrnoValue(err), Value{}});
+      });
+    }
+  }
+
+  std::shared_ptr<Socket> AddSocket(int fd) {
+    auto s = std::make_shared<Socket>();
+    s->fd = fd;
+    sockets_[fd] = s;
+    return s;
+  }
+
+  std::shared_ptr<Socket> GetSocket(Value fd) {
+    auto it = sockets_.find(static_cast<int>(fd.ToNumber()));
+    if (it == sockets_.end()) {
+      Panic("go2cppNet: invalid socket: " + fd.Inspect());
+    }
+    return it->second;
+  }
+
+#if defined(MSG_NOSIGNAL)
+  static constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+  static constexpr int kSendFlags = 0;
+#endif
+
+  std::unordered_map<int, std::shared_ptr<Socket>> sockets_;
+};
+
 class Date : public Object {
 public:
   Value Get(const std::string& key) override {
@@ -1407,32 +2234,167 @@ public:
 
 Writer::~Writer() = default;
 
+const std::string& PropertyNames::Get(const uint8_t* data, size_t size) {
+  size_t h = (reinterpret_cast<uintptr_t>(data) >> 3) ^ size;
+  CacheEntry& c = cache_[h % kCacheSize];
+  // The bytes at the same address might be changed. Compare the bytes too.
+  if (c.data == data && c.size == size && std::memcmp(c.name->data(), data, size) == 0) {
+    return *c.name;
+  }
+
+  const char* str = reinterpret_cast<const char*>(data);
+  std::unique_ptr<std::string>* name = names_.Find(str, size);
+  if (!name) {
+    name = &names_.Set(std::string{str, size}, std::make_unique<std::string>(str, size));
+  }
+  c.data = data;
+  c.size = size;
+  c.name = name->get();
+  return *c.name;
+}
+
+void Writer::Flush() {
+}
+
 StreamWriter::StreamWriter(std::ostream& out)
     : out_{out} {
 }
 
-void StreamWriter::Write(const std::vector<uint8_t>& bytes) {
-  buf_.insert(buf_.end(), bytes.begin(), bytes.end());
-  for (;;) {
-    auto it = std::find(buf_.begin(), buf_.end(), '\n');
-    if (it == buf_.end()) {
-      break;
+void StreamWriter::Write(BytesSpan bytes) {
+  // Find the last line break, and output the lines at once.
+  uint8_t* end = bytes.end();
+  while (end != bytes.begin() && *(end - 1) != '\n') {
+    --end;
+  }
+  if (end == bytes.begin()) {
+    buf_.insert(buf_.end(), bytes.begin(), bytes.end());
+    return;
+  }
+  out_.write(reinterpret_cast<const char*>(buf_.data()), buf_.size());
+  out_.write(reinterpret_cast<const char*>(bytes.begin()), end - bytes.begin());
+  out_.flush();
+  buf_.assign(end, bytes.end());
+}
+
+namespace {
+
+struct BufferedStreamWriters {
+  std::mutex mutex;
+  std::vector<BufferedStreamWriter*> writers;
+};
+
+// GetBufferedStreamWriters returns the living BufferedStreamWriters. This is never destructed so that the exit
+// handler can use this after the static objects are destructed.
+BufferedStreamWriters& GetBufferedStreamWriters() {
+  static BufferedStreamWriters* writers = [] {
+    std::atexit(BufferedStreamWriter::FlushAll);
+    return new BufferedStreamWriters();
+  }();
+  return *writers;
+}
+
+}
+
+constexpr size_t BufferedStreamWriter::kDefaultBufferSize;
+constexpr size_t BufferedStreamWriter::kDefaultFlushSize;
+constexpr int BufferedStreamWriter::kDefaultFlushIntervalInMilliseconds;
+
+BufferedStreamWriter::BufferedStreamWriter(std::ostream& out)
+    : BufferedStreamWriter{out, kDefaultBufferSize, kDefaultFlushSize,
+                           std::chrono::milliseconds{kDefaultFlushIntervalInMilliseconds}} {
+}
+
+BufferedStreamWriter::BufferedStreamWriter(std::ostream& out, size_t buffer_size, size_t flush_size, std::chrono::milliseconds flush_interval)
+    : out_{out},
+      flush_size_{std::min(std::max<size_t>(flush_size, 1), std::max<size_t>(buffer_size, 1))},
+      flush_interval_{flush_interval},
+      ring_(std::max<size_t>(buffer_size, 1)),
+      thread_{[this] { Loop(); }} {
+  BufferedStreamWriters& writers = GetBufferedStreamWriters();
+  std::lock_guard<std::mutex> lock{writers.mutex};
+  writers.writers.push_back(this);
+}
+
+BufferedStreamWriter::~BufferedStreamWriter() {
+  {
+    BufferedStreamWriters& writers = GetBufferedStreamWriters();
+    std::lock_guard<std::mutex> lock{writers.mutex};
+    writers.writers.erase(std::remove(writers.writers.begin(), writers.writers.end(), this), writers.writers.end());
+  }
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    closed_ = true;
+  }
+  cond_.notify_one();
+  thread_.join();
+}
+
+void BufferedStreamWriter::Write(BytesSpan bytes) {
+  const uint8_t* data = bytes.begin();
+  size_t n = bytes.size();
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (n > 0) {
+    output_cond_.wait(lock, [this] { return size_ < ring_.size(); });
+    size_t tail = (head_ + size_) % ring_.size();
+    size_t m = std::min(n, std::min(ring_.size() - size_, ring_.size() - tail));
+    std::memcpy(&ring_[tail], data, m);
+    bool was_empty = size_ == 0;
+    size_ += m;
+    written_ += m;
+    data += m;
+    n -= m;
+    // Wake the background thread to start the timer, or to output the bytes now.
+    if (was_empty || size_ >= flush_size_) {
+      cond_.notify_one();
     }
-    std::string str(buf_.begin(), it);
-    out_ << str << std::endl;
-    ++it;
-    buf_.erase(buf_.begin(), it);
   }
 }
 
-std::size_t Value::Hash::operator()(const Value& value) const {
-  size_t h = 17;
-  h = h * 31 + std::hash<decltype(value.type_)>()(value.type_);
-  h = h * 31 + std::hash<decltype(value.num_value_)>()(value.num_value_);
-  h = h * 31 + std::hash<decltype(value.str_value_)>()(value.str_value_);
-  h = h * 31 + std::hash<decltype(value.object_value_)>()(value.object_value_);
-  h = h * 31 + std::hash<decltype(value.array_value_)>()(value.array_value_);
-  return h;
+void BufferedStreamWriter::Flush() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  uint64_t target = written_;
+  if (output_ >= target) {
+    return;
+  }
+  flusher_num_++;
+  cond_.notify_one();
+  output_cond_.wait(lock, [this, target] { return output_ >= target; });
+  flusher_num_--;
+}
+
+void BufferedStreamWriter::FlushAll() {
+  BufferedStreamWriters& writers = GetBufferedStreamWriters();
+  std::lock_guard<std::mutex> lock{writers.mutex};
+  for (BufferedStreamWriter* w : writers.writers) {
+    w->Flush();
+  }
+}
+
+void BufferedStreamWriter::Loop() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  for (;;) {
+    cond_.wait(lock, [this] { return closed_ || size_ > 0; });
+    if (size_ == 0) {
+      return;
+    }
+    cond_.wait_for(lock, flush_interval_, [this] { return closed_ || flusher_num_ > 0 || size_ >= flush_size_; });
+
+    size_t head = head_;
+    size_t n = size_;
+    lock.unlock();
+    size_t first = std::min(n, ring_.size() - head);
+    out_.write(reinterpret_cast<const char*>(&ring_[head]), first);
+    if (first < n) {
+      out_.write(reinterpret_cast<const char*>(&ring_[0]), n - first);
+    }
+    out_.flush();
+    lock.lock();
+
+    head_ = (head_ + n) % ring_.size();
+    size_ -= n;
+    output_ += n;
+    output_cond_.notify_all();
+  }
 }
 
 Value Value::Null() {
@@ -1457,29 +2419,84 @@ Value::Value(const char* str)
 
 Value::Value(const std::string& str)
     : type_{Type::String},
-      str_value_{str} {
+      ptr_{std::make_shared<std::string>(str)} {
 }
 
 Value::Value(std::shared_ptr<Object> object)
     : type_{Type::Object},
-      object_value_{object} {
+      ptr_{std::move(object)} {
 }
 
 Value::Value(const std::vector<Value>& array)
     : type_{Type::Object},
-      array_value_{std::make_shared<std::vector<Value>>(array.begin(), array.end())} {
+      is_array_{true},
+      ptr_{std::make_shared<std::vector<Value>>(array.begin(), array.end())} {
+}
+
+Value::Value(std::vector<Value>&& array)
+    : type_{Type::Object},
+      is_array_{true},
+      ptr_{std::make_shared<std::vector<Value>>(std::move(array))} {
 }
 
 Value::Value(const Value& rhs) = default;
 
+Value::Value(Value&& rhs) noexcept
+    : type_{rhs.type_},
+      is_array_{rhs.is_array_},
+      num_value_{rhs.num_value_},
+      ptr_{std::move(rhs.ptr_)} {
+  rhs.type_ = Type::Undefined;
+  rhs.is_array_ = false;
+  rhs.num_value_ = 0;
+}
+
 Value& Value::operator=(const Value& rhs) = default;
 
+Value& Value::operator=(Value&& rhs) noexcept {
+  if (this == &rhs) {
+    return *this;
+  }
+  type_ = rhs.type_;
+  is_array_ = rhs.is_array_;
+  num_value_ = rhs.num_value_;
+  ptr_ = std::move(rhs.ptr_);
+  rhs.type_ = Type::Undefined;
+  rhs.is_array_ = false;
+  rhs.num_value_ = 0;
+  return *this;
+}
+
 bool Value::operator==(const Value& rhs) const {
-  return type_ == rhs.type_ &&
-      num_value_ == rhs.num_value_ &&
-      str_value_ == rhs.str_value_ &&
-      object_value_ == rhs.object_value_ &&
-      array_value_ == rhs.array_value_;
+  if (type_ != rhs.type_ || num_value_ != rhs.num_value_) {
+    return false;
+  }
+  if (type_ == Type::String) {
+    return ptr_ == rhs.ptr_ || str_value() == rhs.str_value();
+  }
+  return ptr_ == rhs.ptr_;
+}
+
+const std::string& Value::str_value() const {
+  return *static_cast<const std::string*>(ptr_.get());
+}
+
+Object* Value::object_value() const {
+  if (is_array_) {
+    return nullptr;
+  }
+  return static_cast<Object*>(ptr_.get());
+}
+
+const void* Value::Identity() const {
+  return ptr_.get();
+}
+
+std::vector<Value>* Value::array_value() const {
+  if (!is_array_) {
+    return nullptr;
+  }
+  return static_cast<std::vector<Value>*>(ptr_.get());
 }
 
 Value::Value(Type type)
@@ -1512,15 +2529,15 @@ bool Value::IsString() const {
 }
 
 bool Value::IsBytes() const {
-  return type_ == Type::Object && object_value_->IsBytes();
+  return type_ == Type::Object && object_value() && object_value()->IsBytes();
 }
 
 bool Value::IsObject() const {
-  return type_ == Type::Object && !!object_value_;
+  return type_ == Type::Object && !!object_value();
 }
 
 bool Value::IsArray() const {
-  return type_ == Type::Object && !!array_value_;
+  return type_ == Type::Object && !!array_value();
 }
 
 bool Value::ToBool() const {
@@ -1541,60 +2558,61 @@ std::string Value::ToString() const {
   if (type_ != Type::String) {
     Panic("Value::ToString: the type must be Type::String but not: " + Inspect());
   }
-  return str_value_;
+  return str_value();
 }
 
 BytesSpan Value::ToBytes() {
   if (type_ != Type::Object) {
     Panic("Value::ToBytes: the type must be Type::Object but not: " + Inspect());
   }
-  if (!object_value_) {
-    Panic("Value::ToBytes: object_value_ must not be null");
+  if (!object_value()) {
+    Panic("Value::ToBytes: object_value() must not be null");
   }
-  if (!object_value_->IsBytes()) {
-    Panic("Value::ToBytes: object_value_->IsBytes() must be true");
+  if (!object_value()->IsBytes()) {
+    Panic("Value::ToBytes: object_value()->IsBytes() must be true");
   }
-  return object_value_->ToBytes();
+  return object_value()->ToBytes();
 }
 
 Object& Value::ToObject() {
   if (type_ != Type::Object) {
     Panic("Value::ToObject: the type must be Type::Object but not: " + Inspect());
   }
-  if (!object_value_) {
-    Panic("Value::ToObject: object_value_ must not be null");
+  if (!object_value()) {
+    Panic("Value::ToObject: object_value() must not be null");
   }
-  return *object_value_;
+  return *object_value();
 }
 
 const Object& Value::ToObject() const {
   if (type_ != Type::Object) {
     Panic("Value::ToObject: the type must be Type::Object but not: " + Inspect());
   }
-  if (!object_value_) {
-    Panic("Value::ToObject: object_value_ must not be null");
+  if (!object_value()) {
+    Panic("Value::ToObject: object_value() must not be null");
   }
-  return *object_value_;
+  return *object_value();
 }
 
 std::vector<Value>& Value::ToArray() {
   if (type_ != Type::Object) {
     Panic("Value::ToArray: the type must be Type::Object but not: " + Inspect());
   }
-  if (!array_value_) {
-    Panic("Value::ToArray: array_value_ must not be null");
+  if (!array_value()) {
+    Panic("Value::ToArray: array_value() must not be null");
   }
-  return *array_value_;
+  return *array_value();
 }
 
 std::shared_ptr<ArrayBuffer> Value::ToArrayBuffer() {
   if (type_ != Type::Object) {
     Panic("Value::ToArrayBuffer: the type must be Type::Object but not: " + Inspect());
   }
-  if (!object_value_) {
-    Panic("Value::ToArrayBuffer: object_value_ must not be null");
+  if (!object_value()) {
+    Panic("Value::ToArrayBuffer: object_value() must not be null");
   }
-  return std::static_pointer_cast<ArrayBuffer>(object_value_);
+  // ptr_ holds an Object* converted to void*. Restore the Object* first and then cast it to ArrayBuffer*.
+  return std::shared_ptr<ArrayBuffer>{ptr_, static_cast<ArrayBuffer*>(object_value())};
 }
 
 std::string Value::Inspect() const {
@@ -1612,10 +2630,10 @@ std::string Value::Inspect() const {
   case Type::Object:
     if (IsArray()) {
       std::string str = "[";
-      for (auto& v : *array_value_) {
+      for (auto& v : *array_value()) {
         str += v.Inspect() + " ";
       }
-      if (array_value_->size()) {
+      if (array_value()->size()) {
         str.resize(str.size()-1);
       }
       str += "]";
@@ -1652,6 +2670,10 @@ Value Object::Invoke(Value self, std::vector<Value> args) {
   return Value{};
 };
 
+Value Object::InvokeSpan(Value self, ValueSpan args) {
+  return Invoke(std::move(self), std::vector<Value>(args.begin(), args.end()));
+}
+
 Value Object::New(std::vector<Value> args) {
   // TODO: Make this a pure virtual function?
   Panic("Object::New is not implemented: this: " + Inspect());
@@ -1670,7 +2692,19 @@ ArrayBuffer::ArrayBuffer(size_t size)
     : data_(size) {
 }
 
+ArrayBuffer::ArrayBuffer(std::vector<uint8_t> data)
+    : data_(std::move(data)) {
+}
+
+ArrayBuffer::ArrayBuffer(BytesSpan view)
+    : view_{view},
+      is_view_{true} {
+}
+
 size_t ArrayBuffer::ByteLength() const {
+  if (is_view_) {
+    return view_.size();
+  }
   return data_.size();
 }
 
@@ -1686,6 +2720,9 @@ bool ArrayBuffer::IsBytes() const {
 }
 
 BytesSpan ArrayBuffer::ToBytes() {
+  if (is_view_) {
+    return view_;
+  }
   return BytesSpan{&*data_.begin(), data_.size()};
 }
 
@@ -1773,24 +2810,26 @@ std::string Float32Array::ToString() const {
 DictionaryValues::DictionaryValues() {
 }
 
-DictionaryValues::DictionaryValues(const std::map<std::string, Value>& dict)
-    : dict_{dict} {
+DictionaryValues::DictionaryValues(const std::map<std::string, Value>& dict) {
+  for (auto& kv : dict) {
+    dict_.Set(kv.first, kv.second);
+  }
 }
 
 Value DictionaryValues::Get(const std::string& key) {
-  auto it = dict_.find(key);
-  if (it == dict_.end()) {
+  Value* v = dict_.Find(key);
+  if (!v) {
     return Value{};
   }
-  return it->second;
+  return *v;
 }
 
 void DictionaryValues::Set(const std::string& key, Value object) {
-  dict_[key] = object;
+  dict_.Set(key, std::move(object));
 }
 
 void DictionaryValues::Delete(const std::string& key) {
-  dict_.erase(key);
+  dict_.Erase(key);
 }
 
 std::string DictionaryValues::ToString() const {
@@ -1799,9 +2838,9 @@ std::string DictionaryValues::ToString() const {
 
 std::string DictionaryValues::Inspect() const {
   std::string str = "{";
-  for (auto& kv : dict_) {
-    str += kv.first + ":" + kv.second.Inspect() + " ";
-  }
+  dict_.ForEach([&str](const std::string& key, const Value& value) {
+    str += key + ":" + value.Inspect() + " ";
+  });
   if (dict_.size()) {
     str.resize(str.size()-1);
   }
@@ -1818,10 +2857,22 @@ Function::Function(Object::Func fn, Value self)
       self_(self) {
 }
 
+Function::Function(Object::SpanFunc fn)
+    : Function(fn, {}) {
+}
+
+Function::Function(Object::SpanFunc fn, Value self)
+    : span_fn_(fn),
+      self_(self) {
+}
+
 Value Function::Get(const std::string& key) {
   if (key == "bind") {
     return Value{std::make_shared<Function>(
       [this](Value self, std::vector<Value> args) -> Value {
+        if (span_fn_) {
+          return Value{std::make_shared<Function>(span_fn_, args[0])};
+        }
         return Value{std::make_shared<Function>(fn_, args[0])};
       })};
   }
@@ -1829,15 +2880,41 @@ Value Function::Get(const std::string& key) {
 }
 
 Value Function::Invoke(Value self, std::vector<Value> args) {
-  return fn_(self_, args);
+  if (span_fn_) {
+    return span_fn_(self_, ValueSpan{args.data(), args.size()});
+  }
+  return fn_(self_, std::move(args));
 }
 
-Value Value::Global() {
-  static Value global = MakeGlobal();
+Value Function::InvokeSpan(Value self, ValueSpan args) {
+  if (span_fn_) {
+    return span_fn_(self_, args);
+  }
+  return fn_(self_, std::vector<Value>(args.begin(), args.end()));
+}
+
+namespace {
+
+const Value*& CurrentGlobal() {
+  static thread_local const Value* global = nullptr;
   return global;
 }
 
-Value Value::MakeGlobal() {
+}
+
+Value Value::Global() {
+  const Value* global = CurrentGlobal();
+  if (!global) {
+    Panic("Value::Global: no Go instance runs on the current thread");
+  }
+  return *global;
+}
+
+void Value::SetCurrentGlobal(const Value* global) {
+  CurrentGlobal() = global;
+}
+
+Value Value::NewGlobal() {
   std::shared_ptr<Constructor> arr = std::make_shared<Constructor>("Array",
     [](Value self, std::vector<Value> args) -> Value {
       // TODO: Implement this.
@@ -1948,7 +3025,7 @@ Value Value::MakeGlobal() {
     [](Value self, std::vector<Value> args) -> Value {
       BytesSpan bs = args[0].ToBytes();
       // TODO: Use cryptographically strong random values instead of std::random_device.
-      static std::random_device rd;
+      static thread_local std::random_device rd;
       std::uniform_int_distribution<uint8_t> dist(0, 255);
       for (size_t i = 0; i < bs.size(); i++) {
         bs[i] = dist(rd);
@@ -1983,8 +3060,9 @@ Value Value::MakeGlobal() {
       return Value{};
     });
 
-  static std::shared_ptr<FS> fs = std::make_shared<FS>();
-  static std::shared_ptr<Process> process = std::make_shared<Process>();
+  std::shared_ptr<FS> fs = std::make_shared<FS>();
+  std::shared_ptr<Process> process = std::make_shared<Process>();
+  std::shared_ptr<Net> net = std::make_shared<Net>();
 
   std::shared_ptr<DictionaryValues> global = std::make_shared<DictionaryValues>(std::map<std::string, Value>{
     {"Array", Value{arr}},
@@ -1997,6 +3075,7 @@ Value Value::MakeGlobal() {
     {"crypto", Value{crypto}},
     {"fetch", Value{fetch}},
     {"fs", Value{fs}},
+    {"go2cppNet", Value{net}},
     {"process", Value{process}},
   });
 
@@ -2068,7 +3147,7 @@ Value Value::ReflectConstruct(Value target, std::vector<Value> args) {
       Panic(t.ToString() + " is not a constructor");
       return Value{};
     }
-    return t.New(args);
+    return t.New(std::move(args));
   }
   Panic("new " + target.Inspect() + "(" + JoinObjects(args) + ") cannot be called");
   return Value{};
@@ -2089,19 +3168,26 @@ Value Value::ReflectApply(Value target, Value self, std::vector<Value> args) {
       Panic(t.ToString() + " is a constructor");
       return Value{};
     }
-    return t.Invoke(self, args);
+    return t.Invoke(std::move(self), std::move(args));
   }
   Panic(target.Inspect() + "(" + JoinObjects(args) + ") cannot be called");
   return Value{};
 }
 
+Value Value::ReflectApplySpan(Value target, Value self, ValueSpan args) {
+  if (!target.IsObject() || target.ToObject().IsConstructor()) {
+    return ReflectApply(std::move(target), std::move(self), std::vector<Value>(args.begin(), args.end()));
+  }
+  return target.ToObject().InvokeSpan(std::move(self), args);
+}
+
 Constructor::Constructor(const std::string& name, Object::Func fn)
     : name_(name),
       fn_(fn) {
 }
 
 Value Constructor::New(std::vector<Value> args) {
-  return fn_(Value{}, args);
+  return fn_(Value{}, std::move(args));
 }
 
 std::string Constructor::ToString() const {
@@ -3,67 +3,124 @@
 package gowasm2cpp
 
 import (
-	"os"
 	"path/filepath"
+	"strconv"
 	"text/template"
 )
 
+const dataFileName = "mem.data"
+
 type wasmData struct {
 	Offset int
 	Data   []byte
 }
 
-func writeMem(dir string, incpath string, namespace string, initPageNum int, data []wasmData) error {
+// dataImage returns the data segments laid out as in the linear memory, and the offset of the image. The image is
+// aligned to the page size so that it can be mapped into the linear memory directly.
+func dataImage(data []wasmData, pageSize int) ([]byte, int) {
+	if len(data) == 0 {
+		return nil, 0
+	}
+	start := data[0].Offset
+	end := 0
+	for _, d := range data {
+		if start > d.Offset {
+			start = d.Offset
+		}
+		if end < d.Offset+len(d.Data) {
+			end = d.Offset + len(d.Data)
+		}
+	}
+	start = start / pageSize * pageSize
+	end = (end + pageSize - 1) / pageSize * pageSize
+
+	image := make([]byte, end-start)
+	for _, d := range data {
+		copy(image[d.Offset-start:], d.Data)
+	}
+	return image, start
+}
+
+func writeMem(dir *outputDir, incpath string, namespace string, initPageNum int, data []wasmData, options *Options) error {
 	const pageSize = 64 * 1024
 
-	{
-		f, err := os.Create(filepath.Join(dir, "mem.h"))
-		if err != nil {
+	mode := options.dataMode()
+	var image []byte
+	var imageOffset int
+	if mode != DataModeInline {
+		image, imageOffset = dataImage(data, pageSize)
+		// The data file is always put in the output directory. DataPath is how the program or the assembler finds it.
+		if err := dir.WriteFile(filepath.Base(options.dataPath()), image); err != nil {
 			return err
 		}
-		defer f.Close()
+	}
+
+	{
+		f := dir.Create("mem.h")
 
 		if err := memHTmpl.Execute(f, struct {
 			IncludeGuard string
 			IncludePath  string
 			Namespace    string
 			PageSize     int
+			Checked      bool
 		}{
 			IncludeGuard: includeGuard(namespace) + "_MEM_H",
 			IncludePath:  incpath,
 			Namespace:    namespace,
 			PageSize:     pageSize,
+			Checked:      options.memMode() == MemModeChecked,
 		}); err != nil {
 			return err
 		}
-	}
-	{
-		f, err := os.Create(filepath.Join(dir, "mem.cpp"))
-		if err != nil {
+		if err := f.Close(); err != nil {
 			return err
 		}
-		defer f.Close()
+	}
+	{
+		f := dir.Create("mem.cpp")
 
 		var flatten []byte
-		for _, d := range data {
-			flatten = append(flatten, d.Data...)
+		if mode == DataModeInline {
+			for _, d := range data {
+				flatten = append(flatten, d.Data...)
+			}
 		}
 
 		if err := memCppTmpl.Execute(f, struct {
-			IncludePath string
-			Namespace   string
-			InitPageNum int
-			Data        []wasmData
-			FlattenData []byte
+			IncludeGuard string
+			IncludePath  string
+			Namespace    string
+			InitPageNum  int
+			Data         []wasmData
+			FlattenData  []byte
+			DataMode     DataMode
+			DataPath     string
+			DataPathAsm  string
+			DataSymbol   string
+			DataOffset   int
+			DataSize     int
+			Checked      bool
 		}{
-			IncludePath: incpath,
-			Namespace:   namespace,
-			InitPageNum: initPageNum,
-			Data:        data,
-			FlattenData: flatten,
+			IncludeGuard: includeGuard(namespace),
+			IncludePath:  incpath,
+			Namespace:    namespace,
+			InitPageNum:  initPageNum,
+			Data:         data,
+			FlattenData:  flatten,
+			DataMode:     mode,
+			DataPath:     strconv.Quote(options.dataPath()),
+			DataPathAsm:  strconv.Quote(strconv.Quote(options.dataPath())),
+			DataSymbol:   identifierFromString(namespace) + "_mem_data",
+			DataOffset:   imageOffset,
+			DataSize:     len(image),
+			Checked:      options.memMode() == MemModeChecked,
 		}); err != nil {
 			return err
 		}
+		if err := f.Close(); err != nil {
+			return err
+		}
 	}
 	return nil
 }
@@ -76,6 +133,8 @@ var memHTmpl = template.Must(template.New("mem.h").Parse(`// Code generated by g
 #include "{{.IncludePath}}bytes.h"
 
 #include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -88,73 +147,155 @@ public:
   Mem();
   ~Mem();
 
+  // Restore returns a Mem of page_num pages with the bytes at offset in the file at path, instead of the data
+  // segments. offset must be a multiple of kPageSize. The file is mapped privately where possible, so that only the
+  // pages touched are loaded. Restore returns nullptr on failure.
+  static std::unique_ptr<Mem> Restore(const std::string& path, uint64_t offset, int32_t page_num);
+
   int32_t GetSize() const;
+
+  // Grow never moves the linear memory, so a pointer or a BytesSpan into the memory, like a view made by View,
+  // stays valid after Grow. Such pointers are invalidated only when the Mem is destroyed.
   int32_t Grow(int32_t delta);
 
+  // GetCommittedBytes returns the number of bytes backed by accessible pages.
+  size_t GetCommittedBytes() const;
+
+  // GetReservedBytes returns the number of bytes of address space reserved for the memory, including the guard
+  // region.
+  size_t GetReservedBytes() const;
+
+  // The accessors use memcpy, as an access might be unaligned. The compiler folds a memcpy into a single move.
   inline int8_t LoadInt8(int32_t addr) const {
-    return static_cast<int8_t>(*(bytes_ + addr));
+    return Load<int8_t>(nullptr, addr);
   }
 
   inline uint8_t LoadUint8(int32_t addr) const {
-    return *(bytes_ + addr);
+    return Load<uint8_t>(nullptr, addr);
   }
 
   inline int16_t LoadInt16(int32_t addr) const {
-    return *(reinterpret_cast<const int16_t*>(bytes_ + addr));
+    return Load<int16_t>(nullptr, addr);
   }
 
   inline uint16_t LoadUint16(int32_t addr) const {
-    return *(reinterpret_cast<const uint16_t*>(bytes_ + addr));
+    return Load<uint16_t>(nullptr, addr);
   }
 
   inline int32_t LoadInt32(int32_t addr) const {
-    return *(reinterpret_cast<const int32_t*>(bytes_ + addr));
+    return Load<int32_t>(nullptr, addr);
   }
 
   inline uint32_t LoadUint32(int32_t addr) const {
-    return *(reinterpret_cast<const uint32_t*>(bytes_ + addr));
+    return Load<uint32_t>(nullptr, addr);
   }
 
   inline int64_t LoadInt64(int32_t addr) const {
-    return *(reinterpret_cast<const int64_t*>(bytes_ + addr));
+    return Load<int64_t>(nullptr, addr);
   }
 
   inline float LoadFloat32(int32_t addr) const {
-    return *(reinterpret_cast<const float*>(bytes_ + addr));
+    return Load<float>(nullptr, addr);
   }
 
   inline double LoadFloat64(int32_t addr) const {
-    return *(reinterpret_cast<const double*>(bytes_ + addr));
+    return Load<double>(nullptr, addr);
   }
 
-  void StoreInt8(int32_t addr, int8_t val) {
-    *(bytes_ + addr) = static_cast<uint8_t>(val);
+  inline void StoreInt8(int32_t addr, int8_t val) {
+    Store<int8_t>(nullptr, addr, val);
   }
 
   inline void StoreInt16(int32_t addr, int16_t val) {
-    *(reinterpret_cast<int16_t*>(bytes_ + addr)) = val;
+    Store<int16_t>(nullptr, addr, val);
   }
 
   inline void StoreInt32(int32_t addr, int32_t val) {
-    *(reinterpret_cast<int32_t*>(bytes_ + addr)) = val;
+    Store<int32_t>(nullptr, addr, val);
   }
 
   inline void StoreInt64(int32_t addr, int64_t val) {
-    *(reinterpret_cast<int64_t*>(bytes_ + addr)) = val;
+    Store<int64_t>(nullptr, addr, val);
   }
 
   inline void StoreFloat32(int32_t addr, float val) {
-    *(reinterpret_cast<float*>(bytes_ + addr)) = val;
+    Store<float>(nullptr, addr, val);
   }
 
   inline void StoreFloat64(int32_t addr, double val) {
-    *(reinterpret_cast<double*>(bytes_ + addr)) = val;
+    Store<double>(nullptr, addr, val);
+  }
+
+{{if .Checked}}  // The accessors with func are used by the generated functions to report an invalid access with the function
+  // name.
+  inline int8_t LoadInt8(const char* func, int32_t addr) const {
+    return Load<int8_t>(func, addr);
+  }
+
+  inline uint8_t LoadUint8(const char* func, int32_t addr) const {
+    return Load<uint8_t>(func, addr);
+  }
+
+  inline int16_t LoadInt16(const char* func, int32_t addr) const {
+    return Load<int16_t>(func, addr);
+  }
+
+  inline uint16_t LoadUint16(const char* func, int32_t addr) const {
+    return Load<uint16_t>(func, addr);
+  }
+
+  inline int32_t LoadInt32(const char* func, int32_t addr) const {
+    return Load<int32_t>(func, addr);
+  }
+
+  inline uint32_t LoadUint32(const char* func, int32_t addr) const {
+    return Load<uint32_t>(func, addr);
+  }
+
+  inline int64_t LoadInt64(const char* func, int32_t addr) const {
+    return Load<int64_t>(func, addr);
+  }
+
+  inline float LoadFloat32(const char* func, int32_t addr) const {
+    return Load<float>(func, addr);
+  }
+
+  inline double LoadFloat64(const char* func, int32_t addr) const {
+    return Load<double>(func, addr);
+  }
+
+  inline void StoreInt8(const char* func, int32_t addr, int8_t val) {
+    Store<int8_t>(func, addr, val);
+  }
+
+  inline void StoreInt16(const char* func, int32_t addr, int16_t val) {
+    Store<int16_t>(func, addr, val);
+  }
+
+  inline void StoreInt32(const char* func, int32_t addr, int32_t val) {
+    Store<int32_t>(func, addr, val);
+  }
+
+  inline void StoreInt64(const char* func, int32_t addr, int64_t val) {
+    Store<int64_t>(func, addr, val);
+  }
+
+  inline void StoreFloat32(const char* func, int32_t addr, float val) {
+    Store<float>(func, addr, val);
   }
 
-  void StoreBytes(int32_t addr, const std::vector<uint8_t>& bytes);
+  inline void StoreFloat64(const char* func, int32_t addr, double val) {
+    Store<double>(func, addr, val);
+  }
+
+{{end}}  void StoreBytes(int32_t addr, const std::vector<uint8_t>& bytes);
 
   BytesSpan LoadSlice(int32_t addr);
   BytesSpan LoadSliceDirectly(int64_t array, int32_t len);
+
+  // View returns a span of [addr, addr+len) of the linear memory without copying. View returns an empty span if the
+  // range is out of the current memory.
+  BytesSpan View(int64_t addr, int64_t len);
   std::string LoadString(int32_t addr) const;
 
   int Memcmp(int32_t a, int32_t b, int32_t len);
@@ -162,12 +303,57 @@ public:
   void Memmove(int32_t dst, int32_t src, int32_t count);
   void Memset(int32_t dst, uint8_t ch, int32_t count);
 
+  // Compare compares [a, a+alen) and [b, b+blen) lexicographically and returns -1, 0 or 1.
+  int64_t Compare(int32_t a, int32_t alen, int32_t b, int32_t blen);
+
+  // Count returns the number of ch in [ptr, ptr+len).
+  int64_t Count(int32_t ptr, int32_t len, uint8_t ch);
+
+  // RuneCount returns the number of runes in [ptr, ptr+len) in the same way as Go's utf8.RuneCount.
+  int64_t RuneCount(int32_t ptr, int32_t len);
+
+  // ValidUTF8 reports whether [ptr, ptr+len) is valid UTF-8 in the same way as Go's utf8.Valid.
+  bool ValidUTF8(int32_t ptr, int32_t len);
+
 private:
+  struct Uninitialized {};
+
+  // Mem with Uninitialized only reserves the memory.
+  explicit Mem(Uninitialized);
+
   Mem(const Mem&) = delete;
   Mem& operator=(const Mem&) = delete;
 
-  uint8_t* bytes_;
+  bool Commit(size_t size);
+
+  template<typename T>
+  inline T Load(const char* func, int32_t addr) const {
+    Check(func, addr, sizeof(T));
+    T val;
+    std::memcpy(&val, bytes_ + addr, sizeof(T));
+    return val;
+  }
+
+  template<typename T>
+  inline void Store(const char* func, int32_t addr, T val) {
+    Check(func, addr, sizeof(T));
+    std::memcpy(bytes_ + addr, &val, sizeof(T));
+  }
+
+  inline void Check(const char* func, int64_t addr, int64_t len) const {
+{{- if .Checked}}
+    if (addr < 0 || len < 0 || static_cast<size_t>(addr + len) > size_) {
+      OutOfBounds(func, addr, len);
+    }
+{{- end}}
+  }
+{{if .Checked}}
+  [[noreturn]] void OutOfBounds(const char* func, int64_t addr, int64_t len) const;
+{{end}}
+  uint8_t* bytes_ = nullptr;
   size_t size_ = 0;
+  size_t committed_ = 0;
+  size_t reserved_ = 0;
 };
 
 }
@@ -184,8 +370,55 @@ var memCppTmpl = template.Must(template.New("mem.cpp").Funcs(template.FuncMap{
 #include "{{.IncludePath}}mem.h"
 
 #include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
-
+#include <iostream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define {{.IncludeGuard}}_USE_MMAP
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define {{.IncludeGuard}}_USE_AVX2
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define {{.IncludeGuard}}_USE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define {{.IncludeGuard}}_USE_NEON
+#endif
+{{if eq .DataMode "incbin"}}
+#if defined(__APPLE__)
+#define {{.IncludeGuard}}_DATA_SECTION ".const_data"
+#define {{.IncludeGuard}}_DATA_PREVIOUS ".text"
+#define {{.IncludeGuard}}_DATA_SYMBOL(name) "_" #name
+#elif defined(__GNUC__)
+#define {{.IncludeGuard}}_DATA_SECTION ".section .rodata"
+#define {{.IncludeGuard}}_DATA_PREVIOUS ".previous"
+#define {{.IncludeGuard}}_DATA_SYMBOL(name) #name
+#else
+#error "the incbin data mode requires a GNU-compatible assembler"
+#endif
+
+__asm__(
+    {{.IncludeGuard}}_DATA_SECTION "\n"
+    ".balign 16\n"
+    {{.IncludeGuard}}_DATA_SYMBOL({{.DataSymbol}}) ":\n"
+    ".incbin " {{.DataPathAsm}} "\n"
+    {{.IncludeGuard}}_DATA_PREVIOUS "\n");
+
+extern "C" const uint8_t {{.DataSymbol}}[];
+{{end}}
 namespace {{.Namespace}} {
 
 namespace {
@@ -193,7 +426,10 @@ namespace {
 // 2GB. 4GB seems too big on some machines.
 constexpr size_t kMaxMemorySize = 2ull * 1024ull * 1024ull * 1024ull;
 
-const uint8_t initial_data_[] = {
+// The region after the maximum memory is never committed so that an access beyond the memory traps.
+constexpr size_t kGuardSize = 64ull * 1024ull;
+
+{{if eq .DataMode "inline"}}const uint8_t initial_data_[] = {
   {{range $index, $value := .FlattenData}}{{$value}}, {{if needsNewLine $index}}
   {{end}}{{end}}
 };
@@ -206,13 +442,157 @@ struct WasmData {
 const WasmData initial_data_info_[] = {
   {{range $index, $value := .Data}}{ {{$value.Offset}}, {{len $value.Data}} }, {{if needsNewLine $index}}
   {{end}}{{end}}
-};
+};{{else}}// The data segments are laid out as in the linear memory from kDataOffset.
+constexpr int32_t kDataOffset = {{.DataOffset}};
+constexpr size_t kDataSize = {{.DataSize}};
+{{if eq .DataMode "file"}}constexpr char kDataPath[] = {{.DataPath}};{{end}}{{end}}
+
+void error(const std::string& msg) {
+  std::cerr << msg << std::endl;
+  std::exit(1);
+}
 
+// CountByte returns the number of ch in [p, p+n).
+size_t CountByte(const uint8_t* p, size_t n, uint8_t ch) {
+  size_t count = 0;
+  size_t i = 0;
+#if defined({{.IncludeGuard}}_USE_AVX2)
+  const __m256i c32 = _mm256_set1_epi8(static_cast<char>(ch));
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    count += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, c32))));
+  }
+#endif
+#if defined({{.IncludeGuard}}_USE_SSE2)
+  const __m128i c16 = _mm_set1_epi8(static_cast<char>(ch));
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    count += __builtin_popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, c16))));
+  }
+#elif defined({{.IncludeGuard}}_USE_NEON)
+  const uint8x16_t c16 = vdupq_n_u8(ch);
+  for (; i + 16 <= n; i += 16) {
+    // Each lane is 1 for a match, so the sum fits in a byte.
+    count += vaddvq_u8(vshrq_n_u8(vceqq_u8(vld1q_u8(p + i), c16), 7));
+  }
+#endif
+  for (; i < n; i++) {
+    count += p[i] == ch;
+  }
+  return count;
+}
+
+// ASCIIPrefix returns the length of the ASCII bytes at the beginning of [p, p+n).
+size_t ASCIIPrefix(const uint8_t* p, size_t n) {
+  size_t i = 0;
+#if defined({{.IncludeGuard}}_USE_SSE2)
+  for (; i + 16 <= n; i += 16) {
+    int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+    if (mask) {
+      return i + __builtin_ctz(static_cast<uint32_t>(mask));
+    }
+  }
+#elif defined({{.IncludeGuard}}_USE_NEON)
+  for (; i + 16 <= n; i += 16) {
+    if (vmaxvq_u8(vld1q_u8(p + i)) >= 0x80) {
+      break;
+    }
+  }
+#endif
+  while (i < n && p[i] < 0x80) {
+    i++;
+  }
+  return i;
+}
+
+// UTF8SequenceSize returns the length of the valid UTF-8 sequence starting with a non-ASCII byte at the beginning
+// of [p, p+n), or 0 if the sequence is invalid or short. This accepts the same sequences as Go's unicode/utf8.
+size_t UTF8SequenceSize(const uint8_t* p, size_t n) {
+  uint8_t c = p[0];
+  size_t size = 0;
+  uint8_t lo = 0x80;
+  uint8_t hi = 0xbf;
+  if (c < 0xc2) {
+    return 0;
+  } else if (c < 0xe0) {
+    size = 2;
+  } else if (c < 0xf0) {
+    size = 3;
+    if (c == 0xe0) {
+      lo = 0xa0;
+    } else if (c == 0xed) {
+      hi = 0x9f;
+    }
+  } else if (c < 0xf5) {
+    size = 4;
+    if (c == 0xf0) {
+      lo = 0x90;
+    } else if (c == 0xf4) {
+      hi = 0x8f;
+    }
+  } else {
+    return 0;
+  }
+  if (n < size) {
+    return 0;
+  }
+  if (p[1] < lo || hi < p[1]) {
+    return 0;
+  }
+  for (size_t i = 2; i < size; i++) {
+    if (p[i] < 0x80 || 0xbf < p[i]) {
+      return 0;
+    }
+  }
+  return size;
+}
+
+uint8_t* Reserve(size_t size) {
+#if defined(_WIN32)
+  return reinterpret_cast<uint8_t*>(::VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS));
+#elif defined({{.IncludeGuard}}_USE_MMAP)
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+  void* ptr = ::mmap(nullptr, size, PROT_NONE, flags, -1, 0);
+  if (ptr == MAP_FAILED) {
+    return nullptr;
+  }
+  return reinterpret_cast<uint8_t*>(ptr);
+#else
+  // There is no way to reserve address space on this platform. Allocate the whole memory instead.
+  return reinterpret_cast<uint8_t*>(std::calloc(1, size));
+#endif
+}
+
+void Release(uint8_t* ptr, size_t size) {
+#if defined(_WIN32)
+  ::VirtualFree(ptr, 0, MEM_RELEASE);
+#elif defined({{.IncludeGuard}}_USE_MMAP)
+  ::munmap(ptr, size);
+#else
+  std::free(ptr);
+#endif
+}
+
+}
+
+Mem::Mem(Uninitialized)
+    : reserved_(kMaxMemorySize + kGuardSize) {
+  bytes_ = Reserve(reserved_);
+  if (!bytes_) {
+    error("Mem::Mem: reserving the memory failed");
+  }
 }
 
 Mem::Mem()
-    : size_({{.InitPageNum}} * kPageSize) {
-  bytes_ = reinterpret_cast<uint8_t*>(std::calloc(1, kMaxMemorySize));
+    : Mem(Uninitialized{}) {
+  if (!Commit({{.InitPageNum}} * kPageSize)) {
+    error("Mem::Mem: committing the initial memory failed");
+  }
+  size_ = {{.InitPageNum}} * kPageSize;
+{{if eq .DataMode "inline"}}
   constexpr int32_t info_size = sizeof(initial_data_info_) / sizeof(initial_data_info_[0]);
   int32_t src_offset = 0;
   for (int32_t i = 0; i < info_size; i++) {
@@ -220,10 +600,92 @@ Mem::Mem()
     std::memcpy(bytes_ + info.offset, initial_data_ + src_offset, info.length);
     src_offset += info.length;
   }
+{{- else if eq .DataMode "incbin"}}
+  std::memcpy(bytes_ + kDataOffset, {{.DataSymbol}}, kDataSize);
+{{- else}}
+  if (kDataSize == 0) {
+    return;
+  }
+#if defined({{.IncludeGuard}}_USE_MMAP)
+  // Map the data file privately so that only the pages touched are loaded, and written pages are copied.
+  int fd = ::open(kDataPath, O_RDONLY);
+  if (fd < 0) {
+    error(std::string("Mem::Mem: opening ") + kDataPath + " failed: " + std::strerror(errno));
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != kDataSize) {
+    error(std::string("Mem::Mem: the size of ") + kDataPath + " must be " + std::to_string(kDataSize));
+  }
+  void* ptr = ::mmap(bytes_ + kDataOffset, kDataSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+  if (ptr == MAP_FAILED) {
+    error(std::string("Mem::Mem: mapping ") + kDataPath + " failed: " + std::strerror(errno));
+  }
+  ::close(fd);
+#else
+  std::FILE* f = std::fopen(kDataPath, "rb");
+  if (!f) {
+    error(std::string("Mem::Mem: opening ") + kDataPath + " failed: " + std::strerror(errno));
+  }
+  if (std::fread(bytes_ + kDataOffset, 1, kDataSize, f) != kDataSize) {
+    error(std::string("Mem::Mem: reading ") + kDataPath + " failed");
+  }
+  std::fclose(f);
+#endif
+{{- end}}
 }
 
 Mem::~Mem() {
-  std::free(bytes_);
+  Release(bytes_, reserved_);
+}
+
+std::unique_ptr<Mem> Mem::Restore(const std::string& path, uint64_t offset, int32_t page_num) {
+  size_t size = static_cast<size_t>(page_num) * kPageSize;
+  if (page_num < 0 || size > kMaxMemorySize || offset % kPageSize != 0) {
+    return nullptr;
+  }
+  std::unique_ptr<Mem> mem{new Mem(Uninitialized{})};
+#if defined({{.IncludeGuard}}_USE_MMAP)
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < offset + size) {
+    ::close(fd);
+    return nullptr;
+  }
+  if (size) {
+    void* ptr = ::mmap(mem->bytes_, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, static_cast<off_t>(offset));
+    if (ptr == MAP_FAILED) {
+      ::close(fd);
+      return nullptr;
+    }
+  }
+  ::close(fd);
+  mem->committed_ = size;
+#else
+  if (!mem->Commit(size)) {
+    return nullptr;
+  }
+  std::FILE* f = std::fopen(path.c_str(), "rb");
+  if (!f) {
+    return nullptr;
+  }
+  bool ok = true;
+  for (uint64_t skip = offset; ok && skip > 0;) {
+    // fseek's offset is a long, which might be 32-bit.
+    long n = static_cast<long>(std::min<uint64_t>(skip, 1 << 30));
+    ok = std::fseek(f, n, SEEK_CUR) == 0;
+    skip -= n;
+  }
+  ok = ok && std::fread(mem->bytes_, 1, size, f) == size;
+  std::fclose(f);
+  if (!ok) {
+    return nullptr;
+  }
+#endif
+  mem->size_ = size;
+  return mem;
 }
 
 int32_t Mem::GetSize() const {
@@ -231,36 +693,85 @@ int32_t Mem::GetSize() const {
 }
 
 int32_t Mem::Grow(int32_t delta) {
-  int prev_page_num = GetSize();
-  size_ = std::min(static_cast<size_t>((prev_page_num + delta) * kPageSize), kMaxMemorySize);
+  int32_t prev_page_num = GetSize();
+  if (delta < 0) {
+    return -1;
+  }
+  size_t new_size = (static_cast<size_t>(prev_page_num) + static_cast<size_t>(delta)) * kPageSize;
+  if (new_size > kMaxMemorySize) {
+    return -1;
+  }
+  if (!Commit(new_size)) {
+    return -1;
+  }
+  size_ = new_size;
   return prev_page_num;
 }
 
+size_t Mem::GetCommittedBytes() const {
+  return committed_;
+}
+
+size_t Mem::GetReservedBytes() const {
+  return reserved_;
+}
+
+bool Mem::Commit(size_t size) {
+  if (size <= committed_) {
+    return true;
+  }
+#if defined(_WIN32)
+  if (!::VirtualAlloc(bytes_ + committed_, size - committed_, MEM_COMMIT, PAGE_READWRITE)) {
+    return false;
+  }
+#elif defined({{.IncludeGuard}}_USE_MMAP)
+  if (::mprotect(bytes_ + committed_, size - committed_, PROT_READ | PROT_WRITE) != 0) {
+    return false;
+  }
+#endif
+  committed_ = size;
+  return true;
+}
+
 void Mem::StoreBytes(int32_t addr, const std::vector<uint8_t>& src) {
+  Check(nullptr, addr, src.size());
   std::memcpy(bytes_ + addr, &(*src.begin()), src.size());
 }
 
 BytesSpan Mem::LoadSlice(int32_t addr) {
   int64_t array = LoadInt64(addr);
   int64_t len = LoadInt64(addr + 8);
+  Check(nullptr, array, len);
   return BytesSpan{&*(bytes_ + array), static_cast<BytesSpan::size_type>(len)};
 }
 
 BytesSpan Mem::LoadSliceDirectly(int64_t array, int32_t len) {
+  Check(nullptr, array, len);
   return BytesSpan{&*(bytes_ + array), static_cast<BytesSpan::size_type>(len)};
 }
 
+BytesSpan Mem::View(int64_t addr, int64_t len) {
+  if (addr < 0 || len < 0 || static_cast<size_t>(addr + len) > size_) {
+    return BytesSpan{};
+  }
+  return BytesSpan{bytes_ + addr, static_cast<BytesSpan::size_type>(len)};
+}
+
 std::string Mem::LoadString(int32_t addr) const {
   int64_t saddr = LoadInt64(addr);
   int64_t len = LoadInt64(addr + 8);
+  Check(nullptr, saddr, len);
   return std::string{bytes_ + saddr, bytes_ + saddr + len};
 }
 
 int Mem::Memcmp(int32_t a, int32_t b, int32_t len) {
+  Check(nullptr, a, len);
+  Check(nullptr, b, len);
   return std::memcmp(bytes_ + a, bytes_ + b, len);
 }
 
 int32_t Mem::Memchr(int32_t ptr, int32_t ch, int32_t count) {
+  Check(nullptr, ptr, count);
   void* result = std::memchr(bytes_ + ptr, ch, count);
   if (!result) {
     return 0;
@@ -269,12 +780,85 @@ int32_t Mem::Memchr(int32_t ptr, int32_t ch, int32_t count) {
 }
 
 void Mem::Memmove(int32_t dst, int32_t src, int32_t count) {
+  Check(nullptr, dst, count);
+  Check(nullptr, src, count);
   std::memmove(bytes_ + dst, bytes_ + src, count);
 }
 
 void Mem::Memset(int32_t dst, uint8_t ch, int32_t count) {
+  Check(nullptr, dst, count);
   std::memset(bytes_ + dst, ch, count);
 }
 
+int64_t Mem::Compare(int32_t a, int32_t alen, int32_t b, int32_t blen) {
+  Check(nullptr, a, alen);
+  Check(nullptr, b, blen);
+  int r = std::memcmp(bytes_ + a, bytes_ + b, std::min(alen, blen));
+  if (r < 0) {
+    return -1;
+  }
+  if (r > 0) {
+    return 1;
+  }
+  if (alen < blen) {
+    return -1;
+  }
+  if (alen > blen) {
+    return 1;
+  }
+  return 0;
+}
+
+int64_t Mem::Count(int32_t ptr, int32_t len, uint8_t ch) {
+  Check(nullptr, ptr, len);
+  return static_cast<int64_t>(CountByte(bytes_ + ptr, len, ch));
+}
+
+int64_t Mem::RuneCount(int32_t ptr, int32_t len) {
+  Check(nullptr, ptr, len);
+  const uint8_t* p = bytes_ + ptr;
+  size_t n = static_cast<size_t>(len);
+  int64_t count = 0;
+  size_t i = 0;
+  for (;;) {
+    size_t ascii = ASCIIPrefix(p + i, n - i);
+    count += ascii;
+    i += ascii;
+    if (i >= n) {
+      break;
+    }
+    // An invalid byte is counted as one rune.
+    size_t size = UTF8SequenceSize(p + i, n - i);
+    i += size ? size : 1;
+    count++;
+  }
+  return count;
+}
+
+bool Mem::ValidUTF8(int32_t ptr, int32_t len) {
+  Check(nullptr, ptr, len);
+  const uint8_t* p = bytes_ + ptr;
+  size_t n = static_cast<size_t>(len);
+  size_t i = 0;
+  for (;;) {
+    i += ASCIIPrefix(p + i, n - i);
+    if (i >= n) {
+      return true;
+    }
+    size_t size = UTF8SequenceSize(p + i, n - i);
+    if (!size) {
+      return false;
+    }
+    i += size;
+  }
+}
+{{if .Checked}}
+void Mem::OutOfBounds(const char* func, int64_t addr, int64_t len) const {
+  std::string where = func ? func : "(runtime)";
+  error("Mem: out of bounds memory access in " + where + ": address " + std::to_string(addr) + ", length " +
+        std::to_string(len) + ", memory size " + std::to_string(size_));
+  std::abort();
+}
+{{end}}
 }
 `))
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: Apache-2.0
+
+package gowasm2cpp
+
+import (
+	"bytes"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+)
+
+func TestWriteMemDataPath(t *testing.T) {
+	const pageSize = 64 * 1024
+
+	data := []wasmData{
+		{Offset: pageSize + 16, Data: []byte("hello")},
+	}
+
+	for _, tc := range []struct {
+		mode     DataMode
+		dataPath string
+		fileName string
+	}{
+		{DataModeFile, "", "mem.data"},
+		{DataModeFile, "autogen/app.data", "app.data"},
+		{DataModeFile, "/opt/app/app.data", "app.data"},
+		{DataModeIncbin, "", "mem.data"},
+		{DataModeIncbin, "autogen/app.data", "app.data"},
+	} {
+		dir, err := ioutil.TempDir("", "go2cpp-mem")
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer os.RemoveAll(dir)
+
+		options := &Options{
+			DataMode: tc.mode,
+			DataPath: tc.dataPath,
+		}
+		if err := writeMem(newOutputDir(dir), "", "go2cpp_test", 2, data, options); err != nil {
+			t.Fatal(err)
+		}
+
+		image, err := ioutil.ReadFile(filepath.Join(dir, tc.fileName))
+		if err != nil {
+			t.Errorf("mode: %s, data path: %q: %v", tc.mode, tc.dataPath, err)
+			continue
+		}
+		if len(image) != pageSize || !bytes.Equal(image[16:16+len("hello")], []byte("hello")) {
+			t.Errorf("mode: %s, data path: %q: the data file is not the image of the data segments", tc.mode, tc.dataPath)
+		}
+
+		files, err := ioutil.ReadDir(dir)
+		if err != nil {
+			t.Fatal(err)
+		}
+		for _, f := range files {
+			if f.Name() != tc.fileName && f.Name() != "mem.h" && f.Name() != "mem.cpp" {
+				t.Errorf("mode: %s, data path: %q: unexpected file %s", tc.mode, tc.dataPath, f.Name())
+			}
+		}
+
+		cpp, err := ioutil.ReadFile(filepath.Join(dir, "mem.cpp"))
+		if err != nil {
+			t.Fatal(err)
+		}
+		want := strconv.Quote(options.dataPath())
+		if tc.mode == DataModeIncbin {
+			want = strconv.Quote(want)
+		}
+		if !strings.Contains(string(cpp), want) {
+			t.Errorf("mode: %s, data path: %q: mem.cpp doesn't refer to %s", tc.mode, tc.dataPath, want)
+		}
+	}
+}
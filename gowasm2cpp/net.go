@@ -0,0 +1,470 @@
+// SPDX-License-Identifier: Apache-2.0
+
+package gowasm2cpp
+
+import (
+	"text/template"
+)
+
+func writeNet(dir *outputDir, incpath string, namespace string) error {
+	{
+		f := dir.Create("net.h")
+
+		if err := netHTmpl.Execute(f, struct {
+			IncludeGuard string
+			IncludePath  string
+			Namespace    string
+		}{
+			IncludeGuard: includeGuard(namespace) + "_NET_H",
+			IncludePath:  incpath,
+			Namespace:    namespace,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+	}
+	{
+		f := dir.Create("net.cpp")
+
+		if err := netCppTmpl.Execute(f, struct {
+			IncludePath string
+			Namespace   string
+		}{
+			IncludePath: incpath,
+			Namespace:   namespace,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+var netHTmpl = template.Must(template.New("net.h").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#ifndef {{.IncludeGuard}}
+#define {{.IncludeGuard}}
+
+#include "{{.IncludePath}}taskqueue.h"
+
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace {{.Namespace}} {
+
+// Reactor waits for the readiness of nonblocking file descriptors like sockets on one thread, by epoll on Linux,
+// kqueue on macOS and BSDs, and poll elsewhere. When a file descriptor becomes ready, the task watching it is posted
+// to the thread running Go.
+class Reactor {
+public:
+  enum class Event {
+    Read,
+    Write,
+  };
+
+  // Poster posts a task to the thread running Go. Poster must be concurrent-safe.
+  using Poster = std::function<void(TaskQueue::Task)>;
+
+  // Current returns the Reactor for the current thread, or nullptr if there is none.
+  static Reactor* Current();
+
+  // SetCurrent sets the Reactor for the current thread. reactor can be nullptr.
+  static void SetCurrent(Reactor* reactor);
+
+  explicit Reactor(Poster poster);
+
+  // The destructor stops the thread. The tasks not posted yet are discarded.
+  ~Reactor();
+
+  // Watch posts task once when fd becomes ready for event. A file descriptor has at most one task for each event,
+  // and a new task replaces the old one. A task might be posted spuriously, e.g. when the peer has closed the
+  // connection, so the task should retry the operation and watch again if it would still block.
+  //
+  // Watch must be called on the thread running Go.
+  void Watch(int fd, Event event, TaskQueue::Task task);
+
+  // Unwatch discards the tasks for fd. Unwatch must be called before fd is closed.
+  //
+  // Unwatch must be called on the thread running Go.
+  void Unwatch(int fd);
+
+  // Post posts task to the thread running Go. Post is concurrent-safe.
+  void Post(TaskQueue::Task task);
+
+private:
+  struct Watcher {
+    TaskQueue::Task read;
+    TaskQueue::Task write;
+    // registered reports whether fd is registered to epoll.
+    bool registered = false;
+  };
+
+  Reactor(const Reactor&) = delete;
+  Reactor& operator=(const Reactor&) = delete;
+
+  // Start creates the poller and starts the thread. The thread is started lazily, as most programs never use
+  // sockets.
+  void Start();
+  void Loop();
+  void Wake();
+  // Update updates the interests of fd in the poller. Update must be called with mutex_ locked.
+  void Update(int fd, Watcher& watcher, Event event);
+
+  Poster poster_;
+
+  std::mutex mutex_;
+  bool stopped_ = false;
+  std::unordered_map<int, Watcher> watchers_;
+  // poller_ is the file descriptor of epoll or kqueue.
+  int poller_ = -1;
+  // wake_fds_ is a pipe to wake the thread.
+  int wake_fds_[2] = {-1, -1};
+
+  std::thread thread_;
+};
+
+}
+
+#endif  // {{.IncludeGuard}}
+`))
+
+var netCppTmpl = template.Must(template.New("net.cpp").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#include "{{.IncludePath}}net.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#define GO2CPP_NET_EPOLL 1
+#include <sys/epoll.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#define GO2CPP_NET_KQUEUE 1
+#include <sys/event.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#else
+#include <poll.h>
+#endif
+
+namespace {{.Namespace}} {
+
+namespace {
+
+Reactor*& CurrentReactor() {
+  static thread_local Reactor* reactor = nullptr;
+  return reactor;
+}
+
+void error(const std::string& msg) {
+  std::cerr << msg << ": " << std::strerror(errno) << std::endl;
+  std::exit(1);
+}
+
+// kMaxEvents is the maximum number of the events taken by one wait.
+constexpr int kMaxEvents = 64;
+
+}
+
+Reactor* Reactor::Current() {
+  return CurrentReactor();
+}
+
+void Reactor::SetCurrent(Reactor* reactor) {
+  CurrentReactor() = reactor;
+}
+
+Reactor::Reactor(Poster poster)
+    : poster_{std::move(poster)} {
+}
+
+Reactor::~Reactor() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopped_ = true;
+  }
+  if (thread_.joinable()) {
+    Wake();
+    thread_.join();
+  }
+  if (poller_ != -1) {
+    close(poller_);
+  }
+  for (int fd : wake_fds_) {
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+  if (CurrentReactor() == this) {
+    CurrentReactor() = nullptr;
+  }
+}
+
+void Reactor::Watch(int fd, Event event, TaskQueue::Task task) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (!thread_.joinable()) {
+    Start();
+  }
+  Watcher& w = watchers_[fd];
+  if (event == Event::Read) {
+    w.read = std::move(task);
+  } else {
+    w.write = std::move(task);
+  }
+  Update(fd, w, event);
+}
+
+void Reactor::Unwatch(int fd) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto it = watchers_.find(fd);
+  if (it == watchers_.end()) {
+    return;
+  }
+#if defined(GO2CPP_NET_EPOLL)
+  if (it->second.registered) {
+    epoll_ctl(poller_, EPOLL_CTL_DEL, fd, nullptr);
+  }
+#elif defined(GO2CPP_NET_KQUEUE)
+  // Deleting a filter that was not added fails with ENOENT, which is fine.
+  struct kevent changes[2];
+  EV_SET(&changes[0], fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+  EV_SET(&changes[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+  for (struct kevent& change : changes) {
+    kevent(poller_, &change, 1, nullptr, 0, nullptr);
+  }
+#endif
+  watchers_.erase(it);
+#if !defined(GO2CPP_NET_EPOLL) && !defined(GO2CPP_NET_KQUEUE)
+  // poll might still be waiting for fd.
+  Wake();
+#endif
+}
+
+void Reactor::Post(TaskQueue::Task task) {
+  poster_(std::move(task));
+}
+
+void Reactor::Start() {
+  if (pipe(wake_fds_)) {
+    error("pipe failed");
+  }
+  for (int fd : wake_fds_) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+
+#if defined(GO2CPP_NET_EPOLL)
+  poller_ = epoll_create1(EPOLL_CLOEXEC);
+  if (poller_ == -1) {
+    error("epoll_create1 failed");
+  }
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = wake_fds_[0];
+  if (epoll_ctl(poller_, EPOLL_CTL_ADD, wake_fds_[0], &ev)) {
+    error("epoll_ctl failed");
+  }
+#elif defined(GO2CPP_NET_KQUEUE)
+  poller_ = kqueue();
+  if (poller_ == -1) {
+    error("kqueue failed");
+  }
+  fcntl(poller_, F_SETFD, FD_CLOEXEC);
+  struct kevent change;
+  EV_SET(&change, wake_fds_[0], EVFILT_READ, EV_ADD, 0, 0, nullptr);
+  if (kevent(poller_, &change, 1, nullptr, 0, nullptr) == -1) {
+    error("kevent failed");
+  }
+#endif
+
+  thread_ = std::thread{[this] { Loop(); }};
+}
+
+void Reactor::Wake() {
+  uint8_t b = 0;
+  // If the pipe is full, the thread is going to wake anyway.
+  ssize_t n = write(wake_fds_[1], &b, 1);
+  (void)n;
+}
+
+void Reactor::Update(int fd, Watcher& w, Event event) {
+#if defined(GO2CPP_NET_EPOLL)
+  // A one-shot registration is disabled once it reports an event. The interests are armed again here and in Loop.
+  struct epoll_event ev = {};
+  ev.events = EPOLLONESHOT;
+  if (w.read) {
+    ev.events |= EPOLLIN | EPOLLRDHUP;
+  }
+  if (w.write) {
+    ev.events |= EPOLLOUT;
+  }
+  ev.data.fd = fd;
+  int op = w.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  // If fd was closed without Unwatch, epoll has already forgotten it, and fd might be a new file now.
+  if (epoll_ctl(poller_, op, fd, &ev) && !(op == EPOLL_CTL_MOD && errno == ENOENT && !epoll_ctl(poller_, EPOLL_CTL_ADD, fd, &ev))) {
+    error("epoll_ctl failed");
+  }
+  w.registered = true;
+#elif defined(GO2CPP_NET_KQUEUE)
+  struct kevent change;
+  EV_SET(&change, fd, event == Event::Read ? EVFILT_READ : EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, nullptr);
+  if (kevent(poller_, &change, 1, nullptr, 0, nullptr) == -1) {
+    error("kevent failed");
+  }
+#else
+  Wake();
+#endif
+}
+
+void Reactor::Loop() {
+  struct Ready {
+    int fd;
+    bool read;
+    bool write;
+  };
+  std::vector<Ready> readies;
+  std::vector<TaskQueue::Task> tasks;
+
+#if defined(GO2CPP_NET_EPOLL)
+  struct epoll_event events[kMaxEvents];
+#elif defined(GO2CPP_NET_KQUEUE)
+  struct kevent events[kMaxEvents];
+#else
+  std::vector<struct pollfd> pollfds;
+#endif
+
+  for (;;) {
+    readies.clear();
+    bool woken = false;
+
+#if defined(GO2CPP_NET_EPOLL)
+    int n = epoll_wait(poller_, events, kMaxEvents, -1);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error("epoll_wait failed");
+    }
+    for (int i = 0; i < n; i++) {
+      int fd = events[i].data.fd;
+      if (fd == wake_fds_[0]) {
+        woken = true;
+        continue;
+      }
+      // An error or a hang-up makes both of the operations fail without blocking.
+      uint32_t e = events[i].events;
+      bool both = e & (EPOLLERR | EPOLLHUP);
+      readies.push_back(Ready{fd, both || (e & (EPOLLIN | EPOLLRDHUP)) != 0, both || (e & EPOLLOUT) != 0});
+    }
+#elif defined(GO2CPP_NET_KQUEUE)
+    int n = kevent(poller_, nullptr, 0, events, kMaxEvents, nullptr);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error("kevent failed");
+    }
+    for (int i = 0; i < n; i++) {
+      int fd = static_cast<int>(events[i].ident);
+      if (fd == wake_fds_[0]) {
+        woken = true;
+        continue;
+      }
+      readies.push_back(Ready{fd, events[i].filter == EVFILT_READ, events[i].filter == EVFILT_WRITE});
+    }
+#else
+    pollfds.clear();
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (stopped_) {
+        return;
+      }
+      pollfds.push_back(pollfd{wake_fds_[0], POLLIN, 0});
+      for (auto& kv : watchers_) {
+        short events = 0;
+        if (kv.second.read) {
+          events |= POLLIN;
+        }
+        if (kv.second.write) {
+          events |= POLLOUT;
+        }
+        if (events) {
+          pollfds.push_back(pollfd{kv.first, events, 0});
+        }
+      }
+    }
+    if (poll(pollfds.data(), pollfds.size(), -1) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error("poll failed");
+    }
+    woken = pollfds[0].revents != 0;
+    for (size_t i = 1; i < pollfds.size(); i++) {
+      short e = pollfds[i].revents;
+      if (!e) {
+        continue;
+      }
+      bool both = e & (POLLERR | POLLHUP | POLLNVAL);
+      readies.push_back(Ready{pollfds[i].fd, both || (e & POLLIN) != 0, both || (e & POLLOUT) != 0});
+    }
+#endif
+
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (stopped_) {
+        return;
+      }
+      if (woken) {
+        uint8_t buf[64];
+        while (read(wake_fds_[0], buf, sizeof(buf)) > 0) {
+        }
+      }
+      for (const Ready& r : readies) {
+        auto it = watchers_.find(r.fd);
+        if (it == watchers_.end()) {
+          continue;
+        }
+        Watcher& w = it->second;
+        if (r.read && w.read) {
+          tasks.push_back(std::move(w.read));
+          w.read = TaskQueue::Task{};
+        }
+        if (r.write && w.write) {
+          tasks.push_back(std::move(w.write));
+          w.write = TaskQueue::Task{};
+        }
+#if defined(GO2CPP_NET_EPOLL)
+        // Arm the remaining interest again, as the one-shot registration has been disabled.
+        if (w.read) {
+          Update(r.fd, w, Event::Read);
+        } else if (w.write) {
+          Update(r.fd, w, Event::Write);
+        }
+#endif
+      }
+    }
+
+    // Post the tasks without the lock, so that a poster never waits for the lock held by Watch.
+    for (TaskQueue::Task& task : tasks) {
+      poster_(std::move(task));
+    }
+    tasks.clear();
+  }
+}
+
+}
+`))
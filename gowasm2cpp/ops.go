@@ -11,6 +11,7 @@ import (
 	"sort"
 	"strconv"
 	"strings"
+	"sync/atomic"
 
 	"github.com/go-interpreter/wagon/disasm"
 	"github.com/go-interpreter/wagon/wasm"
@@ -106,6 +107,16 @@ type block struct {
 	typ       blockType
 	ret       string
 	stackvars *stackvar.StackVars
+
+	// scoped reports whether the block or the loop is lowered to a C++ compound statement.
+	scoped bool
+
+	// open is the index of the line opening the compound statement in the body.
+	open int
+
+	// breakable reports whether a branch to the block is lowered to break or continue. If so, the compound
+	// statement is a do-while(false) for a block and a for(;;) for a loop.
+	breakable bool
 }
 
 type blockStack struct {
@@ -148,12 +159,55 @@ func (b *blockStack) PushBlock(btype blockType, ret string) int {
 	return b.indexstack.Push()
 }
 
+// PushScopedBlock pushes a block or a loop that is lowered to a C++ compound statement opened at the line open.
+func (b *blockStack) PushScopedBlock(btype blockType, ret string, open int) int {
+	idx := b.PushBlock(btype, ret)
+	bl := b.blocks[len(b.blocks)-1]
+	bl.scoped = true
+	bl.open = open
+	return idx
+}
+
 func (b *blockStack) PopBlock() (id int, typ blockType, ret string) {
 	bl := b.blocks[len(b.blocks)-1]
 	b.blocks = b.blocks[:len(b.blocks)-1]
 	return b.indexstack.Pop(), bl.typ, bl.ret
 }
 
+// PopScopedBlock pops a block like PopBlock, and returns the lowering information of the compound statement.
+func (b *blockStack) PopScopedBlock() (id int, typ blockType, scoped bool, open int, breakable bool) {
+	bl := b.blocks[len(b.blocks)-1]
+	id, typ, _ = b.PopBlock()
+	return id, typ, bl.scoped, bl.open, bl.breakable
+}
+
+// BreakOrContinue returns a break or continue statement for a branch to the block at the level, if possible.
+//
+// A break or continue can be used only when the target is the innermost block or loop, i.e., when all the
+// blocks inside the target are ifs, which are not breakable in C++.
+func (b *blockStack) BreakOrContinue(level int) (string, bool) {
+	if level >= b.indexstack.Len() {
+		return "", false
+	}
+	for i := 0; i < level; i++ {
+		if b.blocks[len(b.blocks)-1-i].typ != blockTypeIf {
+			return "", false
+		}
+	}
+	bl := b.blocks[len(b.blocks)-1-level]
+	if !bl.scoped {
+		return "", false
+	}
+	bl.breakable = true
+	switch bl.typ {
+	case blockTypeBlock:
+		return "break;", true
+	case blockTypeLoop:
+		return "continue;", true
+	}
+	return "", false
+}
+
 func (b *blockStack) PeepBlock() (id int, typ blockType, ret string) {
 	bl := b.blocks[len(b.blocks)-1]
 	return b.indexstack.Peep(), bl.typ, bl.ret
@@ -330,6 +384,16 @@ func (f *wasmFunc) bodyToCpp() ([]string, error) {
 		}
 	}
 
+	// branch is like gotoOrReturn but uses break or continue instead of goto when possible.
+	branch := func(level int) string {
+		if f.Structured {
+			if s, ok := blockStack.BreakOrContinue(level); ok {
+				return s
+			}
+		}
+		return gotoOrReturn(level)
+	}
+
 	// Some stack variables must not be merged when they are used across multiple blocks.
 	nomerge := map[string]struct{}{}
 
@@ -344,12 +408,25 @@ func (f *wasmFunc) bodyToCpp() ([]string, error) {
 			if t := instr.Immediates[0]; t != wasm.BlockTypeEmpty {
 				return nil, fmt.Errorf("br with a returning value is not implemented yet")
 			}
+			if f.Structured {
+				// The opening line is fixed at End, when whether the block is breakable is known.
+				appendBody("{")
+				blockStack.PushScopedBlock(blockTypeBlock, ret, len(body)-1)
+				break
+			}
 			blockStack.PushBlock(blockTypeBlock, ret)
 		case operators.Loop:
 			var ret string
 			if t := instr.Immediates[0]; t != wasm.BlockTypeEmpty {
 				return nil, fmt.Errorf("br with a returning value is not implemented yet")
 			}
+			if f.Structured {
+				// The label is still needed for gotos from the nested blocks.
+				l := blockStack.PushScopedBlock(blockTypeLoop, ret, len(body)+1)
+				appendBody("label%d:;", l)
+				appendBody("{")
+				break
+			}
 			l := blockStack.PushBlock(blockTypeLoop, ret)
 			appendBody("label%d:;", l)
 		case operators.If:
@@ -372,10 +449,28 @@ func (f *wasmFunc) bodyToCpp() ([]string, error) {
 			if _, _, ret := blockStack.PeepBlock(); ret != "" {
 				return nil, fmt.Errorf("br with a returning value is not implemented yet")
 			}
-			idx, btype, _ := blockStack.PopBlock()
+			idx, btype, scoped, open, breakable := blockStack.PopScopedBlock()
 			if btype == blockTypeIf {
 				appendBody("}")
 			}
+			if scoped {
+				switch {
+				case btype == blockTypeBlock && breakable:
+					body[open] = strings.Replace(body[open], "{", "do {", 1)
+					// Though do-while(false) is a loop, there is no continue for an outer loop in this block,
+					// since a branch to an outer loop is lowered to goto.
+					appendBody("} while (false);")
+				case btype == blockTypeLoop && breakable:
+					body[open] = strings.Replace(body[open], "{", "for (;;) {", 1)
+					// Falling through the end of a loop exits the loop.
+					if !isJump(body[len(body)-1]) {
+						appendBody("break;")
+					}
+					appendBody("}")
+				default:
+					appendBody("}")
+				}
+			}
 			if btype != blockTypeLoop {
 				appendBody("label%d:;", idx)
 			}
@@ -384,7 +479,7 @@ func (f *wasmFunc) bodyToCpp() ([]string, error) {
 				return nil, fmt.Errorf("br with a returning value is not implemented yet")
 			}
 			level := instr.Immediates[0].(uint32)
-			appendBody(gotoOrReturn(int(level)))
+			appendBody(branch(int(level)))
 		case operators.BrIf:
 			if _, _, ret := blockStack.PeepBlock(); ret != "" {
 				return nil, fmt.Errorf("br_if with a returning value is not implemented yet")
@@ -393,7 +488,7 @@ func (f *wasmFunc) bodyToCpp() ([]string, error) {
 			expr, _ := blockStack.PopExpr()
 			appendBody("if (%s) {", optimizeCondition(expr))
 			blockStack.IndentTemporarily()
-			appendBody(gotoOrReturn(int(level)))
+			appendBody(branch(int(level)))
 			blockStack.UnindentTemporarily()
 			appendBody("}")
 		case operators.BrTable:
@@ -401,6 +496,7 @@ func (f *wasmFunc) bodyToCpp() ([]string, error) {
 				return nil, fmt.Errorf("br_table with a returning value is not implemented yet")
 			}
 			expr, _ := blockStack.PopExpr()
+			// A break in a switch exits the switch, then the cases always use goto.
 			appendBody("switch (%s) {", expr)
 			len := int(instr.Immediates[0].(uint32))
 			for i := 0; i < len; i++ {
@@ -441,6 +537,8 @@ func (f *wasmFunc) bodyToCpp() ([]string, error) {
 			var imp string
 			if f.Import {
 				imp = "import_->"
+			} else {
+				args = append([]string{"inst"}, args...)
 			}
 			appendBody("%s%s%s(%s);", ret, imp, identifierFromString(f.Wasm.Name), strings.Join(args, ", "))
 		case operators.CallIndirect:
@@ -463,9 +561,20 @@ func (f *wasmFunc) bodyToCpp() ([]string, error) {
 				ret = fmt.Sprintf("%s %s = ", t.Cpp(), blockStack.PushLhs(t.stackVarType()))
 			}
 
-			appendBody("Type%d stack0_%d_ = funcs_[table_[0][%s]].type%d_;", typeid, tmpidx, idx, typeid)
-			appendBody("%s(this->*stack0_%d_)(%s);", ret, tmpidx, strings.Join(args, ", "))
-			tmpidx++
+			args = append([]string{"inst"}, args...)
+			switch {
+			case t.Devirtualized != nil:
+				appendBody("%s%s(%s);", ret, identifierFromString(t.Devirtualized.Wasm.Name), strings.Join(args, ", "))
+			case t.IndirectTargets != nil:
+				atomic.StoreInt32(&t.indirectCalled, 1)
+				appendBody("%sLookupTableType%d(%s)(%s);", ret, typeid, idx, strings.Join(args, ", "))
+			default:
+				// No function in the table has this type.
+				appendBody("TrapIndirectCall();")
+				if ret != "" {
+					appendBody("%s0;", ret)
+				}
+			}
 
 		case operators.Drop:
 			blockStack.PopExpr()
@@ -1262,9 +1371,14 @@ func (f *wasmFunc) bodyToCpp() ([]string, error) {
 		return nil, fmt.Errorf("unexpected num of return types: %d", len(sig.ReturnTypes))
 	}
 
-	body = aggregateStackVars(body, nomerge)
+	// In the structured mode, every block is a C++ compound statement and no goto bypasses a variable
+	// initialization. Then the stack variables can be kept in their blocks.
+	body = aggregateStackVars(body, nomerge, !f.Structured)
 	body = optimizeGoto(body)
 	body = removeUnusedLabels(body)
+	if f.CacheGlobals {
+		body = cacheGlobals(body, len(sig.ReturnTypes) == 0)
+	}
 
 	return body, nil
 }
@@ -1274,7 +1388,9 @@ var (
 	stackVarDeclRe = regexp.MustCompile(`^\s*((int32_t|int64_t|uint32_t|uint64_t|float|double|Type[0-9]+) (stack([0-9]+)_[0-9]+_))`)
 )
 
-func aggregateStackVars(body []string, nomerge map[string]struct{}) []string {
+// aggregateStackVars renames the stack variables to shorter names, reusing the names among the blocks.
+// If hoist is true, the variables are declared at the beginning of the function.
+func aggregateStackVars(body []string, nomerge map[string]struct{}, hoist bool) []string {
 	// To avoid "jump bypasses variable initialization" errors, all the stack variables must be declared first.
 
 	newVarName := func(t string, idx int) string {
@@ -1308,7 +1424,7 @@ func aggregateStackVars(body []string, nomerge map[string]struct{}) []string {
 			continue
 		}
 
-		if _, ok := nomerge[m[3]]; ok {
+		if _, ok := nomerge[m[3]]; ok && hoist {
 			nomergelines = append(nomergelines, body[i])
 			varmap[m[3]] = m[3]
 			body[i] = ""
@@ -1329,6 +1445,9 @@ func aggregateStackVars(body []string, nomerge map[string]struct{}) []string {
 
 		varmap[m[3]] = newVarName(t, newidx)
 
+		if !hoist {
+			continue
+		}
 		body[i] = strings.Replace(body[i], m[1], m[3], 1)
 		// If the line consists of only a variable name and a semicolon after replacing, remove this.
 		if strings.TrimSpace(body[i]) == m[3]+";" {
@@ -1342,6 +1461,10 @@ func aggregateStackVars(body []string, nomerge map[string]struct{}) []string {
 		})
 	}
 
+	if !hoist {
+		return body
+	}
+
 	var decls []string
 	var ts []string
 	for t := range varnum {
@@ -1367,6 +1490,7 @@ var (
 	caseGotoRe     = regexp.MustCompile(`^\s*(case (\d+)|default): goto (label\d+);$`)
 	returnRe       = regexp.MustCompile(`^\s*(return.*);$`)
 	brtableBeginRe = regexp.MustCompile(`^\s*switch \((local\d+_)\) {$`)
+	scopeOpenRe    = regexp.MustCompile(`^\s*(do |for \(;;\) )?{$`)
 )
 
 func optimizeGoto(body []string) []string {
@@ -1421,7 +1545,12 @@ func optimizeGoto(body []string) []string {
 			continue
 		}
 
-		m2 := labelRe.FindStringSubmatch(body[i-1])
+		// In the structured mode, there can be opening lines of the blocks between the loop label and the switch.
+		j := i - 1
+		for j > 0 && scopeOpenRe.MatchString(body[j]) {
+			j--
+		}
+		m2 := labelRe.FindStringSubmatch(body[j])
 		if m2 == nil {
 			continue
 		}
@@ -1485,6 +1614,100 @@ func optimizeGoto(body []string) []string {
 	return body
 }
 
+var (
+	globalAssignRe = regexp.MustCompile(`\bglobal([0-9]+)_ = `)
+	globalCallRe   = regexp.MustCompile(`\(inst[,)]|\bimport_->`)
+	globalReturnRe = regexp.MustCompile(`^(\s*((case \d+|default):\s*)?)return\b`)
+	globalRefRe    = regexp.MustCompile(`\bglobal([0-9]+)_`)
+)
+
+// cacheGlobals makes the function body work on local copies of the globals, declared by instMemberAliases.
+//
+// The globals are Inst's members and the C++ compiler has to reload them after every store to the memory, as the
+// memory might alias them. Local copies don't alias anything. A callee, including an import that might resume the
+// Go program, can read and write the globals, so the assigned globals are written back before a call and every
+// global is reloaded after a call. The assigned globals are also written back before returning.
+func cacheGlobals(body []string, void bool) []string {
+	used := map[int]struct{}{}
+	assigned := map[int]struct{}{}
+	for _, l := range body {
+		for _, m := range globalRefRe.FindAllStringSubmatch(l, -1) {
+			idx, _ := strconv.Atoi(m[1])
+			used[idx] = struct{}{}
+		}
+		for _, m := range globalAssignRe.FindAllStringSubmatch(l, -1) {
+			idx, _ := strconv.Atoi(m[1])
+			assigned[idx] = struct{}{}
+		}
+	}
+	if len(used) == 0 {
+		return body
+	}
+
+	sorted := func(m map[int]struct{}) []int {
+		var r []int
+		for idx := range m {
+			r = append(r, idx)
+		}
+		sort.Ints(r)
+		return r
+	}
+	var writeBack, reload []string
+	for _, idx := range sorted(assigned) {
+		writeBack = append(writeBack, fmt.Sprintf("inst->global%d_ = global%d_;", idx, idx))
+	}
+	for _, idx := range sorted(used) {
+		reload = append(reload, fmt.Sprintf("global%d_ = inst->global%d_;", idx, idx))
+	}
+
+	indent := func(l string) string {
+		return l[:len(l)-len(strings.TrimLeft(l, " "))]
+	}
+
+	r := make([]string, 0, len(body))
+	for _, l := range body {
+		if m := globalReturnRe.FindStringSubmatch(l); m != nil {
+			if len(writeBack) == 0 {
+				r = append(r, l)
+				continue
+			}
+			// A case label can be followed by multiple statements.
+			if m[2] != "" {
+				r = append(r, m[1]+strings.Join(writeBack, " ")+" "+l[len(m[1]):])
+				continue
+			}
+			for _, w := range writeBack {
+				r = append(r, indent(l)+w)
+			}
+			r = append(r, l)
+			continue
+		}
+		if globalCallRe.MatchString(l) {
+			for _, w := range writeBack {
+				r = append(r, indent(l)+w)
+			}
+			r = append(r, l)
+			for _, w := range reload {
+				r = append(r, indent(l)+w)
+			}
+			continue
+		}
+		r = append(r, l)
+	}
+	if void && (len(r) == 0 || !isJump(r[len(r)-1])) {
+		for _, w := range writeBack {
+			r = append(r, "  "+w)
+		}
+	}
+	return r
+}
+
+// isJump reports whether the line is an unconditional jump.
+func isJump(line string) bool {
+	l := strings.TrimSpace(line)
+	return l == "break;" || l == "continue;" || strings.HasPrefix(l, "goto ") || returnRe.MatchString(l)
+}
+
 func removeUnusedLabels(body []string) []string {
 	labels := map[string]int{}
 	gotos := map[string]struct{}{}
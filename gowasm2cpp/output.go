@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: Apache-2.0
+
+package gowasm2cpp
+
+import (
+	"bytes"
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"sort"
+	"sync"
+)
+
+const manifestFileName = "manifest.json"
+
+// outputDir is a directory for the generated files.
+//
+// A file is written only when its content differs from the existing file, so that the modification times of the
+// unchanged files are kept and build systems don't recompile them.
+type outputDir struct {
+	path string
+
+	m       sync.Mutex
+	files   map[string]string
+	changed []string
+}
+
+func newOutputDir(path string) *outputDir {
+	return &outputDir{
+		path:  path,
+		files: map[string]string{},
+	}
+}
+
+// outputFile is a file in an outputDir. The content is written at Close.
+type outputFile struct {
+	dir    *outputDir
+	name   string
+	buf    bytes.Buffer
+	closed bool
+}
+
+// Create creates a new file with the name in the directory.
+func (d *outputDir) Create(name string) *outputFile {
+	return &outputFile{
+		dir:  d,
+		name: name,
+	}
+}
+
+// WriteFile writes the content to the file with the name in the directory.
+func (d *outputDir) WriteFile(name string, content []byte) error {
+	f := d.Create(name)
+	if _, err := f.Write(content); err != nil {
+		return err
+	}
+	return f.Close()
+}
+
+func (f *outputFile) Write(p []byte) (int, error) {
+	return f.buf.Write(p)
+}
+
+func (f *outputFile) Close() error {
+	if f.closed {
+		return nil
+	}
+	f.closed = true
+
+	content := f.buf.Bytes()
+	sum := sha256.Sum256(content)
+	hash := hex.EncodeToString(sum[:])
+
+	path := filepath.Join(f.dir.path, f.name)
+	changed := true
+	if old, err := ioutil.ReadFile(path); err == nil && bytes.Equal(old, content) {
+		changed = false
+	}
+	if changed {
+		if err := ioutil.WriteFile(path, content, 0644); err != nil {
+			return err
+		}
+	}
+
+	f.dir.m.Lock()
+	defer f.dir.m.Unlock()
+	f.dir.files[f.name] = hash
+	if changed {
+		f.dir.changed = append(f.dir.changed, f.name)
+	}
+	return nil
+}
+
+// manifest is the content of manifest.json, which describes the generated files.
+type manifest struct {
+	// Files maps the file names to the SHA-256 hashes of their contents.
+	Files map[string]string `json:"files"`
+
+	// Changed is the names of the files that were written by the last generation.
+	Changed []string `json:"changed"`
+
+	// ShardBoundaries is the name of the first function of each inst.funcs.*.cpp. This is used to keep the
+	// assignment of the functions to the shards across generations.
+	ShardBoundaries []string `json:"shardBoundaries"`
+}
+
+func readManifest(dir string) *manifest {
+	content, err := ioutil.ReadFile(filepath.Join(dir, manifestFileName))
+	if err != nil {
+		return nil
+	}
+	var m manifest
+	if err := json.Unmarshal(content, &m); err != nil {
+		return nil
+	}
+	return &m
+}
+
+// writeManifest writes manifest.json and removes the files generated previously but not by this generation.
+func (d *outputDir) writeManifest(old *manifest, shardBoundaries []string) error {
+	d.m.Lock()
+	m := manifest{
+		Files:           d.files,
+		Changed:         append([]string{}, d.changed...),
+		ShardBoundaries: shardBoundaries,
+	}
+	d.m.Unlock()
+	sort.Strings(m.Changed)
+
+	if old != nil {
+		for name := range old.Files {
+			if _, ok := m.Files[name]; ok {
+				continue
+			}
+			if err := os.Remove(filepath.Join(d.path, name)); err != nil && !os.IsNotExist(err) {
+				return err
+			}
+		}
+	}
+
+	content, err := json.MarshalIndent(&m, "", "  ")
+	if err != nil {
+		return err
+	}
+	content = append(content, '\n')
+	return ioutil.WriteFile(filepath.Join(d.path, manifestFileName), content, 0644)
+}
@@ -0,0 +1,301 @@
+// SPDX-License-Identifier: Apache-2.0
+
+package gowasm2cpp
+
+import (
+	"bytes"
+	"compress/gzip"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io/ioutil"
+	"regexp"
+	"sort"
+)
+
+// temperature is how often a function runs according to a profile.
+type temperature int
+
+const (
+	temperatureNormal temperature = iota
+	temperatureHot
+	temperatureCold
+)
+
+// Attr returns the macro for the function attributes, which inst.h defines.
+func (t temperature) Attr() string {
+	switch t {
+	case temperatureHot:
+		return "GO2CPP_HOT "
+	case temperatureCold:
+		return "GO2CPP_COLD "
+	default:
+		return ""
+	}
+}
+
+// hotCoverage is the ratio of the self samples that the hot functions cover.
+const hotCoverage = 0.9
+
+// coldFuncRe matches the functions for panics and fatal errors. Such a function is cold unless the profile has it.
+var coldFuncRe = regexp.MustCompile(`^runtime\.(throw|fatal|gopanic|goPanic|panic|dopanic|startpanic|printpanic|badmorestack|morestackc|sigpanic)`)
+
+// nonWasmNameRe matches the characters that Go's linker replaces with '_' in the Wasm function names, e.g.
+// fmt.(*pp).printArg is fmt.__pp_.printArg and crypto/sha256.block is crypto_sha256.block in Wasm.
+var nonWasmNameRe = regexp.MustCompile(`[^\w.]`)
+
+// funcProfile is the samples per Go function in a pprof profile, e.g. a profile written by Profiler or by
+// runtime/pprof. The functions are keyed by the Wasm function names.
+type funcProfile struct {
+	// self is the number of the samples where the function is the leaf.
+	self map[string]int64
+	// total is the number of the samples where the function is on the stack.
+	total map[string]int64
+}
+
+// temperatures returns the temperatures of the functions by the names.
+//
+// The hot functions are the fewest functions that cover hotCoverage of the self samples. The cold functions are the
+// functions for panics and fatal errors that are never sampled.
+func (p *funcProfile) temperatures(funcs []*wasmFunc) map[*wasmFunc]temperature {
+	var names []string
+	var selfSum int64
+	for name, n := range p.self {
+		names = append(names, name)
+		selfSum += n
+	}
+	sort.Slice(names, func(a, b int) bool {
+		if p.self[names[a]] != p.self[names[b]] {
+			return p.self[names[a]] > p.self[names[b]]
+		}
+		return names[a] < names[b]
+	})
+	hot := map[string]struct{}{}
+	var acc int64
+	for _, name := range names {
+		if float64(acc) >= float64(selfSum)*hotCoverage {
+			break
+		}
+		hot[name] = struct{}{}
+		acc += p.self[name]
+	}
+
+	ts := map[*wasmFunc]temperature{}
+	for _, f := range funcs {
+		if _, ok := hot[f.Wasm.Name]; ok {
+			ts[f] = temperatureHot
+			continue
+		}
+		if p.total[f.Wasm.Name] == 0 && coldFuncRe.MatchString(f.Wasm.Name) {
+			ts[f] = temperatureCold
+		}
+	}
+	return ts
+}
+
+// protoField is a field of a protocol buffer message.
+type protoField struct {
+	num    int
+	varint uint64
+	bytes  []byte
+}
+
+// protoFields decodes the fields of a protocol buffer message.
+func protoFields(msg []byte) ([]protoField, error) {
+	var fs []protoField
+	for len(msg) > 0 {
+		key, n := binary.Uvarint(msg)
+		if n <= 0 {
+			return nil, errors.New("invalid varint")
+		}
+		msg = msg[n:]
+		f := protoField{num: int(key >> 3)}
+		switch key & 7 {
+		case 0:
+			v, n := binary.Uvarint(msg)
+			if n <= 0 {
+				return nil, errors.New("invalid varint")
+			}
+			f.varint = v
+			msg = msg[n:]
+		case 1:
+			if len(msg) < 8 {
+				return nil, errors.New("unexpected end of a message")
+			}
+			f.varint = binary.LittleEndian.Uint64(msg)
+			msg = msg[8:]
+		case 2:
+			l, n := binary.Uvarint(msg)
+			if n <= 0 || uint64(len(msg)-n) < l {
+				return nil, errors.New("invalid length")
+			}
+			f.bytes = msg[n : n+int(l)]
+			msg = msg[n+int(l):]
+		case 5:
+			if len(msg) < 4 {
+				return nil, errors.New("unexpected end of a message")
+			}
+			f.varint = uint64(binary.LittleEndian.Uint32(msg))
+			msg = msg[4:]
+		default:
+			return nil, fmt.Errorf("unsupported wire type: %d", key&7)
+		}
+		fs = append(fs, f)
+	}
+	return fs, nil
+}
+
+// protoVarints returns the varints of a repeated field, which is either packed or not.
+func protoVarints(dst []uint64, f protoField) ([]uint64, error) {
+	if f.bytes == nil {
+		return append(dst, f.varint), nil
+	}
+	b := f.bytes
+	for len(b) > 0 {
+		v, n := binary.Uvarint(b)
+		if n <= 0 {
+			return nil, errors.New("invalid varint")
+		}
+		dst = append(dst, v)
+		b = b[n:]
+	}
+	return dst, nil
+}
+
+// readFuncProfile reads a pprof profile, which is gzipped or not, and counts the first sample values per function.
+//
+// See https://github.com/google/pprof/blob/master/proto/profile.proto for the format.
+func readFuncProfile(path string) (*funcProfile, error) {
+	content, err := ioutil.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	if len(content) >= 2 && content[0] == 0x1f && content[1] == 0x8b {
+		r, err := gzip.NewReader(bytes.NewReader(content))
+		if err != nil {
+			return nil, err
+		}
+		content, err = ioutil.ReadAll(r)
+		if err != nil {
+			return nil, err
+		}
+	}
+
+	fields, err := protoFields(content)
+	if err != nil {
+		return nil, fmt.Errorf("%s: %v", path, err)
+	}
+
+	type sample struct {
+		locations []uint64
+		value     int64
+	}
+	var samples []sample
+	// locationFuncs maps a location ID to the function IDs, from the innermost.
+	locationFuncs := map[uint64][]uint64{}
+	funcNames := map[uint64]uint64{}
+	var strs []string
+
+	for _, f := range fields {
+		switch f.num {
+		case 2: // Sample
+			sfs, err := protoFields(f.bytes)
+			if err != nil {
+				return nil, err
+			}
+			var s sample
+			var values []uint64
+			for _, sf := range sfs {
+				switch sf.num {
+				case 1:
+					if s.locations, err = protoVarints(s.locations, sf); err != nil {
+						return nil, err
+					}
+				case 2:
+					if values, err = protoVarints(values, sf); err != nil {
+						return nil, err
+					}
+				}
+			}
+			if len(values) > 0 {
+				s.value = int64(values[0])
+			}
+			samples = append(samples, s)
+		case 4: // Location
+			lfs, err := protoFields(f.bytes)
+			if err != nil {
+				return nil, err
+			}
+			var id uint64
+			var funcIDs []uint64
+			for _, lf := range lfs {
+				switch lf.num {
+				case 1:
+					id = lf.varint
+				case 4: // Line
+					lnfs, err := protoFields(lf.bytes)
+					if err != nil {
+						return nil, err
+					}
+					for _, lnf := range lnfs {
+						if lnf.num == 1 {
+							funcIDs = append(funcIDs, lnf.varint)
+						}
+					}
+				}
+			}
+			locationFuncs[id] = funcIDs
+		case 5: // Function
+			ffs, err := protoFields(f.bytes)
+			if err != nil {
+				return nil, err
+			}
+			var id, name uint64
+			for _, ff := range ffs {
+				switch ff.num {
+				case 1:
+					id = ff.varint
+				case 2:
+					name = ff.varint
+				}
+			}
+			funcNames[id] = name
+		case 6: // string_table
+			strs = append(strs, string(f.bytes))
+		}
+	}
+
+	funcName := func(id uint64) string {
+		idx, ok := funcNames[id]
+		if !ok || idx >= uint64(len(strs)) {
+			return ""
+		}
+		// A profile by runtime/pprof has the symbol names, and a profile by Profiler has the Wasm names already.
+		return nonWasmNameRe.ReplaceAllString(strs[idx], "_")
+	}
+
+	p := &funcProfile{
+		self:  map[string]int64{},
+		total: map[string]int64{},
+	}
+	for _, s := range samples {
+		seen := map[string]struct{}{}
+		for i, loc := range s.locations {
+			for j, id := range locationFuncs[loc] {
+				name := funcName(id)
+				if name == "" {
+					continue
+				}
+				if i == 0 && j == 0 {
+					p.self[name] += s.value
+				}
+				if _, ok := seen[name]; ok {
+					continue
+				}
+				seen[name] = struct{}{}
+				p.total[name] += s.value
+			}
+		}
+	}
+	return p, nil
+}
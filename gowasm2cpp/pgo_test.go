@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: Apache-2.0
+
+package gowasm2cpp
+
+import (
+	"bytes"
+	"compress/gzip"
+	"encoding/binary"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+
+	"github.com/go-interpreter/wagon/wasm"
+)
+
+// testProto encodes a protocol buffer message for tests.
+type testProto struct {
+	buf []byte
+}
+
+func (p *testProto) varint(v uint64) {
+	var b [binary.MaxVarintLen64]byte
+	n := binary.PutUvarint(b[:], v)
+	p.buf = append(p.buf, b[:n]...)
+}
+
+func (p *testProto) Varint(field int, v uint64) {
+	p.varint(uint64(field) << 3)
+	p.varint(v)
+}
+
+func (p *testProto) Bytes(field int, b []byte) {
+	p.varint(uint64(field)<<3 | 2)
+	p.varint(uint64(len(b)))
+	p.buf = append(p.buf, b...)
+}
+
+func (p *testProto) PackedVarints(field int, vs ...uint64) {
+	var packed testProto
+	for _, v := range vs {
+		packed.varint(v)
+	}
+	p.Bytes(field, packed.buf)
+}
+
+// testProfile returns a pprof profile with the samples of the stacks of function names, from the leaf to the root.
+// Each location has one function whose ID is the same as the location's.
+func testProfile(names []string, samples []struct {
+	stack []uint64
+	value uint64
+}) []byte {
+	var profile testProto
+	strs := []string{""}
+	for i, s := range samples {
+		var sample testProto
+		if i%2 == 0 {
+			sample.PackedVarints(1, s.stack...)
+		} else {
+			// A repeated field can also be unpacked.
+			for _, loc := range s.stack {
+				sample.Varint(1, loc)
+			}
+		}
+		sample.PackedVarints(2, s.value, s.value*10000000)
+		profile.Bytes(2, sample.buf)
+	}
+	for i, name := range names {
+		id := uint64(i + 1)
+
+		var line testProto
+		line.Varint(1, id)
+		var location testProto
+		location.Varint(1, id)
+		location.Bytes(4, line.buf)
+		profile.Bytes(4, location.buf)
+
+		var function testProto
+		function.Varint(1, id)
+		function.Varint(2, uint64(len(strs)))
+		strs = append(strs, name)
+		profile.Bytes(5, function.buf)
+	}
+	for _, str := range strs {
+		profile.Bytes(6, []byte(str))
+	}
+	return profile.buf
+}
+
+func TestReadFuncProfile(t *testing.T) {
+	dir, err := ioutil.TempDir("", "go2cpp-pgo")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	// The names are the symbol names as runtime/pprof writes them.
+	content := testProfile([]string{
+		"github.com/hajimehoshi/go2cpp/example.(*spinner).spin",
+		"main.caller",
+		"main.normal",
+	}, []struct {
+		stack []uint64
+		value uint64
+	}{
+		{[]uint64{1, 2}, 90},
+		{[]uint64{3, 2}, 10},
+		// A recursive call is counted once for the total.
+		{[]uint64{1, 1, 2}, 5},
+	})
+
+	raw := filepath.Join(dir, "cpu.raw.pprof")
+	if err := ioutil.WriteFile(raw, content, 0644); err != nil {
+		t.Fatal(err)
+	}
+	// runtime/pprof writes a gzipped profile.
+	var gzipped bytes.Buffer
+	w := gzip.NewWriter(&gzipped)
+	if _, err := w.Write(content); err != nil {
+		t.Fatal(err)
+	}
+	if err := w.Close(); err != nil {
+		t.Fatal(err)
+	}
+	gz := filepath.Join(dir, "cpu.pprof")
+	if err := ioutil.WriteFile(gz, gzipped.Bytes(), 0644); err != nil {
+		t.Fatal(err)
+	}
+
+	// The names are mangled as Go's linker does for Wasm.
+	const (
+		hot    = "github.com_hajimehoshi_go2cpp_example.__spinner_.spin"
+		caller = "main.caller"
+		normal = "main.normal"
+		cold   = "runtime.gopanic"
+	)
+	funcs := map[string]*wasmFunc{}
+	var fs []*wasmFunc
+	for _, name := range []string{hot, caller, normal, cold} {
+		f := &wasmFunc{Wasm: wasm.Function{Name: name}}
+		funcs[name] = f
+		fs = append(fs, f)
+	}
+
+	for _, path := range []string{gz, raw} {
+		p, err := readFuncProfile(path)
+		if err != nil {
+			t.Fatalf("readFuncProfile(%q): %v", path, err)
+		}
+
+		wantSelf := map[string]int64{
+			hot:    95,
+			normal: 10,
+		}
+		wantTotal := map[string]int64{
+			hot:    95,
+			caller: 105,
+			normal: 10,
+		}
+		if len(p.self) != len(wantSelf) {
+			t.Errorf("%s: self: got: %v, want: %v", path, p.self, wantSelf)
+		}
+		for name, w := range wantSelf {
+			if got := p.self[name]; got != w {
+				t.Errorf("%s: self of %s: got: %d, want: %d", path, name, got, w)
+			}
+		}
+		if len(p.total) != len(wantTotal) {
+			t.Errorf("%s: total: got: %v, want: %v", path, p.total, wantTotal)
+		}
+		for name, w := range wantTotal {
+			if got := p.total[name]; got != w {
+				t.Errorf("%s: total of %s: got: %d, want: %d", path, name, got, w)
+			}
+		}
+
+		ts := p.temperatures(fs)
+		want := map[string]temperature{
+			hot:    temperatureHot,
+			caller: temperatureNormal,
+			normal: temperatureNormal,
+			cold:   temperatureCold,
+		}
+		for name, w := range want {
+			if got := ts[funcs[name]]; got != w {
+				t.Errorf("%s: temperature of %s: got: %d, want: %d", path, name, got, w)
+			}
+		}
+	}
+}
@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: Apache-2.0
+
+package gowasm2cpp
+
+import (
+	"text/template"
+)
+
+func writePool(dir *outputDir, incpath string, namespace string) error {
+	{
+		f := dir.Create("pool.h")
+
+		if err := poolHTmpl.Execute(f, struct {
+			IncludeGuard string
+			IncludePath  string
+			Namespace    string
+		}{
+			IncludeGuard: includeGuard(namespace) + "_POOL_H",
+			IncludePath:  incpath,
+			Namespace:    namespace,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+	}
+	{
+		f := dir.Create("pool.cpp")
+
+		if err := poolCppTmpl.Execute(f, struct {
+			IncludePath string
+			Namespace   string
+		}{
+			IncludePath: incpath,
+			Namespace:   namespace,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+var poolHTmpl = template.Must(template.New("pool.h").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#ifndef {{.IncludeGuard}}
+#define {{.IncludeGuard}}
+
+#include "{{.IncludePath}}bytes.h"
+#include "{{.IncludePath}}go.h"
+#include "{{.IncludePath}}js.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {{.Namespace}} {
+
+// GoPool runs multiple instances of the Go program on their own threads. This is experimental.
+//
+// Each instance has its own Mem, Inst and global object, and the instances share nothing. The host and the instances
+// communicate by messages. A Go program accesses the pool via the global object 'go2cppPool':
+//
+//   go2cppPool.id                      The index of the instance.
+//   go2cppPool.size                    The number of the instances.
+//   go2cppPool.onmessage = f           f(from, data) is called with a message. from is -1 for the host.
+//   go2cppPool.postMessage(to, data)   Sends a Uint8Array data to the instance to, or to the host if to is -1.
+//
+// A message's bytes are shared between the sender and the receiver without copying. The sender must not modify the
+// bytes after sending them.
+class GoPool {
+public:
+  static constexpr int kHost = -1;
+  static constexpr int kAnyInstance = -2;
+
+  class Message {
+  public:
+    Message();
+    explicit Message(std::vector<uint8_t> data);
+    Message(std::shared_ptr<ArrayBuffer> buffer, size_t offset, size_t length);
+
+    BytesSpan Bytes() const;
+    size_t size() const;
+
+    // ToValue returns a Uint8Array viewing the bytes.
+    Value ToValue() const;
+
+  private:
+    std::shared_ptr<ArrayBuffer> buffer_;
+    size_t offset_ = 0;
+    size_t length_ = 0;
+  };
+
+  // Handler is called with messages sent to the host. Handler is called on the sender's thread.
+  using Handler = std::function<void(int from, Message message)>;
+
+  explicit GoPool(int size);
+
+  // The destructor waits for all the instances to exit.
+  ~GoPool();
+
+  // SetHostHandler must be called before Start.
+  void SetHostHandler(Handler handler);
+
+  // Start runs the Go program on each instance with args. Start must be called once.
+  void Start(const std::vector<std::string>& args);
+
+  // Post sends a message from the host to the instance. If instance is kAnyInstance, the instance with the fewest
+  // pending messages is chosen. Post is concurrent-safe.
+  void Post(int instance, Message message);
+
+  // Wait waits for all the instances to exit, and returns their exit codes.
+  std::vector<int> Wait();
+
+  int size() const;
+
+private:
+  class PoolObject : public Object {
+  public:
+    PoolObject(GoPool* pool, int id);
+
+    Value Get(const std::string& key) override;
+    void Set(const std::string& key, Value value) override;
+    std::string ToString() const override { return "GoPool"; }
+
+    void Dispatch(int from, Message message);
+
+  private:
+    GoPool* pool_;
+    int id_;
+    Value onmessage_;
+    std::vector<std::pair<int, Message>> pending_messages_;
+  };
+
+  struct Instance {
+    Go go;
+    std::thread thread;
+    std::shared_ptr<PoolObject> object;
+    // The number of messages posted but not dispatched yet.
+    std::atomic<int> pending{0};
+    int exit_code = 0;
+  };
+
+  GoPool(const GoPool&) = delete;
+  GoPool& operator=(const GoPool&) = delete;
+
+  void Send(int from, int to, Message message);
+
+  std::vector<std::unique_ptr<Instance>> instances_;
+  Handler host_handler_;
+  bool started_ = false;
+};
+
+}
+
+#endif  // {{.IncludeGuard}}
+`))
+
+var poolCppTmpl = template.Must(template.New("pool.cpp").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#include "{{.IncludePath}}pool.h"
+
+#include <iostream>
+
+namespace {{.Namespace}} {
+
+namespace {
+
+void error(const std::string& msg) {
+  std::cerr << msg << std::endl;
+  std::exit(1);
+}
+
+}
+
+GoPool::Message::Message() = default;
+
+GoPool::Message::Message(std::vector<uint8_t> data)
+    : length_{data.size()} {
+  buffer_ = std::make_shared<ArrayBuffer>(std::move(data));
+}
+
+GoPool::Message::Message(std::shared_ptr<ArrayBuffer> buffer, size_t offset, size_t length)
+    : buffer_{std::move(buffer)},
+      offset_{offset},
+      length_{length} {
+}
+
+BytesSpan GoPool::Message::Bytes() const {
+  if (!buffer_) {
+    return BytesSpan{};
+  }
+  return BytesSpan{buffer_->ToBytes().begin() + offset_, length_};
+}
+
+size_t GoPool::Message::size() const {
+  return length_;
+}
+
+Value GoPool::Message::ToValue() const {
+  std::shared_ptr<ArrayBuffer> buffer = buffer_;
+  if (!buffer) {
+    buffer = std::make_shared<ArrayBuffer>(0);
+  }
+  return Value{std::make_shared<Uint8Array>(buffer, offset_, length_)};
+}
+
+GoPool::PoolObject::PoolObject(GoPool* pool, int id)
+    : pool_{pool},
+      id_{id} {
+}
+
+Value GoPool::PoolObject::Get(const std::string& key) {
+  if (key == "id") {
+    return Value{static_cast<double>(id_)};
+  }
+  if (key == "size") {
+    return Value{static_cast<double>(pool_->size())};
+  }
+  if (key == "onmessage") {
+    return onmessage_;
+  }
+  if (key == "postMessage") {
+    return Value{std::make_shared<Function>(
+      [this](Value self, std::vector<Value> args) -> Value {
+        int to = static_cast<int>(args[0].ToNumber());
+        Value data = args[1];
+        std::shared_ptr<ArrayBuffer> buffer = Value::ReflectGet(data, "buffer").ToArrayBuffer();
+        size_t offset = static_cast<size_t>(Value::ReflectGet(data, "byteOffset").ToNumber());
+        size_t length = static_cast<size_t>(Value::ReflectGet(data, "byteLength").ToNumber());
+        pool_->Send(id_, to, Message{buffer, offset, length});
+        return Value{};
+      })};
+  }
+  return Value{};
+}
+
+void GoPool::PoolObject::Set(const std::string& key, Value value) {
+  if (key == "onmessage") {
+    onmessage_ = value;
+    // Dispatch the messages that arrived before the handler was set.
+    std::vector<std::pair<int, Message>> messages;
+    messages.swap(pending_messages_);
+    for (auto& m : messages) {
+      Dispatch(m.first, std::move(m.second));
+    }
+    return;
+  }
+  error("GoPool::PoolObject::Set: invalid key: " + key);
+}
+
+void GoPool::PoolObject::Dispatch(int from, Message message) {
+  if (onmessage_.IsUndefined() || onmessage_.IsNull()) {
+    pending_messages_.emplace_back(from, std::move(message));
+    return;
+  }
+  Value::ReflectApply(onmessage_, Value{}, {Value{static_cast<double>(from)}, message.ToValue()});
+}
+
+GoPool::GoPool(int size) {
+  if (size <= 0) {
+    error("GoPool::GoPool: size must be positive but " + std::to_string(size));
+  }
+  for (int i = 0; i < size; i++) {
+    auto instance = std::make_unique<Instance>();
+    instance->object = std::make_shared<PoolObject>(this, i);
+    instances_.push_back(std::move(instance));
+  }
+}
+
+GoPool::~GoPool() {
+  Wait();
+}
+
+void GoPool::SetHostHandler(Handler handler) {
+  host_handler_ = std::move(handler);
+}
+
+void GoPool::Start(const std::vector<std::string>& args) {
+  if (started_) {
+    error("GoPool::Start: Start must be called once");
+  }
+  started_ = true;
+  for (auto& instance : instances_) {
+    Instance* i = instance.get();
+    i->go.Global().ToObject().Set("go2cppPool", Value{i->object});
+    i->thread = std::thread{[i, args] {
+      i->exit_code = i->go.Run(args);
+    }};
+  }
+}
+
+void GoPool::Post(int instance, Message message) {
+  Send(kHost, instance, std::move(message));
+}
+
+std::vector<int> GoPool::Wait() {
+  std::vector<int> codes;
+  for (auto& instance : instances_) {
+    if (instance->thread.joinable()) {
+      instance->thread.join();
+    }
+    codes.push_back(instance->exit_code);
+  }
+  return codes;
+}
+
+int GoPool::size() const {
+  return static_cast<int>(instances_.size());
+}
+
+void GoPool::Send(int from, int to, Message message) {
+  if (to == kHost) {
+    if (host_handler_) {
+      host_handler_(from, std::move(message));
+    }
+    return;
+  }
+  if (to == kAnyInstance) {
+    to = 0;
+    for (int i = 1; i < size(); i++) {
+      if (instances_[i]->pending.load(std::memory_order_relaxed) < instances_[to]->pending.load(std::memory_order_relaxed)) {
+        to = i;
+      }
+    }
+  }
+  if (to < 0 || size() <= to) {
+    error("GoPool::Send: invalid instance: " + std::to_string(to));
+  }
+
+  Instance* i = instances_[to].get();
+  i->pending.fetch_add(1, std::memory_order_relaxed);
+  // Message is copyable but a TaskQueue::Task is move-only. Move the message into the task.
+  i->go.EnqueueTask([i, from, message = std::move(message)]() mutable {
+    i->pending.fetch_sub(1, std::memory_order_relaxed);
+    i->object->Dispatch(from, std::move(message));
+  });
+}
+
+}
+`))
@@ -0,0 +1,445 @@
+// SPDX-License-Identifier: Apache-2.0
+
+package gowasm2cpp
+
+import (
+	"strconv"
+	"text/template"
+)
+
+func writeProfiler(dir *outputDir, incpath string, namespace string, funcs []*wasmFunc, options *Options) error {
+	{
+		f := dir.Create("profiler.h")
+
+		if err := profilerHTmpl.Execute(f, struct {
+			IncludeGuard string
+			IncludePath  string
+			Namespace    string
+		}{
+			IncludeGuard: includeGuard(namespace) + "_PROFILER_H",
+			IncludePath:  incpath,
+			Namespace:    namespace,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+	}
+	{
+		f := dir.Create("profiler.cpp")
+
+		// The names are needed only when the functions record their calls.
+		var names []string
+		if options.Profiler {
+			for _, f := range funcs {
+				names = append(names, strconv.Quote(f.Wasm.Name))
+			}
+		}
+
+		if err := profilerCppTmpl.Execute(f, struct {
+			IncludePath string
+			Namespace   string
+			Enabled     bool
+			FuncNames   []string
+		}{
+			IncludePath: incpath,
+			Namespace:   namespace,
+			Enabled:     options.Profiler,
+			FuncNames:   names,
+		}); err != nil {
+			return err
+		}
+		if err := f.Close(); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+var profilerHTmpl = template.Must(template.New("profiler.h").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#ifndef {{.IncludeGuard}}
+#define {{.IncludeGuard}}
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace {{.Namespace}} {
+
+// Profiler samples the Go functions running on all the threads, and writes the samples as a pprof profile keyed by
+// the Go function names, which 'go tool pprof' reads.
+//
+// This works only when the program is generated with the profiler option. Otherwise the functions don't record their
+// calls and Start returns false.
+//
+//   Profiler::Start();
+//   go.Run();
+//   Profiler::Stop();
+//   Profiler::WriteProfile("cpu.pprof");
+//
+// The samples are in wall-clock time. A function waiting in an import function, e.g. a blocking read, is sampled
+// too, but the time when no Go function runs, e.g. waiting for the next task, is not.
+//
+// A stack deeper than ShadowStack::kMaxDepth keeps only its outermost frames, so such a sample is recorded with the
+// leaf "[truncated]" instead of a wrong function.
+class Profiler {
+public:
+  class ShadowStack;
+
+  // Scope records a call of a Go function on the current thread's shadow call stack.
+  class Scope {
+  public:
+    explicit Scope(int32_t func);
+    ~Scope();
+
+  private:
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    ShadowStack& stack_;
+  };
+
+  // ShadowStack is the stack of the Go functions called on a thread. This is written by the thread and read by the
+  // sampling thread without locks. A sample can be torn while the stack changes, which is rare.
+  class ShadowStack {
+  public:
+    static constexpr int32_t kMaxDepth = 1024;
+
+  private:
+    friend class Profiler;
+    friend class Scope;
+
+    std::atomic<int32_t> depth_{0};
+    std::atomic<int32_t> funcs_[kMaxDepth];
+  };
+
+  // Start starts sampling every interval. Start returns false if the program was generated without the profiler
+  // option or the profiler is already started.
+  static bool Start(std::chrono::microseconds interval = std::chrono::microseconds{10000});
+
+  // Stop stops sampling. The samples are kept until the next Start.
+  static void Stop();
+
+  // WriteProfile writes the samples as a pprof profile. The profile is an uncompressed protocol buffer, which 'go
+  // tool pprof' accepts as well as a gzipped one.
+  static void WriteProfile(std::ostream& out);
+  static bool WriteProfile(const std::string& path);
+
+private:
+  static ShadowStack& CurrentStack();
+  static ShadowStack* RegisterCurrentThread();
+};
+
+inline Profiler::Scope::Scope(int32_t func)
+    : stack_{CurrentStack()} {
+  int32_t depth = stack_.depth_.load(std::memory_order_relaxed);
+  if (depth < ShadowStack::kMaxDepth) {
+    stack_.funcs_[depth].store(func, std::memory_order_relaxed);
+  }
+  stack_.depth_.store(depth + 1, std::memory_order_release);
+}
+
+inline Profiler::Scope::~Scope() {
+  stack_.depth_.store(stack_.depth_.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+}
+
+inline Profiler::ShadowStack& Profiler::CurrentStack() {
+  thread_local ShadowStack* stack = RegisterCurrentThread();
+  return *stack;
+}
+
+}
+
+#endif  // {{.IncludeGuard}}
+`))
+
+var profilerCppTmpl = template.Must(template.New("profiler.cpp").Parse(`// Code generated by go2cpp. DO NOT EDIT.
+
+#include "{{.IncludePath}}profiler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {{.Namespace}} {
+
+namespace {
+
+constexpr bool kEnabled = {{.Enabled}};
+
+// kTruncatedFunc is the pseudo function index for the leaf of a stack deeper than ShadowStack::kMaxDepth.
+constexpr int32_t kTruncatedFunc = std::numeric_limits<int32_t>::max();
+
+// kFuncNames is the Go function names indexed by the Wasm function indices.
+{{if .FuncNames}}const char* const kFuncNames[] = {
+{{range $value := .FuncNames}}  {{$value}},
+{{end}}};
+{{else}}const char* const kFuncNames[] = {""};
+{{end}}
+// ProtoWriter encodes a protocol buffer message.
+class ProtoWriter {
+public:
+  void Varint(int field, uint64_t v) {
+    Key(field, 0);
+    WriteVarint(v);
+  }
+
+  void Bytes(int field, const std::string& bytes) {
+    Key(field, 2);
+    WriteVarint(bytes.size());
+    buf_ += bytes;
+  }
+
+  void Message(int field, const ProtoWriter& message) {
+    Bytes(field, message.buf_);
+  }
+
+  void PackedVarints(int field, const std::vector<uint64_t>& vs) {
+    ProtoWriter packed;
+    for (uint64_t v : vs) {
+      packed.WriteVarint(v);
+    }
+    Bytes(field, packed.buf_);
+  }
+
+  const std::string& buf() const {
+    return buf_;
+  }
+
+private:
+  void Key(int field, int wire_type) {
+    WriteVarint((static_cast<uint64_t>(field) << 3) | wire_type);
+  }
+
+  void WriteVarint(uint64_t v) {
+    while (v >= 0x80) {
+      buf_.push_back(static_cast<char>((v & 0x7f) | 0x80));
+      v >>= 7;
+    }
+    buf_.push_back(static_cast<char>(v));
+  }
+
+  std::string buf_;
+};
+
+// StringTable is the string table of a pprof profile. The index 0 is always the empty string.
+class StringTable {
+public:
+  StringTable() {
+    Index("");
+  }
+
+  uint64_t Index(const std::string& str) {
+    auto it = indices_.find(str);
+    if (it != indices_.end()) {
+      return it->second;
+    }
+    uint64_t index = strings_.size();
+    indices_[str] = index;
+    strings_.push_back(str);
+    return index;
+  }
+
+  const std::vector<std::string>& strings() const {
+    return strings_;
+  }
+
+private:
+  std::map<std::string, uint64_t> indices_;
+  std::vector<std::string> strings_;
+};
+
+struct State {
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::vector<std::unique_ptr<Profiler::ShadowStack>> stacks;
+
+  std::thread thread;
+  bool running = false;
+  std::chrono::nanoseconds interval{0};
+  std::chrono::system_clock::time_point start_time;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::duration duration{0};
+
+  // samples maps the stacks, from the leaf to the root, to the numbers of the samples.
+  std::map<std::vector<int32_t>, int64_t> samples;
+};
+
+State& GetState() {
+  // The state is never destroyed so that the threads running Go after main returns can still use it.
+  static State* state = new State();
+  return *state;
+}
+
+}
+
+constexpr int32_t Profiler::ShadowStack::kMaxDepth;
+
+Profiler::ShadowStack* Profiler::RegisterCurrentThread() {
+  State& state = GetState();
+  std::lock_guard<std::mutex> lock{state.mutex};
+  // A stack is kept after its thread exits, as the number of the threads running Go is small.
+  state.stacks.emplace_back(new ShadowStack());
+  return state.stacks.back().get();
+}
+
+bool Profiler::Start(std::chrono::microseconds interval) {
+  if (!kEnabled) {
+    return false;
+  }
+  State& state = GetState();
+  std::lock_guard<std::mutex> lock{state.mutex};
+  if (state.running || state.thread.joinable()) {
+    return false;
+  }
+  state.running = true;
+  state.interval = interval;
+  state.start_time = std::chrono::system_clock::now();
+  state.start = std::chrono::steady_clock::now();
+  state.duration = std::chrono::steady_clock::duration{0};
+  state.samples.clear();
+
+  state.thread = std::thread{[&state] {
+    std::vector<int32_t> stack;
+    std::unique_lock<std::mutex> lock{state.mutex};
+    while (state.running) {
+      state.cond.wait_for(lock, state.interval);
+      if (!state.running) {
+        break;
+      }
+      for (auto& s : state.stacks) {
+        int32_t depth = s->depth_.load(std::memory_order_acquire);
+        if (depth <= 0) {
+          continue;
+        }
+        stack.clear();
+        if (depth > ShadowStack::kMaxDepth) {
+          // The frames between the kept ones and the leaf are unknown.
+          stack.push_back(kTruncatedFunc);
+          depth = ShadowStack::kMaxDepth;
+        }
+        for (int32_t i = depth - 1; i >= 0; i--) {
+          stack.push_back(s->funcs_[i].load(std::memory_order_relaxed));
+        }
+        state.samples[stack]++;
+      }
+    }
+  }};
+  return true;
+}
+
+void Profiler::Stop() {
+  State& state = GetState();
+  {
+    std::lock_guard<std::mutex> lock{state.mutex};
+    if (!state.running) {
+      return;
+    }
+    state.running = false;
+    state.duration = std::chrono::steady_clock::now() - state.start;
+  }
+  state.cond.notify_all();
+  state.thread.join();
+}
+
+void Profiler::WriteProfile(std::ostream& out) {
+  State& state = GetState();
+  std::lock_guard<std::mutex> lock{state.mutex};
+
+  std::chrono::steady_clock::duration duration = state.duration;
+  if (state.running) {
+    duration = std::chrono::steady_clock::now() - state.start;
+  }
+  int64_t period = state.interval.count();
+
+  // See https://github.com/google/pprof/blob/master/proto/profile.proto for the format.
+  ProtoWriter profile;
+  StringTable strings;
+
+  ProtoWriter samples_type;
+  samples_type.Varint(1, strings.Index("samples"));
+  samples_type.Varint(2, strings.Index("count"));
+  profile.Message(1, samples_type);
+
+  ProtoWriter time_type;
+  time_type.Varint(1, strings.Index("wall"));
+  time_type.Varint(2, strings.Index("nanoseconds"));
+  profile.Message(1, time_type);
+
+  std::map<int32_t, bool> funcs;
+  for (auto& s : state.samples) {
+    ProtoWriter sample;
+    // The IDs of the locations and the functions are the function indices plus one, as 0 is invalid.
+    std::vector<uint64_t> locations;
+    for (int32_t func : s.first) {
+      locations.push_back(static_cast<uint64_t>(func) + 1);
+      funcs[func] = true;
+    }
+    sample.PackedVarints(1, locations);
+    sample.PackedVarints(2, {static_cast<uint64_t>(s.second), static_cast<uint64_t>(s.second * period)});
+    profile.Message(2, sample);
+  }
+
+  for (auto& f : funcs) {
+    uint64_t id = static_cast<uint64_t>(f.first) + 1;
+    ProtoWriter line;
+    line.Varint(1, id);
+    ProtoWriter location;
+    location.Varint(1, id);
+    location.Message(4, line);
+    profile.Message(4, location);
+  }
+
+  for (auto& f : funcs) {
+    std::string name;
+    if (f.first == kTruncatedFunc) {
+      name = "[truncated]";
+    } else if (0 <= f.first && f.first < static_cast<int32_t>(sizeof(kFuncNames) / sizeof(kFuncNames[0]))) {
+      name = kFuncNames[f.first];
+    }
+    if (name.empty()) {
+      name = "func" + std::to_string(f.first);
+    }
+    ProtoWriter function;
+    function.Varint(1, static_cast<uint64_t>(f.first) + 1);
+    function.Varint(2, strings.Index(name));
+    function.Varint(3, strings.Index(name));
+    profile.Message(5, function);
+  }
+
+  ProtoWriter period_type;
+  period_type.Varint(1, strings.Index("wall"));
+  period_type.Varint(2, strings.Index("nanoseconds"));
+
+  for (const std::string& str : strings.strings()) {
+    profile.Bytes(6, str);
+  }
+  profile.Varint(9, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(state.start_time.time_since_epoch()).count()));
+  profile.Varint(10, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+  profile.Message(11, period_type);
+  profile.Varint(12, static_cast<uint64_t>(period));
+
+  out.write(profile.buf().data(), profile.buf().size());
+}
+
+bool Profiler::WriteProfile(const std::string& path) {
+  std::ofstream out{path, std::ios::binary};
+  if (!out) {
+    return false;
+  }
+  WriteProfile(out);
+  return static_cast<bool>(out);
+}
+
+}
+`))
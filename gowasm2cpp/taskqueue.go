@@ -3,18 +3,12 @@
 package gowasm2cpp
 
 import (
-	"os"
-	"path/filepath"
 	"text/template"
 )
 
-func writeTaskQueue(dir string, incpath string, namespace string) error {
+func writeTaskQueue(dir *outputDir, incpath string, namespace string) error {
 	{
-		f, err := os.Create(filepath.Join(dir, "taskqueue.h"))
-		if err != nil {
-			return err
-		}
-		defer f.Close()
+		f := dir.Create("taskqueue.h")
 
 		if err := taskqueueHTmpl.Execute(f, struct {
 			IncludeGuard string
@@ -27,13 +21,12 @@ func writeTaskQueue(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
-	}
-	{
-		f, err := os.Create(filepath.Join(dir, "taskqueue.cpp"))
-		if err != nil {
+		if err := f.Close(); err != nil {
 			return err
 		}
-		defer f.Close()
+	}
+	{
+		f := dir.Create("taskqueue.cpp")
 
 		if err := taskqueueCppTmpl.Execute(f, struct {
 			IncludePath string
@@ -44,6 +37,9 @@ func writeTaskQueue(dir string, incpath string, namespace string) error {
 		}); err != nil {
 			return err
 		}
+		if err := f.Close(); err != nil {
+			return err
+		}
 	}
 	return nil
 }
@@ -53,46 +49,209 @@ var taskqueueHTmpl = template.Must(template.New("taskqueue.h").Parse(`// Code ge
 #ifndef {{.IncludeGuard}}
 #define {{.IncludeGuard}}
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace {{.Namespace}} {
 
 class TaskQueue {
 public:
-  using Task = std::function<void()>;
+  // Task is a move-only callable. A small callable is stored inline without a heap allocation.
+  class Task {
+  public:
+    Task() = default;
+
+    template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) {
+      using Func = typename std::decay<F>::type;
+      Construct<Func>(std::forward<F>(f), std::integral_constant<bool, IsInlinable<Func>()>{});
+    }
+
+    Task(Task&& rhs) noexcept;
+    Task& operator=(Task&& rhs) noexcept;
+    ~Task();
+
+    explicit operator bool() const { return ops_ != nullptr; }
+    void operator()() { ops_->invoke(&storage_); }
+
+  private:
+    static constexpr size_t kInlineSize = 6 * sizeof(void*);
+    using Storage = typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type;
+
+    struct Ops {
+      void (*invoke)(void* storage);
+      void (*move)(void* dst, void* src);
+      void (*destroy)(void* storage);
+    };
+
+    template<typename Func>
+    static constexpr bool IsInlinable() {
+      return sizeof(Func) <= kInlineSize && alignof(Func) <= alignof(Storage) &&
+          std::is_nothrow_move_constructible<Func>::value;
+    }
+
+    template<typename Func>
+    struct InlineOps {
+      static void Invoke(void* storage) {
+        (*static_cast<Func*>(storage))();
+      }
+      static void Move(void* dst, void* src) {
+        new (dst) Func(std::move(*static_cast<Func*>(src)));
+        static_cast<Func*>(src)->~Func();
+      }
+      static void Destroy(void* storage) {
+        static_cast<Func*>(storage)->~Func();
+      }
+      static constexpr Ops kOps = {Invoke, Move, Destroy};
+    };
+
+    template<typename Func>
+    struct HeapOps {
+      static void Invoke(void* storage) {
+        (**static_cast<Func**>(storage))();
+      }
+      static void Move(void* dst, void* src) {
+        *static_cast<Func**>(dst) = *static_cast<Func**>(src);
+      }
+      static void Destroy(void* storage) {
+        delete *static_cast<Func**>(storage);
+      }
+      static constexpr Ops kOps = {Invoke, Move, Destroy};
+    };
+
+    template<typename Func, typename F>
+    void Construct(F&& f, std::true_type) {
+      new (&storage_) Func(std::forward<F>(f));
+      ops_ = &InlineOps<Func>::kOps;
+    }
+
+    template<typename Func, typename F>
+    void Construct(F&& f, std::false_type) {
+      *reinterpret_cast<Func**>(&storage_) = new Func(std::forward<F>(f));
+      ops_ = &HeapOps<Func>::kOps;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    Storage storage_;
+    const Ops* ops_ = nullptr;
+  };
+
+  TaskQueue();
 
+  // Enqueue is concurrent-safe.
   void Enqueue(Task task);
-  Task Dequeue();
+
+  // DequeueAll blocks until at least one task is enqueued, and then moves all the enqueued tasks into tasks in the
+  // order they were enqueued. DequeueAll must be called from one thread at a time.
+  void DequeueAll(std::vector<Task>& tasks);
 
 private:
+  // Slot is an entry of the ring buffer (D. Vyukov's bounded queue).
+  struct Slot {
+    std::atomic<size_t> sequence;
+    Task task;
+  };
+
+  static constexpr size_t kRingSize = 1024;
+
+  TaskQueue(const TaskQueue&) = delete;
+  TaskQueue& operator=(const TaskQueue&) = delete;
+
+  bool TryPush(Task& task);
+  bool TryPop(Task& task);
+  bool IsEmpty();
+
+  std::unique_ptr<Slot[]> ring_;
+  std::atomic<size_t> enqueue_pos_{0};
+  size_t dequeue_pos_ = 0;
+
+  // overflow_ holds tasks while the ring buffer is full. While overflowed_ is true, all the tasks are enqueued to
+  // overflow_ to keep the order.
+  std::atomic<bool> overflowed_{false};
+  std::mutex overflow_mutex_;
+  std::deque<Task> overflow_;
+
+  std::atomic<bool> waiting_{false};
   std::mutex mutex_;
   std::condition_variable cond_;
-  std::queue<Task> queue_;
 };
 
-class Timer {
+template<typename Func>
+constexpr TaskQueue::Task::Ops TaskQueue::Task::InlineOps<Func>::kOps;
+
+template<typename Func>
+constexpr TaskQueue::Task::Ops TaskQueue::Task::HeapOps<Func>::kOps;
+
+// TimerService runs callbacks after their delays on one thread shared by all the timers.
+class TimerService {
 public:
-  Timer(std::function<void()> func, double interval);
-  ~Timer();
+  struct Stats {
+    // The number of the callbacks that have been fired.
+    uint64_t fired_count = 0;
+
+    // The differences between the deadlines and the actual times the callbacks were fired, in milliseconds.
+    double total_jitter = 0;
+    double max_jitter = 0;
+  };
 
-  void Stop();
+  TimerService();
+
+  // The destructor stops the thread. Pending callbacks are discarded.
+  ~TimerService();
+
+  // Schedule is concurrent-safe. Schedule returns an ID to cancel the callback.
+  uint64_t Schedule(double milliseconds, TaskQueue::Task func);
+
+  // Cancel is concurrent-safe. If Cancel returns true, the callback is never fired. Cancel returns false if the
+  // callback has already been fired or is being fired.
+  bool Cancel(uint64_t id);
+
+  Stats GetStats();
 
 private:
-  enum class Result {
-    kTimeout,
-    kNoTimeout,
+  using Clock = std::chrono::steady_clock;
+
+  struct Entry {
+    Clock::time_point deadline;
+    uint64_t id;
+
+    bool operator>(const Entry& rhs) const {
+      if (deadline != rhs.deadline) {
+        return deadline > rhs.deadline;
+      }
+      return id > rhs.id;
+    }
   };
 
-  Result WaitFor(double milliseconds);
+  TimerService(const TimerService&) = delete;
+  TimerService& operator=(const TimerService&) = delete;
+
+  void Loop();
 
   // All the member variables other than a thread must be initialized before the thread.
-  bool stopped_ = false;
   std::mutex mutex_;
   std::condition_variable cond_;
+  bool stopped_ = false;
+  uint64_t next_id_ = 1;
+  // entries_ is a min-heap of the deadlines.
+  std::vector<Entry> entries_;
+  std::unordered_map<uint64_t, TaskQueue::Task> funcs_;
+  Stats stats_;
 
   std::thread thread_;
 };
@@ -106,56 +265,230 @@ var taskqueueCppTmpl = template.Must(template.New("taskqueue.cpp").Parse(`// Cod
 
 #include "{{.IncludePath}}taskqueue.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <memory>
 
 namespace {{.Namespace}} {
 
+TaskQueue::Task::Task(Task&& rhs) noexcept
+    : ops_{rhs.ops_} {
+  if (ops_) {
+    ops_->move(&storage_, &rhs.storage_);
+    rhs.ops_ = nullptr;
+  }
+}
+
+TaskQueue::Task& TaskQueue::Task::operator=(Task&& rhs) noexcept {
+  if (this == &rhs) {
+    return *this;
+  }
+  if (ops_) {
+    ops_->destroy(&storage_);
+  }
+  ops_ = rhs.ops_;
+  if (ops_) {
+    ops_->move(&storage_, &rhs.storage_);
+    rhs.ops_ = nullptr;
+  }
+  return *this;
+}
+
+TaskQueue::Task::~Task() {
+  if (ops_) {
+    ops_->destroy(&storage_);
+  }
+}
+
+TaskQueue::TaskQueue()
+    : ring_{new Slot[kRingSize]} {
+  for (size_t i = 0; i < kRingSize; i++) {
+    ring_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
 void TaskQueue::Enqueue(Task task) {
-  {
+  if (overflowed_.load(std::memory_order_acquire) || !TryPush(task)) {
+    std::lock_guard<std::mutex> lock{overflow_mutex_};
+    overflow_.push_back(std::move(task));
+    overflowed_.store(true, std::memory_order_seq_cst);
+  }
+
+  // Wake the consumer only when it is sleeping. This pairs with the check in DequeueAll.
+  if (waiting_.load(std::memory_order_seq_cst)) {
     std::lock_guard<std::mutex> lock{mutex_};
-    queue_.push(task);
+    cond_.notify_one();
   }
-  cond_.notify_one();
 }
 
-TaskQueue::Task TaskQueue::Dequeue() {
-  std::unique_lock<std::mutex> lock{mutex_};
-  cond_.wait(lock, [this]{ return !queue_.empty(); });
-  Task task = queue_.front();
-  queue_.pop();
-  return task;
+void TaskQueue::DequeueAll(std::vector<Task>& tasks) {
+  if (IsEmpty()) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    waiting_.store(true, std::memory_order_seq_cst);
+    cond_.wait(lock, [this]{ return !IsEmpty(); });
+    waiting_.store(false, std::memory_order_relaxed);
+  }
+
+  Task task;
+  while (TryPop(task)) {
+    tasks.push_back(std::move(task));
+  }
+  if (overflowed_.load(std::memory_order_acquire)) {
+    std::deque<Task> overflow;
+    {
+      std::lock_guard<std::mutex> lock{overflow_mutex_};
+      // Take the tasks on the ring buffer again, as they might have been enqueued before the tasks in overflow_.
+      while (TryPop(task)) {
+        tasks.push_back(std::move(task));
+      }
+      overflow.swap(overflow_);
+      overflowed_.store(false, std::memory_order_release);
+    }
+    for (Task& t : overflow) {
+      tasks.push_back(std::move(t));
+    }
+  }
+}
+
+bool TaskQueue::TryPush(Task& task) {
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Slot* slot = nullptr;
+  for (;;) {
+    slot = &ring_[pos % kRingSize];
+    size_t seq = slot->sequence.load(std::memory_order_acquire);
+    intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The ring buffer is full.
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  slot->task = std::move(task);
+  slot->sequence.store(pos + 1, std::memory_order_seq_cst);
+  return true;
 }
 
-Timer::Timer(std::function<void()> func, double interval)
-    : thread_{[this, interval](std::function<void()> func) {
-        Result result = WaitFor(interval);
-        if (result == Timer::Result::kNoTimeout) {
-          return;
-        }
-        func();
-      }, std::move(func)} {
+bool TaskQueue::TryPop(Task& task) {
+  Slot& slot = ring_[dequeue_pos_ % kRingSize];
+  size_t seq = slot.sequence.load(std::memory_order_acquire);
+  if (seq != dequeue_pos_ + 1) {
+    return false;
+  }
+  task = std::move(slot.task);
+  slot.sequence.store(dequeue_pos_ + kRingSize, std::memory_order_release);
+  dequeue_pos_++;
+  return true;
 }
 
-Timer::~Timer() {
-  if (thread_.joinable()) {
-    thread_.join();
+bool TaskQueue::IsEmpty() {
+  if (overflowed_.load(std::memory_order_seq_cst)) {
+    return false;
   }
+  const Slot& slot = ring_[dequeue_pos_ % kRingSize];
+  return slot.sequence.load(std::memory_order_seq_cst) != dequeue_pos_ + 1;
+}
+
+TimerService::TimerService()
+    : thread_{[this]{ Loop(); }} {
 }
 
-void Timer::Stop() {
+TimerService::~TimerService() {
   {
     std::lock_guard<std::mutex> lock{mutex_};
     stopped_ = true;
   }
   cond_.notify_one();
+  thread_.join();
+}
+
+uint64_t TimerService::Schedule(double milliseconds, TaskQueue::Task func) {
+  auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::milli>(milliseconds));
+  uint64_t id = 0;
+  bool earliest = false;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    id = next_id_;
+    next_id_++;
+    earliest = entries_.empty() || deadline < entries_.front().deadline;
+    entries_.push_back(Entry{deadline, id});
+    std::push_heap(entries_.begin(), entries_.end(), std::greater<Entry>{});
+    funcs_.emplace(id, std::move(func));
+  }
+  // The thread needs to wake up earlier only when the new deadline is the earliest.
+  if (earliest) {
+    cond_.notify_one();
+  }
+  return id;
 }
 
-Timer::Result Timer::WaitFor(double milliseconds) {
+bool TimerService::Cancel(uint64_t id) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (funcs_.erase(id) == 0) {
+    return false;
+  }
+
+  // The entry in entries_ is left and skipped later. Remove such entries when they are the majority.
+  if (entries_.size() > 64 && entries_.size() > funcs_.size() * 2) {
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [this](const Entry& e) {
+      return funcs_.find(e.id) == funcs_.end();
+    }), entries_.end());
+    std::make_heap(entries_.begin(), entries_.end(), std::greater<Entry>{});
+  }
+  return true;
+}
+
+TimerService::Stats TimerService::GetStats() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return stats_;
+}
+
+void TimerService::Loop() {
   std::unique_lock<std::mutex> lock{mutex_};
-  auto duration = std::chrono::duration<double, std::milli>(milliseconds);
-  bool result = cond_.wait_for(lock, duration, [this]{ return stopped_; });
-  return result ? Result::kNoTimeout : Result::kTimeout;
+  for (;;) {
+    if (stopped_) {
+      return;
+    }
+    if (entries_.empty()) {
+      cond_.wait(lock);
+      continue;
+    }
+
+    Entry entry = entries_.front();
+    auto it = funcs_.find(entry.id);
+    if (it == funcs_.end()) {
+      // Canceled.
+      std::pop_heap(entries_.begin(), entries_.end(), std::greater<Entry>{});
+      entries_.pop_back();
+      continue;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (now < entry.deadline) {
+      cond_.wait_until(lock, entry.deadline);
+      continue;
+    }
+
+    std::pop_heap(entries_.begin(), entries_.end(), std::greater<Entry>{});
+    entries_.pop_back();
+    TaskQueue::Task func = std::move(it->second);
+    funcs_.erase(it);
+
+    double jitter = std::chrono::duration<double, std::milli>(now - entry.deadline).count();
+    stats_.fired_count++;
+    stats_.total_jitter += jitter;
+    stats_.max_jitter = std::max(stats_.max_jitter, jitter);
+
+    lock.unlock();
+    func();
+    lock.lock();
+  }
 }
 
 }